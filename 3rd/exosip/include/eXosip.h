@@ -32,6 +32,7 @@ typedef enum {
     EXOSIP_CALL_CLOSED,
     EXOSIP_CALL_BYE,
     EXOSIP_CALL_ACK,
+    EXOSIP_CALL_MESSAGE_NEW,    /* 对话内新请求（INFO等） */
     EXOSIP_MESSAGE_NEW,
     EXOSIP_MESSAGE_SUCCESS,
     EXOSIP_MESSAGE_FAILURE,
@@ -51,6 +52,7 @@ typedef struct eXosip_event {
     int cid;                    /* 呼叫ID */
     int sid;                    /* 订阅ID */
     int nid;                    /* 通知ID */
+    int rid;                    /* 注册ID */
     osip_message_t *request;    /* SIP请求 */
     osip_message_t *response;   /* SIP响应 */
     void *ctx;                  /* 用户上下文 */
@@ -25,6 +25,7 @@ struct eXosip_t {
     char local_ip[64];
     int local_port;
     char user_agent[128];
+    int next_rid;
 
     eXosip_event_t *events[MAX_EVENTS];
     int event_count;
@@ -137,8 +138,10 @@ void eXosip_unlock(eXosip_t *excontext) {
 
 int eXosip_register_init(eXosip_t *excontext, const char *from,
                          const char *proxy, const char *contact) {
-    /* 简化实现 */
-    return 0;
+    if (!excontext) return -1;
+
+    /* 简化实现：每个注册分配独立的rid */
+    return ++excontext->next_rid;
 }
 
 int eXosip_register_build_initial_register(eXosip_t *excontext, const char *from,
@@ -7,11 +7,14 @@
 #include <memory>
 #include <chrono>
 #include <map>
-#include <thread>
+#include <mutex>
 #include <atomic>
+#include <cstdint>
 
 namespace gb28181 {
 
+class TimerService;
+
 /**
  * @brief 告警级别
  */
@@ -112,14 +115,21 @@ public:
      */
     void SetAlarmCallback(std::function<void(const AlarmInfo&)> callback);
 
+    /**
+     * @brief 设置定时器服务，周期上报挂在其上
+     * @param timerService 定时器服务，需在StartAlarmReporting前设置
+     */
+    void SetTimerService(TimerService* timerService);
+
     /**
      * @brief 启动告警上报
      * @param interval 上报间隔(秒)
+     * @return 未设置定时器服务或间隔无效时返回false
      */
-    void StartAlarmReporting(int interval = 60);
+    bool StartAlarmReporting(int interval = 60);
 
     /**
-     * @brief 停止告警上报
+     * @brief 停止告警上报，等待正在执行的上报回调返回
      */
     void StopAlarmReporting();
 
@@ -145,9 +155,9 @@ private:
     std::string GetCurrentTime();
 
     /**
-     * @brief 告警上报线程
+     * @brief 上报所有活跃告警（定时器回调）
      */
-    void AlarmReportingThread();
+    void ReportActiveAlarms();
 
 private:
     std::map<std::string, AlarmInfo> alarms_;
@@ -156,9 +166,10 @@ private:
     bool initialized_;
     bool reportingEnabled_;
     int reportingInterval_;
-    std::thread reportingThread_;
-    std::atomic<bool> running_;
-    int alarmCounter_;
+    TimerService* timerService_;
+    uint64_t reportingTimer_;
+    std::atomic<int> alarmCounter_;
+    std::mutex mutex_;
 };
 
 } // namespace gb28181
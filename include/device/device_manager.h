@@ -4,6 +4,8 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <vector>
+#include <cstdint>
 
 namespace gb28181 {
 
@@ -53,6 +55,9 @@ public:
     // 获取所有通道
     std::vector<ChannelInfo> GetAllChannels() const;
 
+    // 获取通道数量
+    size_t GetChannelCount() const;
+
     // 设置设备状态
     void SetDeviceStatus(DeviceStatus status);
 
@@ -62,9 +67,14 @@ public:
     // 设置事件回调
     void SetEventCallback(DeviceEventCallback callback);
 
-    // 生成设备目录查询响应
+    // 生成设备目录查询响应（全部通道在一条消息中，通道多时会超过UDP MTU）
     std::string GenerateCatalogResponse() const;
 
+    // 生成一条目录分片消息：从第offset个通道开始，在消息体不超过maxBodyBytes的前提下
+    // 尽量多地放入通道（至少一个），覆盖写入out。返回本条包含的通道数，offset越界返回0
+    size_t GenerateCatalogChunk(std::string& out, uint32_t sn, const std::string& deviceId,
+                                size_t offset, size_t maxBodyBytes) const;
+
     // 生成设备信息查询响应
     std::string GenerateDeviceInfoResponse() const;
 
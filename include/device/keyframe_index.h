@@ -0,0 +1,66 @@
+#ifndef GB28181_KEYFRAME_INDEX_H
+#define GB28181_KEYFRAME_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "device/media_file_reader.h"
+
+namespace gb28181 {
+
+/**
+ * @brief 关键帧索引文件头，位于文件开头，占32字节
+ * 其后紧接定长16字节的KeyframeEntry数组，项数由文件长度得出
+ */
+struct KeyframeIndexHeader {
+    char magic[4];              // "GBKI"
+    uint16_t version;
+    uint8_t videoStreamType;    // PSM中视频流的stream_type
+    uint8_t reserved;
+    uint64_t sourceSize;        // 建立索引时的录像文件大小，与当前大小不符时索引作废
+    uint64_t firstPts;          // 录像第一个PTS (90kHz)，索引项时间相对于它
+    uint64_t durationMs;        // 录像时长
+};
+
+static_assert(sizeof(KeyframeIndexHeader) == 32, "KeyframeIndexHeader must be 32 bytes");
+
+/**
+ * @brief 存放索引文件的子目录名，位于录像文件所在目录下
+ * 索引不与录像放在同一目录，写入索引不改变录像目录的修改时间（录像目录据此判断录像有无增删）
+ */
+extern const char kKeyframeIndexDirectory[];
+
+/**
+ * @brief 录像文件对应的索引文件路径：录像所在目录/index/录像文件名.idx
+ */
+std::string GetKeyframeIndexPath(const std::string& filePath);
+
+/**
+ * @brief 在filePath所在目录下创建索引子目录，已存在时直接返回true
+ */
+bool CreateKeyframeIndexDirectory(const std::string& filePath);
+
+/**
+ * @brief 读取索引文件
+ * @param filePath 录像文件路径
+ * @param header 输出文件头
+ * @param entries 输出索引项，按时间升序
+ * @return 索引文件不存在、格式不符或长度不完整时返回false，sourceSize由调用方核对
+ */
+bool LoadKeyframeIndex(const std::string& filePath, KeyframeIndexHeader& header,
+                       std::vector<KeyframeEntry>& entries);
+
+/**
+ * @brief 写入索引文件，magic和version由本函数填写
+ * 先写临时文件再改名，同一录像被并发打开时不会读到写了一半的索引
+ * @param filePath 录像文件路径
+ * @param header 文件头
+ * @param entries 索引项，按时间升序
+ */
+bool SaveKeyframeIndex(const std::string& filePath, KeyframeIndexHeader header,
+                       const std::vector<KeyframeEntry>& entries);
+
+} // namespace gb28181
+
+#endif // GB28181_KEYFRAME_INDEX_H
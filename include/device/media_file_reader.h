@@ -0,0 +1,202 @@
+#ifndef GB28181_MEDIA_FILE_READER_H
+#define GB28181_MEDIA_FILE_READER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb28181 {
+
+/**
+ * @brief 录像文件中的一帧
+ * data指向文件映射，读取器关闭或析构后失效
+ */
+struct MediaFrame {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    uint64_t timestampMs = 0;       // 相对文件第一帧的时间
+    uint64_t offset = 0;            // 在文件中的字节偏移
+    uint32_t sample = 0;            // MP4样本序号，PS文件为0
+    bool video = false;
+    bool keyframe = false;
+};
+
+/**
+ * @brief 关键帧索引项，定长16字节，与索引文件中的记录布局相同
+ */
+struct KeyframeEntry {
+    uint64_t offset;                // 关键帧所在PS包或MP4样本的字节偏移
+    uint32_t timestampMs;           // 相对文件第一帧的时间
+    uint32_t sample;                // MP4样本序号，PS文件为0
+};
+
+static_assert(sizeof(KeyframeEntry) == 16, "KeyframeEntry must be 16 bytes");
+
+/**
+ * @brief 录像文件读取器
+ * 以只读方式映射整个文件，按帧返回指向映射的视图，不拷贝数据。
+ * PS文件（GB28181录像）每帧是从一个PS包头(00 00 01 BA)到下一个包头之间的完整PS数据，
+ * 可直接按PS over RTP发送；关键帧为带系统头的包或首个视频PES以IDR/参数集开头的包。
+ * MP4文件按moov中的样本表读取视频轨，每帧是一个样本（长度前缀的NALU），关键帧取自stss。
+ * 打开时建立关键帧索引：MP4直接取自样本表；PS优先加载录像旁的索引文件（见SaveKeyframeIndex），
+ * 没有可用索引时按包头跳读整个文件重建并写回索引文件，之后再打开只需一次读取。
+ * 映射按顺序读取提示内核加大预读，读取过程中预取前方窗口、释放已读窗口，
+ * 多路并发回放时常驻内存与预读量可控。非线程安全，每个回放会话使用各自的读取器。
+ */
+class MediaFileReader {
+public:
+    enum class Format {
+        UNKNOWN,
+        PS,
+        MP4
+    };
+
+    MediaFileReader();
+    ~MediaFileReader();
+
+    MediaFileReader(const MediaFileReader&) = delete;
+    MediaFileReader& operator=(const MediaFileReader&) = delete;
+
+    /**
+     * @brief 映射文件、识别格式并建立关键帧索引
+     * @return 文件无法打开或格式不支持时返回false
+     */
+    bool Open(const std::string& filePath);
+
+    void Close();
+
+    bool IsOpen() const {
+        return data_ != nullptr;
+    }
+
+    Format GetFormat() const {
+        return format_;
+    }
+
+    /**
+     * @brief 视频编码（H264/H265），PS文件取自节目流映射，未知时为空
+     */
+    const std::string& GetVideoCodec() const {
+        return videoCodec_;
+    }
+
+    /**
+     * @brief 读取当前位置的一帧并前进
+     * @return 到达文件末尾返回false
+     */
+    bool ReadFrame(MediaFrame& frame);
+
+    /**
+     * @brief 定位到关键帧，下一次ReadFrame从该帧开始
+     */
+    void Seek(const KeyframeEntry& keyframe);
+
+    /**
+     * @brief 不晚于timestampMs的最后一个关键帧（二分查找）
+     * @return 索引为空或第一个关键帧晚于timestampMs时返回nullptr
+     */
+    const KeyframeEntry *FindKeyframe(uint64_t timestampMs) const;
+
+    const std::vector<KeyframeEntry>& GetKeyframes() const {
+        return keyframes_;
+    }
+
+    /**
+     * @brief 文件时长（最后一帧时间）
+     */
+    uint64_t GetDurationMs() const {
+        return durationMs_;
+    }
+
+    uint64_t GetFileSize() const {
+        return size_;
+    }
+
+    /**
+     * @brief 把一个PS包的SCR和其中各PES的PTS/DTS平移shift (90kHz)，按33位回绕
+     * 用于倍速和倒放时改写拷贝出的帧，data须为ReadFrame返回的一个完整PS包
+     */
+    static void ShiftPsTimestamps(uint8_t *data, size_t size, int64_t shift);
+
+private:
+    struct Sample {
+        uint64_t offset;
+        uint32_t size;
+        uint64_t timestampMs;
+        bool keyframe;
+    };
+
+    bool MapFile(const std::string& filePath);
+
+    /**
+     * @brief 解析offset处的PS包，frame.size为到下一个包头的长度
+     * @return offset处没有完整的包时返回false
+     */
+    bool ParsePsFrame(uint64_t offset, MediaFrame& frame);
+
+    /**
+     * @brief 从节目流映射(PSM)中取视频流类型
+     */
+    void ParsePsm(uint64_t offset, uint64_t end);
+
+    /**
+     * @brief 视频PES负载是否以IDR或参数集开头，需已知视频流类型
+     */
+    bool IsKeyframePayload(uint64_t offset, uint64_t end) const;
+
+    /**
+     * @brief 从索引文件加载PS关键帧索引，索引缺失或与文件大小不符时返回false
+     */
+    bool LoadPsIndex(const std::string& filePath);
+
+    /**
+     * @brief 跳读整个PS文件建立关键帧索引
+     */
+    void BuildPsIndex();
+
+    /**
+     * @brief 把重建的索引写入索引文件，覆盖已作废的旧索引
+     */
+    void SavePsIndex(const std::string& filePath) const;
+
+    /**
+     * @brief 解析moov中的视频轨样本表
+     */
+    bool ParseMp4();
+
+    /**
+     * @brief PES中的33位PTS（90kHz）换算为相对第一帧的毫秒，按33位取模处理一次回绕
+     */
+    uint64_t ToRelativeMs(uint64_t pts) const;
+
+    /**
+     * @brief 读取到offset时预取前方窗口并释放已读窗口
+     */
+    void Advise(uint64_t offset);
+
+private:
+    static constexpr uint64_t kReadaheadWindow = 2 * 1024 * 1024;
+
+    const uint8_t *data_;
+    uint64_t size_;
+    Format format_;
+    std::string videoCodec_;
+
+    uint64_t cursor_;               // PS为字节偏移，MP4为样本序号
+    uint64_t adviseWindow_;         // 已预取到的窗口序号
+
+    // PS时间戳换算
+    bool haveFirstPts_;
+    uint64_t firstPts_;
+    uint64_t lastTimestampMs_;      // 没有PTS的包沿用上一帧时间
+    uint8_t videoStreamType_;       // PSM中视频流的stream_type，0x1B为H.264，0x24为H.265
+
+    std::vector<Sample> samples_;   // 仅MP4
+    std::vector<KeyframeEntry> keyframes_;
+    uint64_t durationMs_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_MEDIA_FILE_READER_H
@@ -6,6 +6,10 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "device/media_file_reader.h"
 
 namespace gb28181 {
 
@@ -30,26 +34,86 @@ struct PlaybackControl {
     bool isAudio;           // 是否包含音频
 };
 
+/**
+ * @brief 读取帧的方式，由倍速和方向决定
+ */
+enum class ReadMode {
+    FORWARD,            // 正序发送所有帧
+    REVERSE_GOP,        // 按GOP倒序
+    KEYFRAMES,          // 只发关键帧
+    KEYFRAMES_REVERSE   // 只发关键帧，倒序
+};
+
+/**
+ * @brief 下一帧的状态
+ */
+enum class FrameState {
+    READY,      // 可以发送
+    PAUSED,     // 会话暂停
+    FINISHED    // 会话不存在或已到达结束位置
+};
+
+/**
+ * @brief 回放范围内的一个录像文件
+ */
+struct PlaybackSegment {
+    std::string filePath;   // 文件路径
+    uint64_t startTime;     // 文件第一帧对应的时间(Unix毫秒)
+    uint64_t endTime;       // 文件结束时间(Unix毫秒)
+};
+
 /**
  * @brief 回放会话信息
+ * 除sessionId外的字段由mutex保护
  */
 struct PlaybackSession {
+    std::mutex mutex;        // 会话锁，读文件和帧回调期间持有，不影响其他会话
     std::string sessionId;   // 会话ID
     std::string channelId;  // 通道ID
-    std::string filePath;   // 文件路径
+    std::string filePath;   // 当前读取的文件路径
     uint64_t startTime;     // 开始时间(毫秒)
     uint64_t endTime;       // 结束时间(毫秒)
     uint64_t currentPosition; // 当前位置(毫秒)
     PlaybackControl control; // 控制参数
+    double resumeSpeed;     // 暂停前的倍速，恢复时沿用
     bool isActive;          // 是否活跃
+    bool download;          // 是否为下载（s=Download）
+    int downloadSpeed;      // 下载倍速（a=downloadspeed），0表示不限速
+    uint64_t fileStartTime; // 当前录像文件第一帧对应的时间(毫秒)
+    std::unique_ptr<MediaFileReader> reader; // 当前录像文件读取器
+    std::vector<PlaybackSegment> segments;   // 按时间排序的录像文件，读完一个接着读相邻的
+    size_t segmentIndex;    // 当前文件在segments中的序号
+    bool segmentEntered;    // 刚切换到相邻文件，下一帧从文件开头（倒放时从结尾）读取
+
+    // 输出时间戳：连续的一段按 锚点输出时间 + |媒体时间 - 锚点媒体时间| / 倍速 映射，
+    // 开始、拖动、改变倍速和倒放进入上一个GOP时重新锚定，新的一段接在已输出的最大时间戳之后
+    bool started;           // 是否已输出过帧
+    bool anchored;          // 为false时下一帧重新锚定
+    bool anchorReverse;     // 本段媒体时间是否递减（仅关键帧倒放）
+    uint64_t mediaAnchor;   // 锚点媒体时间(毫秒)
+    uint64_t outputAnchor;  // 锚点输出时间(毫秒)
+    uint64_t outputEnd;     // 已输出的最大时间戳(毫秒)
+    int64_t keyframeIndex;  // 倒放或仅关键帧播放时当前关键帧在索引中的序号
+    int64_t gopEnd;         // 倒放时当前GOP的结束偏移（下一个关键帧），-1表示需定位上一个GOP
+    std::vector<uint8_t> frameBuffer; // 改写时间戳时的帧拷贝
+
+    // 已读出未发送的帧（PeekNextFrame读出，ReadNextFrame发送）
+    bool hasPending;
+    ReadMode pendingMode;   // 读出时的读取方式，方式改变时退回重读
+    MediaFrame pending;
 };
 
 /**
  * @brief 回放管理器
- * 用于GB28181历史视音频回放功能
+ * 用于GB28181历史视音频回放和下载，接口线程安全。
+ * 管理器锁只保护会话表，查找时取得会话的shared_ptr后即释放；读文件、改写时间戳和帧回调
+ * 只持有该会话自己的锁，各会话的读取互不阻塞。会话停止后正在进行的读取仍可安全完成。
  */
 class PlaybackManager {
 public:
+    static constexpr uint64_t kFrameDurationMs = 40;    // 按25fps计的每帧时长
+    static constexpr double kDefaultKeyframeOnlySpeed = 2.0;
+
     PlaybackManager();
     ~PlaybackManager();
 
@@ -72,6 +136,54 @@ public:
                              const std::string& endTime,
                              const std::string& filePath);
 
+    /**
+     * @brief 开始回放或下载，会话ID由调用方指定（如SIP Call-ID）
+     * @param sessionId 会话ID
+     * @param channelId 通道ID
+     * @param startMs 开始时间(Unix毫秒)
+     * @param endMs 结束时间(Unix毫秒)
+     * @param filePath 文件路径
+     * @param fileStartMs 录像文件开始时间(Unix毫秒)，用于把文件内时间换算为绝对时间
+     * @param download 是否为下载，下载不按实时节奏发送
+     * @param downloadSpeed 下载倍速，0表示按链路能力尽快发送
+     * @return 文件无法读取或会话ID已存在时返回false
+     */
+    bool StartPlayback(const std::string& sessionId,
+                       const std::string& channelId,
+                       uint64_t startMs,
+                       uint64_t endMs,
+                       const std::string& filePath,
+                       uint64_t fileStartMs,
+                       bool download = false,
+                       int downloadSpeed = 0);
+
+    /**
+     * @brief 开始跨多个录像文件的回放或下载
+     * 从包含开始时间的文件读起，一个文件读完（倒放时读到开头）后接着读相邻的文件，
+     * 文件之间的间隔不发送，输出时间戳保持连续；拖动时切换到目标时间所在的文件
+     * @param segments 按开始时间升序排列的录像文件
+     * @return 没有文件、第一个文件无法读取或会话ID已存在时返回false
+     */
+    bool StartPlayback(const std::string& sessionId,
+                       const std::string& channelId,
+                       uint64_t startMs,
+                       uint64_t endMs,
+                       const std::vector<PlaybackSegment>& segments,
+                       bool download = false,
+                       int downloadSpeed = 0);
+
+    /**
+     * @brief 设置只发关键帧的倍速阈值
+     * 回放倍速绝对值超过该值时按关键帧索引只读取和发送关键帧，带宽与正常播放相当；
+     * 不超过时发送所有帧，倒放时按GOP倒序发送（GOP内仍为正序，由解码端倒序显示）
+     */
+    void SetKeyframeOnlySpeed(double speed);
+
+    /**
+     * @brief 会话是否存在
+     */
+    bool HasSession(const std::string& sessionId) const;
+
     /**
      * @brief 停止回放
      * @param sessionId 会话ID
@@ -95,7 +207,7 @@ public:
     bool PausePlayback(const std::string& sessionId);
 
     /**
-     * @brief 恢复回放
+     * @brief 恢复回放，沿用暂停前的倍速和方向；未暂停时不改变当前倍速
      * @param sessionId 会话ID
      * @return 是否成功
      */
@@ -125,12 +237,35 @@ public:
      */
     bool SeekPlayback(const std::string& sessionId, uint64_t position);
 
+    /**
+     * @brief 按相对回放开始时间的偏移拖动播放（MANSRTSP Range的npt）
+     * @param sessionId 会话ID
+     * @param offset 相对回放开始时间的偏移(毫秒)
+     * @return 是否成功
+     */
+    bool SeekPlaybackOffset(const std::string& sessionId, uint64_t offset);
+
     /**
      * @brief 获取回放会话
      * @param sessionId 会话ID
-     * @return 会话信息
+     * @return 会话信息，不存在时为空；访问字段前需持有会话的mutex
+     */
+    std::shared_ptr<PlaybackSession> GetSession(const std::string& sessionId) const;
+
+    /**
+     * @brief 发送下一帧前应等待的时间
+     * 回放按帧时长除以倍速；下载按a=downloadspeed倍速，未指定时为0（不限速）
+     * @return 微秒，暂停、逐帧或会话不存在时返回-1
+     */
+    int64_t GetFrameDelayUs(const std::string& sessionId) const;
+
+    /**
+     * @brief 读出（但不发送）下一帧并返回其输出时间戳，供调度器计算发送时间
+     * 下一次ReadNextFrame发送的就是这一帧；期间改变倍速会按新倍速重新计算时间戳
+     * @param timestamp 输出时间戳(毫秒)，与ReadNextFrame交给帧回调的时间戳相同
+     * @param pace 发送速度相对时间戳的倍数：回放为1，下载为下载倍速，0表示不限速
      */
-    PlaybackSession* GetSession(const std::string& sessionId);
+    FrameState PeekNextFrame(const std::string& sessionId, uint64_t& timestamp, double& pace);
 
     /**
      * @brief 获取所有活跃会话
@@ -139,15 +274,19 @@ public:
     std::vector<std::string> GetActiveSessions();
 
     /**
-     * @brief 设置帧回调
+     * @brief 设置帧回调，需在开始回放前设置
+     * 回调在持有会话锁时调用，回调中不能再控制同一会话
      * @param callback 帧数据回调函数
      */
     void SetFrameCallback(std::function<void(const uint8_t* data, size_t len, uint64_t timestamp)> callback);
 
     /**
-     * @brief 读取下一帧
+     * @brief 读取下一帧并交给帧回调
+     * 回调收到的数据只在回调期间有效。正常播放时数据直接指向文件映射，时间戳为帧的绝对时间(毫秒)；
+     * 倍速、倒放或只发关键帧时时间戳改写为按倍速压缩后连续递增的输出时间，
+     * PS帧拷贝后同步改写包内的SCR和PTS/DTS
      * @param sessionId 会话ID
-     * @return 是否成功
+     * @return 到达结束时间、文件末尾或开始位置时返回false
      */
     bool ReadNextFrame(const std::string& sessionId);
 
@@ -158,27 +297,72 @@ public:
      */
     bool FileExists(const std::string& filePath);
 
+    /**
+     * @brief 解析时间字符串为毫秒
+     */
+    static uint64_t ParseTimeToMs(const std::string& timeStr);
+
+    /**
+     * @brief 格式化毫秒为本地时间字符串，如2024-01-01T12:00:00
+     */
+    static std::string FormatMsToTime(uint64_t ms);
+
 private:
     /**
      * @brief 生成会话ID
      */
     std::string GenerateSessionId();
 
+    ReadMode GetReadMode(const PlaybackSession& session) const;
+
     /**
-     * @brief 解析时间字符串为毫秒
+     * @brief 打开第index个录像文件作为当前文件
+     * @return 文件不存在或无法读取时返回false，当前文件不变
+     */
+    bool OpenSegment(PlaybackSession& session, size_t index);
+
+    /**
+     * @brief 当前文件读完后切换到下一个（倒放时上一个）仍在回放范围内的文件，跳过无法读取的文件
+     * @return 没有可读的相邻文件时返回false
+     */
+    bool EnterNextSegment(PlaybackSession& session, bool reverse);
+
+    /**
+     * @brief 按当前读取方式读出下一帧存入session.pending，已有待发送帧时直接返回
+     * @return 到达结束位置时返回false
+     */
+    bool LoadPendingFrame(PlaybackSession& session);
+
+    /**
+     * @brief 帧时间换算为输出时间戳
+     * @param commit 是否保存新建立的锚点，预读时不保存
+     */
+    uint64_t MapOutputTime(PlaybackSession& session, uint64_t timestamp, bool commit) const;
+
+    /**
+     * @brief 只发关键帧时读取下一个（倒放时上一个）关键帧
+     * @return 到达文件两端或开始时间时返回false
+     */
+    bool ReadKeyframe(PlaybackSession& session, bool reverse, MediaFrame& frame);
+
+    /**
+     * @brief 按GOP倒序读取下一帧，当前GOP读完后定位到上一个GOP
+     * @return 到达开始时间时返回false
      */
-    uint64_t ParseTimeToMs(const std::string& timeStr);
+    bool ReadReverseGopFrame(PlaybackSession& session, MediaFrame& frame);
 
     /**
-     * @brief 格式化毫秒为时间字符串
+     * @brief 第index个关键帧开始的GOP是否还有不早于开始时间的部分
      */
-    std::string FormatMsToTime(uint64_t ms);
+    static bool GopReachesStart(const PlaybackSession& session, int64_t index);
 
 private:
-    std::map<std::string, std::unique_ptr<PlaybackSession>> sessions_;
+    std::map<std::string, std::shared_ptr<PlaybackSession>> sessions_;
     std::function<void(const uint8_t*, size_t, uint64_t)> frameCallback_;
     bool initialized_;
     int sessionCounter_;
+    std::atomic<double> keyframeOnlySpeed_;
+    mutable std::mutex mutex_;              // 只保护sessions_和sessionCounter_
 };
 
 } // namespace gb28181
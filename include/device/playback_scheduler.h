@@ -0,0 +1,146 @@
+#ifndef GB28181_PLAYBACK_SCHEDULER_H
+#define GB28181_PLAYBACK_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb28181 {
+
+class PlaybackManager;
+
+/**
+ * @brief 回放调度器
+ * 由少量线程按时间戳驱动所有回放会话的ReadNextFrame。会话按ID哈希分到各线程，每个线程维护
+ * 以下一帧发送时间为键的最小堆，只在堆顶到期时醒来，单线程可承载数百路回放。
+ * 发送时间 = 锚点时刻 + (帧时间戳 - 锚点时间戳) / pace，由单调时钟上的锚点直接算出，
+ * 不逐帧累加延时，不会积累漂移。倍速改变时PlaybackManager输出的时间戳保持连续，锚点不变；
+ * 暂停后恢复或落后超过kMaxLagMs时以当前时刻重新锚定。
+ */
+class PlaybackScheduler {
+public:
+    using FinishedCallback = std::function<void(const std::string& sessionId)>;
+    using ActivityCallback = std::function<void(const std::string& sessionId)>;
+
+    static constexpr int64_t kPausePollMs = 40;     // 暂停的会话检查恢复的间隔
+    static constexpr int64_t kMaxLagMs = 500;       // 落后超过该值时不再追赶
+    static constexpr int64_t kActivityIntervalMs = 1000;    // 同一会话上报活动的最小间隔
+
+    /**
+     * @param playbackManager 回放管理器，须比调度器存活更久
+     * @param threadCount 调度线程数
+     */
+    PlaybackScheduler(PlaybackManager* playbackManager, size_t threadCount = 1);
+    ~PlaybackScheduler();
+
+    PlaybackScheduler(const PlaybackScheduler&) = delete;
+    PlaybackScheduler& operator=(const PlaybackScheduler&) = delete;
+
+    /**
+     * @brief 启动调度线程
+     */
+    bool Start();
+
+    /**
+     * @brief 停止调度线程，已加入的会话保留
+     */
+    void Stop();
+
+    /**
+     * @brief 开始按时间戳发送会话的帧，第一帧立即发送
+     * @return 会话已在调度中时返回false
+     */
+    bool Add(const std::string& sessionId);
+
+    /**
+     * @brief 停止调度会话，不停止回放会话本身
+     */
+    void Remove(const std::string& sessionId);
+
+    /**
+     * @brief 会话的控制参数改变后立即重新计算下一帧的发送时间
+     * 未调用时暂停的会话在kPausePollMs内恢复，倍速改变在下一帧发送后生效
+     */
+    void Wake(const std::string& sessionId);
+
+    /**
+     * @brief 设置会话到达结束位置后的回调，在调度线程中调用，需在Start前设置
+     */
+    void SetFinishedCallback(FinishedCallback callback);
+
+    /**
+     * @brief 设置会话活动回调，调度中的会话（包括暂停的）每kActivityIntervalMs至多回调一次，
+     * 用于刷新媒体会话的活动时间。在调度线程中调用，需在Start前设置
+     */
+    void SetActivityCallback(ActivityCallback callback);
+
+    /**
+     * @brief 调度中的会话数
+     */
+    size_t GetSessionCount() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string sessionId;
+        uint32_t generation = 0;        // 每次移除或唤醒递增，使堆中旧的项失效
+        bool active = false;
+        bool ready = false;             // 已预读出下一帧，到期时发送
+        bool anchored = false;
+        Clock::time_point anchorTime;
+        uint64_t anchorTimestamp = 0;
+        Clock::time_point lastActivity; // 上次回调会话活动的时刻
+    };
+
+    struct HeapItem {
+        Clock::time_point due;
+        uint32_t slot;
+        uint32_t generation;
+
+        bool operator>(const HeapItem& other) const {
+            return due > other.due;
+        }
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::thread thread;
+        std::vector<Entry> entries;
+        std::vector<uint32_t> freeSlots;
+        std::unordered_map<std::string, uint32_t> slots;
+        std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    };
+
+    Worker& WorkerFor(const std::string& sessionId) const;
+
+    /**
+     * @brief 发送到期的帧并预读下一帧，计算其发送时间
+     * @return 会话已结束时返回false
+     */
+    bool Service(Entry& entry, Clock::time_point& due);
+
+    void Run(Worker& worker);
+
+private:
+    PlaybackManager *playbackManager_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    FinishedCallback finishedCallback_;
+    ActivityCallback activityCallback_;
+    std::atomic<bool> running_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_PLAYBACK_SCHEDULER_H
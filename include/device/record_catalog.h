@@ -0,0 +1,189 @@
+#ifndef GB28181_RECORD_CATALOG_H
+#define GB28181_RECORD_CATALOG_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb28181 {
+
+/**
+ * @brief 录像目录文件头，位于文件开头，占64字节
+ * 其后依次为通道表（每项32字节，以NUL结尾的通道ID）和按列存放的录像表：
+ * 文件大小uint64[rowCapacity]、开始时间uint32[rowCapacity]、结束时间uint32[rowCapacity]、
+ * 通道序号uint32[rowCapacity]、标志uint8[rowCapacity]。时间为本地时间的秒数。
+ */
+struct RecordCatalogHeader {
+    char magic[4];              // "GBRC"
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t rowCapacity;       // 录像表的行数
+    uint32_t rowCount;          // 已使用的行数，其后的行未写入
+    uint32_t channelCapacity;   // 通道表的项数
+    uint32_t channelCount;      // 已使用的通道数
+    uint64_t directoryTime;     // 与录像目录核对时目录的修改时间，由使用方写入，新建时为0
+    uint8_t padding[32];
+};
+
+static_assert(sizeof(RecordCatalogHeader) == 64, "RecordCatalogHeader must be 64 bytes");
+
+/**
+ * @brief 录像目录
+ * 以列式布局保存录像目录中所有录像的通道、起止时间、大小和类型，文件映射到内存后直接读写，
+ * 录像增删时只改动对应的行，录像目录没有变化时启动无需遍历录像目录。删除的行清除有效标志，之后追加时复用。
+ * 行或通道表写满时按两倍容量重建文件后替换。路径为空或不支持内存映射的平台上只保存在内存中。
+ */
+class RecordCatalog {
+public:
+    static const uint16_t kVersion = 2;
+    static const char kMagic[4];
+    static const uint32_t kInvalidRow = UINT32_MAX;
+    static const size_t kChannelIdSize = 32;            // 通道表每项的字节数，含结尾NUL
+
+    // 标志位
+    static const uint8_t kFlagTypeMask = 0x03;          // RecordType的值
+    static const uint8_t kFlagPrivacy = 0x08;           // 包含隐私遮挡
+    static const uint8_t kFlagExtMask = 0x30;           // 文件扩展名
+    static const uint8_t kFlagExtMp4 = 0x00;            // .mp4
+    static const uint8_t kFlagExtPs = 0x10;             // .ps
+    static const uint8_t kFlagExtMpg = 0x20;            // .mpg
+    static const uint8_t kFlagValid = 0x80;             // 行有效，删除时清除
+
+    RecordCatalog();
+    ~RecordCatalog();
+
+    RecordCatalog(const RecordCatalog&) = delete;
+    RecordCatalog& operator=(const RecordCatalog&) = delete;
+
+    /**
+     * @brief 映射已有的目录文件
+     * @return 文件不存在或格式不符时返回false
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @brief 新建空目录，覆盖已有文件
+     * @param path 目录文件路径，为空时只保存在内存中
+     * @param rowCapacity 初始行数
+     */
+    bool Create(const std::string& path, uint32_t rowCapacity = 1024);
+
+    /**
+     * @brief 刷出修改并解除映射
+     */
+    void Close();
+
+    /**
+     * @brief 将修改同步写入磁盘
+     */
+    void Sync();
+
+    bool IsOpen() const {
+        return base_ != nullptr;
+    }
+
+    /**
+     * @brief 已使用的行数，包括已删除的行
+     */
+    uint32_t GetRowCount() const {
+        return header_ ? header_->rowCount : 0;
+    }
+
+    bool IsValid(uint32_t row) const {
+        return (flags_[row] & kFlagValid) != 0;
+    }
+
+    uint32_t GetChannel(uint32_t row) const { return channels_[row]; }
+    uint32_t GetStartTime(uint32_t row) const { return startTimes_[row]; }
+    uint32_t GetEndTime(uint32_t row) const { return endTimes_[row]; }
+    uint64_t GetFileSize(uint32_t row) const { return fileSizes_[row]; }
+    uint8_t GetFlags(uint32_t row) const { return flags_[row]; }
+
+    /**
+     * @brief 与录像目录核对时记录的目录修改时间
+     */
+    uint64_t GetDirectoryTime() const {
+        return header_ ? header_->directoryTime : 0;
+    }
+
+    void SetDirectoryTime(uint64_t time) {
+        if (header_) {
+            header_->directoryTime = time;
+        }
+    }
+
+    uint32_t GetChannelCount() const {
+        return static_cast<uint32_t>(channelIds_.size());
+    }
+
+    /**
+     * @brief 查找通道ID的序号
+     * @return 通道不存在时返回kInvalidRow
+     */
+    uint32_t FindChannel(const std::string& channelId) const {
+        auto it = channelIndex_.find(channelId);
+        return it != channelIndex_.end() ? it->second : kInvalidRow;
+    }
+
+    /**
+     * @brief 通道序号对应的通道ID
+     */
+    const std::string& GetChannelId(uint32_t channel) const {
+        return channelIds_[channel];
+    }
+
+    /**
+     * @brief 追加一行，通道ID不存在时加入通道表
+     * @param flags 标志位，kFlagValid自动设置
+     * @return 行号，通道ID过长或扩容失败时返回kInvalidRow
+     */
+    uint32_t Append(const std::string& channelId, uint32_t startTime, uint32_t endTime,
+                    uint64_t fileSize, uint8_t flags);
+
+    /**
+     * @brief 删除一行
+     */
+    void Remove(uint32_t row);
+
+private:
+    /**
+     * @brief 分配指定容量的清零存储，映射文件时在path创建文件
+     */
+    bool Allocate(const std::string& path, uint32_t rowCapacity, uint32_t channelCapacity,
+                  uint8_t*& base, size_t& size);
+    void Release(uint8_t *base, size_t size);
+    void Attach(uint8_t *base, size_t size);
+
+    /**
+     * @brief 按新容量重建目录，复制已有的通道和行后替换
+     */
+    bool Grow(uint32_t rowCapacity, uint32_t channelCapacity);
+
+    static size_t LayoutSize(uint32_t rowCapacity, uint32_t channelCapacity);
+
+    uint32_t InternChannel(const std::string& channelId);
+
+private:
+    std::string path_;
+    uint8_t *base_;
+    size_t size_;
+    bool mapped_;                                   // base_为文件映射，否则为堆内存
+
+    RecordCatalogHeader *header_;
+    char *channelTable_;
+    uint64_t *fileSizes_;
+    uint32_t *startTimes_;
+    uint32_t *endTimes_;
+    uint32_t *channels_;
+    uint8_t *flags_;
+
+    std::vector<std::string> channelIds_;           // 通道序号 -> 通道ID
+    std::unordered_map<std::string, uint32_t> channelIndex_;
+    std::vector<uint32_t> freeRows_;                // 已删除可复用的行
+};
+
+} // namespace gb28181
+
+#endif // GB28181_RECORD_CATALOG_H
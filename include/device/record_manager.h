@@ -5,6 +5,9 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <mutex>
+#include <cstdint>
+#include "device/record_catalog.h"
 
 namespace gb28181 {
 
@@ -63,20 +66,23 @@ public:
 
     /**
      * @brief 查询录像信息
+     * 返回与时间范围有交集的录像，按开始时间排序（order为desc时降序，否则升序）后再截取maxResults条
      * @param condition 查询条件
      * @return 录像信息列表
      */
     std::vector<RecordInfo> QueryRecords(const RecordQueryCondition& condition);
 
     /**
-     * @brief 添加录像信息
+     * @brief 添加录像信息，同时写入录像目录
+     * 目录只保存通道、起止时间、大小、类型和隐私遮挡，文件路径按命名规则由通道和时间还原，
+     * 因此只接受录像目录下按命名规则命名的.mp4、.ps和.mpg文件，且文件名与通道和起止时间一致
      * @param record 录像信息
      */
     void AddRecord(const RecordInfo& record);
 
     /**
-     * @brief 删除录像信息
-     * @param deviceId 设备ID
+     * @brief 删除录像信息，同时从录像目录中删除
+     * @param deviceId 设备ID，录像目录只保存本设备的录像，不参与匹配
      * @param channelId 通道ID
      * @param startTime 开始时间
      */
@@ -97,13 +103,28 @@ public:
                                           int sumNum,
                                           const std::vector<RecordInfo>& records);
 
+    /**
+     * @brief 生成一条录像查询应答分片
+     * 从第offset条录像开始，在消息体不超过maxBodyBytes的前提下尽量多地放入条目
+     * （至少一条），覆盖写入out。SumNum为records总数。
+     * @return 本条包含的录像数，offset越界返回0（records为空时生成一条Num=0的应答）
+     */
+    size_t GenerateRecordInfoChunk(std::string& out, uint32_t sn,
+                                   const std::string& deviceId,
+                                   const std::vector<RecordInfo>& records,
+                                   size_t offset, size_t maxBodyBytes) const;
+
     /**
      * @brief 从存储路径加载录像信息
+     * 优先映射录像目录文件，不存在或无效时扫描录像文件并重建。录像目录的修改时间与目录文件中
+     * 记录的不同时，列出录像文件与目录核对：删除文件已不存在的行，新出现的文件补入目录。
+     * 经AddRecord/DeleteRecord增删录像时同步更新记录的修改时间，正常重启不需要核对
      */
     bool LoadRecordsFromStorage();
 
     /**
-     * @brief 扫描录像文件
+     * @brief 扫描录像文件，重建录像目录
+     * 运行中录像文件不经AddRecord加入或删除时调用
      */
     void ScanRecordFiles();
 
@@ -112,7 +133,86 @@ public:
      */
     std::string GetRecordPath() const { return recordPath_; }
 
+    /**
+     * @brief 解析录像时间为本地时间的秒数
+     * 支持2024-01-01T12:00:00、20240101T120000和文件名中的20240101_120000
+     * @return 格式不符时返回false
+     */
+    static bool ParseRecordTime(const std::string& timeStr, int64_t& seconds);
+
 private:
+    /**
+     * @brief 按开始时间排序的录像，row为录像目录中的行号
+     */
+    struct IndexedRecord {
+        uint32_t startTime;
+        uint32_t endTime;
+        uint32_t row;
+    };
+
+    /**
+     * @brief 单个通道的录像索引
+     * 录像按开始时间升序存放。与[start, end]有交集的录像开始时间不晚于end、不早于
+     * start - maxDuration，二分查找定位该区间后只需逐条检查结束时间。
+     */
+    struct ChannelRecords {
+        std::vector<IndexedRecord> records;
+        uint32_t maxDuration = 0;   // 最长录像时长，删除录像时不减小
+    };
+
+    /**
+     * @brief 将录像目录中的一行加入通道索引
+     */
+    void IndexRow(uint32_t row);
+
+    /**
+     * @brief 由录像目录中的一行还原录像信息
+     */
+    RecordInfo MakeRecordInfo(uint32_t row) const;
+
+    /**
+     * @brief 按命名规则由录像目录中的一行还原录像文件名
+     */
+    std::string MakeRecordFileName(uint32_t row) const;
+
+    /**
+     * @brief 列出录像目录与目录文件核对，删除文件已不存在的行，需持有mutex_
+     * @param newFiles 输出目录文件中没有的录像文件名
+     */
+    void ReconcileRecordFiles(std::vector<std::string>& newFiles);
+
+    /**
+     * @brief 把录像目录当前的修改时间记入目录文件，需持有mutex_
+     * 录像增删后、目录文件新建或扩容后调用，下次启动时目录修改时间不变即可跳过核对
+     */
+    void RefreshDirectoryTime();
+
+    /**
+     * @brief 列出录像目录中符合命名规则的文件名，不访问文件本身
+     */
+    void ListRecordFiles(std::vector<std::string>& fileNames);
+
+    /**
+     * @brief 按文件名解析录像信息、读取文件大小后加入目录
+     */
+    void AddRecordFile(const std::string& fileName);
+
+    std::string GetCatalogPath() const;
+
+    /**
+     * @brief 在单个通道中按时间顺序收集匹配的录像
+     * @param limit 最多收集的条数，0为不限
+     */
+    void CollectRecords(const ChannelRecords& channel, int64_t start, int64_t end,
+                        RecordType type, bool descending, size_t limit,
+                        std::vector<const IndexedRecord*>& out) const;
+
+    /**
+     * @brief 录像路径是否位于录像目录下，且文件名按命名规则由channelId和起止时间(秒)组成
+     */
+    bool IsRecordFilePath(const std::string& filePath, const std::string& channelId,
+                          int64_t start, int64_t end);
+
     /**
      * @brief 解析录像文件名
      */
@@ -126,8 +226,11 @@ private:
 
 private:
     std::string recordPath_;
-    std::vector<RecordInfo> records_;
+    RecordCatalog catalog_;
+    std::vector<ChannelRecords> channels_;      // 按录像目录中的通道序号索引
+    size_t recordCount_;
     bool initialized_;
+    mutable std::mutex mutex_;      // 保护catalog_和channels_，查询可在线程池中并发执行
 };
 
 } // namespace gb28181
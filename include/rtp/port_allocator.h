@@ -0,0 +1,95 @@
+#ifndef GB28181_PORT_ALLOCATOR_H
+#define GB28181_PORT_ALLOCATOR_H
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb28181 {
+
+/**
+ * @brief RTP端口分配器
+ * 把[basePort, basePort+portCount)按每会话4个端口（视频RTP/RTCP、音频RTP/RTCP）划分成端口组，
+ * 用两级位图记录占用：第一级每位对应一个端口组，第二级每位表示第一级的一个字已满，
+ * 查找空闲端口组只需扫描常数个字。从上次分配位置之后开始查找，刚释放的端口不会立即复用，
+ * 避免旧会话的迟到报文进入新会话。可选在分配时试绑定端口，被其他程序占用的端口组跳过并不再分配。
+ * 所有接口线程安全。
+ */
+class PortAllocator {
+public:
+    static constexpr int kPortsPerSession = 4;
+
+    /**
+     * @param basePort 起始端口，向上取整为偶数
+     * @param portCount 端口数量
+     * @param validateBind 分配时是否试绑定UDP端口
+     */
+    PortAllocator(int basePort, int portCount, bool validateBind = true);
+
+    PortAllocator(const PortAllocator&) = delete;
+    PortAllocator& operator=(const PortAllocator&) = delete;
+
+    /**
+     * @brief 分配一组端口
+     * @return 组内第一个端口（视频RTP端口，偶数），无可用端口返回-1
+     */
+    int Allocate();
+
+    /**
+     * @brief 释放Allocate返回的端口组，不在范围内的端口忽略
+     */
+    void Release(int port);
+
+    /**
+     * @brief 端口所在的端口组是否已分配
+     */
+    bool IsAllocated(int port) const;
+
+    /**
+     * @brief 空闲端口组数量
+     */
+    size_t GetFreeCount() const;
+
+    /**
+     * @brief 端口组总数
+     */
+    size_t GetCapacity() const {
+        return blockCount_;
+    }
+
+    int GetBasePort() const {
+        return basePort_;
+    }
+
+private:
+    /**
+     * @brief 从start开始循环查找空闲端口组，需持有锁
+     * @return 端口组下标，没有空闲返回-1
+     */
+    int64_t FindFree(size_t start) const;
+
+    void Mark(size_t block);
+    void Unmark(size_t block);
+
+    /**
+     * @brief 端口组内所有端口是否都能绑定
+     */
+    bool CanBind(size_t block) const;
+
+private:
+    const int basePort_;
+    const size_t blockCount_;
+    const bool validateBind_;
+
+    mutable std::mutex mutex_;
+    std::vector<uint64_t> used_;        // 每位一个端口组，1为已占用
+    std::vector<uint64_t> fullWords_;   // 每位对应used_中的一个字，1为该字已满
+    std::vector<uint64_t> unusable_;    // 绑定失败而永久跳过的端口组
+    size_t freeCount_;
+    size_t cursor_;                     // 下次查找的起点
+};
+
+} // namespace gb28181
+
+#endif // GB28181_PORT_ALLOCATOR_H
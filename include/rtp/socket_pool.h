@@ -0,0 +1,135 @@
+#ifndef GB28181_SOCKET_POOL_H
+#define GB28181_SOCKET_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb28181 {
+
+class PortAllocator;
+
+using SocketHandle = intptr_t;
+constexpr SocketHandle kInvalidSocket = -1;
+
+/**
+ * @brief 一路媒体会话的本地套接字
+ * 占用PortAllocator分配的一组4个端口，析构时关闭套接字，端口由持有者归还分配器。
+ */
+struct MediaSockets {
+    enum Index {
+        VIDEO_RTP,
+        VIDEO_RTCP,
+        AUDIO_RTP,
+        AUDIO_RTCP,
+        COUNT
+    };
+
+    int basePort = -1;                      // 视频RTP端口，-1表示无效
+    SocketHandle udp[COUNT] = {kInvalidSocket, kInvalidSocket, kInvalidSocket, kInvalidSocket};
+    SocketHandle tcpListen = kInvalidSocket; // 视频RTP端口上的TCP监听（TCP被动模式）
+
+    MediaSockets() = default;
+    ~MediaSockets();
+
+    MediaSockets(MediaSockets&& other) noexcept;
+    MediaSockets& operator=(MediaSockets&& other) noexcept;
+
+    MediaSockets(const MediaSockets&) = delete;
+    MediaSockets& operator=(const MediaSockets&) = delete;
+
+    bool IsValid() const {
+        return basePort >= 0;
+    }
+
+    /**
+     * @brief 关闭所有套接字，不归还端口
+     */
+    void Close();
+};
+
+/**
+ * @brief 套接字池参数
+ */
+struct SocketPoolOptions {
+    size_t lowWatermark = 8;                // 空闲数低于该值时唤醒后台线程补充
+    size_t highWatermark = 32;              // 后台线程补充到该数量，0表示不预建
+    int sendBufferBytes = 2 * 1024 * 1024;  // SO_SNDBUF
+    int recvBufferBytes = 256 * 1024;       // SO_RCVBUF
+    bool tcpListen = false;                 // 是否同时预建TCP监听套接字
+};
+
+/**
+ * @brief 预建媒体套接字池
+ * 后台线程预先从端口分配器取端口、创建并绑定UDP（可选TCP监听）套接字、设置缓冲区和非阻塞，
+ * 处理INVITE时Claim只从空闲栈弹出一组，O(1)且不做系统调用。空闲数低于低水位时后台补充到高水位；
+ * 池空时Claim同步创建一组作为兜底。
+ */
+class SocketPool {
+public:
+    SocketPool(PortAllocator* portAllocator, const SocketPoolOptions& options);
+    ~SocketPool();
+
+    SocketPool(const SocketPool&) = delete;
+    SocketPool& operator=(const SocketPool&) = delete;
+
+    /**
+     * @brief 启动后台补充线程
+     */
+    bool Start();
+
+    /**
+     * @brief 停止后台线程，关闭空闲套接字并归还端口
+     */
+    void Stop();
+
+    /**
+     * @brief 取一组套接字
+     * @return 端口或套接字资源耗尽时返回无效对象
+     */
+    MediaSockets Claim();
+
+    /**
+     * @brief 关闭一组套接字并归还端口
+     */
+    void Release(MediaSockets sockets);
+
+    /**
+     * @brief 当前空闲的套接字组数
+     */
+    size_t GetIdleCount() const;
+
+    /**
+     * @brief 池空时同步创建的次数
+     */
+    uint64_t GetMissCount() const {
+        return misses_.load(std::memory_order_relaxed);
+    }
+
+private:
+    /**
+     * @brief 分配端口并创建一组套接字
+     */
+    bool Create(MediaSockets& sockets);
+
+    void RefillLoop();
+
+private:
+    PortAllocator *portAllocator_;
+    const SocketPoolOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable refillCondition_;
+    std::vector<MediaSockets> idle_;
+    std::thread thread_;
+    bool running_;
+    std::atomic<uint64_t> misses_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_SOCKET_POOL_H
@@ -0,0 +1,86 @@
+#ifndef GB28181_IDENTITY_TABLE_H
+#define GB28181_IDENTITY_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace gb28181 {
+
+class DeviceManager;
+
+/**
+ * @brief 设备身份注册状态
+ */
+enum class IdentityState : uint8_t {
+    UNREGISTERED,   // 未注册
+    REGISTERING,    // 注册中
+    REGISTERED      // 已注册
+};
+
+/**
+ * @brief 设备身份表
+ * 网关模式下一个进程托管多个GB28181设备身份（如NVR下挂的每路摄像机）。
+ * 按结构数组(SoA)布局存储：定时器扫描只访问状态和时间列，
+ * 不会把账号、密码等冷数据带进缓存。
+ */
+struct IdentityTable {
+    // 冷数据：仅在构建SIP消息时访问
+    std::vector<std::string> deviceIds;     // 设备ID
+    std::vector<std::string> usernames;     // 认证用户名
+    std::vector<std::string> passwords;     // 认证密码
+    std::vector<DeviceManager*> devices;    // 身份自身的设备信息和通道，应答DeviceInfo/Catalog，可为空
+
+    // 热数据：定时器和事件分发访问
+    std::vector<IdentityState> states;      // 注册状态
+    std::vector<int32_t> registerIds;       // eXosip注册ID (rid)，未注册为-1
+    std::vector<uint32_t> sns;              // MANSCDP序列号
+    std::vector<int64_t> nextKeepaliveMs;   // 下次心跳时间(毫秒)，0表示未排期
+    std::vector<uint64_t> keepaliveTimers;  // 心跳定时器ID，0表示无
+    std::vector<uint8_t> missedKeepalives;  // 连续未应答的心跳数
+
+    /**
+     * @brief 添加身份
+     * @return 身份索引，设备ID重复时返回-1
+     */
+    int Add(const std::string& deviceId,
+            const std::string& username,
+            const std::string& password,
+            DeviceManager *device = nullptr);
+
+    /**
+     * @brief 按设备ID查找身份
+     * @return 身份索引，不存在返回-1
+     */
+    int Find(const std::string& deviceId) const;
+
+    /**
+     * @brief 按eXosip注册ID查找身份
+     * @return 身份索引，不存在返回-1
+     */
+    int FindByRegisterId(int rid) const;
+
+    /**
+     * @brief 绑定eXosip注册ID
+     */
+    void SetRegisterId(size_t index, int rid);
+
+    /**
+     * @brief 统计处于指定状态的身份数量
+     */
+    size_t CountInState(IdentityState state) const;
+
+    /**
+     * @brief 身份数量
+     */
+    size_t Size() const { return deviceIds.size(); }
+
+private:
+    std::unordered_map<std::string, uint32_t> byDeviceId_;
+    std::unordered_map<int32_t, uint32_t> byRegisterId_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_IDENTITY_TABLE_H
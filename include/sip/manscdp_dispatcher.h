@@ -0,0 +1,121 @@
+#ifndef GB28181_MANSCDP_DISPATCHER_H
+#define GB28181_MANSCDP_DISPATCHER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace gb28181 {
+
+/**
+ * @brief MANSCDP消息头部字段
+ * 所有字段都是消息体内的视图，消息体释放后失效。
+ */
+struct ManscdpMessage {
+    std::string_view root;          // 根元素：Query/Control/Notify/Response
+    std::string_view cmdType;       // CmdType
+    std::string_view deviceId;      // 第一个DeviceID（目标设备/通道）
+    uint32_t sn = 0;                // SN
+    bool hasSn = false;
+    std::string_view body;          // 完整消息体
+};
+
+/**
+ * @brief 单次前向扫描提取根元素、CmdType、SN和DeviceID
+ * 三个字段都找到后立即停止，扫描代价与消息体后续内容无关。
+ * @return 找到根元素和CmdType返回true
+ */
+bool ParseManscdpMessage(std::string_view body, ManscdpMessage& message);
+
+/**
+ * @brief 查找元素文本，如<PTZCmd>...</PTZCmd>
+ * @return 元素文本视图，不存在返回空视图
+ */
+std::string_view FindManscdpElement(std::string_view body, std::string_view tag);
+
+/**
+ * @brief GB28181 PTZ指令（附录A.3，8字节十六进制）
+ */
+struct PtzCommand {
+    enum class Type : uint8_t {
+        STOP,           // 停止
+        MOVE,           // 方向/变焦
+        PRESET_SET,     // 设置预置位
+        PRESET_CALL,    // 调用预置位
+        PRESET_DELETE,  // 删除预置位
+        OTHER           // 聚焦/光圈/巡航等暂不支持的指令
+    };
+
+    Type type = Type::STOP;
+    uint8_t instruction = 0;        // 字节4指令码
+    uint16_t address = 0;           // 地址（12位）
+    int direction = 0;              // 0=无, 1=上, 2=下, 3=左, 4=右, 5=左上, 6=左下, 7=右上, 8=右下
+    int zoom = 0;                   // 0=无, 1=放大, 2=缩小
+    int panSpeed = 0;               // 水平速度(0-255)
+    int tiltSpeed = 0;              // 垂直速度(0-255)
+    int zoomSpeed = 0;              // 变焦速度(0-15)
+    int presetId = 0;               // 预置位号
+};
+
+/**
+ * @brief 解析8字节十六进制PTZCmd
+ * 校验首字节A5H、字节2的高半字节校验和及字节8的累加校验和。
+ * @return 格式或校验失败返回false
+ */
+bool ParsePtzCommand(std::string_view hex, PtzCommand& command);
+
+/**
+ * @brief MANSCDP命令分发表
+ * 按CmdType查找处理函数。注册时为当前命令集搜索一个无冲突的乘法哈希种子
+ * （完美哈希），查找只取命令名的长度和几个字符计算槽位，再做一次比较，
+ * 代价与注册的命令数量无关。
+ */
+class ManscdpDispatcher {
+public:
+    /**
+     * @brief 处理函数
+     * @return 已自行应答事务返回true，否则由调用方回200 OK
+     */
+    using Handler = std::function<bool(const ManscdpMessage& message, int tid, size_t index)>;
+
+    ManscdpDispatcher();
+
+    /**
+     * @brief 注册命令处理函数，同名覆盖
+     */
+    void Register(const std::string& cmdType, Handler handler);
+
+    /**
+     * @brief 分发命令
+     * @param handled 输出：找到处理函数时为true
+     * @return 处理函数的返回值，未找到返回false
+     */
+    bool Dispatch(const ManscdpMessage& message, int tid, size_t index, bool& handled) const;
+
+    /**
+     * @brief 已注册命令数量
+     */
+    size_t Size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::string cmdType;
+        Handler handler;
+    };
+
+    static uint32_t Key(std::string_view name);
+    size_t Slot(uint32_t key) const;
+    void Rebuild();
+
+private:
+    std::vector<Entry> entries_;
+    std::vector<int> slots_;        // 槽位 -> entries_下标，-1为空
+    uint32_t seed_;
+    int bits_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_MANSCDP_DISPATCHER_H
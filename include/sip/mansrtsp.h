@@ -0,0 +1,43 @@
+#ifndef GB28181_MANSRTSP_H
+#define GB28181_MANSRTSP_H
+
+#include <string_view>
+#include <cstdint>
+
+namespace gb28181 {
+
+/**
+ * @brief MANSRTSP请求方法
+ */
+enum class MansrtspMethod {
+    UNKNOWN,
+    PLAY,       // 播放、恢复、倍速、拖动
+    PAUSE,      // 暂停
+    TEARDOWN    // 停止
+};
+
+/**
+ * @brief MANSRTSP回放控制请求（GB/T 28181附录B，INFO消息体）
+ * 字符串字段指向消息体，消息体释放后失效
+ */
+struct MansrtspRequest {
+    MansrtspMethod method = MansrtspMethod::UNKNOWN;
+    std::string_view methodName;        // 请求行中的方法名
+    uint32_t cseq = 0;
+    bool hasScale = false;
+    double scale = 1.0;                 // Scale，负数为倒放
+    bool hasRange = false;
+    bool rangeNow = false;              // Range: npt=now-，从当前位置继续
+    uint64_t rangeStartMs = 0;          // Range的npt起点，相对回放开始时间
+};
+
+/**
+ * @brief 单次扫描解析MANSRTSP请求，不分配内存
+ * 识别请求行和CSeq、Scale、Range头，其他头忽略
+ * @return 请求行不是"方法 RTSP/1.0"、缺少CSeq或Scale为0时返回false
+ */
+bool ParseMansrtsp(std::string_view body, MansrtspRequest& request);
+
+} // namespace gb28181
+
+#endif // GB28181_MANSRTSP_H
@@ -3,12 +3,22 @@
 
 #include <string>
 #include <memory>
-#include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <functional>
 #include <chrono>
+#include <cstdint>
+#include "utils/event_log.h"
+#include "sip/ssrc_allocator.h"
 
 namespace gb28181 {
 
+class TimerService;
+class PortAllocator;
+struct MediaSockets;
+
 /**
  * @brief 媒体会话状态
  */
@@ -34,6 +44,7 @@ enum class MediaType {
  */
 struct MediaSessionInfo {
     std::string sessionId;       // 会话ID (Call-ID)
+    uint64_t sessionHash;       // 会话ID哈希，用于二进制事件日志
     std::string channelId;      // 通道ID
     std::string remoteIp;       // 远程IP
     int remoteVideoPort;        // 远程视频端口
@@ -45,14 +56,38 @@ struct MediaSessionInfo {
     SessionState state;         // 会话状态
     std::string videoCodec;     // 视频编码格式
     std::string audioCodec;     // 音频编码格式
-    uint32_t videoSsrc;         // 视频SSRC
+    uint32_t videoSsrc;         // 视频SSRC（PS流音视频复用同一SSRC）
     uint32_t audioSsrc;         // 音频SSRC
+    int videoStream;            // 编码流下标，0为主码流
+    std::string mediaParams;    // 应答中的f=媒体参数
     std::chrono::system_clock::time_point createTime;  // 创建时间
     std::chrono::system_clock::time_point lastActivity; // 最后活动时间
 };
 
+/**
+ * @brief 媒体会话句柄
+ * 由槽位下标和代数组成，会话终止后槽位代数递增，旧句柄随之失效，不会访问到复用该槽位的新会话
+ */
+struct SessionHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0;    // 奇数表示有效，0为无效句柄
+
+    bool IsValid() const {
+        return generation != 0;
+    }
+
+    bool operator==(const SessionHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const SessionHandle& other) const {
+        return !(*this == other);
+    }
+};
+
 /**
  * @brief 媒体会话事件回调
+ * 在触发事件的线程中调用，调用时不持有管理器内部的锁
  */
 using SessionEventCallback = std::function<void(const std::string& sessionId,
                                                 SessionState state,
@@ -60,7 +95,9 @@ using SessionEventCallback = std::function<void(const std::string& sessionId,
 
 /**
  * @brief 媒体会话管理器
- * 管理视频点播、回放等媒体会话
+ * 管理视频点播、回放等媒体会话，可被SIP、RTP和定时器线程同时访问。
+ * 会话存放在按块分配、地址不变的槽位中，Call-ID到句柄的索引按哈希分片，每片一把读写锁；
+ * 按句柄读取状态、刷新活动时间只做原子操作，不加锁。会话信息通过拷贝返回，不暴露内部指针。
  */
 class MediaSessionManager {
 public:
@@ -73,6 +110,16 @@ public:
      */
     bool Initialize();
 
+    /**
+     * @brief 设置SIP监控域ID，用于生成GB28181格式的SSRC
+     */
+    void SetRealm(const std::string& realm);
+
+    /**
+     * @brief 设置RTP端口分配器，会话终止时归还其本地端口，需在创建会话前设置
+     */
+    void SetPortAllocator(PortAllocator* portAllocator);
+
     /**
      * @brief 创建新的媒体会话
      * @param sessionId 会话ID (Call-ID)
@@ -80,20 +127,47 @@ public:
      * @param remoteIp 远程IP
      * @param videoCodec 视频编码格式
      * @param audioCodec 音频编码格式
-     * @return 会话信息指针
+     * @param history 是否为历史流（回放、下载），决定SSRC首位
+     * @return 会话句柄，会话已存在、SSRC用尽或未初始化时返回无效句柄
      */
-    MediaSessionInfo* CreateSession(const std::string& sessionId,
-                                   const std::string& channelId,
-                                   const std::string& remoteIp,
-                                   const std::string& videoCodec = "H264",
-                                   const std::string& audioCodec = "PCMA");
+    SessionHandle CreateSession(const std::string& sessionId,
+                                const std::string& channelId,
+                                const std::string& remoteIp,
+                                const std::string& videoCodec = "H264",
+                                const std::string& audioCodec = "PCMA",
+                                bool history = false);
 
     /**
-     * @brief 获取会话
+     * @brief 按会话ID查找句柄
      * @param sessionId 会话ID
-     * @return 会话信息指针，不存在返回nullptr
+     * @return 会话句柄，不存在返回无效句柄
      */
-    MediaSessionInfo* GetSession(const std::string& sessionId);
+    SessionHandle FindSession(const std::string& sessionId) const;
+
+    /**
+     * @brief 获取会话信息副本
+     * @param sessionId 会话ID
+     * @param info 输出会话信息
+     * @return 会话是否存在
+     */
+    bool GetSession(const std::string& sessionId, MediaSessionInfo& info) const;
+
+    /**
+     * @brief 按句柄获取会话信息副本
+     * @return 句柄是否仍然有效
+     */
+    bool GetSession(SessionHandle handle, MediaSessionInfo& info) const;
+
+    /**
+     * @brief 句柄是否仍指向存活的会话（无锁）
+     */
+    bool IsValid(SessionHandle handle) const;
+
+    /**
+     * @brief 按句柄读取会话状态（无锁）
+     * @return 句柄失效时返回TERMINATED
+     */
+    SessionState GetState(SessionHandle handle) const;
 
     /**
      * @brief 更新会话状态
@@ -126,16 +200,33 @@ public:
                        int remoteAudioPort);
 
     /**
-     * @brief 设置SSRC
+     * @brief 把预建的媒体套接字交给会话，会话终止时关闭套接字并归还端口
+     * @return 会话不存在时返回false，套接字随参数析构关闭
+     */
+    bool AttachSockets(const std::string& sessionId, MediaSockets sockets);
+
+    /**
+     * @brief 设置SSRC（如采用平台在y=行中指定的值），原先分配的SSRC被回收
      * @param sessionId 会话ID
      * @param videoSsrc 视频SSRC
      * @param audioSsrc 音频SSRC
-     * @return 是否成功
+     * @return 是否成功；videoSsrc不属于本域或已被其他会话占用时返回false，会话保留原先分配的SSRC
      */
     bool SetSsrc(const std::string& sessionId,
                 uint32_t videoSsrc,
                 uint32_t audioSsrc);
 
+    /**
+     * @brief 设置SDP协商选定的编码流
+     * @param sessionId 会话ID
+     * @param videoStream 编码流下标，0为主码流
+     * @param mediaParams 应答中的f=媒体参数
+     * @return 是否成功
+     */
+    bool SetVideoStream(const std::string& sessionId,
+                        int videoStream,
+                        const std::string& mediaParams);
+
     /**
      * @brief 终止会话
      * @param sessionId 会话ID
@@ -156,14 +247,25 @@ public:
     size_t GetSessionCount();
 
     /**
-     * @brief 清理超时会话
+     * @brief 设置会话超时定时器
+     * @param timerService 定时器服务，nullptr取消所有会话的超时定时器
+     * @param timeoutSeconds 无活动超时时间（秒）
+     * 每个会话在时间轮上挂一个单次定时器，刷新活动时间只更新时间戳；定时器到期时若期间有活动，
+     * 按最后活动时间重新挂上，否则终止会话并触发TERMINATED事件。回调在定时器线程中执行。
+     * 更换或解除时等待旧定时器服务上正在执行的超时回调返回；传nullptr时等待全部超时回调结束，
+     * 返回后可以安全销毁管理器或定时器服务。不能在定时器回调中调用。
+     */
+    void SetTimerService(TimerService* timerService, int timeoutSeconds = 300);
+
+    /**
+     * @brief 立即清理超时会话（全量扫描，未设置定时器服务时使用）
      * @param timeoutSeconds 超时时间（秒）
      * @return 清理的会话数量
      */
     size_t CleanupTimeoutSessions(int timeoutSeconds = 300);
 
     /**
-     * @brief 设置事件回调
+     * @brief 设置事件回调，需在会话开始前设置
      * @param callback 回调函数
      */
     void SetEventCallback(SessionEventCallback callback);
@@ -174,27 +276,89 @@ public:
      */
     void UpdateActivity(const std::string& sessionId);
 
+    /**
+     * @brief 按句柄更新会话活动时间（无锁），供媒体收发线程每包调用
+     */
+    void UpdateActivity(SessionHandle handle);
+
     /**
      * @brief 获取状态名称
      */
     static std::string GetStateName(SessionState state);
 
 private:
+    struct Slot;
+    struct Shard;
+
+    /**
+     * @brief 记录二进制事件并触发事件回调
+     */
+    void TriggerEvent(const std::string& sessionId, uint64_t sessionHash, SessionState state,
+                      EventCode code, const std::string& event, uint32_t arg = 0);
+
+    Shard& GetShard(const std::string& sessionId) const;
+    Slot *GetSlot(uint32_t index) const;
+
     /**
-     * @brief 生成SSRC
+     * @brief 句柄有效时返回槽位，否则返回nullptr
      */
-    uint32_t GenerateSsrc();
+    Slot *ResolveSlot(SessionHandle handle) const;
 
     /**
-     * @brief 触发事件回调
+     * @brief 在分片读锁和槽位锁内对会话执行fn，会话不存在返回false
      */
-    void TriggerEvent(const std::string& sessionId, SessionState state, const std::string& event);
+    template <class F>
+    bool WithSession(const std::string& sessionId, F&& fn);
+
+    SessionHandle AllocateSlot();
+    void ReleaseSlot(uint32_t index);
+
+    /**
+     * @brief 将槽位标记为已终止并使句柄失效，需持有分片写锁
+     * 会话的套接字和本地端口通过sockets、localPort取出，由调用者释放锁后交给ReleaseMedia
+     * @return 终止前的状态
+     */
+    SessionState RetireSlot(Slot *slot, uint64_t& sessionHash, MediaSockets& sockets, int& localPort);
+
+    /**
+     * @brief 关闭会话套接字后归还本地端口
+     */
+    void ReleaseMedia(MediaSockets& sockets, int localPort);
+
+    /**
+     * @brief 会话在idleBeforeNs之后没有活动时将其终止并触发TERMINATED事件
+     * @return 是否终止了会话
+     */
+    bool ExpireIfIdle(const std::string& sessionId, SessionHandle handle, int64_t idleBeforeNs);
+
+    void ArmExpiry(SessionHandle handle, Slot *slot, int64_t delayNs);
+    void OnExpiryTimer(SessionHandle handle);
+
+    /**
+     * @brief 超时定时器的回调执行完毕或被取消不再执行时调用，计数归零时唤醒SetTimerService
+     */
+    void FinishExpiry();
 
 private:
-    std::map<std::string, std::unique_ptr<MediaSessionInfo>> sessions_;
+    static const size_t kShardCount = 16;
+    static const size_t kSlotsPerChunk = 1024;
+    static const size_t kMaxChunks = 1024;
+
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<Slot*> chunks_[kMaxChunks];     // 只增不减，会话槽位地址在管理器生命周期内不变
+    std::mutex slotMutex_;                      // 保护分配新块和空闲槽位列表
+    std::vector<uint32_t> freeSlots_;
+    uint32_t chunkCount_;
+    std::atomic<size_t> sessionCount_;
+    std::atomic<TimerService*> timerService_;
+    std::mutex expiryMutex_;                    // 保护armedExpiries_
+    std::condition_variable expiryDone_;
+    size_t armedExpiries_;                      // 已挂上且回调尚未结束的超时定时器数量
+    PortAllocator *portAllocator_;
+    std::atomic<int64_t> timeoutNs_;
     SessionEventCallback eventCallback_;
-    bool initialized_;
-    uint32_t ssrcCounter_;
+    std::atomic<bool> initialized_;
+    SsrcAllocator ssrcAllocator_;
 };
 
 } // namespace gb28181
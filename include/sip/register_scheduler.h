@@ -0,0 +1,163 @@
+#ifndef GB28181_REGISTER_SCHEDULER_H
+#define GB28181_REGISTER_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <random>
+#include <cstdint>
+
+namespace gb28181 {
+
+/**
+ * @brief 注册调度策略
+ */
+struct RegisterPolicy {
+    int expires = 3600;                 // 注册有效期(秒)
+    double refreshRatio = 0.5;          // 在有效期的该比例处刷新注册
+    int retryBaseMs = 2000;             // 失败重试的初始退避(毫秒)
+    int retryMaxMs = 300000;            // 退避上限(毫秒)
+    double maxRegistersPerSecond = 50;  // 全局REGISTER速率上限(令牌桶速率)
+    int burst = 10;                     // 令牌桶容量
+    int requestTimeoutMs = 32000;       // REGISTER无最终响应的超时(RFC 3261 Timer F)
+    int maxChallenges = 2;              // 单次注册允许的连续401次数
+};
+
+/**
+ * @brief 注册调度统计
+ */
+struct RegisterMetrics {
+    size_t scheduled = 0;       // 已排期未到期
+    size_t queued = 0;          // 已到期，等待令牌
+    size_t inFlight = 0;        // 已发送，等待最终响应
+    uint64_t sent = 0;          // 累计发送
+    uint64_t succeeded = 0;     // 累计成功
+    uint64_t failed = 0;        // 累计失败（含超时）
+    uint64_t timedOut = 0;      // 累计超时
+    uint64_t throttled = 0;     // 因令牌不足被延后的次数
+};
+
+/**
+ * @brief REGISTER调度器
+ * 平台故障恢复后，大量设备同时重试注册会形成风暴。调度器为每个身份维护
+ * 到期时间，失败按指数退避加抖动重试，并用全局令牌桶限制REGISTER发送速率。
+ * 不做任何网络操作：Poll返回应发送的身份索引，由调用方发送。
+ * 非线程安全，应在SIP事件循环线程中使用。
+ */
+class RegisterScheduler {
+public:
+    RegisterScheduler();
+    ~RegisterScheduler();
+
+    /**
+     * @brief 设置调度策略
+     */
+    void SetPolicy(const RegisterPolicy& policy);
+
+    /**
+     * @brief 获取调度策略
+     */
+    const RegisterPolicy& GetPolicy() const { return policy_; }
+
+    /**
+     * @brief 调整身份数量（只增不减）
+     */
+    void Resize(size_t count);
+
+    /**
+     * @brief 在指定时间排期注册
+     * @param index 身份索引
+     * @param dueMs 到期时间(毫秒)
+     */
+    void Schedule(size_t index, int64_t dueMs);
+
+    /**
+     * @brief 取消身份的注册排期（注销时调用）
+     */
+    void Cancel(size_t index);
+
+    /**
+     * @brief 取出到期且获得令牌的身份，并将其标记为发送中
+     * @param nowMs 当前时间(毫秒)
+     * @param out 输出身份索引
+     * @param maxCount 本次最多取出数量
+     * @return 取出数量
+     */
+    size_t Poll(int64_t nowMs, std::vector<uint32_t>& out, size_t maxCount);
+
+    /**
+     * @brief 注册成功，按刷新比例排期下次注册
+     * @param grantedExpires 平台批准的有效期(秒)，<=0时使用策略值
+     */
+    void OnSuccess(size_t index, int64_t nowMs, int grantedExpires = 0);
+
+    /**
+     * @brief 注册失败，按指数退避加抖动排期重试
+     */
+    void OnFailure(size_t index, int64_t nowMs);
+
+    /**
+     * @brief 收到401质询并已重发带认证的REGISTER
+     * @return 质询次数未超限返回true；超限时按失败处理并返回false
+     */
+    bool OnChallenge(size_t index, int64_t nowMs);
+
+    /**
+     * @brief 是否处于发送中
+     */
+    bool IsInFlight(size_t index) const;
+
+    /**
+     * @brief 获取统计信息
+     */
+    RegisterMetrics GetMetrics() const;
+
+    /**
+     * @brief 最近一个排期的到期时间，无排期返回-1
+     */
+    int64_t NextDueMs();
+
+private:
+    enum class SlotState : uint8_t {
+        IDLE,
+        SCHEDULED,
+        QUEUED,
+        IN_FLIGHT
+    };
+
+    struct HeapEntry {
+        int64_t dueMs;
+        uint32_t index;
+
+        bool operator>(const HeapEntry& other) const {
+            return dueMs > other.dueMs;
+        }
+    };
+
+    void Push(size_t index, int64_t dueMs, SlotState state);
+    void RefillTokens(int64_t nowMs);
+    int64_t Jitter(int64_t lo, int64_t hi);
+
+private:
+    RegisterPolicy policy_;
+
+    // 每个身份的调度状态（结构数组）
+    std::vector<SlotState> states_;
+    std::vector<int64_t> dueMs_;
+    std::vector<uint16_t> attempts_;
+    std::vector<uint8_t> challenges_;
+
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap_;
+    std::deque<uint32_t> ready_;
+
+    double tokens_;
+    int64_t lastRefillMs_;
+    std::minstd_rand rng_;
+
+    RegisterMetrics counters_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_REGISTER_SCHEDULER_H
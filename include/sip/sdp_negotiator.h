@@ -2,8 +2,11 @@
 #define GB28181_SDP_NEGOTIATOR_H
 
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include "device/config_manager.h"
 #include <vector>
-#include <map>
 
 namespace gb28181 {
 
@@ -32,17 +35,142 @@ struct SdpMediaInfo {
 };
 
 /**
- * @brief SDP会话信息
+ * @brief SDP中一个负载类型及其rtpmap
  */
-struct SdpSessionInfo {
-    std::string version;           // 协议版本
-    std::string origin;            // 会话发起者
-    std::string sessionName;       // 会话名称
-    std::string connectionInfo;    // 连接信息
-    std::string timing;            // 时间信息
-    std::vector<SdpMediaInfo> mediaInfos; // 媒体信息
+struct SdpPayload {
+    int type = -1;                      // 负载类型编号
+    std::string_view encoding;          // rtpmap编码名称，如PS/H264/PCMA，无rtpmap时为空
+    int clockRate = 0;                  // rtpmap时钟频率
 };
 
+/**
+ * @brief 解析出的m=媒体段
+ */
+struct SdpMedia {
+    static constexpr size_t kMaxPayloads = 8;
+
+    std::string_view type;              // video/audio
+    int port = 0;                       // 端口号
+    std::string_view transport;         // RTP/AVP或TCP/RTP/AVP
+    SdpPayload payloads[kMaxPayloads];  // 按m=行中的顺序
+    size_t payloadCount = 0;
+    std::string_view connectionAddress; // 媒体级c=地址
+    std::string_view direction;         // recvonly/sendonly/sendrecv/inactive
+    std::string_view setup;             // a=setup：active/passive/actpass（TCP传输）
+    std::string_view connection;        // a=connection：new/existing（TCP传输）
+    int downloadSpeed = 0;              // a=downloadspeed（Download）
+    uint64_t fileSize = 0;              // a=filesize（Download）
+    int streamNumber = -1;              // a=streamnumber：0主码流，1子码流，-1未指定
+
+    /**
+     * @brief 按负载类型编号查找
+     */
+    const SdpPayload *FindPayload(int type) const;
+};
+
+/**
+ * @brief 解析出的SDP
+ * 所有字符串字段都是SDP正文内的视图，正文释放后失效。
+ */
+struct SdpDescription {
+    static constexpr size_t kMaxMedia = 4;
+
+    std::string_view origin;            // o=整行内容
+    std::string_view originAddress;     // o=中的地址
+    std::string_view sessionName;       // s=：Play/Playback/Download/Talk
+    std::string_view uri;               // u=：回放/下载的通道ID:参数
+    std::string_view connectionAddress; // 会话级c=地址
+    uint64_t startTime = 0;             // t=开始时间
+    uint64_t stopTime = 0;              // t=结束时间
+    std::string_view ssrc;              // y=：GB28181十位十进制SSRC
+    std::string_view format;            // f=：v/编码格式/分辨率/帧率/码率类型/码率a/编码格式/码率/采样率
+    SdpMedia media[kMaxMedia];
+    size_t mediaCount = 0;
+
+    /**
+     * @brief 查找第一个指定类型的媒体段
+     * @return 不存在返回nullptr
+     */
+    const SdpMedia *FindMedia(std::string_view type) const;
+
+    /**
+     * @brief 媒体段的对端地址，媒体级c=优先于会话级c=
+     */
+    std::string_view GetAddress(const SdpMedia& media) const;
+
+    /**
+     * @brief y=解析为数值
+     * @return 没有y=或不是合法十进制数返回false
+     */
+    bool GetSsrc(uint32_t& ssrc) const;
+};
+
+/**
+ * @brief GB28181 f=媒体参数（附录F），各字段0表示未指定
+ * 格式为 v/编码格式/分辨率/帧率/码率类型/码率大小a/编码格式/码率大小/采样率
+ */
+struct SdpMediaParams {
+    // 视频编码格式
+    static constexpr int kCodecMpeg4 = 1;
+    static constexpr int kCodecH264 = 2;
+    static constexpr int kCodecSvac = 3;
+    static constexpr int kCodec3gp = 4;
+    static constexpr int kCodecH265 = 5;
+
+    // 分辨率，数值越大画面越大
+    static constexpr int kQcif = 1;
+    static constexpr int kCif = 2;
+    static constexpr int k4Cif = 3;
+    static constexpr int kD1 = 4;
+    static constexpr int k720P = 5;
+    static constexpr int k1080P = 6;
+
+    int videoCodec = 0;
+    int resolution = 0;
+    int frameRate = 0;                  // 帧/秒
+    int bitRateType = 0;                // 1固定码率，2可变码率
+    int bitRate = 0;                    // kbps
+    bool hasAudio = false;              // 是否带a/音频部分
+    int audioCodec = 0;                 // 1 G.711，2 G.723.1，3 G.729，4 G.722.1
+    int audioBitRate = 0;               // 码率代码，8为64kbps
+    int sampleRate = 0;                 // 采样率代码，1为8kHz
+};
+
+/**
+ * @brief 解析f=行内容
+ * @return 不以v/开头时返回false
+ */
+bool ParseMediaParams(std::string_view text, SdpMediaParams& params);
+
+/**
+ * @brief 格式化为f=行内容，未指定的字段留空
+ */
+std::string FormatMediaParams(const SdpMediaParams& params);
+
+/**
+ * @brief SDP应答参数
+ */
+struct SdpAnswerOptions {
+    std::string localIp;
+    int rtpPort = 0;
+    std::string sessionName = "Play";
+    SdpMediaFormat videoFormat = SdpMediaFormat::PS;
+    int videoPayloadType = -1;          // 沿用offer中的编号，-1取默认编号
+    SdpMediaFormat audioFormat = SdpMediaFormat::PCMA;
+    int audioPayloadType = -1;
+    std::string ssrc;                   // y=，空时不输出
+    std::string mediaParams;            // f=，空时不输出
+    uint64_t fileSize = 0;              // a=filesize（Download应答），0时不输出
+};
+
+/**
+ * @brief 单次扫描解析SDP，不分配内存
+ * 识别GB28181用到的v/o/s/u/c/t/m/a/y/f行；多于kMaxMedia的m=段和多于kMaxPayloads的负载类型被忽略，
+ * 未知行和格式错误的行跳过。
+ * @return 至少解析出一个m=段返回true
+ */
+bool ParseSdp(std::string_view body, SdpDescription& sdp);
+
 /**
  * @brief SDP协商器
  * 用于GB28181视频流的SDP协商
@@ -67,6 +195,11 @@ public:
         SdpMediaFormat audioFormat = SdpMediaFormat::PCMA
     );
 
+    /**
+     * @brief 按协商结果创建SDP应答，带y=和f=行
+     */
+    std::string CreateSdpAnswer(const SdpAnswerOptions& options);
+
     /**
      * @brief 创建SDP邀请（用于主动发起会话）
      * @param localIp 本地IP
@@ -84,13 +217,6 @@ public:
         SdpMediaFormat audioFormat = SdpMediaFormat::PCMA
     );
 
-    /**
-     * @brief 解析SDP
-     * @param sdpStr SDP字符串
-     * @return SDP会话信息
-     */
-    SdpSessionInfo ParseSdp(const std::string& sdpStr);
-
     /**
      * @brief 获取视频负载类型
      * @param format 视频格式
@@ -112,6 +238,32 @@ public:
      */
     static std::string GetFormatName(SdpMediaFormat format);
 
+    /**
+     * @brief 由rtpmap编码名称得到媒体格式，不区分大小写
+     * @return 不支持的编码返回false
+     */
+    static bool GetFormatByName(std::string_view name, SdpMediaFormat& format);
+
+    /**
+     * @brief 按平台请求的f=参数从本机视频流中选择一路
+     * 指定了码流编号时直接使用；否则选分辨率不超过请求的最大一路，都超过时选最小一路。
+     * 帧率和码率取请求与所选流中的较小值，编码格式和分辨率取所选流的值。
+     * @param requested 请求参数
+     * @param streamNumber a=streamnumber，-1表示未指定
+     * @param streams 本机视频流，下标0为主码流
+     * @param answer 输出应答参数
+     * @return 所选流下标，streams为空时返回0且answer为请求参数
+     */
+    static size_t NegotiateVideo(const SdpMediaParams& requested,
+                                 int streamNumber,
+                                 const std::vector<VideoConfig>& streams,
+                                 SdpMediaParams& answer);
+
+    /**
+     * @brief VideoConfig分辨率(0=QCIF..4=1080P)转换为f=分辨率代码
+     */
+    static int ToMediaParamsResolution(int resolution);
+
 private:
     /**
      * @brief 创建媒体描述行
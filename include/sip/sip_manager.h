@@ -5,11 +5,20 @@
 #include <memory>
 #include <functional>
 #include <vector>
+#include "sip/register_scheduler.h"
 
 namespace gb28181 {
 
 // 前向声明
 class MediaSessionManager;
+class TimerService;
+class DeviceManager;
+class RecordManager;
+class PlaybackManager;
+class PlaybackScheduler;
+class ThreadPool;
+struct SocketPoolOptions;
+struct VideoConfig;
 
 // SIP事件回调类型
 using SipEventCallback = std::function<void(const std::string& event, const std::string& data)>;
@@ -19,6 +28,19 @@ using MediaSessionEventCallback = std::function<void(const std::string& sessionI
                                                      const std::string& state,
                                                      const std::string& event)>;
 
+// 目录应答分片参数
+struct CatalogOptions {
+    size_t maxBodyBytes = 1024;     // 单条MESSAGE消息体上限，加上SIP头后需低于UDP MTU
+    int pacingMs = 20;              // 相邻分片的发送间隔(毫秒)，0表示不限速
+};
+
+// 异步查询参数：目录、录像检索在线程池中执行，结果以MESSAGE发回平台
+struct QueryOptions {
+    int maxCatalogQueries = 1;      // 同时执行的目录查询数
+    int maxRecordQueries = 2;       // 同时执行的录像检索数
+    size_t maxQueuedQueries = 16;   // 每类查询的排队上限，超出时回503
+};
+
 class SipManager {
 public:
     SipManager();
@@ -32,13 +54,75 @@ public:
     bool RegisterToServer(const std::string& serverIp, int serverPort,
                          const std::string& username, const std::string& password);
 
-    // 注销
+    // 注销，与ProcessMessage修改同一份注册状态，须在处理线程中或处理线程停止后调用
     bool Unregister();
 
-    // 发送心跳
+    // 立即发送一次心跳（周期心跳由定时器服务驱动，无需外部调用）
     bool SendHeartbeat();
 
-    // 处理SIP消息
+    // 设置设备管理器，目录查询应答其通道列表
+    void SetDeviceManager(DeviceManager* deviceManager);
+
+    // 设置目录应答分片参数（录像查询应答共用）
+    void SetCatalogOptions(const CatalogOptions& options);
+
+    // 设置录像管理器，录像查询检索其录像列表
+    void SetRecordManager(RecordManager* recordManager);
+
+    // 设置回放管理器，s=Playback/Download的INVITE在其中开始回放会话；需在处理INVITE前调用
+    void SetPlaybackManager(PlaybackManager* playbackManager);
+
+    // 设置回放调度器，回放会话收到ACK后由其按时间戳发送，会话终止时移出
+    void SetPlaybackScheduler(PlaybackScheduler* playbackScheduler);
+
+    // 设置执行目录/录像查询的线程池；未设置时在SIP线程中执行
+    void SetThreadPool(ThreadPool* threadPool);
+
+    // 设置异步查询并发和排队上限
+    void SetQueryOptions(const QueryOptions& options);
+
+    // 设置媒体流本地RTP端口范围，每个会话占4个端口；需在处理INVITE前调用
+    void SetRtpPortRange(int basePort, int portCount);
+
+    // 设置本机视频编码流（下标0为主码流），INVITE按f=请求的分辨率选择其中一路；需在处理INVITE前调用
+    void SetVideoStreams(const std::vector<VideoConfig>& streams);
+
+    // 启用预建媒体套接字池，highWatermark为0时关闭；需在处理INVITE前调用
+    void SetSocketPoolOptions(const SocketPoolOptions& options);
+
+    // 设置共享定时器服务，心跳、注册刷新、会话超时清理都挂在其上
+    // 必须在注册前调用；未设置时内部自建一个
+    void SetTimerService(TimerService* timerService);
+
+    // 设置心跳周期(秒)，连续3次心跳无响应视为离线并重新注册
+    void SetHeartbeatInterval(int seconds);
+
+    // 网关模式：添加一个设备身份，共享同一SIP套接字和事件循环
+    // deviceManager为该身份自身的设备信息和通道，用于应答DeviceInfo和Catalog，由调用方持有
+    // 返回身份索引，设备ID重复返回-1；Initialize传入的设备为主身份(索引0)，使用SetDeviceManager设置的管理器
+    int AddIdentity(const std::string& deviceId, const std::string& username,
+                    const std::string& password, DeviceManager* deviceManager = nullptr);
+
+    // 网关模式：注册所有身份，REGISTER与心跳错峰发送
+    bool RegisterAllIdentities(const std::string& serverIp, int serverPort,
+                               int expires, int heartbeatInterval);
+
+    // 获取身份数量
+    size_t GetIdentityCount() const;
+
+    // 获取已注册身份数量
+    size_t GetRegisteredIdentityCount() const;
+
+    // 设置注册调度策略（刷新比例、退避、全局速率上限）
+    void SetRegisterPolicy(const RegisterPolicy& policy);
+
+    // 获取注册调度策略
+    RegisterPolicy GetRegisterPolicy() const;
+
+    // 获取注册调度统计（排队、发送中数量等）
+    RegisterMetrics GetRegisterMetrics() const;
+
+    // 处理SIP消息及定时器投递的任务
     void ProcessMessage();
 
     // 设置事件回调
@@ -59,6 +143,10 @@ public:
     // 发送MESSAGE消息
     bool SendMessage(const std::string& to, const std::string& content);
 
+    // 以首个设备身份向平台发送MANSCDP通知（如告警），可在任意线程调用，
+    // 消息投递到ProcessMessage线程发送，未注册时丢弃
+    void PostNotify(const std::string& content);
+
     // 发送响应
     bool SendResponse(int tid, int statusCode, const std::string& reason);
 
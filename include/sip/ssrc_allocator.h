@@ -0,0 +1,75 @@
+#ifndef GB28181_SSRC_ALLOCATOR_H
+#define GB28181_SSRC_ALLOCATOR_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+namespace gb28181 {
+
+/**
+ * @brief GB28181 SSRC分配器
+ * 按GB/T 28181-2016附录C生成10位十进制SSRC：第1位0为实时流、1为历史流，
+ * 第2-6位取SIP监控域ID的第4-8位，第7-10位为域内流序号。
+ * 每种流类型的10000个序号用原子位图记录占用情况，分配从快速伪随机数选定的起点开始找空位，
+ * 判重、分配和回收都是O(1)且不加锁，可被多个线程同时调用。
+ */
+class SsrcAllocator {
+public:
+    static constexpr uint32_t kInvalidSsrc = 0xFFFFFFFF;
+    static constexpr uint32_t kSequenceCount = 10000;
+
+    SsrcAllocator();
+
+    SsrcAllocator(const SsrcAllocator&) = delete;
+    SsrcAllocator& operator=(const SsrcAllocator&) = delete;
+
+    /**
+     * @brief 设置SIP监控域ID（如"3402000000"），应在分配前调用
+     */
+    void SetRealm(const std::string& realm);
+
+    /**
+     * @brief 分配SSRC
+     * @param history 是否为历史流（回放、下载）
+     * @return SSRC，序号用尽时返回kInvalidSsrc
+     */
+    uint32_t Allocate(bool history);
+
+    /**
+     * @brief 占用指定的SSRC（如平台在INVITE的y=行中指定的值）
+     * @return 属于本域且此前未被占用时返回true
+     */
+    bool Reserve(uint32_t ssrc);
+
+    /**
+     * @brief 回收SSRC，不属于本域的值忽略
+     */
+    void Release(uint32_t ssrc);
+
+    /**
+     * @brief 已占用的SSRC数量
+     */
+    size_t GetAllocatedCount() const;
+
+private:
+    static constexpr size_t kWordsPerType = (kSequenceCount + 63) / 64;
+
+    /**
+     * @brief 拆分SSRC，不属于本域返回false
+     */
+    bool Decode(uint32_t ssrc, bool& history, uint32_t& sequence) const;
+
+    bool TrySet(bool history, uint32_t sequence);
+    uint64_t NextRandom();
+
+private:
+    std::atomic<uint32_t> realmDigits_;     // 第2-6位的五位域标识
+    std::atomic<uint64_t> randomState_;
+    std::atomic<size_t> allocated_;
+    std::atomic<uint64_t> bitmap_[2][kWordsPerType];
+};
+
+} // namespace gb28181
+
+#endif // GB28181_SSRC_ALLOCATOR_H
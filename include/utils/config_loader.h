@@ -6,6 +6,8 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <vector>
+#include <cstdlib>
 
 namespace gb28181 {
 
@@ -27,65 +29,94 @@ public:
         return true;
     }
 
+    /**
+     * @brief 读取整数配置项
+     * @param key 键名，嵌套对象用点号连接，如"sip.heartbeatInterval"
+     */
+    static int GetInt(const std::map<std::string, std::string>& config,
+                      const std::string& key, int defaultValue) {
+        auto it = config.find(key);
+        if (it == config.end() || it->second.empty()) {
+            return defaultValue;
+        }
+        return std::atoi(it->second.c_str());
+    }
+
 private:
+    // 简化的JSON解析：嵌套对象展开为"父键.子键"，数组元素展开为"父键.下标"
     static void ParseJson(const std::string& json, std::map<std::string, std::string>& config) {
+        std::vector<std::string> path;      // 当前所在容器的键路径
+        std::vector<int> arrayIndex;        // 每层容器的数组下标，-1表示对象
         std::string key;
-        std::string value;
-        bool inKey = false;
-        bool inValue = false;
-        bool inString = false;
+        size_t i = 0;
 
-        for (size_t i = 0; i < json.length(); i++) {
-            char c = json[i];
+        auto fullKey = [&](const std::string& name) {
+            std::string result;
+            for (const auto& part : path) {
+                if (!part.empty()) {
+                    result += part + ".";
+                }
+            }
+            return result + name;
+        };
 
-            if (c == '"' && json[i-1] != '\\') {
-                inString = !inString;
-                continue;
+        // 当前值的键：对象中是最近读到的键，数组中是元素下标
+        auto currentName = [&]() {
+            if (!arrayIndex.empty() && arrayIndex.back() >= 0) {
+                return std::to_string(arrayIndex.back());
             }
+            return key;
+        };
+
+        while (i < json.length()) {
+            char c = json[i];
 
-            if (!inString) {
-                if (c == '{' || c == '}' || c == '[' || c == ']' || c == ',' || c == ':') {
-                    if (!key.empty() && !value.empty()) {
-                        // 去除空格和引号
-                        key = Trim(key);
-                        value = Trim(value);
-                        if (!key.empty() && !value.empty()) {
-                            config[key] = value;
-                        }
-                        key.clear();
-                        value.clear();
+            if (c == '{' || c == '[') {
+                path.push_back(arrayIndex.empty() ? "" : currentName());
+                arrayIndex.push_back(c == '[' ? 0 : -1);
+                key.clear();
+                i++;
+            } else if (c == '}' || c == ']') {
+                if (!path.empty()) {
+                    path.pop_back();
+                    arrayIndex.pop_back();
+                }
+                i++;
+            } else if (c == ',') {
+                if (!arrayIndex.empty() && arrayIndex.back() >= 0) {
+                    arrayIndex.back()++;
+                }
+                key.clear();
+                i++;
+            } else if (c == '"') {
+                std::string str;
+                for (i++; i < json.length() && json[i] != '"'; i++) {
+                    if (json[i] == '\\' && i + 1 < json.length()) {
+                        i++;
                     }
-                    continue;
+                    str += json[i];
                 }
-                if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
-                    continue;
+                i++;
+
+                // 字符串后紧跟冒号的是键，否则是值
+                size_t next = json.find_first_not_of(" \t\n\r", i);
+                bool inArray = !arrayIndex.empty() && arrayIndex.back() >= 0;
+                if (!inArray && next != std::string::npos && json[next] == ':') {
+                    key = str;
+                    i = next + 1;
+                } else {
+                    config[fullKey(currentName())] = str;
                 }
-            }
-
-            if (c == ':') {
-                inKey = false;
-                inValue = true;
-            } else if (c == '"' && json[i-1] != '\\') {
-                // 已经处理
-            } else if (c == '{') {
-                // 进入嵌套对象
-            } else if (c == '}') {
-                // 退出嵌套对象
+            } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ':') {
+                i++;
             } else {
-                if (inKey) {
-                    key += c;
-                } else if (inValue) {
-                    value += c;
+                // 数字、true/false/null
+                size_t end = json.find_first_of(",}] \t\n\r", i);
+                if (end == std::string::npos) {
+                    end = json.length();
                 }
-            }
-        }
-
-        // 处理最后一个键值对
-        if (!key.empty() && !value.empty()) {
-            key = Trim(key);
-            value = Trim(value);
-            if (!key.empty() && !value.empty()) {
-                config[key] = value;
+                config[fullKey(currentName())] = Trim(json.substr(i, end - i));
+                i = end;
             }
         }
     }
@@ -0,0 +1,152 @@
+#ifndef GB28181_EVENT_LOG_H
+#define GB28181_EVENT_LOG_H
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace gb28181 {
+
+/**
+ * @brief 事件码
+ * 只能追加，不能修改已有取值，否则旧的事件文件无法解码
+ */
+enum class EventCode : uint16_t {
+    NONE = 0,
+
+    // 媒体会话，arg0为会话状态
+    SESSION_CREATED = 1,            // arg1为视频SSRC
+    SESSION_STATE_CHANGED = 2,      // arg1为原状态
+    SESSION_TERMINATED = 3,
+    SESSION_TIMEOUT = 4,            // arg1为超时前的状态
+
+    // SIP信令，arg1为事务ID
+    SIP_INVITE_RECEIVED = 100,      // arg0为远端视频端口
+    SIP_INVITE_ANSWERED = 101,      // arg0为本地视频端口
+    SIP_INVITE_REJECTED = 102,      // arg0为应答状态码
+    SIP_ACK_RECEIVED = 103,
+    SIP_BYE_RECEIVED = 104,
+    SIP_INFO_RECEIVED = 105         // arg0为应答状态码
+};
+
+/**
+ * @brief 事件文件头，位于文件开头，占64字节
+ */
+struct EventLogHeader {
+    char magic[8];                      // "GBEVLOG\0"
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;                  // 记录槽数，2的幂
+    std::atomic<uint64_t> writeIndex;   // 下一条记录的序号
+    uint8_t reserved[32];
+};
+
+/**
+ * @brief 事件记录，定长32字节
+ * seq为序号加1，最后写入；解码时seq与槽位不符的记录视为未写完或已被覆盖
+ */
+struct EventRecord {
+    std::atomic<uint64_t> seq;
+    uint64_t timestampNs;       // Unix纪元起的纳秒数
+    uint64_t sessionHash;       // 会话ID (Call-ID) 的FNV-1a哈希
+    uint16_t code;              // EventCode
+    uint16_t arg0;
+    uint32_t arg1;
+};
+
+static_assert(sizeof(EventLogHeader) == 64, "EventLogHeader must be 64 bytes");
+static_assert(sizeof(EventRecord) == 32, "EventRecord must be 32 bytes");
+
+/**
+ * @brief 二进制事件日志
+ * 事件以定长记录写入内存映射的环形文件，写入只有一次原子加和几次内存写，不加锁、
+ * 不格式化、不做系统调用，可在生产环境常开。进程崩溃后文件内容仍由内核写回磁盘，
+ * 用gb28181_event_dump解码为文本或JSON。未打开时Record直接返回。
+ */
+class EventLog {
+public:
+    static const uint32_t kVersion = 1;
+    static const char kMagic[8];
+
+    static EventLog& Instance();
+
+    /**
+     * @brief 打开（不存在则创建）事件文件
+     * @param path 文件路径
+     * @param capacity 记录槽数，向上取整为2的幂
+     * @return 是否成功
+     * 已有文件头匹配时接着原序号追加，否则重新初始化
+     */
+    bool Open(const std::string& path, size_t capacity = 65536);
+
+    /**
+     * @brief 关闭事件文件
+     */
+    void Close();
+
+    bool IsOpen() const {
+        return records_ != nullptr;
+    }
+
+    /**
+     * @brief 写一条事件
+     */
+    void Record(EventCode code, uint64_t sessionHash, uint16_t arg0 = 0, uint32_t arg1 = 0) {
+        if (!records_) {
+            return;
+        }
+
+        uint64_t index = header_->writeIndex.fetch_add(1, std::memory_order_relaxed);
+        EventRecord& record = records_[index & mask_];
+
+        // 先作废槽位再写内容，读者不会把半条新记录当成旧记录
+        record.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        record.timestampNs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+        record.sessionHash = sessionHash;
+        record.code = static_cast<uint16_t>(code);
+        record.arg0 = arg0;
+        record.arg1 = arg1;
+        record.seq.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief 计算会话ID的哈希（64位FNV-1a）
+     */
+    static uint64_t HashSession(std::string_view sessionId) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c : sessionId) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief 事件码名称，未知事件码返回nullptr
+     */
+    static const char *GetEventName(uint16_t code);
+
+private:
+    EventLog();
+    ~EventLog();
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+private:
+    EventLogHeader *header_;
+    EventRecord *records_;
+    uint64_t mask_;
+    void *mapping_;
+    size_t mappingSize_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_EVENT_LOG_H
@@ -2,13 +2,17 @@
 #define GB28181_LOGGER_H
 
 #include <string>
-#include <sstream>
-#include <iostream>
-#include <fstream>
-#include <mutex>
-#include <chrono>
-#include <iomanip>
-#include <ctime>
+#include <string_view>
+#include <atomic>
+#include <memory>
+#include <ios>
+#include <cstdint>
+#include <type_traits>
+
+// 编译期日志级别下限：0=DEBUG 1=INFO 2=WARN 3=ERROR 4=FATAL，低于该级别的日志语句不生成代码
+#ifndef GB28181_LOG_MIN_LEVEL
+#define GB28181_LOG_MIN_LEVEL 0
+#endif
 
 namespace gb28181 {
 
@@ -20,82 +24,175 @@ enum class LogLevel {
     FATAL
 };
 
+/**
+ * @brief 异步日志
+ * 每个线程把日志写入自己的无锁单生产者环形缓冲区（缓冲区满时丢弃并计数，从不阻塞），
+ * 后台线程定期批量取出，按时间排序后一次性写到控制台和日志文件。时间戳前缀按秒缓存，
+ * 每秒只格式化一次。ERROR及以上级别立即唤醒后台线程，FATAL等待写出后才返回。
+ */
 class Logger {
 public:
-    static Logger& Instance() {
-        static Logger instance;
-        return instance;
-    }
+    static Logger& Instance();
 
     void SetLevel(LogLevel level) {
-        level_ = level;
+        level_.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    LogLevel GetLevel() const {
+        return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
     }
 
-    void SetLogFile(const std::string& filename) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (file_.is_open()) {
-            file_.close();
-        }
-        file_.open(filename, std::ios::out | std::ios::app);
+    bool IsEnabled(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
     }
 
-    void Log(LogLevel level, const std::string& message) {
-        if (level < level_) {
-            return;
-        }
+    /**
+     * @brief 设置日志文件（追加写），空字符串关闭文件输出
+     */
+    void SetLogFile(const std::string& filename);
 
-        std::string log = FormatLog(level, message);
+    /**
+     * @brief 是否同时输出到控制台，默认开启
+     */
+    void SetConsoleOutput(bool enabled);
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::cout << log << std::endl;
+    /**
+     * @brief 写一条日志
+     */
+    void Log(LogLevel level, std::string_view message);
 
-        if (file_.is_open()) {
-            file_ << log << std::endl;
-            file_.flush();
-        }
-    }
+    /**
+     * @brief 等待后台线程写出此前提交的所有日志
+     */
+    void Flush();
+
+    /**
+     * @brief 因缓冲区满而丢弃的日志条数
+     */
+    uint64_t GetDroppedCount() const;
+
+private:
+    Logger();
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
 
 private:
-    Logger() : level_(LogLevel::INFO) {}
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+    std::atomic<int> level_;
+};
+
+/**
+ * @brief 日志语句构造器，析构时提交
+ * 格式化写入线程本地缓冲区，整数和浮点数直接用to_chars转换；支持std::hex/std::dec。
+ */
+class LogStream {
+public:
+    explicit LogStream(LogLevel level);
+    ~LogStream();
 
-    std::string FormatLog(LogLevel level, const std::string& message) {
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now.time_since_epoch()) % 1000;
+    LogStream(const LogStream&) = delete;
+    LogStream& operator=(const LogStream&) = delete;
 
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-        ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-        ss << " [" << LevelToString(level) << "] ";
-        ss << message;
+    LogStream& operator<<(std::string_view text) {
+        buffer_->append(text.data(), text.size());
+        return *this;
+    }
+
+    LogStream& operator<<(const std::string& text) {
+        buffer_->append(text);
+        return *this;
+    }
 
-        return ss.str();
+    LogStream& operator<<(const char *text) {
+        buffer_->append(text ? text : "(null)");
+        return *this;
     }
 
-    std::string LevelToString(LogLevel level) {
-        switch (level) {
-            case LogLevel::DEBUG:   return "DEBUG";
-            case LogLevel::INFO:    return "INFO";
-            case LogLevel::WARNING: return "WARN";
-            case LogLevel::ERROR:   return "ERROR";
-            case LogLevel::FATAL:   return "FATAL";
-            default:                return "UNKNOWN";
-        }
+    LogStream& operator<<(char c) {
+        buffer_->push_back(c);
+        return *this;
     }
 
+    LogStream& operator<<(bool value) {
+        buffer_->append(value ? "1" : "0");
+        return *this;
+    }
+
+    template <class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogStream& operator<<(T value) {
+        AppendInteger(static_cast<typename std::conditional<std::is_signed<T>::value,
+                                                           int64_t, uint64_t>::type>(value));
+        return *this;
+    }
+
+    template <class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    LogStream& operator<<(T value) {
+        AppendInteger(static_cast<int64_t>(value));
+        return *this;
+    }
+
+    LogStream& operator<<(double value);
+
+    LogStream& operator<<(const void *pointer);
+
+    LogStream& operator<<(std::ios_base& (*manip)(std::ios_base&));
+
+private:
+    void AppendInteger(int64_t value);
+    void AppendInteger(uint64_t value);
+
 private:
     LogLevel level_;
-    std::ofstream file_;
-    std::mutex mutex_;
+    std::string *buffer_;
+    std::string ownBuffer_;     // 同一线程嵌套构造时使用
+    bool hex_;
+    bool nested_;
 };
 
-#define LOG_DEBUG(msg)  Logger::Instance().Log(LogLevel::DEBUG, msg)
-#define LOG_INFO(msg)   Logger::Instance().Log(LogLevel::INFO, msg)
-#define LOG_WARN(msg)   Logger::Instance().Log(LogLevel::WARNING, msg)
-#define LOG_ERROR(msg)  Logger::Instance().Log(LogLevel::ERROR, msg)
-#define LOG_FATAL(msg)  Logger::Instance().Log(LogLevel::FATAL, msg)
-
 } // namespace gb28181
 
+#define GB28181_LOG(level, msg) \
+    do { \
+        if (::gb28181::Logger::Instance().IsEnabled(level)) { \
+            ::gb28181::LogStream(level) << msg; \
+        } \
+    } while (0)
+
+// 编译期关闭的级别仍做类型检查，但不生成代码
+#define GB28181_LOG_DISABLED(level, msg) \
+    do { \
+        if (false) { \
+            ::gb28181::LogStream(level) << msg; \
+        } \
+    } while (0)
+
+#if GB28181_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(msg)  GB28181_LOG(::gb28181::LogLevel::DEBUG, msg)
+#else
+#define LOG_DEBUG(msg)  GB28181_LOG_DISABLED(::gb28181::LogLevel::DEBUG, msg)
+#endif
+
+#if GB28181_LOG_MIN_LEVEL <= 1
+#define LOG_INFO(msg)   GB28181_LOG(::gb28181::LogLevel::INFO, msg)
+#else
+#define LOG_INFO(msg)   GB28181_LOG_DISABLED(::gb28181::LogLevel::INFO, msg)
+#endif
+
+#if GB28181_LOG_MIN_LEVEL <= 2
+#define LOG_WARN(msg)   GB28181_LOG(::gb28181::LogLevel::WARNING, msg)
+#else
+#define LOG_WARN(msg)   GB28181_LOG_DISABLED(::gb28181::LogLevel::WARNING, msg)
+#endif
+
+#if GB28181_LOG_MIN_LEVEL <= 3
+#define LOG_ERROR(msg)  GB28181_LOG(::gb28181::LogLevel::ERROR, msg)
+#else
+#define LOG_ERROR(msg)  GB28181_LOG_DISABLED(::gb28181::LogLevel::ERROR, msg)
+#endif
+
+#define LOG_FATAL(msg)  GB28181_LOG(::gb28181::LogLevel::FATAL, msg)
+
 #endif // GB28181_LOGGER_H
@@ -0,0 +1,137 @@
+#ifndef GB28181_TASK_H
+#define GB28181_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace gb28181 {
+
+/**
+ * @brief 只可移动的任务对象
+ * 与std::function<void()>相比不要求可拷贝（可直接持有packaged_task、unique_ptr等），
+ * 且不超过kInlineSize字节、移动不抛异常的可调用对象直接存放在对象内部，不分配堆内存。
+ */
+class Task {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    Task() noexcept : ops_(nullptr) {}
+
+    template <class F, class = typename std::enable_if<
+                           !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) : ops_(nullptr) {
+        using Fn = typename std::decay<F>::type;
+        if constexpr (kFitsInline<Fn>) {
+            new (storage_) Fn(std::forward<F>(f));
+            ops_ = &InlineOps<Fn>::kOps;
+        } else {
+            *reinterpret_cast<Fn**>(storage_) = new Fn(std::forward<F>(f));
+            ops_ = &HeapOps<Fn>::kOps;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            if (other.ops_) {
+                ops_ = other.ops_;
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        Reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return ops_ != nullptr;
+    }
+
+    /**
+     * @brief 执行任务，空任务不做任何事
+     */
+    void operator()() {
+        if (ops_) {
+            ops_->invoke(storage_);
+        }
+    }
+
+    /**
+     * @brief 释放持有的可调用对象
+     */
+    void Reset() noexcept {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void *storage);
+        void (*move)(void *dst, void *src) noexcept;   // 移动到dst并析构src
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template <class Fn>
+    static constexpr bool kFitsInline = sizeof(Fn) <= kInlineSize &&
+                                        alignof(std::max_align_t) % alignof(Fn) == 0 &&
+                                        std::is_nothrow_move_constructible<Fn>::value;
+
+    template <class Fn>
+    struct InlineOps {
+        static Fn *Get(void *storage) {
+            return std::launder(reinterpret_cast<Fn*>(storage));
+        }
+        static void Invoke(void *storage) {
+            (*Get(storage))();
+        }
+        static void Move(void *dst, void *src) noexcept {
+            new (dst) Fn(std::move(*Get(src)));
+            Get(src)->~Fn();
+        }
+        static void Destroy(void *storage) noexcept {
+            Get(storage)->~Fn();
+        }
+        static constexpr Ops kOps = {&Invoke, &Move, &Destroy};
+    };
+
+    template <class Fn>
+    struct HeapOps {
+        static Fn *&Get(void *storage) {
+            return *reinterpret_cast<Fn**>(storage);
+        }
+        static void Invoke(void *storage) {
+            (*Get(storage))();
+        }
+        static void Move(void *dst, void *src) noexcept {
+            *reinterpret_cast<Fn**>(dst) = Get(src);
+        }
+        static void Destroy(void *storage) noexcept {
+            delete Get(storage);
+        }
+        static constexpr Ops kOps = {&Invoke, &Move, &Destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops *ops_;
+};
+
+} // namespace gb28181
+
+#endif // GB28181_TASK_H
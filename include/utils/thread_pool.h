@@ -2,89 +2,98 @@
 #define GB28181_THREAD_POOL_H
 
 #include <vector>
-#include <queue>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <functional>
 #include <future>
 #include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include "utils/task.h"
 
 namespace gb28181 {
 
+/**
+ * @brief 工作窃取线程池
+ * 每个工作线程有自己的Chase-Lev双端队列：线程内提交的任务压入自己队列的底部并从
+ * 底部取出（无锁、缓存友好），空闲线程从其他队列顶部窃取。外部线程提交的任务进入
+ * 全局注入队列。任务节点执行后由工作线程缓存复用，稳定运行时提交小任务不分配内存。
+ * 析构时执行完所有已提交的任务再退出。
+ */
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t numThreads) : stop_(false) {
-        for (size_t i = 0; i < numThreads; ++i) {
-            workers_.emplace_back([this] {
-                while (true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(queueMutex_);
-                        condition_.wait(lock, [this] {
-                            return stop_ || !tasks_.empty();
-                        });
-
-                        if (stop_ && tasks_.empty()) {
-                            return;
-                        }
-
-                        task = std::move(tasks_.front());
-                        tasks_.pop();
-                    }
-
-                    task();
-                }
-            });
-        }
-    }
-
-    ~ThreadPool() {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex_);
-            stop_ = true;
-        }
-
-        condition_.notify_all();
-
-        for (std::thread& worker : workers_) {
-            if (worker.joinable()) {
-                worker.join();
-            }
-        }
-    }
-
+    explicit ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief 提交任务，不关心结果
+     * 任务抛出的异常被捕获并记录，不会终止工作线程。
+     * @throw std::runtime_error 线程池已停止
+     */
+    void Post(Task task);
+
+    /**
+     * @brief 提交任务并通过future获取结果或异常
+     * @throw std::runtime_error 线程池已停止
+     */
     template <class F, class... Args>
     auto Enqueue(F&& f, Args&&... args)
-        -> std::future<typename std::result_of<F(Args...)>::type> {
-        using ReturnType = typename std::result_of<F(Args...)>::type;
+        -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        using ReturnType = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
 
-        auto task = std::make_shared<std::packaged_task<ReturnType()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
+        std::packaged_task<ReturnType()> task(
+            [f = std::forward<F>(f), args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                return std::apply(std::move(f), std::move(args));
+            });
 
-        std::future<ReturnType> result = task->get_future();
+        std::future<ReturnType> result = task.get_future();
+        Post(Task(std::move(task)));
+        return result;
+    }
 
-        {
-            std::unique_lock<std::mutex> lock(queueMutex_);
+    /**
+     * @brief 工作线程数量
+     */
+    size_t GetThreadCount() const { return workers_.size(); }
 
-            if (stop_) {
-                throw std::runtime_error("Enqueue on stopped ThreadPool");
-            }
+private:
+    struct Worker;
 
-            tasks_.emplace([task]() { (*task)(); });
-        }
+    void WorkerLoop(size_t index);
+    Task *FindTask(size_t index);
+    void Run(size_t index, Task *task);
 
-        condition_.notify_one();
-        return result;
-    }
+    /**
+     * @brief 取本工作线程缓存的空闲节点存放任务，没有时才分配
+     */
+    Task *AcquireNode(size_t index, Task&& task);
+    void ReleaseNode(size_t index, Task *node);
 
-private:
-    std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
+    /**
+     * @brief 注入队列写满时按两倍容量扩容，须持有injectMutex_
+     */
+    void GrowInjectQueue();
+    void Wake();
 
-    std::mutex queueMutex_;
-    std::condition_variable condition_;
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    // 非工作线程提交的任务，按值存放在容量为2的幂的环形缓冲区中，只扩容不收缩
+    std::mutex injectMutex_;
+    std::vector<Task> injectQueue_;
+    size_t injectHead_;
+    size_t injectCount_;
+
+    // 空闲线程休眠；pending_为已提交未取走的任务数，与sleeping_配合避免丢失唤醒
+    std::mutex sleepMutex_;
+    std::condition_variable wakeCondition_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> sleeping_;
     std::atomic<bool> stop_;
 };
 
@@ -0,0 +1,146 @@
+#ifndef GB28181_TIMER_SERVICE_H
+#define GB28181_TIMER_SERVICE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace gb28181 {
+
+/**
+ * @brief 定时器服务
+ * 基于分层时间轮(4层×64槽)，单个后台线程驱动心跳、注册刷新、会话超时、
+ * 告警上报等所有周期任务。插入和取消均为O(1)，空闲时按最近非空槽休眠，
+ * Stop()可立即唤醒线程退出。
+ * 回调在定时器线程中执行，应尽量短小；需要访问非线程安全对象时，
+ * 回调内只投递任务到对象自己的线程。
+ */
+class TimerService {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    static constexpr TimerId kInvalidTimer = 0;
+
+    /**
+     * @param tickMs 时间轮精度(毫秒)
+     */
+    explicit TimerService(int tickMs = 10);
+    ~TimerService();
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    /**
+     * @brief 启动定时器线程
+     */
+    bool Start();
+
+    /**
+     * @brief 停止定时器线程，未到期的定时器不再触发
+     */
+    void Stop();
+
+    /**
+     * @brief 单次定时器
+     * @param delayMs 延迟(毫秒)
+     * @param callback 到期回调
+     * @return 定时器ID
+     */
+    TimerId ScheduleOnce(int64_t delayMs, Callback callback);
+
+    /**
+     * @brief 周期定时器
+     * @param intervalMs 周期(毫秒)
+     * @param callback 到期回调
+     * @param initialDelayMs 首次延迟(毫秒)，<0时等于周期
+     * @return 定时器ID
+     */
+    TimerId ScheduleRepeating(int64_t intervalMs, Callback callback, int64_t initialDelayMs = -1);
+
+    /**
+     * @brief 取消定时器
+     * @return 定时器仍在等待触发时返回true（正在执行的回调不会被打断）
+     */
+    bool Cancel(TimerId id);
+
+    /**
+     * @brief 取消定时器，并等待该定时器正在执行的回调返回
+     * 返回后回调不会再被调用，之后可以安全释放回调引用的对象。
+     * 在定时器线程（回调内）调用时只取消不等待。
+     * @return 回调因此不再执行时返回true（仍在等待触发，或已到期尚未执行）
+     */
+    bool CancelAndWait(TimerId id);
+
+    /**
+     * @brief 等待触发的定时器数量
+     */
+    size_t GetPendingCount() const;
+
+    /**
+     * @brief 是否运行中
+     */
+    bool IsRunning() const { return running_; }
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 6;
+    static constexpr int kSlots = 1 << kSlotBits;
+    static constexpr uint32_t kNil = 0xFFFFFFFF;
+
+    // 定时器节点存放在连续数组中，槽内以下标组成双向链表，取消时直接摘除
+    struct Node {
+        uint64_t expireTick = 0;
+        uint64_t intervalTicks = 0;     // 0表示单次
+        uint32_t generation = 1;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        int16_t level = -1;             // -1表示未挂在时间轮上
+        uint8_t slot = 0;
+        Callback callback;
+    };
+
+    // 已到期待执行的回调
+    struct Fired {
+        TimerId id;
+        Callback callback;
+    };
+
+    TimerId Add(int64_t delayMs, int64_t intervalMs, Callback callback);
+    bool CancelLocked(TimerId id);
+    void Link(uint32_t index);
+    void Unlink(uint32_t index);
+    void Release(uint32_t index);
+    void Cascade(int level);
+    void Advance(uint64_t targetTick);
+    uint64_t TicksUntilNextEvent() const;
+    uint64_t CurrentTargetTick() const;
+    void Run();
+
+private:
+    const int64_t tickMs_;
+    const std::chrono::steady_clock::time_point origin_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable callbackDone_;  // 回调执行完毕
+    std::thread thread_;
+    bool running_;
+
+    uint64_t currentTick_;
+    size_t pending_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> freeList_;
+    uint32_t heads_[kLevels][kSlots];
+    uint64_t occupied_[kLevels];        // 每层非空槽位图
+    std::vector<Fired> fired_;          // 本轮到期的回调，取消时置空
+    TimerId runningTimer_;              // 正在执行回调的定时器
+};
+
+} // namespace gb28181
+
+#endif // GB28181_TIMER_SERVICE_H
@@ -0,0 +1,90 @@
+#ifndef GB28181_XML_TEMPLATE_H
+#define GB28181_XML_TEMPLATE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <initializer_list>
+#include <cstdint>
+
+namespace gb28181 {
+
+/**
+ * @brief 模板字段值
+ * 字符串渲染时做XML转义，整数直接格式化，均不产生临时分配。
+ */
+class XmlValue {
+public:
+    XmlValue(std::string_view text) : text_(text), number_(0), isNumber_(false) {}
+    XmlValue(const std::string& text) : text_(text), number_(0), isNumber_(false) {}
+    XmlValue(const char *text) : text_(text ? text : ""), number_(0), isNumber_(false) {}
+    XmlValue(int number) : number_(number), isNumber_(true) {}
+    XmlValue(unsigned int number) : number_(number), isNumber_(true) {}
+    XmlValue(long number) : number_(number), isNumber_(true) {}
+    XmlValue(long long number) : number_(number), isNumber_(true) {}
+    XmlValue(unsigned long number) : number_(static_cast<int64_t>(number)), isNumber_(true) {}
+    XmlValue(unsigned long long number) : number_(static_cast<int64_t>(number)), isNumber_(true) {}
+
+    /**
+     * @brief 追加到输出缓冲区
+     */
+    void AppendTo(std::string& out) const;
+
+private:
+    std::string_view text_;
+    int64_t number_;
+    bool isNumber_;
+};
+
+/**
+ * @brief 预编译的MANSCDP/XML模板
+ * 构造时把模板文本拆成静态片段和占位符（形如{{SN}}），渲染时只做片段拷贝
+ * 和字段拼接，输出到调用方复用的缓冲区，避免每次请求构造stringstream。
+ * 同名占位符可出现多次，字段值按占位符首次出现的顺序传入。
+ */
+class XmlTemplate {
+public:
+    explicit XmlTemplate(std::string_view text);
+
+    /**
+     * @brief 渲染模板，覆盖输出缓冲区内容（保留其容量）
+     * @param out 输出缓冲区
+     * @param values 字段值，数量需与不同占位符数量一致
+     */
+    void Render(std::string& out, std::initializer_list<XmlValue> values) const;
+
+    /**
+     * @brief 渲染模板并追加到输出缓冲区
+     */
+    void RenderAppend(std::string& out, std::initializer_list<XmlValue> values) const;
+
+    /**
+     * @brief 不同占位符数量
+     */
+    size_t GetFieldCount() const { return fieldNames_.size(); }
+
+    /**
+     * @brief 静态片段总长度
+     */
+    size_t GetStaticSize() const { return staticSize_; }
+
+private:
+    struct Segment {
+        std::string text;       // 占位符之前的静态文本
+        int field;              // 其后的字段序号，-1表示结尾
+    };
+
+    std::vector<Segment> segments_;
+    std::vector<std::string> fieldNames_;
+    size_t staticSize_;
+};
+
+/**
+ * @brief XML文本转义并追加到输出缓冲区
+ * 不含特殊字符时（设备ID、数字等常见情况）直接整段拷贝
+ */
+void XmlEscapeAppend(std::string& out, std::string_view text);
+
+} // namespace gb28181
+
+#endif // GB28181_XML_TEMPLATE_H
@@ -1,11 +1,12 @@
 #include "device/alarm_manager.h"
+#include "utils/timer_service.h"
+#include "utils/logger.h"
 #include <sstream>
 #include <iomanip>
 #include <chrono>
 #include <ctime>
 #include <algorithm>
 #include <mutex>
-#include <iostream>
 
 namespace gb28181 {
 
@@ -13,7 +14,8 @@ AlarmManager::AlarmManager()
     : initialized_(false)
     , reportingEnabled_(false)
     , reportingInterval_(60)
-    , running_(false)
+    , timerService_(nullptr)
+    , reportingTimer_(TimerService::kInvalidTimer)
     , alarmCounter_(0) {
 }
 
@@ -23,16 +25,18 @@ AlarmManager::~AlarmManager() {
 
 bool AlarmManager::Initialize() {
     initialized_ = true;
-    std::cout << "[AlarmManager] Initialized" << std::endl;
+    LOG_INFO("[AlarmManager] Initialized");
     return true;
 }
 
 std::string AlarmManager::TriggerAlarm(const AlarmInfo& alarm) {
     if (!initialized_) {
-        std::cerr << "[AlarmManager] Not initialized" << std::endl;
+        LOG_ERROR("[AlarmManager] Not initialized");
         return "";
     }
 
+    std::unique_lock<std::mutex> lock(mutex_);
+
     // 生成告警ID
     std::string alarmId = GenerateAlarmId();
 
@@ -56,10 +60,12 @@ std::string AlarmManager::TriggerAlarm(const AlarmInfo& alarm) {
         alarmHistory_.erase(alarmHistory_.begin());
     }
 
-    std::cout << "[AlarmManager] Triggered alarm: " << alarmId
-              << " type=" << GetAlarmTypeName(newAlarm.type)
-              << " level=" << GetAlarmLevelName(newAlarm.level)
-              << " channel=" << newAlarm.channelId << std::endl;
+    LOG_INFO("[AlarmManager] Triggered alarm: " << alarmId
+             << " type=" << GetAlarmTypeName(newAlarm.type)
+             << " level=" << GetAlarmLevelName(newAlarm.level)
+             << " channel=" << newAlarm.channelId);
+
+    lock.unlock();
 
     // 调用回调函数
     if (alarmCallback_) {
@@ -70,9 +76,11 @@ std::string AlarmManager::TriggerAlarm(const AlarmInfo& alarm) {
 }
 
 bool AlarmManager::ClearAlarm(const std::string& alarmId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
     auto it = alarms_.find(alarmId);
     if (it == alarms_.end()) {
-        std::cerr << "[AlarmManager] Alarm not found: " << alarmId << std::endl;
+        LOG_ERROR("[AlarmManager] Alarm not found: " << alarmId);
         return false;
     }
 
@@ -80,7 +88,7 @@ bool AlarmManager::ClearAlarm(const std::string& alarmId) {
     it->second.isActive = false;
     it->second.endTime = GetCurrentTime();
 
-    std::cout << "[AlarmManager] Cleared alarm: " << alarmId << std::endl;
+    LOG_INFO("[AlarmManager] Cleared alarm: " << alarmId);
 
     // 从活跃列表中移除（保留在历史记录中）
     alarms_.erase(it);
@@ -90,6 +98,7 @@ bool AlarmManager::ClearAlarm(const std::string& alarmId) {
 
 std::vector<AlarmInfo> AlarmManager::GetActiveAlarms() {
     std::vector<AlarmInfo> activeAlarms;
+    std::lock_guard<std::mutex> lock(mutex_);
 
     for (const auto& pair : alarms_) {
         if (pair.second.isActive) {
@@ -102,12 +111,14 @@ std::vector<AlarmInfo> AlarmManager::GetActiveAlarms() {
 
 std::vector<AlarmInfo> AlarmManager::GetAlarmHistory(const std::string& channelId, int limit) {
     std::vector<AlarmInfo> history;
+    std::unique_lock<std::mutex> lock(mutex_);
 
     for (const auto& alarm : alarmHistory_) {
         if (channelId.empty() || alarm.channelId == channelId) {
             history.push_back(alarm);
         }
     }
+    lock.unlock();
 
     // 按时间倒序排列
     std::sort(history.begin(), history.end(),
@@ -173,19 +184,38 @@ void AlarmManager::SetAlarmCallback(std::function<void(const AlarmInfo&)> callba
     alarmCallback_ = callback;
 }
 
-void AlarmManager::StartAlarmReporting(int interval) {
+void AlarmManager::SetTimerService(TimerService* timerService) {
+    timerService_ = timerService;
+}
+
+bool AlarmManager::StartAlarmReporting(int interval) {
     if (reportingEnabled_) {
-        std::cout << "[AlarmManager] Alarm reporting already started" << std::endl;
-        return;
+        LOG_INFO("[AlarmManager] Alarm reporting already started");
+        return true;
+    }
+
+    if (!timerService_) {
+        LOG_ERROR("[AlarmManager] Timer service not set, alarm reporting disabled");
+        return false;
+    }
+
+    if (interval <= 0) {
+        LOG_ERROR("[AlarmManager] Invalid reporting interval: " << interval);
+        return false;
+    }
+
+    reportingTimer_ = timerService_->ScheduleRepeating(static_cast<int64_t>(interval) * 1000,
+                                                       [this]() { ReportActiveAlarms(); });
+    if (reportingTimer_ == TimerService::kInvalidTimer) {
+        LOG_ERROR("[AlarmManager] Failed to schedule alarm reporting");
+        return false;
     }
 
     reportingInterval_ = interval;
     reportingEnabled_ = true;
-    running_ = true;
-
-    reportingThread_ = std::thread(&AlarmManager::AlarmReportingThread, this);
 
-    std::cout << "[AlarmManager] Started alarm reporting with interval: " << interval << "s" << std::endl;
+    LOG_INFO("[AlarmManager] Started alarm reporting with interval: " << interval << "s");
+    return true;
 }
 
 void AlarmManager::StopAlarmReporting() {
@@ -193,32 +223,23 @@ void AlarmManager::StopAlarmReporting() {
         return;
     }
 
-    running_ = false;
     reportingEnabled_ = false;
 
-    if (reportingThread_.joinable()) {
-        reportingThread_.join();
-    }
+    // 回调引用this，必须等正在执行的上报结束后才能返回（析构时同样经过这里）
+    timerService_->CancelAndWait(reportingTimer_);
+    reportingTimer_ = TimerService::kInvalidTimer;
 
-    std::cout << "[AlarmManager] Stopped alarm reporting" << std::endl;
+    LOG_INFO("[AlarmManager] Stopped alarm reporting");
 }
 
-void AlarmManager::AlarmReportingThread() {
-    while (running_) {
-        std::this_thread::sleep_for(std::chrono::seconds(reportingInterval_));
-
-        if (!running_) {
-            break;
-        }
-
-        // 获取活跃告警
-        auto activeAlarms = GetActiveAlarms();
+void AlarmManager::ReportActiveAlarms() {
+    // 获取活跃告警
+    auto activeAlarms = GetActiveAlarms();
 
-        // 上报所有活跃告警
-        for (const auto& alarm : activeAlarms) {
-            if (alarmCallback_) {
-                alarmCallback_(alarm);
-            }
+    // 上报所有活跃告警
+    for (const auto& alarm : activeAlarms) {
+        if (alarmCallback_) {
+            alarmCallback_(alarm);
         }
     }
 }
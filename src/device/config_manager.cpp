@@ -1,8 +1,8 @@
 #include "device/config_manager.h"
+#include "utils/logger.h"
 #include <sstream>
 #include <fstream>
 #include <algorithm>
-#include <iostream>
 namespace gb28181 {
 
 ConfigManager::ConfigManager() : initialized_(false) {
@@ -28,12 +28,12 @@ bool ConfigManager::Initialize(const std::string& configPath) {
 
     // 加载配置
     if (!LoadConfig(ConfigType::ALL)) {
-        std::cerr << "[ConfigManager] Failed to load config from: " << configPath_ << std::endl;
+        LOG_ERROR("[ConfigManager] Failed to load config from: " << configPath_);
         // 不返回false，使用默认配置
     }
 
     initialized_ = true;
-    std::cout << "[ConfigManager] Initialized with config: " << configPath_ << std::endl;
+    LOG_INFO("[ConfigManager] Initialized with config: " << configPath_);
 
     return true;
 }
@@ -81,7 +81,7 @@ bool ConfigManager::SetValue(const std::string& key, const std::string& value) {
         configChangeCallback_(key, value);
     }
 
-    std::cout << "[ConfigManager] Set config: " << key << " = " << value << std::endl;
+    LOG_INFO("[ConfigManager] Set config: " << key << " = " << value);
 
     return true;
 }
@@ -362,7 +362,7 @@ void ConfigManager::SetConfigChangeCallback(std::function<void(const std::string
 bool ConfigManager::LoadFromFile(const std::string& filePath) {
     std::ifstream file(filePath);
     if (!file.is_open()) {
-        std::cerr << "[ConfigManager] Failed to open config file: " << filePath << std::endl;
+        LOG_ERROR("[ConfigManager] Failed to open config file: " << filePath);
         return false;
     }
 
@@ -389,7 +389,7 @@ bool ConfigManager::LoadFromFile(const std::string& filePath) {
     audioConfig_.codec = GetValue("audio.codec");
     // ... 其他配置更新
 
-    std::cout << "[ConfigManager] Loaded " << configs_.size() << " config items from: " << filePath << std::endl;
+    LOG_INFO("[ConfigManager] Loaded " << configs_.size() << " config items from: " << filePath);
 
     return true;
 }
@@ -397,7 +397,7 @@ bool ConfigManager::LoadFromFile(const std::string& filePath) {
 bool ConfigManager::SaveToFile(const std::string& filePath) {
     std::ofstream file(filePath);
     if (!file.is_open()) {
-        std::cerr << "[ConfigManager] Failed to open config file for writing: " << filePath << std::endl;
+        LOG_ERROR("[ConfigManager] Failed to open config file for writing: " << filePath);
         return false;
     }
 
@@ -410,7 +410,7 @@ bool ConfigManager::SaveToFile(const std::string& filePath) {
 
     file.close();
 
-    std::cout << "[ConfigManager] Saved " << configs_.size() << " config items to: " << filePath << std::endl;
+    LOG_INFO("[ConfigManager] Saved " << configs_.size() << " config items to: " << filePath);
 
     return true;
 }
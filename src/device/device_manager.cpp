@@ -1,10 +1,43 @@
 #include "device/device_manager.h"
+#include "utils/xml_template.h"
 #include <sstream>
-#include <map>
+#include <unordered_map>
 #include <vector>
+#include <mutex>
+#include <limits>
 
 namespace gb28181 {
 
+namespace {
+
+// 目录消息头，Num为本条消息包含的通道数，SumNum为通道总数
+const XmlTemplate kCatalogHeadTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>Catalog</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<SumNum>{{SumNum}}</SumNum>\r\n"
+    "<DeviceList Num=\"{{Num}}\">\r\n");
+
+const XmlTemplate kCatalogItemTemplate(
+    "<Item>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<Name>{{Name}}</Name>\r\n"
+    "<Manufacturer>{{Manufacturer}}</Manufacturer>\r\n"
+    "<Model>{{Model}}</Model>\r\n"
+    "<Status>{{Status}}</Status>\r\n"
+    "<IPAddress>{{IPAddress}}</IPAddress>\r\n"
+    "<Port>{{Port}}</Port>\r\n"
+    "</Item>\r\n");
+
+const char kCatalogTail[] = "</DeviceList>\r\n</Response>\r\n";
+
+// 消息头中SN/SumNum/Num等数字字段预留的最大长度
+const size_t kCatalogHeadReserve = 40;
+
+} // namespace
+
 class DeviceManager::Impl {
 public:
     Impl() : status_(DeviceStatus::OFFLINE) {}
@@ -15,23 +48,36 @@ public:
     }
 
     void SetDeviceInfo(const DeviceInfo& info) {
+        std::lock_guard<std::mutex> lock(mutex_);
         deviceInfo_ = info;
     }
 
     DeviceInfo GetDeviceInfo() const {
+        std::lock_guard<std::mutex> lock(mutex_);
         return deviceInfo_;
     }
 
     void AddChannel(const ChannelInfo& channel) {
-        channels_[channel.channelId] = channel;
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // 通道按添加顺序存放，目录分片按下标续传
+        auto it = channelIndex_.find(channel.channelId);
+        if (it != channelIndex_.end()) {
+            channels_[it->second] = channel;
+            return;
+        }
+        channelIndex_[channel.channelId] = channels_.size();
+        channels_.push_back(channel);
     }
 
     std::vector<ChannelInfo> GetAllChannels() const {
-        std::vector<ChannelInfo> result;
-        for (const auto& pair : channels_) {
-            result.push_back(pair.second);
-        }
-        return result;
+        std::lock_guard<std::mutex> lock(mutex_);
+        return channels_;
+    }
+
+    size_t GetChannelCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return channels_.size();
     }
 
     void SetDeviceStatus(DeviceStatus status) {
@@ -52,33 +98,45 @@ public:
     }
 
     std::string GenerateCatalogResponse() const {
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Response>\r\n";
-        ss << "<CmdType>Catalog</CmdType>\r\n";
-        ss << "<SN>1</SN>\r\n";
-        ss << "<DeviceID>" << deviceInfo_.deviceId << "</DeviceID>\r\n";
-        ss << "<SumNum>" << channels_.size() << "</SumNum>\r\n";
-        ss << "<DeviceList Num=\"" << channels_.size() << "\">\r\n";
-
-        int index = 1;
-        for (const auto& pair : channels_) {
-            const ChannelInfo& channel = pair.second;
-            ss << "<Item>\r\n";
-            ss << "<DeviceID>" << channel.channelId << "</DeviceID>\r\n";
-            ss << "<Name>" << channel.channelName << "</Name>\r\n";
-            ss << "<Manufacturer>" << deviceInfo_.manufacturer << "</Manufacturer>\r\n";
-            ss << "<Model>" << deviceInfo_.model << "</Model>\r\n";
-            ss << "<Status>" << channel.status << "</Status>\r\n";
-            ss << "<IPAddress>" << deviceInfo_.ipAddress << "</IPAddress>\r\n";
-            ss << "<Port>" << deviceInfo_.port << "</Port>\r\n";
-            ss << "</Item>\r\n";
-            index++;
+        std::string out;
+        GenerateCatalogChunk(out, 1, GetDeviceInfo().deviceId, 0, std::numeric_limits<size_t>::max());
+        return out;
+    }
+
+    size_t GenerateCatalogChunk(std::string& out, uint32_t sn, const std::string& deviceId,
+                                size_t offset, size_t maxBodyBytes) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.clear();
+
+        if (offset >= channels_.size() && !(offset == 0 && channels_.empty())) {
+            return 0;
         }
 
-        ss << "</DeviceList>\r\n";
-        ss << "</Response>\r\n";
-        return ss.str();
+        // 先渲染通道条目，确定本条能容纳的数量后再补消息头
+        size_t fixedSize = kCatalogHeadTemplate.GetStaticSize() + deviceId.size() +
+                           kCatalogHeadReserve + sizeof(kCatalogTail) - 1;
+        size_t budget = (maxBodyBytes > fixedSize) ? maxBodyBytes - fixedSize : 0;
+
+        itemBuffer_.clear();
+        size_t count = 0;
+        for (size_t i = offset; i < channels_.size(); i++) {
+            size_t before = itemBuffer_.size();
+            const ChannelInfo& channel = channels_[i];
+            kCatalogItemTemplate.RenderAppend(itemBuffer_, {channel.channelId, channel.channelName,
+                                                            deviceInfo_.manufacturer, deviceInfo_.model,
+                                                            channel.status, deviceInfo_.ipAddress,
+                                                            deviceInfo_.port});
+            if (itemBuffer_.size() > budget && count > 0) {
+                itemBuffer_.resize(before);
+                break;
+            }
+            count++;
+        }
+
+        kCatalogHeadTemplate.Render(out, {sn, deviceId, channels_.size(), count});
+        out.append(itemBuffer_);
+        out.append(kCatalogTail, sizeof(kCatalogTail) - 1);
+        return count;
     }
 
     std::string GenerateDeviceInfoResponse() const {
@@ -112,9 +170,12 @@ public:
 
 private:
     DeviceInfo deviceInfo_;
-    std::map<std::string, ChannelInfo> channels_;
+    std::vector<ChannelInfo> channels_;
+    std::unordered_map<std::string, size_t> channelIndex_;
     DeviceStatus status_;
     DeviceEventCallback eventCallback_;
+    mutable std::mutex mutex_;
+    mutable std::string itemBuffer_;
 };
 
 DeviceManager::DeviceManager() : impl_(new Impl()) {}
@@ -153,10 +214,19 @@ void DeviceManager::SetEventCallback(DeviceEventCallback callback) {
     impl_->SetEventCallback(callback);
 }
 
+size_t DeviceManager::GetChannelCount() const {
+    return impl_->GetChannelCount();
+}
+
 std::string DeviceManager::GenerateCatalogResponse() const {
     return impl_->GenerateCatalogResponse();
 }
 
+size_t DeviceManager::GenerateCatalogChunk(std::string& out, uint32_t sn, const std::string& deviceId,
+                                           size_t offset, size_t maxBodyBytes) const {
+    return impl_->GenerateCatalogChunk(out, sn, deviceId, offset, maxBodyBytes);
+}
+
 std::string DeviceManager::GenerateDeviceInfoResponse() const {
     return impl_->GenerateDeviceInfoResponse();
 }
@@ -0,0 +1,127 @@
+#include "device/keyframe_index.h"
+#include "utils/logger.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace gb28181 {
+
+namespace {
+
+#ifdef _WIN32
+const char kPathSeparator = '\\';
+const char kPathSeparators[] = "\\/";
+#else
+const char kPathSeparator = '/';
+const char kPathSeparators[] = "/";
+#endif
+
+// 录像文件名在路径中的起始位置
+size_t FileNameStart(const std::string& filePath) {
+    size_t slash = filePath.find_last_of(kPathSeparators);
+    return (slash == std::string::npos) ? 0 : slash + 1;
+}
+
+const char kMagic[4] = {'G', 'B', 'K', 'I'};
+const uint16_t kVersion = 1;
+
+} // namespace
+
+const char kKeyframeIndexDirectory[] = "index";
+
+std::string GetKeyframeIndexPath(const std::string& filePath) {
+    size_t nameStart = FileNameStart(filePath);
+    return filePath.substr(0, nameStart) + kKeyframeIndexDirectory + kPathSeparator +
+           filePath.substr(nameStart) + ".idx";
+}
+
+bool CreateKeyframeIndexDirectory(const std::string& filePath) {
+    std::string path = filePath.substr(0, FileNameStart(filePath)) + kKeyframeIndexDirectory;
+#ifdef _WIN32
+    if (CreateDirectoryA(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS) {
+        return true;
+    }
+#else
+    if (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST) {
+        return true;
+    }
+#endif
+    LOG_ERROR("[KeyframeIndex] Failed to create directory " << path);
+    return false;
+}
+
+bool LoadKeyframeIndex(const std::string& filePath, KeyframeIndexHeader& header,
+                       std::vector<KeyframeEntry>& entries) {
+    std::FILE *file = std::fopen(GetKeyframeIndexPath(filePath).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, kMagic, sizeof(header.magic)) == 0 &&
+              header.version == kVersion;
+
+    long size = 0;
+    if (ok) {
+        ok = std::fseek(file, 0, SEEK_END) == 0 && (size = std::ftell(file)) >= 0 &&
+             (static_cast<uint64_t>(size) - sizeof(header)) % sizeof(KeyframeEntry) == 0 &&
+             std::fseek(file, sizeof(header), SEEK_SET) == 0;
+    }
+
+    if (ok) {
+        // 索引项与KeyframeEntry布局相同，一次读入
+        entries.resize((static_cast<uint64_t>(size) - sizeof(header)) / sizeof(KeyframeEntry));
+        ok = entries.empty() || std::fread(entries.data(), sizeof(KeyframeEntry), entries.size(), file) == entries.size();
+    }
+
+    std::fclose(file);
+    if (!ok) {
+        entries.clear();
+    }
+    return ok;
+}
+
+bool SaveKeyframeIndex(const std::string& filePath, KeyframeIndexHeader header,
+                       const std::vector<KeyframeEntry>& entries) {
+    if (!CreateKeyframeIndexDirectory(filePath)) {
+        return false;
+    }
+
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.reserved = 0;
+
+    static std::atomic<uint32_t> counter(0);
+    std::string indexPath = GetKeyframeIndexPath(filePath);
+    std::string tempPath = indexPath + ".tmp" + std::to_string(counter.fetch_add(1));
+
+    std::FILE *file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR("[KeyframeIndex] Failed to create " << tempPath << ": " << std::strerror(errno));
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(entries.data(), sizeof(KeyframeEntry), entries.size(), file) == entries.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    if (ok) {
+        std::remove(indexPath.c_str());
+    }
+#endif
+    if (!ok || std::rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        LOG_WARN("[KeyframeIndex] Failed to write " << indexPath);
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace gb28181
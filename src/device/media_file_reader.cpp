@@ -0,0 +1,713 @@
+#include "device/media_file_reader.h"
+#include "device/keyframe_index.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gb28181 {
+
+namespace {
+
+const uint64_t kPtsMask = (1ULL << 33) - 1;
+const uint64_t kNoWindow = ~0ULL;
+
+uint16_t ReadU16(const uint8_t *p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t ReadU32(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint64_t ReadU64(const uint8_t *p) {
+    return (static_cast<uint64_t>(ReadU32(p)) << 32) | ReadU32(p + 4);
+}
+
+constexpr uint32_t FourCC(const char (&s)[5]) {
+    return (static_cast<uint32_t>(s[0]) << 24) | (static_cast<uint32_t>(s[1]) << 16) |
+           (static_cast<uint32_t>(s[2]) << 8) | static_cast<uint32_t>(s[3]);
+}
+
+const char *CodecName(uint8_t streamType) {
+    return (streamType == 0x24) ? "H265" : (streamType == 0x1B) ? "H264" : "";
+}
+
+bool IsStartCode(const uint8_t *p) {
+    return p[0] == 0 && p[1] == 0 && p[2] == 1;
+}
+
+/**
+ * @brief PES头中5字节的33位时间戳（PTS/DTS）
+ */
+uint64_t ReadPesTimestamp(const uint8_t *p) {
+    return (static_cast<uint64_t>((p[0] >> 1) & 0x07) << 30) |
+           (static_cast<uint64_t>(p[1]) << 22) |
+           (static_cast<uint64_t>(p[2] >> 1) << 15) |
+           (static_cast<uint64_t>(p[3]) << 7) |
+           (p[4] >> 1);
+}
+
+/**
+ * @brief 写回PES时间戳，保留前缀和标记位
+ */
+void WritePesTimestamp(uint8_t *p, uint64_t ts) {
+    p[0] = static_cast<uint8_t>((p[0] & 0xF0) | ((ts >> 29) & 0x0E) | 0x01);
+    p[1] = static_cast<uint8_t>(ts >> 22);
+    p[2] = static_cast<uint8_t>(((ts >> 14) & 0xFE) | 0x01);
+    p[3] = static_cast<uint8_t>(ts >> 7);
+    p[4] = static_cast<uint8_t>(((ts << 1) & 0xFE) | 0x01);
+}
+
+/**
+ * @brief MPEG-2包头中的33位SCR基值，位于包头第4到9字节
+ */
+uint64_t ReadScrBase(const uint8_t *p) {
+    return (static_cast<uint64_t>((p[0] >> 3) & 0x07) << 30) |
+           (static_cast<uint64_t>(p[0] & 0x03) << 28) |
+           (static_cast<uint64_t>(p[1]) << 20) |
+           (static_cast<uint64_t>((p[2] >> 3) & 0x1F) << 15) |
+           (static_cast<uint64_t>(p[2] & 0x03) << 13) |
+           (static_cast<uint64_t>(p[3]) << 5) |
+           ((p[4] >> 3) & 0x1F);
+}
+
+/**
+ * @brief 写回SCR基值，保留标记位和SCR扩展
+ */
+void WriteScrBase(uint8_t *p, uint64_t scr) {
+    p[0] = static_cast<uint8_t>((p[0] & 0xC4) | (((scr >> 30) & 0x07) << 3) | ((scr >> 28) & 0x03));
+    p[1] = static_cast<uint8_t>(scr >> 20);
+    p[2] = static_cast<uint8_t>((p[2] & 0x04) | (((scr >> 15) & 0x1F) << 3) | ((scr >> 13) & 0x03));
+    p[3] = static_cast<uint8_t>(scr >> 5);
+    p[4] = static_cast<uint8_t>((p[4] & 0x07) | ((scr & 0x1F) << 3));
+}
+
+/**
+ * @brief 从from开始查找下一个PS包头，找不到返回size
+ */
+uint64_t FindPackHeader(const uint8_t *data, uint64_t from, uint64_t size) {
+    uint64_t pos = from + 3;
+    while (pos < size) {
+        const void *hit = memchr(data + pos, 0xBA, size - pos);
+        if (!hit) {
+            break;
+        }
+        uint64_t at = static_cast<const uint8_t*>(hit) - data;
+        if (IsStartCode(data + at - 3)) {
+            return at - 3;
+        }
+        pos = at + 1;
+    }
+    return size;
+}
+
+/**
+ * @brief MP4盒子，payload为盒子内容（不含头部）的起止偏移
+ */
+struct Mp4Box {
+    uint32_t type = 0;
+    uint64_t payload = 0;
+    uint64_t end = 0;
+};
+
+/**
+ * @brief 读取pos处的盒子并前进到下一个盒子
+ */
+bool NextBox(const uint8_t *data, uint64_t& pos, uint64_t end, Mp4Box& box) {
+    if (pos + 8 > end) {
+        return false;
+    }
+
+    uint64_t size = ReadU32(data + pos);
+    box.type = ReadU32(data + pos + 4);
+    uint64_t header = 8;
+    if (size == 1) {
+        if (pos + 16 > end) {
+            return false;
+        }
+        size = ReadU64(data + pos + 8);
+        header = 16;
+    } else if (size == 0) {
+        size = end - pos;
+    }
+
+    if (size < header || size > end - pos) {
+        return false;
+    }
+    box.payload = pos + header;
+    box.end = pos + size;
+    pos = box.end;
+    return true;
+}
+
+bool FindBox(const uint8_t *data, uint64_t begin, uint64_t end, uint32_t type, Mp4Box& box) {
+    uint64_t pos = begin;
+    while (NextBox(data, pos, end, box)) {
+        if (box.type == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 全盒子（version+flags）的表项数，表项超出盒子时返回0
+ */
+uint32_t TableCount(const uint8_t *data, const Mp4Box& box, uint64_t headerBytes, uint64_t entryBytes) {
+    if (box.payload + headerBytes > box.end) {
+        return 0;
+    }
+    uint32_t count = ReadU32(data + box.payload + headerBytes - 4);
+    if (count > (box.end - box.payload - headerBytes) / entryBytes) {
+        return 0;
+    }
+    return count;
+}
+
+} // namespace
+
+MediaFileReader::MediaFileReader()
+    : data_(nullptr)
+    , size_(0)
+    , format_(Format::UNKNOWN)
+    , cursor_(0)
+    , adviseWindow_(kNoWindow)
+    , haveFirstPts_(false)
+    , firstPts_(0)
+    , lastTimestampMs_(0)
+    , videoStreamType_(0)
+    , durationMs_(0) {
+}
+
+MediaFileReader::~MediaFileReader() {
+    Close();
+}
+
+bool MediaFileReader::Open(const std::string& filePath) {
+    Close();
+
+    if (!MapFile(filePath)) {
+        return false;
+    }
+
+    // ISO BMFF文件以ftyp等盒子开头，否则按PS查找第一个包头
+    uint32_t firstBox = (size_ >= 8) ? ReadU32(data_ + 4) : 0;
+    if (firstBox == FourCC("ftyp") || firstBox == FourCC("moov") || firstBox == FourCC("free")) {
+        format_ = Format::MP4;
+        if (!ParseMp4()) {
+            LOG_ERROR("[MediaFileReader] No readable video track in " << filePath);
+            Close();
+            return false;
+        }
+    } else if (FindPackHeader(data_, 0, std::min<uint64_t>(size_, 64 * 1024)) < std::min<uint64_t>(size_, 64 * 1024)) {
+        format_ = Format::PS;
+        if (!LoadPsIndex(filePath)) {
+            BuildPsIndex();
+            SavePsIndex(filePath);
+        }
+    } else {
+        LOG_ERROR("[MediaFileReader] Unsupported file format: " << filePath);
+        Close();
+        return false;
+    }
+
+    LOG_INFO("[MediaFileReader] Opened " << filePath << " ("
+             << (format_ == Format::MP4 ? "MP4" : "PS") << ", " << size_ << " bytes, "
+             << keyframes_.size() << " keyframes, " << durationMs_ << " ms)");
+    return true;
+}
+
+void MediaFileReader::Close() {
+    if (data_) {
+#ifdef _WIN32
+        delete[] data_;
+#else
+        munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    format_ = Format::UNKNOWN;
+    videoCodec_.clear();
+    cursor_ = 0;
+    adviseWindow_ = kNoWindow;
+    haveFirstPts_ = false;
+    firstPts_ = 0;
+    lastTimestampMs_ = 0;
+    videoStreamType_ = 0;
+    samples_.clear();
+    keyframes_.clear();
+    durationMs_ = 0;
+}
+
+bool MediaFileReader::MapFile(const std::string& filePath) {
+#ifdef _WIN32
+    // Windows下暂不映射文件，整体读入内存
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        LOG_ERROR("[MediaFileReader] Failed to open " << filePath);
+        return false;
+    }
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    if (size == 0) {
+        return false;
+    }
+    uint8_t *buffer = new uint8_t[size];
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size))) {
+        delete[] buffer;
+        return false;
+    }
+    data_ = buffer;
+    size_ = size;
+    return true;
+#else
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("[MediaFileReader] Failed to open " << filePath << ": " << std::strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("[MediaFileReader] Failed to map " << filePath << ": " << std::strerror(errno));
+        return false;
+    }
+
+    // 顺序读取，内核加大预读并尽快回收已读页
+    madvise(mapping, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    data_ = static_cast<const uint8_t*>(mapping);
+    size_ = static_cast<uint64_t>(st.st_size);
+    return true;
+#endif
+}
+
+void MediaFileReader::Advise(uint64_t offset) {
+#ifndef _WIN32
+    uint64_t window = offset / kReadaheadWindow;
+    if (window == adviseWindow_) {
+        return;
+    }
+
+    // 预取下一个窗口；顺序前进时释放已读完的窗口，映射常驻内存不随文件大小增长
+    uint64_t ahead = (window + 1) * kReadaheadWindow;
+    if (ahead < size_) {
+        madvise(const_cast<uint8_t*>(data_) + ahead,
+                static_cast<size_t>(std::min(kReadaheadWindow, size_ - ahead)), MADV_WILLNEED);
+    }
+    if (adviseWindow_ != kNoWindow && window > adviseWindow_) {
+        uint64_t begin = adviseWindow_ * kReadaheadWindow;
+        madvise(const_cast<uint8_t*>(data_) + begin,
+                static_cast<size_t>(window * kReadaheadWindow - begin), MADV_DONTNEED);
+    }
+#endif
+    adviseWindow_ = window;
+}
+
+uint64_t MediaFileReader::ToRelativeMs(uint64_t pts) const {
+    return ((pts - firstPts_) & kPtsMask) / 90;
+}
+
+void MediaFileReader::ParsePsm(uint64_t offset, uint64_t end) {
+    // 00 00 01 BC len(2) flags(2) info_len(2) info... map_len(2) {type id info_len(2) info...}
+    uint64_t pos = offset + 8;
+    if (pos + 2 > end) {
+        return;
+    }
+    pos += 2 + ReadU16(data_ + pos);
+    if (pos + 2 > end) {
+        return;
+    }
+    uint64_t mapEnd = std::min(end, pos + 2 + ReadU16(data_ + pos));
+    pos += 2;
+
+    while (pos + 4 <= mapEnd) {
+        uint8_t streamType = data_[pos];
+        uint8_t streamId = data_[pos + 1];
+        if (streamId >= 0xE0 && streamId <= 0xEF) {
+            videoStreamType_ = streamType;
+            videoCodec_ = CodecName(streamType);
+            return;
+        }
+        pos += 4 + ReadU16(data_ + pos + 2);
+    }
+}
+
+bool MediaFileReader::IsKeyframePayload(uint64_t offset, uint64_t end) const {
+    // 负载开头通常是00 00 00 01或00 00 01加NALU头，只看前几字节
+    end = std::min(end, offset + 8);
+    for (uint64_t pos = offset; pos + 3 < end; pos++) {
+        if (!IsStartCode(data_ + pos)) {
+            continue;
+        }
+        uint8_t header = data_[pos + 3];
+        if (videoStreamType_ == 0x1B) {
+            int type = header & 0x1F;
+            return type == 5 || type == 7 || type == 8;
+        }
+        if (videoStreamType_ == 0x24) {
+            int type = (header >> 1) & 0x3F;
+            return (type >= 16 && type <= 21) || (type >= 32 && type <= 34);
+        }
+        return false;
+    }
+    return false;
+}
+
+bool MediaFileReader::ParsePsFrame(uint64_t offset, MediaFrame& frame) {
+    if (offset + 14 > size_ || !IsStartCode(data_ + offset) || data_[offset + 3] != 0xBA) {
+        return false;
+    }
+
+    frame = MediaFrame();
+    frame.offset = offset;
+
+    // MPEG-2包头14字节加填充，MPEG-1包头12字节
+    uint64_t pos = offset + (((data_[offset + 4] & 0xC0) == 0x40) ? 14 + (data_[offset + 13] & 0x07) : 12);
+    uint64_t next = size_;
+    bool havePts = false;
+    bool checkedPayload = false;
+    uint64_t pts = 0;
+
+    while (pos + 4 <= size_) {
+        uint8_t id = data_[pos + 3];
+        if (!IsStartCode(data_ + pos) || id < 0xB9) {
+            // 长度字段与内容不符，重新同步到下一个包头
+            next = FindPackHeader(data_, pos, size_);
+            break;
+        }
+        if (id == 0xBA) {
+            next = pos;
+            break;
+        }
+        if (id == 0xB9) {
+            pos += 4;
+            continue;
+        }
+        if (pos + 6 > size_) {
+            break;
+        }
+
+        uint64_t unitEnd = std::min(size_, pos + 6 + ReadU16(data_ + pos + 4));
+        if (id == 0xBB) {
+            frame.keyframe = true;
+        } else if (id == 0xBC) {
+            ParsePsm(pos, unitEnd);
+        } else if (id >= 0xC0 && id <= 0xEF && pos + 9 <= unitEnd) {
+            bool video = (id >= 0xE0);
+            frame.video = frame.video || video;
+
+            uint8_t flags = data_[pos + 7];
+            uint64_t payload = pos + 9 + data_[pos + 8];
+            if (!havePts && (flags & 0x80) && pos + 14 <= unitEnd) {
+                pts = ReadPesTimestamp(data_ + pos + 9);
+                havePts = true;
+            }
+            if (video && !checkedPayload && payload < unitEnd) {
+                checkedPayload = true;
+                frame.keyframe = frame.keyframe || IsKeyframePayload(payload, unitEnd);
+            }
+        }
+        pos = unitEnd;
+    }
+
+    frame.data = data_ + offset;
+    frame.size = static_cast<size_t>(next - offset);
+
+    if (havePts) {
+        if (!haveFirstPts_) {
+            firstPts_ = pts;
+            haveFirstPts_ = true;
+        }
+        lastTimestampMs_ = ToRelativeMs(pts);
+    }
+    frame.timestampMs = lastTimestampMs_;
+    return true;
+}
+
+bool MediaFileReader::LoadPsIndex(const std::string& filePath) {
+    KeyframeIndexHeader header;
+    std::vector<KeyframeEntry> entries;
+    if (!LoadKeyframeIndex(filePath, header, entries) || header.sourceSize != size_) {
+        return false;
+    }
+
+    for (const KeyframeEntry& entry : entries) {
+        if (entry.offset >= size_) {
+            return false;
+        }
+    }
+
+    keyframes_.swap(entries);
+    durationMs_ = header.durationMs;
+    haveFirstPts_ = true;
+    firstPts_ = header.firstPts;
+    videoStreamType_ = header.videoStreamType;
+    videoCodec_ = CodecName(videoStreamType_);
+    cursor_ = FindPackHeader(data_, 0, size_);
+    return true;
+}
+
+void MediaFileReader::BuildPsIndex() {
+    uint64_t first = FindPackHeader(data_, 0, size_);
+    MediaFrame frame;
+    for (uint64_t pos = first; pos < size_ && ParsePsFrame(pos, frame); pos += frame.size) {
+        if (frame.video && frame.keyframe) {
+            keyframes_.push_back({frame.offset, static_cast<uint32_t>(frame.timestampMs), 0});
+        }
+        durationMs_ = std::max(durationMs_, frame.timestampMs);
+        Advise(pos);
+        if (frame.size == 0) {
+            break;
+        }
+    }
+
+    cursor_ = first;
+    lastTimestampMs_ = 0;
+    adviseWindow_ = kNoWindow;
+}
+
+void MediaFileReader::SavePsIndex(const std::string& filePath) const {
+    KeyframeIndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.videoStreamType = videoStreamType_;
+    header.sourceSize = size_;
+    header.firstPts = firstPts_;
+    header.durationMs = durationMs_;
+    SaveKeyframeIndex(filePath, header, keyframes_);
+}
+
+bool MediaFileReader::ParseMp4() {
+    Mp4Box moov;
+    if (!FindBox(data_, 0, size_, FourCC("moov"), moov)) {
+        return false;
+    }
+
+    uint64_t pos = moov.payload;
+    Mp4Box trak;
+    while (NextBox(data_, pos, moov.end, trak)) {
+        Mp4Box mdia, hdlr, mdhd, minf, stbl;
+        if (trak.type != FourCC("trak") ||
+            !FindBox(data_, trak.payload, trak.end, FourCC("mdia"), mdia) ||
+            !FindBox(data_, mdia.payload, mdia.end, FourCC("hdlr"), hdlr) ||
+            hdlr.payload + 12 > hdlr.end || ReadU32(data_ + hdlr.payload + 8) != FourCC("vide") ||
+            !FindBox(data_, mdia.payload, mdia.end, FourCC("mdhd"), mdhd) ||
+            !FindBox(data_, mdia.payload, mdia.end, FourCC("minf"), minf) ||
+            !FindBox(data_, minf.payload, minf.end, FourCC("stbl"), stbl)) {
+            continue;
+        }
+
+        // mdhd版本0的timescale在第12字节，版本1在第20字节
+        uint64_t timescaleAt = mdhd.payload + (data_[mdhd.payload] == 1 ? 20 : 12);
+        uint32_t timescale = (timescaleAt + 4 <= mdhd.end) ? ReadU32(data_ + timescaleAt) : 0;
+        if (timescale == 0) {
+            continue;
+        }
+
+        Mp4Box stsd, stsz, stsc, stts, chunks, stss;
+        bool co64 = false;
+        if (!FindBox(data_, stbl.payload, stbl.end, FourCC("stsz"), stsz) ||
+            !FindBox(data_, stbl.payload, stbl.end, FourCC("stsc"), stsc) ||
+            !FindBox(data_, stbl.payload, stbl.end, FourCC("stts"), stts)) {
+            continue;
+        }
+        if (!FindBox(data_, stbl.payload, stbl.end, FourCC("stco"), chunks)) {
+            if (!FindBox(data_, stbl.payload, stbl.end, FourCC("co64"), chunks)) {
+                continue;
+            }
+            co64 = true;
+        }
+        bool hasStss = FindBox(data_, stbl.payload, stbl.end, FourCC("stss"), stss);
+
+        if (FindBox(data_, stbl.payload, stbl.end, FourCC("stsd"), stsd) && stsd.payload + 16 <= stsd.end) {
+            uint32_t codec = ReadU32(data_ + stsd.payload + 12);
+            if (codec == FourCC("avc1") || codec == FourCC("avc3")) {
+                videoCodec_ = "H264";
+            } else if (codec == FourCC("hvc1") || codec == FourCC("hev1")) {
+                videoCodec_ = "H265";
+            }
+        }
+
+        // stsz: version/flags, sample_size, sample_count, [entry_size...]
+        if (stsz.payload + 12 > stsz.end) {
+            continue;
+        }
+        uint32_t fixedSize = ReadU32(data_ + stsz.payload + 4);
+        uint32_t sampleCount = ReadU32(data_ + stsz.payload + 8);
+        if (fixedSize == 0 && sampleCount > (stsz.end - stsz.payload - 12) / 4) {
+            continue;
+        }
+
+        uint32_t chunkCount = TableCount(data_, chunks, 8, co64 ? 8 : 4);
+        uint32_t stscCount = TableCount(data_, stsc, 8, 12);
+        uint32_t sttsCount = TableCount(data_, stts, 8, 8);
+        if (sampleCount == 0 || chunkCount == 0 || stscCount == 0) {
+            continue;
+        }
+
+        samples_.resize(sampleCount);
+        for (uint32_t i = 0; i < sampleCount; i++) {
+            samples_[i].size = fixedSize ? fixedSize : ReadU32(data_ + stsz.payload + 12 + i * 4ULL);
+            samples_[i].keyframe = !hasStss;
+        }
+
+        // 按stsc把样本分配到块，块内样本连续存放
+        uint32_t sample = 0;
+        for (uint32_t entry = 0; entry < stscCount && sample < sampleCount; entry++) {
+            const uint8_t *e = data_ + stsc.payload + 8 + entry * 12ULL;
+            uint32_t firstChunk = ReadU32(e);
+            uint32_t perChunk = ReadU32(e + 4);
+            uint32_t lastChunk = (entry + 1 < stscCount) ? ReadU32(e + 12) - 1 : chunkCount;
+            for (uint32_t chunk = firstChunk - 1; chunk < std::min(lastChunk, chunkCount) && sample < sampleCount; chunk++) {
+                uint64_t offset = co64 ? ReadU64(data_ + chunks.payload + 8 + chunk * 8ULL)
+                                       : ReadU32(data_ + chunks.payload + 8 + chunk * 4ULL);
+                for (uint32_t k = 0; k < perChunk && sample < sampleCount; k++) {
+                    samples_[sample++].offset = offset;
+                    offset += samples_[sample - 1].size;
+                }
+            }
+        }
+        samples_.resize(sample);
+
+        // stts给出解码时间增量
+        uint64_t dts = 0;
+        sample = 0;
+        for (uint32_t entry = 0; entry < sttsCount && sample < samples_.size(); entry++) {
+            const uint8_t *e = data_ + stts.payload + 8 + entry * 8ULL;
+            uint32_t count = ReadU32(e);
+            uint32_t delta = ReadU32(e + 4);
+            for (uint32_t k = 0; k < count && sample < samples_.size(); k++) {
+                samples_[sample++].timestampMs = dts * 1000 / timescale;
+                dts += delta;
+            }
+        }
+        for (; sample < samples_.size(); sample++) {
+            samples_[sample].timestampMs = dts * 1000 / timescale;
+        }
+
+        if (hasStss) {
+            uint32_t syncCount = TableCount(data_, stss, 8, 4);
+            for (uint32_t i = 0; i < syncCount; i++) {
+                uint32_t number = ReadU32(data_ + stss.payload + 8 + i * 4ULL);
+                if (number >= 1 && number <= samples_.size()) {
+                    samples_[number - 1].keyframe = true;
+                }
+            }
+        }
+
+        // 丢弃超出文件范围的样本（未写完的文件）
+        while (!samples_.empty() && samples_.back().offset + samples_.back().size > size_) {
+            samples_.pop_back();
+        }
+        for (uint32_t i = 0; i < samples_.size(); i++) {
+            if (samples_[i].keyframe) {
+                keyframes_.push_back({samples_[i].offset, static_cast<uint32_t>(samples_[i].timestampMs), i});
+            }
+        }
+        durationMs_ = samples_.empty() ? 0 : samples_.back().timestampMs;
+        cursor_ = 0;
+        return !samples_.empty();
+    }
+    return false;
+}
+
+bool MediaFileReader::ReadFrame(MediaFrame& frame) {
+    if (!data_) {
+        return false;
+    }
+
+    if (format_ == Format::MP4) {
+        while (cursor_ < samples_.size()) {
+            uint32_t index = static_cast<uint32_t>(cursor_++);
+            const Sample& sample = samples_[index];
+            if (sample.offset + sample.size > size_) {
+                continue;
+            }
+            frame.data = data_ + sample.offset;
+            frame.size = sample.size;
+            frame.timestampMs = sample.timestampMs;
+            frame.offset = sample.offset;
+            frame.sample = index;
+            frame.video = true;
+            frame.keyframe = sample.keyframe;
+            Advise(sample.offset);
+            return true;
+        }
+        return false;
+    }
+
+    if (cursor_ >= size_ || !ParsePsFrame(cursor_, frame) || frame.size == 0) {
+        return false;
+    }
+    Advise(cursor_);
+    cursor_ += frame.size;
+    return true;
+}
+
+void MediaFileReader::Seek(const KeyframeEntry& keyframe) {
+    if (format_ == Format::MP4) {
+        cursor_ = keyframe.sample;
+    } else {
+        cursor_ = keyframe.offset;
+        lastTimestampMs_ = keyframe.timestampMs;
+    }
+}
+
+void MediaFileReader::ShiftPsTimestamps(uint8_t *data, size_t size, int64_t shift) {
+    if (size < 14 || !IsStartCode(data) || data[3] != 0xBA) {
+        return;
+    }
+
+    uint64_t pos = 12;
+    if ((data[4] & 0xC0) == 0x40) {
+        WriteScrBase(data + 4, (ReadScrBase(data + 4) + shift) & kPtsMask);
+        pos = 14 + (data[13] & 0x07);
+    }
+
+    // 与ParsePsFrame相同的方式按长度跳过各单元，只改写PES头中的PTS/DTS
+    while (pos + 6 <= size && IsStartCode(data + pos) && data[pos + 3] > 0xB9) {
+        uint8_t id = data[pos + 3];
+        uint64_t unitEnd = std::min<uint64_t>(size, pos + 6 + ReadU16(data + pos + 4));
+        if (id >= 0xC0 && id <= 0xEF && pos + 9 <= unitEnd) {
+            uint8_t flags = data[pos + 7];
+            if ((flags & 0x80) && pos + 14 <= unitEnd) {
+                WritePesTimestamp(data + pos + 9, (ReadPesTimestamp(data + pos + 9) + shift) & kPtsMask);
+            }
+            if ((flags & 0xC0) == 0xC0 && pos + 19 <= unitEnd) {
+                WritePesTimestamp(data + pos + 14, (ReadPesTimestamp(data + pos + 14) + shift) & kPtsMask);
+            }
+        }
+        pos = unitEnd;
+    }
+}
+
+const KeyframeEntry *MediaFileReader::FindKeyframe(uint64_t timestampMs) const {
+    auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), timestampMs,
+                               [](uint64_t t, const KeyframeEntry& entry) { return t < entry.timestampMs; });
+    if (it == keyframes_.begin()) {
+        return nullptr;
+    }
+    return &*(it - 1);
+}
+
+} // namespace gb28181
@@ -1,10 +1,11 @@
 #include "device/playback_manager.h"
+#include "utils/logger.h"
 #include <sstream>
 #include <chrono>
 #include <iomanip>
 #include <thread>
-#include <iostream>
 #include <cmath>
+#include <algorithm>
 #include <sys/stat.h>
 
 #ifdef _WIN32
@@ -15,21 +16,47 @@
 
 namespace gb28181 {
 
-PlaybackManager::PlaybackManager() : initialized_(false), sessionCounter_(0) {
+namespace {
+
+/**
+ * @brief 不晚于position（相对文件第一帧）的关键帧序号，没有时返回-1
+ */
+int64_t KeyframeIndexAt(const MediaFileReader& reader, uint64_t position) {
+    const KeyframeEntry *keyframe = reader.FindKeyframe(position);
+    return keyframe ? keyframe - reader.GetKeyframes().data() : -1;
+}
+
+/**
+ * @brief 当前位置之前的关键帧序号，没有时返回-1
+ */
+int64_t KeyframeIndexBefore(const PlaybackSession& session) {
+    if (session.currentPosition <= session.fileStartTime) {
+        return -1;
+    }
+    return KeyframeIndexAt(*session.reader, session.currentPosition - session.fileStartTime - 1);
+}
+
+bool IsStopped(PlaybackMode mode) {
+    return mode == PlaybackMode::PAUSE || mode == PlaybackMode::STEP;
+}
+
+} // namespace
+
+PlaybackManager::PlaybackManager()
+    : initialized_(false)
+    , sessionCounter_(0)
+    , keyframeOnlySpeed_(kDefaultKeyframeOnlySpeed) {
 }
 
 PlaybackManager::~PlaybackManager() {
     // 停止所有活跃会话
-    for (auto& pair : sessions_) {
-        if (pair.second && pair.second->isActive) {
-            StopPlayback(pair.first);
-        }
-    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.clear();
 }
 
 bool PlaybackManager::Initialize() {
     initialized_ = true;
-    std::cout << "[PlaybackManager] Initialized" << std::endl;
+    LOG_INFO("[PlaybackManager] Initialized");
     return true;
 }
 
@@ -37,68 +64,165 @@ std::string PlaybackManager::StartPlayback(const std::string& channelId,
                                           const std::string& startTime,
                                           const std::string& endTime,
                                           const std::string& filePath) {
-    if (!initialized_) {
-        std::cerr << "[PlaybackManager] Not initialized" << std::endl;
-        return "";
+    std::string sessionId;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessionId = GenerateSessionId();
     }
 
-    // 检查文件是否存在
-    if (!FileExists(filePath)) {
-        std::cerr << "[PlaybackManager] File not found: " << filePath << std::endl;
+    // 未知文件开始时间时按文件从开始时间起录
+    uint64_t startMs = ParseTimeToMs(startTime);
+    if (!StartPlayback(sessionId, channelId, startMs, ParseTimeToMs(endTime), filePath, startMs)) {
         return "";
     }
+    return sessionId;
+}
+
+bool PlaybackManager::StartPlayback(const std::string& sessionId,
+                                    const std::string& channelId,
+                                    uint64_t startMs,
+                                    uint64_t endMs,
+                                    const std::string& filePath,
+                                    uint64_t fileStartMs,
+                                    bool download,
+                                    int downloadSpeed) {
+    return StartPlayback(sessionId, channelId, startMs, endMs, {{filePath, fileStartMs, endMs}},
+                         download, downloadSpeed);
+}
+
+bool PlaybackManager::StartPlayback(const std::string& sessionId,
+                                    const std::string& channelId,
+                                    uint64_t startMs,
+                                    uint64_t endMs,
+                                    const std::vector<PlaybackSegment>& segments,
+                                    bool download,
+                                    int downloadSpeed) {
+    if (!initialized_) {
+        LOG_ERROR("[PlaybackManager] Not initialized");
+        return false;
+    }
+
+    if (segments.empty()) {
+        LOG_ERROR("[PlaybackManager] No record file for session: " << sessionId);
+        return false;
+    }
 
     // 创建新会话
-    std::string sessionId = GenerateSessionId();
-    auto session = std::make_unique<PlaybackSession>();
+    auto session = std::make_shared<PlaybackSession>();
 
     session->sessionId = sessionId;
     session->channelId = channelId;
-    session->filePath = filePath;
-    session->startTime = ParseTimeToMs(startTime);
-    session->endTime = ParseTimeToMs(endTime);
+    session->startTime = startMs;
+    session->endTime = endMs;
     session->currentPosition = session->startTime;
     session->control.mode = PlaybackMode::NORMAL;
     session->control.speed = 1.0;
     session->control.position = session->startTime;
     session->control.isAudio = true;
+    session->resumeSpeed = 1.0;
     session->isActive = true;
+    session->download = download;
+    session->downloadSpeed = std::max(0, downloadSpeed);
+    session->fileStartTime = 0;
+    session->segments = segments;
+    session->segmentIndex = 0;
+    session->segmentEntered = false;
+    session->started = false;
+    session->anchored = false;
+    session->anchorReverse = false;
+    session->mediaAnchor = 0;
+    session->outputAnchor = 0;
+    session->outputEnd = 0;
+    session->keyframeIndex = -1;
+    session->gopEnd = -1;
+    session->hasPending = false;
+    session->pendingMode = ReadMode::FORWARD;
+
+    // 从包含开始时间的文件读起；映射文件并建立关键帧索引在锁外完成
+    size_t index = 0;
+    while (index + 1 < segments.size() && segments[index].endTime <= startMs) {
+        index++;
+    }
+    if (!OpenSegment(*session, index)) {
+        return false;
+    }
+
+    // 从不晚于开始时间的关键帧开始读，开始时间早于第一个关键帧时从文件头读
+    if (startMs > session->fileStartTime) {
+        const KeyframeEntry *keyframe = session->reader->FindKeyframe(startMs - session->fileStartTime);
+        if (keyframe) {
+            session->reader->Seek(*keyframe);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (sessions_.count(sessionId)) {
+            LOG_ERROR("[PlaybackManager] Session already exists: " << sessionId);
+            return false;
+        }
+        sessions_[sessionId] = std::move(session);
+    }
 
-    sessions_[sessionId] = std::move(session);
+    LOG_INFO("[PlaybackManager] Started " << (download ? "download" : "playback")
+             << " session: " << sessionId
+             << " for channel: " << channelId
+             << " from " << FormatMsToTime(startMs) << " to " << FormatMsToTime(endMs)
+             << " (" << segments.size() << " files)");
 
-    std::cout << "[PlaybackManager] Started playback session: " << sessionId
-              << " for channel: " << channelId
-              << " from " << startTime << " to " << endTime << std::endl;
+    return true;
+}
 
-    return sessionId;
+void PlaybackManager::SetKeyframeOnlySpeed(double speed) {
+    keyframeOnlySpeed_.store(speed);
+}
+
+bool PlaybackManager::HasSession(const std::string& sessionId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.count(sessionId) != 0;
 }
 
 bool PlaybackManager::StopPlayback(const std::string& sessionId) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[PlaybackManager] Session not found: " << sessionId << std::endl;
-        return false;
+    std::shared_ptr<PlaybackSession> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(sessionId);
+        if (it == sessions_.end()) {
+            LOG_ERROR("[PlaybackManager] Session not found: " << sessionId);
+            return false;
+        }
+        session = std::move(it->second);
+        sessions_.erase(it);
     }
 
-    it->second->isActive = false;
-
-    std::cout << "[PlaybackManager] Stopped playback session: " << sessionId << std::endl;
+    // 等正在进行的读取结束；之后仍持有该会话的调用方读取时直接返回结束
+    {
+        std::lock_guard<std::mutex> sessionLock(session->mutex);
+        session->isActive = false;
+    }
 
-    sessions_.erase(it);
+    LOG_INFO("[PlaybackManager] Stopped playback session: " << sessionId);
     return true;
 }
 
 bool PlaybackManager::ControlPlayback(const std::string& sessionId, const PlaybackControl& control) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[PlaybackManager] Session not found: " << sessionId << std::endl;
+    std::shared_ptr<PlaybackSession> session = GetSession(sessionId);
+    if (!session) {
+        LOG_ERROR("[PlaybackManager] Session not found: " << sessionId);
         return false;
     }
 
-    auto& session = it->second;
+    std::lock_guard<std::mutex> sessionLock(session->mutex);
 
-    // 更新控制参数
+    // 暂停时记下当前倍速，恢复时沿用
+    if (IsStopped(control.mode) && !IsStopped(session->control.mode)) {
+        session->resumeSpeed = session->control.speed;
+    }
+
+    // 更新控制参数，输出时间戳从下一帧起按新倍速重新锚定
     session->control = control;
+    session->anchored = false;
+    session->gopEnd = -1;
 
     // 根据模式设置速度
     switch (control.mode) {
@@ -123,9 +247,9 @@ bool PlaybackManager::ControlPlayback(const std::string& sessionId, const Playba
             break;
     }
 
-    std::cout << "[PlaybackManager] Controlled playback: " << sessionId
-              << " mode=" << (int)control.mode
-              << " speed=" << control.speed << std::endl;
+    LOG_INFO("[PlaybackManager] Controlled playback: " << sessionId
+             << " mode=" << (int)control.mode
+             << " speed=" << control.speed);
 
     return true;
 }
@@ -140,9 +264,23 @@ bool PlaybackManager::PausePlayback(const std::string& sessionId) {
 
 bool PlaybackManager::ResumePlayback(const std::string& sessionId) {
     PlaybackControl control;
-    control.mode = PlaybackMode::NORMAL;
-    control.speed = 1.0;
+    {
+        std::shared_ptr<PlaybackSession> session = GetSession(sessionId);
+        if (!session) {
+            LOG_ERROR("[PlaybackManager] Session not found: " << sessionId);
+            return false;
+        }
 
+        std::lock_guard<std::mutex> sessionLock(session->mutex);
+        if (!IsStopped(session->control.mode)) {
+            return true;
+        }
+        control = session->control;
+        control.speed = session->resumeSpeed;
+    }
+
+    control.mode = (control.speed == 1.0) ? PlaybackMode::NORMAL :
+                   (control.speed > 0) ? PlaybackMode::FORWARD : PlaybackMode::BACKWARD;
     return ControlPlayback(sessionId, control);
 }
 
@@ -163,45 +301,126 @@ bool PlaybackManager::FastBackward(const std::string& sessionId, double speed) {
 }
 
 bool PlaybackManager::SeekPlayback(const std::string& sessionId, uint64_t position) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[PlaybackManager] Session not found: " << sessionId << std::endl;
+    std::shared_ptr<PlaybackSession> session = GetSession(sessionId);
+    if (!session) {
+        LOG_ERROR("[PlaybackManager] Session not found: " << sessionId);
         return false;
     }
 
-    auto& session = it->second;
+    std::lock_guard<std::mutex> sessionLock(session->mutex);
 
     // 检查位置是否在有效范围内
     if (position < session->startTime || position > session->endTime) {
-        std::cerr << "[PlaybackManager] Invalid position: " << position << std::endl;
+        LOG_ERROR("[PlaybackManager] Invalid position: " << position);
         return false;
     }
 
+    // 切换到目标位置所在的文件，位置落在两个文件之间时取后一个
+    size_t index = 0;
+    while (index + 1 < session->segments.size() && session->segments[index].endTime <= position) {
+        index++;
+    }
+    if (index != session->segmentIndex && !OpenSegment(*session, index)) {
+        return false;
+    }
+
+    // 定位到不晚于目标位置的关键帧，从关键帧开始发送才能解码
+    MediaFileReader& reader = *session->reader;
+    const KeyframeEntry *keyframe = nullptr;
+    if (position >= session->fileStartTime) {
+        keyframe = reader.FindKeyframe(position - session->fileStartTime);
+    }
+    if (!keyframe && !reader.GetKeyframes().empty()) {
+        keyframe = &reader.GetKeyframes().front();
+    }
+    if (keyframe) {
+        reader.Seek(*keyframe);
+    }
+
     session->currentPosition = position;
     session->control.position = position;
+    session->anchored = false;
+    session->gopEnd = -1;
+    session->hasPending = false;
+    session->segmentEntered = false;
 
-    std::cout << "[PlaybackManager] Seek playback: " << sessionId
-              << " to position: " << position << "ms ("
-              << FormatMsToTime(position) << ")" << std::endl;
+    LOG_INFO("[PlaybackManager] Seek playback: " << sessionId
+             << " to position: " << position << "ms ("
+             << FormatMsToTime(position) << ")");
 
     return true;
 }
 
-PlaybackSession* PlaybackManager::GetSession(const std::string& sessionId) {
+bool PlaybackManager::SeekPlaybackOffset(const std::string& sessionId, uint64_t offset) {
+    std::shared_ptr<PlaybackSession> session = GetSession(sessionId);
+    if (!session) {
+        LOG_ERROR("[PlaybackManager] Session not found: " << sessionId);
+        return false;
+    }
+
+    uint64_t startTime = 0;
+    {
+        std::lock_guard<std::mutex> sessionLock(session->mutex);
+        startTime = session->startTime;
+    }
+
+    return SeekPlayback(sessionId, startTime + offset);
+}
+
+std::shared_ptr<PlaybackSession> PlaybackManager::GetSession(const std::string& sessionId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
     auto it = sessions_.find(sessionId);
     if (it != sessions_.end()) {
-        return it->second.get();
+        return it->second;
     }
     return nullptr;
 }
 
+int64_t PlaybackManager::GetFrameDelayUs(const std::string& sessionId) const {
+    std::shared_ptr<PlaybackSession> found = GetSession(sessionId);
+    if (!found) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> sessionLock(found->mutex);
+    const PlaybackSession& session = *found;
+    if (session.control.mode == PlaybackMode::PAUSE || session.control.mode == PlaybackMode::STEP) {
+        return -1;
+    }
+
+    const int64_t frameUs = static_cast<int64_t>(kFrameDurationMs) * 1000;
+    if (session.download) {
+        // 下载不按实时节奏，只受a=downloadspeed限制
+        return (session.downloadSpeed > 0) ? frameUs / session.downloadSpeed : 0;
+    }
+
+    double speed = fabs(session.control.speed);
+    if (speed <= 0) {
+        return -1;
+    }
+
+    // 只发关键帧时下一帧是相邻的关键帧，间隔为GOP时长
+    const std::vector<KeyframeEntry>& keyframes = session.reader->GetKeyframes();
+    int64_t index = session.keyframeIndex;
+    if (speed > keyframeOnlySpeed_.load() && index >= 0 && index < static_cast<int64_t>(keyframes.size())) {
+        int64_t next = index + ((session.control.speed < 0) ? -1 : 1);
+        if (next >= 0 && next < static_cast<int64_t>(keyframes.size())) {
+            int64_t gapMs = std::abs(static_cast<int64_t>(keyframes[next].timestampMs) -
+                                     static_cast<int64_t>(keyframes[index].timestampMs));
+            return static_cast<int64_t>(gapMs * 1000 / speed);
+        }
+    }
+    return static_cast<int64_t>(frameUs / speed);
+}
+
 std::vector<std::string> PlaybackManager::GetActiveSessions() {
+    // 表中的会话都是活跃的，停止时先从表中移除
+    std::lock_guard<std::mutex> lock(mutex_);
     std::vector<std::string> activeSessions;
+    activeSessions.reserve(sessions_.size());
 
     for (const auto& pair : sessions_) {
-        if (pair.second && pair.second->isActive) {
-            activeSessions.push_back(pair.first);
-        }
+        activeSessions.push_back(pair.first);
     }
 
     return activeSessions;
@@ -212,49 +431,283 @@ void PlaybackManager::SetFrameCallback(std::function<void(const uint8_t* data, s
 }
 
 bool PlaybackManager::ReadNextFrame(const std::string& sessionId) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
+    std::shared_ptr<PlaybackSession> session = GetSession(sessionId);
+    if (!session) {
         return false;
     }
 
-    auto& session = it->second;
+    std::lock_guard<std::mutex> sessionLock(session->mutex);
 
     if (!session->isActive) {
         return false;
     }
 
-    // 检查是否到达结束时间
-    if (session->currentPosition >= session->endTime) {
-        std::cout << "[PlaybackManager] Reached end of playback: " << sessionId << std::endl;
-        return false;
-    }
-
     // 检查是否暂停
     if (session->control.mode == PlaybackMode::PAUSE) {
         return true;
     }
 
-    // 模拟读取帧（实际应该从文件解码）
-    // TODO: 实现实际的文件读取和解码
-    uint8_t dummyFrame[1024] = {0};
-    uint64_t timestamp = session->currentPosition;
+    if (!LoadPendingFrame(*session)) {
+        return false;
+    }
+
+    MediaFrame frame = session->pending;
+    session->hasPending = false;
+
+    uint64_t timestamp = session->fileStartTime + frame.timestampMs;
+    uint64_t output = MapOutputTime(*session, timestamp, true);
+
+    // 输出时间与帧时间不同时拷贝PS帧并改写包内时间戳，正常播放不拷贝
+    const uint8_t *data = frame.data;
+    if (output != timestamp && session->reader->GetFormat() == MediaFileReader::Format::PS) {
+        session->frameBuffer.assign(frame.data, frame.data + frame.size);
+        MediaFileReader::ShiftPsTimestamps(session->frameBuffer.data(), session->frameBuffer.size(),
+                                           (static_cast<int64_t>(output) - static_cast<int64_t>(timestamp)) * 90);
+        data = session->frameBuffer.data();
+    }
 
     // 调用帧回调
     if (frameCallback_) {
-        frameCallback_(dummyFrame, sizeof(dummyFrame), timestamp);
+        frameCallback_(data, frame.size, output);
+    }
+
+    session->started = true;
+    session->outputEnd = std::max(session->outputEnd, output);
+    session->currentPosition = timestamp;
+
+    return true;
+}
+
+FrameState PlaybackManager::PeekNextFrame(const std::string& sessionId, uint64_t& timestamp, double& pace) {
+    std::shared_ptr<PlaybackSession> found = GetSession(sessionId);
+    if (!found) {
+        return FrameState::FINISHED;
+    }
+
+    std::lock_guard<std::mutex> sessionLock(found->mutex);
+    PlaybackSession& session = *found;
+    if (!session.isActive) {
+        return FrameState::FINISHED;
+    }
+    if (session.control.mode == PlaybackMode::PAUSE) {
+        return FrameState::PAUSED;
+    }
+
+    if (!LoadPendingFrame(session)) {
+        return FrameState::FINISHED;
+    }
+
+    timestamp = MapOutputTime(session, session.fileStartTime + session.pending.timestampMs, false);
+
+    // 回放的输出时间戳已按倍速压缩；下载的时间戳不变，按下载倍速发送
+    pace = session.download ? session.downloadSpeed : 1.0;
+    return FrameState::READY;
+}
+
+ReadMode PlaybackManager::GetReadMode(const PlaybackSession& session) const {
+    double speed = session.control.speed;
+    bool reverse = speed < 0;
+    if (!session.download && fabs(speed) > keyframeOnlySpeed_.load() && !session.reader->GetKeyframes().empty()) {
+        return reverse ? ReadMode::KEYFRAMES_REVERSE : ReadMode::KEYFRAMES;
+    }
+    return reverse ? ReadMode::REVERSE_GOP : ReadMode::FORWARD;
+}
+
+bool PlaybackManager::LoadPendingFrame(PlaybackSession& session) {
+    ReadMode mode = GetReadMode(session);
+
+    // 读出待发送帧后读取方式变了，退回到该帧按新方式重新读取
+    if (session.hasPending && session.pendingMode != mode) {
+        session.reader->Seek({session.pending.offset, static_cast<uint32_t>(session.pending.timestampMs),
+                     session.pending.sample});
+        session.hasPending = false;
+    }
+    if (session.hasPending) {
+        return true;
+    }
+
+    bool reverse = (mode == ReadMode::REVERSE_GOP || mode == ReadMode::KEYFRAMES_REVERSE);
+
+    // 检查是否到达结束时间
+    if (!reverse && session.currentPosition >= session.endTime) {
+        LOG_INFO("[PlaybackManager] Reached end of playback: " << session.sessionId);
+        return false;
+    }
+
+    // 当前文件读完时接着读相邻的文件
+    MediaFrame frame;
+    for (;;) {
+        bool read;
+        if (mode == ReadMode::KEYFRAMES || mode == ReadMode::KEYFRAMES_REVERSE) {
+            read = ReadKeyframe(session, reverse, frame);
+        } else if (reverse) {
+            read = ReadReverseGopFrame(session, frame);
+        } else {
+            read = session.reader->ReadFrame(frame);
+        }
+        if (read) {
+            break;
+        }
+        if (!EnterNextSegment(session, reverse)) {
+            LOG_INFO("[PlaybackManager] Reached " << (reverse ? "start" : "end")
+                     << " of playback: " << session.sessionId);
+            return false;
+        }
     }
+    session.segmentEntered = false;
 
-    // 更新位置
-    double frameTime = 40.0 / fabs(session->control.speed); // 假设25fps，每帧40ms
-    if (session->control.speed < 0) {
-        session->currentPosition -= (uint64_t)frameTime;
+    if (!reverse && session.fileStartTime + frame.timestampMs >= session.endTime) {
+        LOG_INFO("[PlaybackManager] Reached end of playback: " << session.sessionId);
+        session.currentPosition = session.endTime;
+        return false;
+    }
+
+    session.pending = frame;
+    session.pendingMode = mode;
+    session.hasPending = true;
+    return true;
+}
+
+uint64_t PlaybackManager::MapOutputTime(PlaybackSession& session, uint64_t timestamp, bool commit) const {
+    double rate = (session.control.speed != 0) ? fabs(session.control.speed) : 1.0;
+    uint64_t mediaAnchor = session.mediaAnchor;
+    uint64_t outputAnchor = session.outputAnchor;
+    bool anchorReverse = session.anchorReverse;
+
+    // 第一帧保持原时间，之后的新段接在已输出的时间之后
+    if (!session.anchored) {
+        mediaAnchor = timestamp;
+        outputAnchor = session.started
+            ? session.outputEnd + static_cast<uint64_t>(kFrameDurationMs / rate)
+            : timestamp;
+        anchorReverse = (GetReadMode(session) == ReadMode::KEYFRAMES_REVERSE);
+        if (commit) {
+            session.mediaAnchor = mediaAnchor;
+            session.outputAnchor = outputAnchor;
+            session.anchorReverse = anchorReverse;
+            session.anchored = true;
+        }
+    }
+
+    int64_t mediaDelta = anchorReverse
+        ? static_cast<int64_t>(mediaAnchor) - static_cast<int64_t>(timestamp)
+        : static_cast<int64_t>(timestamp) - static_cast<int64_t>(mediaAnchor);
+    return static_cast<uint64_t>(std::max<int64_t>(0,
+        static_cast<int64_t>(outputAnchor) + static_cast<int64_t>(mediaDelta / rate)));
+}
+
+bool PlaybackManager::ReadKeyframe(PlaybackSession& session, bool reverse, MediaFrame& frame) {
+    MediaFileReader& reader = *session.reader;
+    const std::vector<KeyframeEntry>& keyframes = reader.GetKeyframes();
+    uint64_t position = (session.currentPosition > session.fileStartTime)
+        ? session.currentPosition - session.fileStartTime : 0;
+
+    // 还未输出时从不晚于开始位置的关键帧开始，刚切换文件时从文件两端开始，之后取相邻的关键帧
+    int64_t index;
+    if (session.segmentEntered) {
+        index = reverse ? static_cast<int64_t>(keyframes.size()) - 1 : 0;
+    } else if (!session.started) {
+        index = std::max<int64_t>(0, KeyframeIndexAt(reader, position));
+    } else if (reverse) {
+        index = KeyframeIndexBefore(session);
     } else {
-        session->currentPosition += (uint64_t)frameTime;
+        index = KeyframeIndexAt(reader, position) + 1;
     }
 
+    if (index < 0 || index >= static_cast<int64_t>(keyframes.size()) ||
+        (reverse && !GopReachesStart(session, index))) {
+        return false;
+    }
+
+    session.keyframeIndex = index;
+    session.gopEnd = -1;
+    reader.Seek(keyframes[index]);
+    return reader.ReadFrame(frame);
+}
+
+bool PlaybackManager::ReadReverseGopFrame(PlaybackSession& session, MediaFrame& frame) {
+    MediaFileReader& reader = *session.reader;
+    const std::vector<KeyframeEntry>& keyframes = reader.GetKeyframes();
+
+    for (;;) {
+        int64_t index;
+        if (session.gopEnd >= 0) {
+            if (reader.ReadFrame(frame) && frame.offset < static_cast<uint64_t>(session.gopEnd)) {
+                return true;
+            }
+            index = session.keyframeIndex - 1;
+        } else if (session.segmentEntered) {
+            // 从后一个文件倒放进来：从最后一个GOP开始
+            index = static_cast<int64_t>(keyframes.size()) - 1;
+        } else {
+            // 刚进入倒放：从当前位置所在的GOP开始
+            index = KeyframeIndexBefore(session);
+        }
+
+        if (index < 0 || !GopReachesStart(session, index)) {
+            return false;
+        }
+
+        // 每个GOP内按正序发送，输出时间戳重新锚定
+        session.keyframeIndex = index;
+        session.gopEnd = (index + 1 < static_cast<int64_t>(keyframes.size()))
+            ? static_cast<int64_t>(keyframes[index + 1].offset)
+            : static_cast<int64_t>(reader.GetFileSize());
+        session.anchored = false;
+        reader.Seek(keyframes[index]);
+    }
+}
+
+bool PlaybackManager::OpenSegment(PlaybackSession& session, size_t index) {
+    const PlaybackSegment& segment = session.segments[index];
+    if (!FileExists(segment.filePath)) {
+        LOG_ERROR("[PlaybackManager] File not found: " << segment.filePath);
+        return false;
+    }
+
+    auto reader = std::make_unique<MediaFileReader>();
+    if (!reader->Open(segment.filePath)) {
+        return false;
+    }
+
+    // 换文件后关键帧序号失效，输出时间戳重新锚定，接在已输出的时间之后
+    session.reader = std::move(reader);
+    session.filePath = segment.filePath;
+    session.fileStartTime = segment.startTime;
+    session.segmentIndex = index;
+    session.keyframeIndex = -1;
+    session.gopEnd = -1;
+    session.anchored = false;
+    session.hasPending = false;
     return true;
 }
 
+bool PlaybackManager::EnterNextSegment(PlaybackSession& session, bool reverse) {
+    size_t index = session.segmentIndex;
+    while (reverse ? index > 0 : index + 1 < session.segments.size()) {
+        index = reverse ? index - 1 : index + 1;
+
+        const PlaybackSegment& segment = session.segments[index];
+        if (reverse ? segment.endTime <= session.startTime : segment.startTime >= session.endTime) {
+            return false;
+        }
+        if (OpenSegment(session, index)) {
+            LOG_DEBUG("[PlaybackManager] Session " << session.sessionId << " continues with " << segment.filePath);
+            session.segmentEntered = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PlaybackManager::GopReachesStart(const PlaybackSession& session, int64_t index) {
+    const std::vector<KeyframeEntry>& keyframes = session.reader->GetKeyframes();
+    if (index + 1 >= static_cast<int64_t>(keyframes.size())) {
+        return true;
+    }
+    return session.fileStartTime + keyframes[index + 1].timestampMs > session.startTime;
+}
+
 bool PlaybackManager::FileExists(const std::string& filePath) {
 #ifdef _WIN32
     DWORD attrs = GetFileAttributesA(filePath.c_str());
@@ -316,7 +769,7 @@ uint64_t PlaybackManager::ParseTimeToMs(const std::string& timeStr) {
                 timePoint.time_since_epoch()).count();
         }
     } catch (...) {
-        std::cerr << "[PlaybackManager] Failed to parse time: " << timeStr << std::endl;
+        LOG_ERROR("[PlaybackManager] Failed to parse time: " << timeStr);
     }
 
     return ms;
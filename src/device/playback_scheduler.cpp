@@ -0,0 +1,257 @@
+#include "device/playback_scheduler.h"
+#include "device/playback_manager.h"
+#include "utils/logger.h"
+#include <algorithm>
+
+namespace gb28181 {
+
+PlaybackScheduler::PlaybackScheduler(PlaybackManager* playbackManager, size_t threadCount)
+    : playbackManager_(playbackManager)
+    , running_(false) {
+    threadCount = std::max<size_t>(1, threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+PlaybackScheduler::~PlaybackScheduler() {
+    Stop();
+}
+
+bool PlaybackScheduler::Start() {
+    if (running_.exchange(true)) {
+        return false;
+    }
+
+    for (auto& worker : workers_) {
+        Worker *w = worker.get();
+        w->thread = std::thread([this, w] { Run(*w); });
+    }
+
+    LOG_INFO("[PlaybackScheduler] Started with " << workers_.size() << " threads");
+    return true;
+}
+
+void PlaybackScheduler::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    for (auto& worker : workers_) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+        worker->cond.notify_all();
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    LOG_INFO("[PlaybackScheduler] Stopped");
+}
+
+PlaybackScheduler::Worker& PlaybackScheduler::WorkerFor(const std::string& sessionId) const {
+    return *workers_[std::hash<std::string>()(sessionId) % workers_.size()];
+}
+
+bool PlaybackScheduler::Add(const std::string& sessionId) {
+    Worker& worker = WorkerFor(sessionId);
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.slots.count(sessionId)) {
+            return false;
+        }
+
+        uint32_t slot;
+        if (!worker.freeSlots.empty()) {
+            slot = worker.freeSlots.back();
+            worker.freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(worker.entries.size());
+            worker.entries.emplace_back();
+        }
+
+        // 槽位复用时代数沿用并递增，堆中指向旧会话的项随之失效
+        Entry& entry = worker.entries[slot];
+        uint32_t generation = entry.generation + 1;
+        entry = Entry();
+        entry.sessionId = sessionId;
+        entry.generation = generation;
+        entry.active = true;
+
+        worker.slots[sessionId] = slot;
+        worker.heap.push({Clock::now(), slot, generation});
+    }
+    worker.cond.notify_one();
+
+    LOG_DEBUG("[PlaybackScheduler] Added session: " << sessionId);
+    return true;
+}
+
+void PlaybackScheduler::Remove(const std::string& sessionId) {
+    Worker& worker = WorkerFor(sessionId);
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    auto it = worker.slots.find(sessionId);
+    if (it == worker.slots.end()) {
+        return;
+    }
+
+    Entry& entry = worker.entries[it->second];
+    entry.active = false;
+    entry.generation++;
+    entry.sessionId.clear();
+    worker.freeSlots.push_back(it->second);
+    worker.slots.erase(it);
+}
+
+void PlaybackScheduler::Wake(const std::string& sessionId) {
+    Worker& worker = WorkerFor(sessionId);
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        auto it = worker.slots.find(sessionId);
+        if (it == worker.slots.end()) {
+            return;
+        }
+
+        // 已预读的帧仍在PlaybackManager中，重新预读时按新的控制参数计算时间戳
+        Entry& entry = worker.entries[it->second];
+        entry.generation++;
+        entry.ready = false;
+        worker.heap.push({Clock::now(), it->second, entry.generation});
+    }
+    worker.cond.notify_one();
+}
+
+void PlaybackScheduler::SetFinishedCallback(FinishedCallback callback) {
+    finishedCallback_ = std::move(callback);
+}
+
+void PlaybackScheduler::SetActivityCallback(ActivityCallback callback) {
+    activityCallback_ = std::move(callback);
+}
+
+size_t PlaybackScheduler::GetSessionCount() const {
+    size_t count = 0;
+    for (const auto& worker : workers_) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        count += worker->slots.size();
+    }
+    return count;
+}
+
+bool PlaybackScheduler::Service(Entry& entry, Clock::time_point& due) {
+    // 到期的帧先发送
+    if (entry.ready && !playbackManager_->ReadNextFrame(entry.sessionId)) {
+        return false;
+    }
+    entry.ready = false;
+
+    uint64_t timestamp = 0;
+    double pace = 1.0;
+    FrameState state = playbackManager_->PeekNextFrame(entry.sessionId, timestamp, pace);
+    Clock::time_point now = Clock::now();
+
+    if (state == FrameState::FINISHED) {
+        return false;
+    }
+    if (state == FrameState::PAUSED) {
+        // 恢复后以恢复时刻重新锚定，不补发暂停期间的帧
+        entry.anchored = false;
+        due = now + std::chrono::milliseconds(kPausePollMs);
+        return true;
+    }
+
+    entry.ready = true;
+    if (pace <= 0) {
+        // 不限速下载：立即发送，与其他到期会话按堆顺序轮流
+        due = now;
+        return true;
+    }
+
+    if (!entry.anchored) {
+        entry.anchorTime = now;
+        entry.anchorTimestamp = timestamp;
+        entry.anchored = true;
+    }
+
+    int64_t offsetUs = static_cast<int64_t>(
+        (static_cast<int64_t>(timestamp) - static_cast<int64_t>(entry.anchorTimestamp)) * 1000 / pace);
+    due = entry.anchorTime + std::chrono::microseconds(offsetUs);
+
+    // 落后过多（线程过载或文件读取阻塞）时从当前时刻重新锚定，避免突发补发
+    if (due + std::chrono::milliseconds(kMaxLagMs) < now) {
+        entry.anchorTime = now;
+        entry.anchorTimestamp = timestamp;
+        due = now;
+    }
+    return true;
+}
+
+void PlaybackScheduler::Run(Worker& worker) {
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    while (running_) {
+        if (worker.heap.empty()) {
+            worker.cond.wait(lock);
+            continue;
+        }
+
+        HeapItem item = worker.heap.top();
+        const Entry& current = worker.entries[item.slot];
+        if (!current.active || current.generation != item.generation) {
+            worker.heap.pop();
+            continue;
+        }
+        if (item.due > Clock::now()) {
+            worker.cond.wait_until(lock, item.due);
+            continue;
+        }
+        worker.heap.pop();
+
+        // 在锁外读文件和发送，期间会话可能被移除或唤醒
+        Entry entry = current;
+        lock.unlock();
+        Clock::time_point due;
+        bool alive = Service(entry, due);
+        if (alive && activityCallback_) {
+            Clock::time_point now = Clock::now();
+            if (now - entry.lastActivity >= std::chrono::milliseconds(kActivityIntervalMs)) {
+                entry.lastActivity = now;
+                activityCallback_(entry.sessionId);
+            }
+        }
+        lock.lock();
+
+        Entry& stored = worker.entries[item.slot];
+        if (!stored.active || stored.generation != item.generation) {
+            continue;
+        }
+
+        if (alive) {
+            stored.ready = entry.ready;
+            stored.anchored = entry.anchored;
+            stored.anchorTime = entry.anchorTime;
+            stored.anchorTimestamp = entry.anchorTimestamp;
+            stored.lastActivity = entry.lastActivity;
+            worker.heap.push({due, item.slot, item.generation});
+            continue;
+        }
+
+        std::string sessionId = stored.sessionId;
+        stored.active = false;
+        stored.generation++;
+        stored.sessionId.clear();
+        worker.freeSlots.push_back(item.slot);
+        worker.slots.erase(sessionId);
+
+        LOG_INFO("[PlaybackScheduler] Session finished: " << sessionId);
+        if (finishedCallback_) {
+            lock.unlock();
+            finishedCallback_(sessionId);
+            lock.lock();
+        }
+    }
+}
+
+} // namespace gb28181
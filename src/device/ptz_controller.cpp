@@ -1,8 +1,8 @@
 #include "device/ptz_controller.h"
+#include "utils/logger.h"
 #include <sstream>
 #include <algorithm>
 #include <regex>
-#include <iostream>
 
 namespace gb28181 {
 
@@ -14,19 +14,19 @@ PTZController::~PTZController() {
 
 bool PTZController::Initialize() {
     initialized_ = true;
-    std::cout << "[PTZController] Initialized" << std::endl;
+    LOG_INFO("[PTZController] Initialized");
     return true;
 }
 
 bool PTZController::ExecuteCommand(const PTZControlParams& params) {
     if (!initialized_) {
-        std::cerr << "[PTZController] Not initialized" << std::endl;
+        LOG_ERROR("[PTZController] Not initialized");
         return false;
     }
 
-    std::cout << "[PTZController] Execute command: " << GetCommandName(params.command)
-              << " on channel: " << params.channelId
-              << " speed: " << params.speed << std::endl;
+    LOG_INFO("[PTZController] Execute command: " << GetCommandName(params.command)
+             << " on channel: " << params.channelId
+             << " speed: " << params.speed);
 
     // 更新当前动作
     currentActions_[params.channelId] = params;
@@ -35,9 +35,9 @@ bool PTZController::ExecuteCommand(const PTZControlParams& params) {
     bool success = ExecuteHardwareControl(params);
 
     if (success) {
-        std::cout << "[PTZController] Command executed successfully" << std::endl;
+        LOG_INFO("[PTZController] Command executed successfully");
     } else {
-        std::cerr << "[PTZController] Command execution failed" << std::endl;
+        LOG_ERROR("[PTZController] Command execution failed");
     }
 
     return success;
@@ -65,8 +65,8 @@ bool PTZController::SetPreset(const std::string& channelId, int presetId, const
 
     presets_[channelId][presetId] = preset;
 
-    std::cout << "[PTZController] Set preset: " << presetId
-              << " for channel: " << channelId << std::endl;
+    LOG_INFO("[PTZController] Set preset: " << presetId
+             << " for channel: " << channelId);
 
     return true;
 }
@@ -74,13 +74,13 @@ bool PTZController::SetPreset(const std::string& channelId, int presetId, const
 bool PTZController::CallPreset(const std::string& channelId, int presetId, int speed) {
     auto it = presets_.find(channelId);
     if (it == presets_.end()) {
-        std::cerr << "[PTZController] Channel not found: " << channelId << std::endl;
+        LOG_ERROR("[PTZController] Channel not found: " << channelId);
         return false;
     }
 
     auto presetIt = it->second.find(presetId);
     if (presetIt == it->second.end()) {
-        std::cerr << "[PTZController] Preset not found: " << presetId << std::endl;
+        LOG_ERROR("[PTZController] Preset not found: " << presetId);
         return false;
     }
 
@@ -101,7 +101,7 @@ bool PTZController::DeletePreset(const std::string& channelId, int presetId) {
 
     it->second.erase(presetId);
 
-    std::cout << "[PTZController] Deleted preset: " << presetId << std::endl;
+    LOG_INFO("[PTZController] Deleted preset: " << presetId);
 
     return true;
 }
@@ -143,8 +143,8 @@ bool PTZController::AddCruisePoint(const std::string& channelId, int cruiseId, i
     cruise.dwellTimes.push_back(dwellTime);
     cruise.enabled = true;
 
-    std::cout << "[PTZController] Added cruise point: cruiseId=" << cruiseId
-              << " presetId=" << presetId << std::endl;
+    LOG_INFO("[PTZController] Added cruise point: cruiseId=" << cruiseId
+             << " presetId=" << presetId);
 
     return true;
 }
@@ -309,7 +309,7 @@ bool PTZController::ExecuteHardwareControl(const PTZControlParams& params) {
     // 例如: 通过串口发送PELCO-D/PELCO-P命令
     // 或者通过网络发送VISCA命令
 
-    std::cout << "[PTZController] Hardware control: " << GetCommandName(params.command) << std::endl;
+    LOG_INFO("[PTZController] Hardware control: " << GetCommandName(params.command));
 
     return true;
 }
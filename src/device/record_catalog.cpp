@@ -0,0 +1,355 @@
+#include "device/record_catalog.h"
+#include "utils/logger.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gb28181 {
+
+namespace {
+
+const uint32_t kInitialChannelCapacity = 64;
+
+} // namespace
+
+const char RecordCatalog::kMagic[4] = {'G', 'B', 'R', 'C'};
+
+RecordCatalog::RecordCatalog()
+    : base_(nullptr)
+    , size_(0)
+    , mapped_(false)
+    , header_(nullptr)
+    , channelTable_(nullptr)
+    , fileSizes_(nullptr)
+    , startTimes_(nullptr)
+    , endTimes_(nullptr)
+    , channels_(nullptr)
+    , flags_(nullptr) {
+}
+
+RecordCatalog::~RecordCatalog() {
+    Close();
+}
+
+size_t RecordCatalog::LayoutSize(uint32_t rowCapacity, uint32_t channelCapacity) {
+    return sizeof(RecordCatalogHeader) + static_cast<size_t>(channelCapacity) * kChannelIdSize +
+           static_cast<size_t>(rowCapacity) * (sizeof(uint64_t) + 3 * sizeof(uint32_t) + sizeof(uint8_t));
+}
+
+void RecordCatalog::Attach(uint8_t *base, size_t size) {
+    base_ = base;
+    size_ = size;
+    header_ = reinterpret_cast<RecordCatalogHeader*>(base);
+
+    // 通道表每项32字节，其后的uint64列保持8字节对齐
+    uint32_t rows = header_->rowCapacity;
+    channelTable_ = reinterpret_cast<char*>(base + sizeof(RecordCatalogHeader));
+    fileSizes_ = reinterpret_cast<uint64_t*>(channelTable_ + static_cast<size_t>(header_->channelCapacity) * kChannelIdSize);
+    startTimes_ = reinterpret_cast<uint32_t*>(fileSizes_ + rows);
+    endTimes_ = startTimes_ + rows;
+    channels_ = endTimes_ + rows;
+    flags_ = reinterpret_cast<uint8_t*>(channels_ + rows);
+}
+
+bool RecordCatalog::Allocate(const std::string& path, uint32_t rowCapacity, uint32_t channelCapacity,
+                             uint8_t*& base, size_t& size) {
+    size = LayoutSize(rowCapacity, channelCapacity);
+
+    if (!mapped_) {
+        base = new uint8_t[size]();
+        return true;
+    }
+
+#ifdef _WIN32
+    return false;
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("[RecordCatalog] Failed to create " << path << ": " << std::strerror(errno));
+        return false;
+    }
+
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        LOG_ERROR("[RecordCatalog] Failed to resize " << path << ": " << std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("[RecordCatalog] Failed to map " << path << ": " << std::strerror(errno));
+        return false;
+    }
+
+    base = static_cast<uint8_t*>(mapping);
+    return true;
+#endif
+}
+
+void RecordCatalog::Release(uint8_t *base, size_t size) {
+    if (!base) {
+        return;
+    }
+
+    if (!mapped_) {
+        delete[] base;
+        return;
+    }
+
+#ifndef _WIN32
+    munmap(base, size);
+#endif
+}
+
+bool RecordCatalog::Open(const std::string& path) {
+    Close();
+
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(RecordCatalogHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("[RecordCatalog] Failed to map " << path << ": " << std::strerror(errno));
+        return false;
+    }
+
+    const RecordCatalogHeader *header = static_cast<const RecordCatalogHeader*>(mapping);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion ||
+        header->rowCount > header->rowCapacity || header->channelCount > header->channelCapacity ||
+        LayoutSize(header->rowCapacity, header->channelCapacity) != size) {
+        LOG_WARN("[RecordCatalog] Ignoring invalid catalog: " << path);
+        munmap(mapping, size);
+        return false;
+    }
+
+    path_ = path;
+    mapped_ = true;
+    Attach(static_cast<uint8_t*>(mapping), size);
+
+    channelIds_.reserve(header_->channelCount);
+    for (uint32_t i = 0; i < header_->channelCount; i++) {
+        const char *id = channelTable_ + static_cast<size_t>(i) * kChannelIdSize;
+        channelIds_.emplace_back(id, strnlen(id, kChannelIdSize - 1));
+        channelIndex_[channelIds_.back()] = i;
+    }
+
+    // 只扫描标志列：收集可复用的行，丢弃通道序号越界的行
+    for (uint32_t row = 0; row < header_->rowCount; row++) {
+        if (IsValid(row) && channels_[row] >= header_->channelCount) {
+            flags_[row] = 0;
+        }
+        if (!IsValid(row)) {
+            freeRows_.push_back(row);
+        }
+    }
+
+    return true;
+#endif
+}
+
+bool RecordCatalog::Create(const std::string& path, uint32_t rowCapacity) {
+    Close();
+
+    path_ = path;
+#ifdef _WIN32
+    mapped_ = false;
+#else
+    mapped_ = !path.empty();
+#endif
+
+    // 先写临时文件再替换，失败时不破坏已有的目录
+    std::string target = mapped_ ? path + ".tmp" : path;
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    if (rowCapacity == 0 || !Allocate(target, rowCapacity, kInitialChannelCapacity, base, size)) {
+        path_.clear();
+        return false;
+    }
+
+    RecordCatalogHeader *header = reinterpret_cast<RecordCatalogHeader*>(base);
+    std::memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->version = kVersion;
+    header->rowCapacity = rowCapacity;
+    header->channelCapacity = kInitialChannelCapacity;
+    Attach(base, size);
+
+#ifndef _WIN32
+    if (mapped_) {
+        msync(base_, size_, MS_SYNC);
+        if (std::rename(target.c_str(), path.c_str()) != 0) {
+            LOG_ERROR("[RecordCatalog] Failed to replace " << path << ": " << std::strerror(errno));
+            std::remove(target.c_str());
+            Close();
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void RecordCatalog::Close() {
+    Sync();
+    Release(base_, size_);
+
+    base_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+    channelTable_ = nullptr;
+    fileSizes_ = nullptr;
+    startTimes_ = nullptr;
+    endTimes_ = nullptr;
+    channels_ = nullptr;
+    flags_ = nullptr;
+    path_.clear();
+    channelIds_.clear();
+    channelIndex_.clear();
+    freeRows_.clear();
+}
+
+void RecordCatalog::Sync() {
+#ifndef _WIN32
+    if (base_ && mapped_) {
+        msync(base_, size_, MS_SYNC);
+    }
+#endif
+}
+
+bool RecordCatalog::Grow(uint32_t rowCapacity, uint32_t channelCapacity) {
+    std::string target = mapped_ ? path_ + ".tmp" : path_;
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    if (!Allocate(target, rowCapacity, channelCapacity, base, size)) {
+        return false;
+    }
+
+    // 逐列复制到新布局中对应的位置
+    RecordCatalogHeader *header = reinterpret_cast<RecordCatalogHeader*>(base);
+    *header = *header_;
+    header->rowCapacity = rowCapacity;
+    header->channelCapacity = channelCapacity;
+
+    // 借用Attach计算新布局的列指针，复制完成后不由grown释放
+    RecordCatalog grown;
+    grown.Attach(base, size);
+    uint32_t rows = header_->rowCount;
+    std::memcpy(grown.channelTable_, channelTable_, static_cast<size_t>(header_->channelCount) * kChannelIdSize);
+    std::memcpy(grown.fileSizes_, fileSizes_, rows * sizeof(uint64_t));
+    std::memcpy(grown.startTimes_, startTimes_, rows * sizeof(uint32_t));
+    std::memcpy(grown.endTimes_, endTimes_, rows * sizeof(uint32_t));
+    std::memcpy(grown.channels_, channels_, rows * sizeof(uint32_t));
+    std::memcpy(grown.flags_, flags_, rows * sizeof(uint8_t));
+    grown.base_ = nullptr;
+
+#ifndef _WIN32
+    if (mapped_) {
+        msync(base, size, MS_SYNC);
+        if (std::rename(target.c_str(), path_.c_str()) != 0) {
+            LOG_ERROR("[RecordCatalog] Failed to replace " << path_ << ": " << std::strerror(errno));
+            munmap(base, size);
+            std::remove(target.c_str());
+            return false;
+        }
+    }
+#endif
+
+    Release(base_, size_);
+    Attach(base, size);
+
+    LOG_DEBUG("[RecordCatalog] Grown to " << rowCapacity << " rows, " << channelCapacity << " channels");
+    return true;
+}
+
+uint32_t RecordCatalog::InternChannel(const std::string& channelId) {
+    auto it = channelIndex_.find(channelId);
+    if (it != channelIndex_.end()) {
+        return it->second;
+    }
+
+    if (channelId.size() >= kChannelIdSize) {
+        LOG_WARN("[RecordCatalog] Channel ID too long: " << channelId);
+        return kInvalidRow;
+    }
+
+    if (header_->channelCount == header_->channelCapacity &&
+        !Grow(header_->rowCapacity, header_->channelCapacity * 2)) {
+        return kInvalidRow;
+    }
+
+    uint32_t channel = header_->channelCount;
+    char *id = channelTable_ + static_cast<size_t>(channel) * kChannelIdSize;
+    std::memset(id, 0, kChannelIdSize);
+    std::memcpy(id, channelId.data(), channelId.size());
+    header_->channelCount++;
+
+    channelIds_.push_back(channelId);
+    channelIndex_[channelId] = channel;
+    return channel;
+}
+
+uint32_t RecordCatalog::Append(const std::string& channelId, uint32_t startTime, uint32_t endTime,
+                               uint64_t fileSize, uint8_t flags) {
+    if (!base_) {
+        return kInvalidRow;
+    }
+
+    uint32_t channel = InternChannel(channelId);
+    if (channel == kInvalidRow) {
+        return kInvalidRow;
+    }
+
+    uint32_t row;
+    if (!freeRows_.empty()) {
+        row = freeRows_.back();
+        freeRows_.pop_back();
+    } else {
+        if (header_->rowCount == header_->rowCapacity &&
+            !Grow(header_->rowCapacity * 2, header_->channelCapacity)) {
+            return kInvalidRow;
+        }
+        row = header_->rowCount;
+    }
+
+    // 有效标志和行数最后写入，中途退出时不会留下半行
+    fileSizes_[row] = fileSize;
+    startTimes_[row] = startTime;
+    endTimes_[row] = endTime;
+    channels_[row] = channel;
+    flags_[row] = static_cast<uint8_t>(flags | kFlagValid);
+    if (row == header_->rowCount) {
+        header_->rowCount++;
+    }
+    return row;
+}
+
+void RecordCatalog::Remove(uint32_t row) {
+    if (!base_ || row >= header_->rowCount || !IsValid(row)) {
+        return;
+    }
+
+    flags_[row] = 0;
+    freeRows_.push_back(row);
+}
+
+} // namespace gb28181
@@ -1,10 +1,14 @@
 #include "device/record_manager.h"
+#include "device/keyframe_index.h"
+#include "utils/xml_template.h"
+#include "utils/logger.h"
 #include <sstream>
 #include <fstream>
 #include <algorithm>
-#include <regex>
+#include <limits>
+#include <unordered_set>
+#include <ctime>
 #include <sys/stat.h>
-#include <iostream>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -15,7 +19,136 @@
 
 namespace gb28181 {
 
-RecordManager::RecordManager() : initialized_(false) {
+namespace {
+
+// 录像查询应答，Num为本条消息包含的录像数，SumNum为检索结果总数
+const XmlTemplate kRecordInfoHeadTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>RecordInfo</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<SumNum>{{SumNum}}</SumNum>\r\n"
+    "<RecordList Num=\"{{Num}}\">\r\n");
+
+const XmlTemplate kRecordInfoItemTemplate(
+    "<Item>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<Name>{{Name}}</Name>\r\n"
+    "<FilePath>{{FilePath}}</FilePath>\r\n"
+    "<Address>{{Address}}</Address>\r\n"
+    "<StartTime>{{StartTime}}</StartTime>\r\n"
+    "<EndTime>{{EndTime}}</EndTime>\r\n"
+    "<Secrecy>{{Secrecy}}</Secrecy>\r\n"
+    "<Type>{{Type}}</Type>\r\n"
+    "<FileSize>{{FileSize}}</FileSize>\r\n"
+    "</Item>\r\n");
+
+const char kRecordInfoTail[] = "</RecordList>\r\n</Response>\r\n";
+
+// 消息头中SN/SumNum/Num等数字字段预留的最大长度
+const size_t kRecordInfoHeadReserve = 40;
+
+#ifdef _WIN32
+const char kPathSeparator = '\\';
+#else
+const char kPathSeparator = '/';
+#endif
+
+// 录像目录文件，位于录像目录下
+const char kCatalogFileName[] = "records.catalog";
+
+// 建立索引的录像扩展名，与回放读取器支持的MP4和PS封装对应
+struct RecordExtension {
+    const char *extension;
+    size_t length;
+    uint8_t flag;
+};
+
+const RecordExtension kRecordExtensions[] = {
+    {".mp4", 4, RecordCatalog::kFlagExtMp4},
+    {".ps", 3, RecordCatalog::kFlagExtPs},
+    {".mpg", 4, RecordCatalog::kFlagExtMpg},
+};
+
+// 按路径的扩展名查找，不支持的扩展名返回nullptr
+const RecordExtension *FindRecordExtension(const std::string& path) {
+    for (const RecordExtension& ext : kRecordExtensions) {
+        if (path.size() > ext.length &&
+            path.compare(path.size() - ext.length, ext.length, ext.extension) == 0) {
+            return &ext;
+        }
+    }
+    return nullptr;
+}
+
+const char *GetRecordExtension(uint8_t flags) {
+    uint8_t flag = flags & RecordCatalog::kFlagExtMask;
+    for (const RecordExtension& ext : kRecordExtensions) {
+        if (ext.flag == flag) {
+            return ext.extension;
+        }
+    }
+    return kRecordExtensions[0].extension;
+}
+
+// 按strftime格式输出本地时间，查询在线程池中并发执行，不使用std::localtime
+std::string FormatLocalTime(uint32_t seconds, const char *format) {
+    std::time_t time = static_cast<std::time_t>(seconds);
+    std::tm tm = {};
+#ifdef _WIN32
+    localtime_s(&tm, &time);
+#else
+    localtime_r(&time, &tm);
+#endif
+    char buffer[32];
+    size_t length = std::strftime(buffer, sizeof(buffer), format, &tm);
+    return std::string(buffer, length);
+}
+
+// 读取定长十进制数字
+bool ParseDigits(const std::string& text, size_t pos, size_t count, int& value) {
+    value = 0;
+    for (size_t i = pos; i < pos + count; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// 文件或目录的修改时间，精确到纳秒（Windows为100纳秒），获取失败返回0
+uint64_t GetModifiedTime(const std::string& path) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
+    if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &fileInfo)) {
+        ULARGE_INTEGER time;
+        time.HighPart = fileInfo.ftLastWriteTime.dwHighDateTime;
+        time.LowPart = fileInfo.ftLastWriteTime.dwLowDateTime;
+        return time.QuadPart;
+    }
+#else
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) == 0) {
+        return static_cast<uint64_t>(fileStat.st_mtim.tv_sec) * 1000000000ULL +
+               static_cast<uint64_t>(fileStat.st_mtim.tv_nsec);
+    }
+#endif
+    return 0;
+}
+
+const char *RecordTypeName(RecordType type) {
+    switch (type) {
+        case RecordType::MANUAL: return "manual";
+        case RecordType::ALARM:  return "alarm";
+        default:                 return "time";
+    }
+}
+
+} // namespace
+
+RecordManager::RecordManager() : recordCount_(0), initialized_(false) {
 }
 
 RecordManager::~RecordManager() {
@@ -30,7 +163,7 @@ bool RecordManager::Initialize(const std::string& recordPath) {
     if (attrs == INVALID_FILE_ATTRIBUTES || !(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
         // 尝试创建目录
         if (!CreateDirectoryA(recordPath_.c_str(), NULL)) {
-            std::cerr << "[RecordManager] Failed to create directory: " << recordPath_ << std::endl;
+            LOG_ERROR("[RecordManager] Failed to create directory: " << recordPath_);
             return false;
         }
     }
@@ -38,7 +171,7 @@ bool RecordManager::Initialize(const std::string& recordPath) {
     DIR* dir = opendir(recordPath_.c_str());
     if (!dir) {
         if (mkdir(recordPath_.c_str(), 0755) != 0) {
-            std::cerr << "[RecordManager] Failed to create directory: " << recordPath_ << std::endl;
+            LOG_ERROR("[RecordManager] Failed to create directory: " << recordPath_);
             return false;
         }
     } else {
@@ -46,8 +179,11 @@ bool RecordManager::Initialize(const std::string& recordPath) {
     }
 #endif
 
+    // 关键帧索引写在子目录中，先建好，之后回放重建索引不改变录像目录的修改时间
+    CreateKeyframeIndexDirectory(GetCatalogPath());
+
     initialized_ = true;
-    std::cout << "[RecordManager] Initialized with path: " << recordPath_ << std::endl;
+    LOG_INFO("[RecordManager] Initialized with path: " << recordPath_);
 
     // 加载录像信息
     LoadRecordsFromStorage();
@@ -59,76 +195,236 @@ std::vector<RecordInfo> RecordManager::QueryRecords(const RecordQueryCondition&
     std::vector<RecordInfo> results;
 
     if (!initialized_) {
-        std::cerr << "[RecordManager] Not initialized" << std::endl;
+        LOG_ERROR("[RecordManager] Not initialized");
         return results;
     }
 
-    for (const auto& record : records_) {
-        // 过滤通道
-        if (!condition.channelId.empty() && record.channelId != condition.channelId) {
-            continue;
+    // 未指定或无法解析的时间视为不限
+    int64_t start = std::numeric_limits<int64_t>::min();
+    int64_t end = std::numeric_limits<int64_t>::max();
+    if (!condition.startTime.empty() && !ParseRecordTime(condition.startTime, start)) {
+        LOG_WARN("[RecordManager] Invalid query start time: " << condition.startTime);
+        start = std::numeric_limits<int64_t>::min();
+    }
+    if (!condition.endTime.empty() && !ParseRecordTime(condition.endTime, end)) {
+        LOG_WARN("[RecordManager] Invalid query end time: " << condition.endTime);
+        end = std::numeric_limits<int64_t>::max();
+    }
+
+    bool descending = (condition.order == "desc");
+    size_t limit = (condition.maxResults > 0) ? static_cast<size_t>(condition.maxResults) : 0;
+    std::vector<const IndexedRecord*> matched;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!condition.channelId.empty()) {
+        uint32_t channel = catalog_.FindChannel(condition.channelId);
+        if (channel < channels_.size()) {
+            CollectRecords(channels_[channel], start, end, condition.type, descending, limit, matched);
+        }
+    } else {
+        // 每个通道各取前limit条，合并排序后再截取
+        for (const ChannelRecords& channel : channels_) {
+            CollectRecords(channel, start, end, condition.type, descending, limit, matched);
         }
 
-        // 过滤录像类型
-        if (condition.type != RecordType::ALL && record.type != condition.type) {
-            continue;
+        auto before = [descending](const IndexedRecord *a, const IndexedRecord *b) {
+            if (a->startTime != b->startTime) {
+                return descending ? a->startTime > b->startTime : a->startTime < b->startTime;
+            }
+            return a->row < b->row;
+        };
+        if (limit > 0 && matched.size() > limit) {
+            std::partial_sort(matched.begin(), matched.begin() + limit, matched.end(), before);
+            matched.resize(limit);
+        } else {
+            std::sort(matched.begin(), matched.end(), before);
         }
+    }
+
+    results.reserve(matched.size());
+    for (const IndexedRecord *record : matched) {
+        results.push_back(MakeRecordInfo(record->row));
+    }
+    lock.unlock();
+
+    LOG_INFO("[RecordManager] Query returned " << results.size() << " records");
 
-        // 过滤时间范围
-        if (!condition.startTime.empty() && record.endTime < condition.startTime) {
+    return results;
+}
+
+void RecordManager::CollectRecords(const ChannelRecords& channel, int64_t start, int64_t end,
+                                   RecordType type, bool descending, size_t limit,
+                                   std::vector<const IndexedRecord*>& out) const {
+    const std::vector<IndexedRecord>& records = channel.records;
+
+    // 开始时间早于start - maxDuration的录像在start之前已经结束
+    int64_t lowest = std::numeric_limits<int64_t>::min();
+    if (start > lowest + channel.maxDuration) {
+        lowest = start - channel.maxDuration;
+    }
+
+    size_t first = std::lower_bound(records.begin(), records.end(), lowest,
+        [](const IndexedRecord& record, int64_t time) {
+            return static_cast<int64_t>(record.startTime) < time;
+        }) - records.begin();
+    size_t last = std::upper_bound(records.begin(), records.end(), end,
+        [](int64_t time, const IndexedRecord& record) {
+            return time < static_cast<int64_t>(record.startTime);
+        }) - records.begin();
+
+    size_t found = 0;
+    for (size_t n = first; n < last && (limit == 0 || found < limit); n++) {
+        const IndexedRecord& record = records[descending ? last - 1 - (n - first) : n];
+        if (static_cast<int64_t>(record.endTime) < start) {
             continue;
         }
-        if (!condition.endTime.empty() && record.startTime > condition.endTime) {
+        if (type != RecordType::ALL &&
+            (catalog_.GetFlags(record.row) & RecordCatalog::kFlagTypeMask) != static_cast<uint8_t>(type)) {
             continue;
         }
+        out.push_back(&record);
+        found++;
+    }
+}
 
-        results.push_back(record);
+void RecordManager::AddRecord(const RecordInfo& record) {
+    int64_t start = 0;
+    int64_t end = 0;
+    if (!ParseRecordTime(record.startTime, start) || !ParseRecordTime(record.endTime, end) ||
+        start < 0 || end < start || end > UINT32_MAX) {
+        LOG_WARN("[RecordManager] Invalid record time: " << record.channelId
+                 << " from " << record.startTime << " to " << record.endTime);
+        return;
+    }
 
-        // 限制结果数量
-        if (condition.maxResults > 0 && results.size() >= condition.maxResults) {
-            break;
-        }
+    // 目录不保存路径，查询和回放按命名规则还原。不在录像目录下、扩展名不支持或文件名与
+    // 通道和起止时间不符的文件还原不出原路径，不加入目录
+    if (!IsRecordFilePath(record.filePath, record.channelId, start, end)) {
+        LOG_WARN("[RecordManager] Record file does not follow naming convention: " << record.filePath);
+        return;
     }
+    const RecordExtension *ext = FindRecordExtension(record.filePath);
 
-    // 排序
-    if (condition.order == "asc") {
-        std::sort(results.begin(), results.end(),
-            [](const RecordInfo& a, const RecordInfo& b) {
-                return a.startTime < b.startTime;
-            });
-    } else if (condition.order == "desc") {
-        std::sort(results.begin(), results.end(),
-            [](const RecordInfo& a, const RecordInfo& b) {
-                return a.startTime > b.startTime;
-            });
+    uint8_t flags = static_cast<uint8_t>(record.type == RecordType::ALL ? RecordType::TIME : record.type);
+    flags |= ext->flag;
+    if (record.hasPrivacy) {
+        flags |= RecordCatalog::kFlagPrivacy;
     }
 
-    std::cout << "[RecordManager] Query returned " << results.size() << " records" << std::endl;
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t row = catalog_.Append(record.channelId, static_cast<uint32_t>(start),
+                                   static_cast<uint32_t>(end), record.fileSize, flags);
+    if (row == RecordCatalog::kInvalidRow) {
+        LOG_WARN("[RecordManager] Failed to add record: " << record.channelId
+                 << " at " << record.startTime);
+        return;
+    }
+    IndexRow(row);
+    RefreshDirectoryTime();
+}
 
-    return results;
+bool RecordManager::IsRecordFilePath(const std::string& filePath, const std::string& channelId,
+                                     int64_t start, int64_t end) {
+    size_t nameStart = recordPath_.size() + 1;
+    if (filePath.size() <= nameStart || filePath.compare(0, recordPath_.size(), recordPath_) != 0 ||
+        filePath[recordPath_.size()] != kPathSeparator) {
+        return false;
+    }
+
+    RecordInfo named;
+    int64_t namedStart = 0;
+    int64_t namedEnd = 0;
+    return ParseRecordFileName(filePath.substr(nameStart), named) && named.channelId == channelId &&
+           ParseRecordTime(named.startTime, namedStart) && namedStart == start &&
+           ParseRecordTime(named.endTime, namedEnd) && namedEnd == end;
 }
 
-void RecordManager::AddRecord(const RecordInfo& record) {
-    records_.push_back(record);
+void RecordManager::IndexRow(uint32_t row) {
+    uint32_t channelIndex = catalog_.GetChannel(row);
+    if (channelIndex >= channels_.size()) {
+        channels_.resize(channelIndex + 1);
+    }
 
-    std::cout << "[RecordManager] Added record: " << record.channelId
-              << " from " << record.startTime << " to " << record.endTime << std::endl;
+    IndexedRecord indexed = {catalog_.GetStartTime(row), catalog_.GetEndTime(row), row};
+    ChannelRecords& channel = channels_[channelIndex];
+    channel.maxDuration = std::max(channel.maxDuration, indexed.endTime - indexed.startTime);
+
+    // 录像通常按时间顺序加入，直接追加；乱序时插入到相同开始时间的录像之后
+    std::vector<IndexedRecord>& records = channel.records;
+    if (records.empty() || records.back().startTime <= indexed.startTime) {
+        records.push_back(indexed);
+    } else {
+        auto pos = std::upper_bound(records.begin(), records.end(), indexed.startTime,
+            [](uint32_t time, const IndexedRecord& entry) {
+                return time < entry.startTime;
+            });
+        records.insert(pos, indexed);
+    }
+    recordCount_++;
+}
+
+RecordInfo RecordManager::MakeRecordInfo(uint32_t row) const {
+    uint8_t flags = catalog_.GetFlags(row);
+    uint32_t start = catalog_.GetStartTime(row);
+    uint32_t end = catalog_.GetEndTime(row);
+
+    RecordInfo info;
+    info.channelId = catalog_.GetChannelId(catalog_.GetChannel(row));
+    info.startTime = FormatLocalTime(start, "%Y-%m-%dT%H:%M:%S");
+    info.endTime = FormatLocalTime(end, "%Y-%m-%dT%H:%M:%S");
+    info.type = static_cast<RecordType>(flags & RecordCatalog::kFlagTypeMask);
+    info.filePath = recordPath_ + kPathSeparator + MakeRecordFileName(row);
+    info.fileSize = catalog_.GetFileSize(row);
+    info.hasPrivacy = (flags & RecordCatalog::kFlagPrivacy) != 0;
+    return info;
+}
+
+std::string RecordManager::MakeRecordFileName(uint32_t row) const {
+    return catalog_.GetChannelId(catalog_.GetChannel(row)) + "_" +
+           FormatLocalTime(catalog_.GetStartTime(row), "%Y%m%d_%H%M%S") + "_" +
+           FormatLocalTime(catalog_.GetEndTime(row), "%Y%m%d_%H%M%S") +
+           GetRecordExtension(catalog_.GetFlags(row));
+}
+
+std::string RecordManager::GetCatalogPath() const {
+    return recordPath_ + kPathSeparator + kCatalogFileName;
 }
 
 void RecordManager::DeleteRecord(const std::string& deviceId,
                                  const std::string& channelId,
                                  const std::string& startTime) {
-    auto it = std::remove_if(records_.begin(), records_.end(),
-        [&deviceId, &channelId, &startTime](const RecordInfo& record) {
-            return record.deviceId == deviceId &&
-                   record.channelId == channelId &&
-                   record.startTime == startTime;
+    (void)deviceId;
+
+    int64_t start = 0;
+    if (!ParseRecordTime(startTime, start)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t channel = catalog_.FindChannel(channelId);
+    if (channel >= channels_.size()) {
+        return;
+    }
+
+    std::vector<IndexedRecord>& records = channels_[channel].records;
+    auto first = std::lower_bound(records.begin(), records.end(), start,
+        [](const IndexedRecord& record, int64_t time) {
+            return static_cast<int64_t>(record.startTime) < time;
+        });
+    auto last = std::upper_bound(first, records.end(), start,
+        [](int64_t time, const IndexedRecord& record) {
+            return time < static_cast<int64_t>(record.startTime);
         });
 
-    if (it != records_.end()) {
-        records_.erase(it, records_.end());
-        std::cout << "[RecordManager] Deleted record: " << channelId
-                  << " at " << startTime << std::endl;
+    if (first != last) {
+        for (auto it = first; it != last; ++it) {
+            catalog_.Remove(it->row);
+        }
+        recordCount_ -= last - first;
+        records.erase(first, last);
+        RefreshDirectoryTime();
+        LOG_INFO("[RecordManager] Deleted record: " << channelId
+                 << " at " << startTime);
     }
 }
 
@@ -174,14 +470,88 @@ std::string RecordManager::GenerateRecordInfoResponse(const std::string& deviceI
     return ss.str();
 }
 
+size_t RecordManager::GenerateRecordInfoChunk(std::string& out, uint32_t sn,
+                                              const std::string& deviceId,
+                                              const std::vector<RecordInfo>& records,
+                                              size_t offset, size_t maxBodyBytes) const {
+    out.clear();
+
+    if (offset >= records.size() && !(offset == 0 && records.empty())) {
+        return 0;
+    }
+
+    // 先渲染录像条目，确定本条能容纳的数量后再补消息头
+    size_t fixedSize = kRecordInfoHeadTemplate.GetStaticSize() + deviceId.size() +
+                       kRecordInfoHeadReserve + sizeof(kRecordInfoTail) - 1;
+    size_t budget = (maxBodyBytes > fixedSize) ? maxBodyBytes - fixedSize : 0;
+
+    std::string items;
+    size_t count = 0;
+    for (size_t i = offset; i < records.size(); i++) {
+        size_t before = items.size();
+        const RecordInfo& record = records[i];
+        kRecordInfoItemTemplate.RenderAppend(items, {record.channelId, record.channelId,
+                                                     record.filePath, record.storage,
+                                                     record.startTime, record.endTime,
+                                                     record.hasPrivacy ? 1 : 0,
+                                                     RecordTypeName(record.type),
+                                                     record.fileSize});
+        if (items.size() > budget && count > 0) {
+            items.resize(before);
+            break;
+        }
+        count++;
+    }
+
+    kRecordInfoHeadTemplate.Render(out, {sn, deviceId, records.size(), count});
+    out.append(items);
+    out.append(kRecordInfoTail, sizeof(kRecordInfoTail) - 1);
+    return count;
+}
+
 bool RecordManager::LoadRecordsFromStorage() {
     if (!initialized_) {
         return false;
     }
 
-    ScanRecordFiles();
+    uint64_t directoryTime = GetModifiedTime(recordPath_);
+    std::vector<std::string> newFiles;
+    bool opened = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        opened = catalog_.Open(GetCatalogPath());
+        if (opened) {
+            // 目录修改时间与上次核对时相同说明没有文件增删，不访问录像文件
+            if (directoryTime == 0 || directoryTime != catalog_.GetDirectoryTime()) {
+                ReconcileRecordFiles(newFiles);
+            }
+
+            // 只遍历映射的列建立通道索引
+            channels_.clear();
+            recordCount_ = 0;
+            for (uint32_t row = 0; row < catalog_.GetRowCount(); row++) {
+                if (catalog_.IsValid(row)) {
+                    IndexRow(row);
+                }
+            }
+        }
+    }
+
+    if (opened) {
+        for (const std::string& fileName : newFiles) {
+            AddRecordFile(fileName);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        RefreshDirectoryTime();
+        catalog_.Sync();
+    } else {
+        ScanRecordFiles();
+    }
 
-    std::cout << "[RecordManager] Loaded " << records_.size() << " records from storage" << std::endl;
+    std::lock_guard<std::mutex> lock(mutex_);
+    LOG_INFO("[RecordManager] Loaded " << recordCount_ << " records from "
+             << channels_.size() << " channels");
 
     return true;
 }
@@ -191,19 +561,75 @@ void RecordManager::ScanRecordFiles() {
         return;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        channels_.clear();
+        recordCount_ = 0;
+        if (!catalog_.Create(GetCatalogPath()) && !catalog_.Create("")) {
+            LOG_ERROR("[RecordManager] Failed to create record catalog");
+            return;
+        }
+    }
+
+    std::vector<std::string> fileNames;
+    ListRecordFiles(fileNames);
+    for (const std::string& fileName : fileNames) {
+        AddRecordFile(fileName);
+    }
+
+    // 新建和扩容目录文件都会改变录像目录的修改时间，全部写完后再记录
+    std::lock_guard<std::mutex> lock(mutex_);
+    RefreshDirectoryTime();
+    catalog_.Sync();
+}
+
+void RecordManager::RefreshDirectoryTime() {
+    catalog_.SetDirectoryTime(GetModifiedTime(recordPath_));
+}
+
+void RecordManager::ReconcileRecordFiles(std::vector<std::string>& newFiles) {
+    std::vector<std::string> fileNames;
+    ListRecordFiles(fileNames);
+    std::unordered_set<std::string> present(fileNames.begin(), fileNames.end());
+
+    // 文件已不存在的行直接删除，其余行的文件名记入known
+    std::unordered_set<std::string> known;
+    size_t removed = 0;
+    for (uint32_t row = 0; row < catalog_.GetRowCount(); row++) {
+        if (!catalog_.IsValid(row)) {
+            continue;
+        }
+        std::string fileName = MakeRecordFileName(row);
+        if (present.count(fileName) == 0) {
+            catalog_.Remove(row);
+            removed++;
+        } else {
+            known.insert(std::move(fileName));
+        }
+    }
+
+    for (std::string& fileName : fileNames) {
+        if (known.count(fileName) == 0) {
+            newFiles.push_back(std::move(fileName));
+        }
+    }
+
+    LOG_INFO("[RecordManager] Record directory changed: removed " << removed
+             << " missing records, found " << newFiles.size() << " new files");
+}
+
+void RecordManager::ListRecordFiles(std::vector<std::string>& fileNames) {
+    RecordInfo record;
 #ifdef _WIN32
     WIN32_FIND_DATAA findData;
-    std::string searchPath = recordPath_ + "\\*.mp4";
+    std::string searchPath = recordPath_ + "\\*";
     HANDLE hFind = FindFirstFileA(searchPath.c_str(), &findData);
 
     if (hFind != INVALID_HANDLE_VALUE) {
         do {
             std::string fileName = findData.cFileName;
-            RecordInfo record;
             if (ParseRecordFileName(fileName, record)) {
-                record.filePath = recordPath_ + "\\" + fileName;
-                record.fileSize = GetFileSize(record.filePath);
-                AddRecord(record);
+                fileNames.push_back(fileName);
             }
         } while (FindNextFileA(hFind, &findData));
 
@@ -215,14 +641,8 @@ void RecordManager::ScanRecordFiles() {
         struct dirent* entry;
         while ((entry = readdir(dir)) != nullptr) {
             std::string fileName = entry->d_name;
-            if (fileName.find(".mp4") != std::string::npos ||
-                fileName.find(".avi") != std::string::npos) {
-                RecordInfo record;
-                if (ParseRecordFileName(fileName, record)) {
-                    record.filePath = recordPath_ + "/" + fileName;
-                    record.fileSize = GetFileSize(record.filePath);
-                    AddRecord(record);
-                }
+            if (ParseRecordFileName(fileName, record)) {
+                fileNames.push_back(fileName);
             }
         }
         closedir(dir);
@@ -230,23 +650,96 @@ void RecordManager::ScanRecordFiles() {
 #endif
 }
 
+void RecordManager::AddRecordFile(const std::string& fileName) {
+    RecordInfo record;
+    if (ParseRecordFileName(fileName, record)) {
+        record.filePath = recordPath_ + kPathSeparator + fileName;
+        record.fileSize = GetFileSize(record.filePath);
+        AddRecord(record);
+    }
+}
+
 bool RecordManager::ParseRecordFileName(const std::string& fileName, RecordInfo& record) {
-    // 文件名格式示例: 34020000001320000001_20240101_120000_20240101_130000.mp4
-    // 或者: ChannelID_StartTime_EndTime.mp4
+    // 文件名格式: ChannelID_StartTime_EndTime.mp4|.ps|.mpg
+    // 示例: 34020000001320000001_20240101_120000_20240101_130000.mp4
+    const size_t kChannelLength = 20;
+    const size_t kTimeLength = 15;
+    const size_t kBaseLength = kChannelLength + 1 + kTimeLength + 1 + kTimeLength;
+    const size_t kStartPos = kChannelLength + 1;
+    const size_t kEndPos = kStartPos + kTimeLength + 1;
+
+    const RecordExtension *ext = FindRecordExtension(fileName);
+    if (!ext || fileName.size() != kBaseLength + ext->length || fileName[kChannelLength] != '_' ||
+        fileName[kEndPos - 1] != '_') {
+        return false;
+    }
 
-    std::regex pattern(R"((\d{20})_(\d{8}_\d{6})_(\d{8}_\d{6})\.(mp4|avi))");
-    std::smatch match;
+    int value = 0;
+    for (size_t i = 0; i < kChannelLength; i += 4) {
+        if (!ParseDigits(fileName, i, 4, value)) {
+            return false;
+        }
+    }
+
+    int64_t start = 0;
+    int64_t end = 0;
+    std::string startTime = fileName.substr(kStartPos, kTimeLength);
+    std::string endTime = fileName.substr(kEndPos, kTimeLength);
+    if (startTime[8] != '_' || endTime[8] != '_' ||
+        !ParseRecordTime(startTime, start) || !ParseRecordTime(endTime, end) ||
+        start < 0 || end > UINT32_MAX) {
+        return false;
+    }
+
+    record.channelId = fileName.substr(0, kChannelLength);
+    record.startTime = FormatLocalTime(static_cast<uint32_t>(start), "%Y-%m-%dT%H:%M:%S");
+    record.endTime = FormatLocalTime(static_cast<uint32_t>(end), "%Y-%m-%dT%H:%M:%S");
+    record.type = RecordType::TIME;
+    record.hasPrivacy = false;
+    return true;
+}
+
+bool RecordManager::ParseRecordTime(const std::string& timeStr, int64_t& seconds) {
+    // 各字段在两类格式中的位置：{年, 月, 日, 时, 分, 秒}
+    static const size_t kExtended[] = {0, 5, 8, 11, 14, 17};    // 2024-01-01T12:00:00
+    static const size_t kBasic[] = {0, 4, 6, 9, 11, 13};        // 20240101T120000
+    const size_t *pos = nullptr;
+
+    if (timeStr.size() == 19 && timeStr[4] == '-' && timeStr[7] == '-' &&
+        (timeStr[10] == 'T' || timeStr[10] == ' ') && timeStr[13] == ':' && timeStr[16] == ':') {
+        pos = kExtended;
+    } else if (timeStr.size() == 15 && (timeStr[8] == 'T' || timeStr[8] == '_')) {
+        pos = kBasic;
+    } else {
+        return false;
+    }
 
-    if (std::regex_match(fileName, match, pattern)) {
-        record.channelId = match[1].str();
-        record.startTime = match[2].str();
-        record.endTime = match[3].str();
-        record.type = RecordType::TIME;
-        record.hasPrivacy = false;
-        return true;
+    int fields[6];
+    for (int i = 0; i < 6; i++) {
+        if (!ParseDigits(timeStr, pos[i], i == 0 ? 4 : 2, fields[i])) {
+            return false;
+        }
+    }
+    if (fields[1] < 1 || fields[1] > 12 || fields[2] < 1 || fields[2] > 31 ||
+        fields[3] > 23 || fields[4] > 59 || fields[5] > 60) {
+        return false;
     }
 
-    return false;
+    std::tm tm = {};
+    tm.tm_year = fields[0] - 1900;
+    tm.tm_mon = fields[1] - 1;
+    tm.tm_mday = fields[2];
+    tm.tm_hour = fields[3];
+    tm.tm_min = fields[4];
+    tm.tm_sec = fields[5];
+    tm.tm_isdst = -1;
+
+    std::time_t time = std::mktime(&tm);
+    if (time == static_cast<std::time_t>(-1)) {
+        return false;
+    }
+    seconds = static_cast<int64_t>(time);
+    return true;
 }
 
 uint64_t RecordManager::GetFileSize(const std::string& filePath) {
@@ -1,17 +1,38 @@
 #include "sip/sip_manager.h"
 #include "device/device_manager.h"
+#include "device/record_manager.h"
+#include "device/config_manager.h"
+#include "device/alarm_manager.h"
+#include "device/playback_manager.h"
+#include "device/playback_scheduler.h"
 #include "rtp/rtp_manager.h"
+#include "rtp/socket_pool.h"
 #include "ps/ps_muxer.h"
+#include "utils/timer_service.h"
+#include "utils/config_loader.h"
+#include "utils/thread_pool.h"
+#include "utils/logger.h"
+#include "utils/event_log.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <csignal>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
 
 using namespace gb28181;
 
 // 全局变量
+std::unique_ptr<TimerService> g_timerService;
 std::unique_ptr<SipManager> g_sipManager;
 std::unique_ptr<DeviceManager> g_deviceManager;
+std::vector<std::unique_ptr<DeviceManager>> g_gatewayDeviceManagers;   // 网关子身份各自的设备信息和通道
+std::unique_ptr<AlarmManager> g_alarmManager;
+std::unique_ptr<RecordManager> g_recordManager;
+std::unique_ptr<PlaybackManager> g_playbackManager;
+std::unique_ptr<PlaybackScheduler> g_playbackScheduler;
+std::unique_ptr<ThreadPool> g_threadPool;
 std::unique_ptr<RtpManager> g_rtpManager;
 std::unique_ptr<PsMuxer> g_psMuxer;
 bool g_running = true;
@@ -24,40 +45,65 @@ void SignalHandler(int signal) {
 
 // SIP事件回调
 void OnSipEvent(const std::string& event, const std::string& data) {
-    std::cout << "[SIP Event] " << event << ": " << data << std::endl;
+    LOG_INFO("[SIP Event] " << event << ": " << data);
 
     if (event == "REGISTER_SUCCESS") {
-        std::cout << "Device registered to SIP server successfully!" << std::endl;
+        LOG_INFO("Device registered to SIP server successfully!");
         g_deviceManager->SetDeviceStatus(DeviceStatus::ONLINE);
     } else if (event == "REGISTER_FAILURE") {
-        std::cout << "Failed to register to SIP server!" << std::endl;
+        LOG_WARN("Failed to register to SIP server!");
+        g_deviceManager->SetDeviceStatus(DeviceStatus::OFFLINE);
+    } else if (event == "KEEPALIVE_TIMEOUT") {
+        LOG_WARN("Lost contact with SIP server, re-registering...");
         g_deviceManager->SetDeviceStatus(DeviceStatus::OFFLINE);
     } else if (event == "INVITE_RECEIVED") {
-        std::cout << "Video streaming request received!" << std::endl;
+        LOG_INFO("Video streaming request received!");
         // TODO: 启动视频流发送
     }
 }
 
 // 设备事件回调
 void OnDeviceEvent(const std::string& event, const std::string& data) {
-    std::cout << "[Device Event] " << event << ": " << data << std::endl;
+    LOG_INFO("[Device Event] " << event << ": " << data);
+}
+
+// 读取一路视频编码流配置，未配置时返回false
+bool LoadVideoStream(const std::map<std::string, std::string>& config,
+                     const std::string& prefix,
+                     VideoConfig& stream) {
+    auto it = config.find(prefix + ".type");
+    if (it == config.end()) {
+        return false;
+    }
+
+    int height = ConfigLoader::GetInt(config, prefix + ".height", 1080);
+    stream.codec = it->second;
+    stream.resolution = (height <= 144) ? 0 : (height <= 288) ? 1 : (height <= 576) ? 2 : (height <= 720) ? 3 : 4;
+    stream.frameRate = ConfigLoader::GetInt(config, prefix + ".fps", 25);
+    stream.bitRate = ConfigLoader::GetInt(config, prefix + ".bitrate", 4096);
+    stream.gop = ConfigLoader::GetInt(config, prefix + ".gop", stream.frameRate);
+    stream.profileLevelId = 0x42E01F;
+    stream.vbr = false;
+    stream.quality = 7;
+    return true;
 }
 
 // RTP接收回调
 void OnRtpReceive(const RtpPacket& packet, const std::string& fromIp, int fromPort) {
-    std::cout << "[RTP] Received packet from " << fromIp << ":" << fromPort
+    LOG_DEBUG("[RTP] Received packet from " << fromIp << ":" << fromPort
               << ", seq=" << packet.sequenceNumber
-              << ", size=" << packet.payload.size() << std::endl;
+              << ", size=" << packet.payload.size());
 }
 
-// 发送心跳线程
-void HeartbeatThread() {
-    while (g_running) {
-        std::this_thread::sleep_for(std::chrono::seconds(60));
-        if (g_sipManager) {
-            g_sipManager->SendHeartbeat();
-        }
+// 网关模式下按序号生成设备ID（20位编码的末7位为设备序号）
+std::string MakeGatewayDeviceId(const std::string& baseId, int offset) {
+    if (baseId.length() != 20) {
+        return baseId + "_" + std::to_string(offset);
     }
+
+    long serial = std::atol(baseId.substr(13).c_str()) + offset;
+    std::string serialStr = std::to_string(serial % 10000000);
+    return baseId.substr(0, 13) + std::string(7 - serialStr.length(), '0') + serialStr;
 }
 
 // SIP消息处理线程
@@ -94,20 +140,92 @@ int main(int argc, char* argv[]) {
     int serverPort = 5060;
     std::string username = "34020000001320000001";
     std::string password = "12345678";
+    int registerExpires = 3600;
+    int heartbeatInterval = 60;
+    int gatewayDevices = 1;
+    std::string recordPath = "records";
+    int queryThreads = 2;
+    int rtpBasePort = 50000;
+    int rtpPortCount = 10000;
+    SocketPoolOptions socketPoolOptions;
+    std::vector<VideoConfig> videoStreams;
+    std::string eventLogPath = "gb28181_events.bin";
+    int eventLogCapacity = 65536;
+    double keyframeOnlySpeed = PlaybackManager::kDefaultKeyframeOnlySpeed;
+    int playbackThreads = 1;
+    int alarmReportInterval = 60;
+
+    // 心跳和注册周期从配置文件读取
+    std::map<std::string, std::string> config;
+    if (ConfigLoader::LoadJson("config/device_config.json", config)) {
+        heartbeatInterval = std::max(1, ConfigLoader::GetInt(config, "sip.heartbeatInterval", heartbeatInterval));
+        registerExpires = std::max(60, ConfigLoader::GetInt(config, "sip.registerInterval", registerExpires));
+        queryThreads = std::max(1, ConfigLoader::GetInt(config, "record.queryThreads", queryThreads));
+        rtpBasePort = ConfigLoader::GetInt(config, "rtp.basePort", rtpBasePort);
+        rtpPortCount = ConfigLoader::GetInt(config, "rtp.portCount", rtpPortCount);
+        socketPoolOptions.lowWatermark = static_cast<size_t>(std::max(0, ConfigLoader::GetInt(
+            config, "rtp.socketPool.lowWatermark", static_cast<int>(socketPoolOptions.lowWatermark))));
+        socketPoolOptions.highWatermark = static_cast<size_t>(std::max(0, ConfigLoader::GetInt(
+            config, "rtp.socketPool.highWatermark", static_cast<int>(socketPoolOptions.highWatermark))));
+        auto it = config.find("record.path");
+        if (it != config.end() && !it->second.empty()) {
+            recordPath = it->second;
+        }
+        // 主码流和子码流，INVITE按f=请求的分辨率选择
+        VideoConfig stream;
+        if (LoadVideoStream(config, "media.video", stream)) {
+            videoStreams.push_back(stream);
+            if (LoadVideoStream(config, "media.subVideo", stream)) {
+                videoStreams.push_back(stream);
+            }
+        }
+        it = config.find("rtp.socketPool.tcpListen");
+        if (it != config.end()) {
+            socketPoolOptions.tcpListen = (it->second == "true");
+        }
+        it = config.find("eventLog.path");
+        if (it != config.end()) {
+            eventLogPath = it->second;
+        }
+        eventLogCapacity = std::max(1024, ConfigLoader::GetInt(config, "eventLog.capacity", eventLogCapacity));
+        it = config.find("playback.keyframeOnlySpeed");
+        if (it != config.end() && !it->second.empty()) {
+            keyframeOnlySpeed = std::atof(it->second.c_str());
+        }
+        playbackThreads = std::max(1, ConfigLoader::GetInt(config, "playback.schedulerThreads", playbackThreads));
+        alarmReportInterval = ConfigLoader::GetInt(config, "alarm.reportInterval", alarmReportInterval);
+    }
 
     // 解析命令行参数
-    // 用法: ./gb28181_device [local_ip] [server_ip]
+    // 用法: ./gb28181_device [local_ip] [server_ip] [gateway_devices]
     // 示例: ./gb28181_device 192.168.1.100 192.168.1.1
+    //       ./gb28181_device 192.168.1.100 192.168.1.1 2000  (网关模式，托管2000个设备身份)
     if (argc > 1) {
         localIp = argv[1];
     }
     if (argc > 2) {
         serverIp = argv[2];
     }
+    if (argc > 3) {
+        gatewayDevices = std::max(1, std::atoi(argv[3]));
+    }
+    bool gatewayMode = gatewayDevices > 1;
 
     std::cout << "Local IP: " << (localIp == "auto" ? "auto-detect" : localIp) << std::endl;
     std::cout << "SIP Server: " << serverIp << ":" << serverPort << std::endl;
     std::cout << "Device ID: " << deviceId << std::endl;
+    if (gatewayMode) {
+        std::cout << "Gateway mode: " << gatewayDevices << " device identities" << std::endl;
+    }
+
+    // 打开二进制事件日志，打开失败不影响运行
+    if (!eventLogPath.empty()) {
+        EventLog::Instance().Open(eventLogPath, static_cast<size_t>(eventLogCapacity));
+    }
+
+    // 启动定时器服务（心跳、注册刷新、会话超时共用一个线程）
+    g_timerService = std::make_unique<TimerService>();
+    g_timerService->Start();
 
     // 初始化SIP管理器
     std::cout << "\nInitializing SIP Manager..." << std::endl;
@@ -117,6 +235,8 @@ int main(int argc, char* argv[]) {
         return -1;
     }
     g_sipManager->SetEventCallback(OnSipEvent);
+    g_sipManager->SetTimerService(g_timerService.get());
+    g_sipManager->SetHeartbeatInterval(heartbeatInterval);
 
     // 初始化设备管理器
     std::cout << "Initializing Device Manager..." << std::endl;
@@ -128,7 +248,8 @@ int main(int argc, char* argv[]) {
     deviceInfo.manufacturer = "GB28181 Inc.";
     deviceInfo.model = "IPC-1000";
     deviceInfo.firmwareVersion = "1.0.0";
-    deviceInfo.ipAddress = localIp;
+    // 配置为auto时使用SIP管理器探测到的地址，目录条目的IPAddress取自这里
+    deviceInfo.ipAddress = g_sipManager->GetLocalIp();
     deviceInfo.port = sipPort;
     deviceInfo.status = DeviceStatus::OFFLINE;
     g_deviceManager->SetDeviceInfo(deviceInfo);
@@ -142,6 +263,42 @@ int main(int argc, char* argv[]) {
     g_deviceManager->AddChannel(channel);
 
     g_deviceManager->SetEventCallback(OnDeviceEvent);
+    g_sipManager->SetDeviceManager(g_deviceManager.get());
+
+    // 初始化告警管理器，触发和周期重报的告警在定时器线程生成，投递到SIP线程发送
+    g_alarmManager = std::make_unique<AlarmManager>();
+    g_alarmManager->Initialize();
+    g_alarmManager->SetTimerService(g_timerService.get());
+    g_alarmManager->SetAlarmCallback([deviceId](const AlarmInfo& alarm) {
+        AlarmInfo notify = alarm;
+        if (notify.deviceId.empty()) {
+            notify.deviceId = deviceId;
+        }
+        g_sipManager->PostNotify(g_alarmManager->GenerateAlarmNotify(notify));
+    });
+    if (alarmReportInterval > 0 && !g_alarmManager->StartAlarmReporting(alarmReportInterval)) {
+        std::cerr << "Failed to start alarm reporting" << std::endl;
+    }
+
+    // 初始化录像管理器，目录和录像查询在线程池中执行，不阻塞SIP线程
+    std::cout << "Initializing Record Manager..." << std::endl;
+    g_recordManager = std::make_unique<RecordManager>();
+    if (!g_recordManager->Initialize(recordPath)) {
+        std::cerr << "Failed to initialize Record Manager, RecordInfo queries will return empty lists" << std::endl;
+    }
+    g_threadPool = std::make_unique<ThreadPool>(queryThreads);
+    g_sipManager->SetRecordManager(g_recordManager.get());
+    g_playbackManager = std::make_unique<PlaybackManager>();
+    g_playbackManager->Initialize();
+    g_playbackManager->SetKeyframeOnlySpeed(keyframeOnlySpeed);
+    g_sipManager->SetPlaybackManager(g_playbackManager.get());
+    g_playbackScheduler = std::make_unique<PlaybackScheduler>(g_playbackManager.get(), playbackThreads);
+    g_sipManager->SetPlaybackScheduler(g_playbackScheduler.get());
+    g_playbackScheduler->Start();
+    g_sipManager->SetThreadPool(g_threadPool.get());
+    g_sipManager->SetRtpPortRange(rtpBasePort, rtpPortCount);
+    g_sipManager->SetSocketPoolOptions(socketPoolOptions);
+    g_sipManager->SetVideoStreams(videoStreams);
 
     // 初始化RTP管理器
     std::cout << "Initializing RTP Manager..." << std::endl;
@@ -162,14 +319,43 @@ int main(int argc, char* argv[]) {
 
     // 注册到SIP服务器
     std::cout << "\nRegistering to SIP Server..." << std::endl;
-    if (!g_sipManager->RegisterToServer(serverIp, serverPort, username, password)) {
-        std::cerr << "Failed to register to SIP Server!" << std::endl;
-        return -1;
+    if (gatewayMode) {
+        // 网关模式：所有身份共享一个SIP套接字，REGISTER和心跳由定时器服务错峰驱动
+        for (int i = 1; i < gatewayDevices; i++) {
+            std::string gatewayId = MakeGatewayDeviceId(deviceId, i);
+
+            // 每个子身份是一台独立的设备，DeviceInfo和Catalog应答各自的设备ID、名称和通道
+            DeviceInfo gatewayInfo = deviceInfo;
+            gatewayInfo.deviceId = gatewayId;
+            gatewayInfo.deviceName = deviceInfo.deviceName + " " + std::to_string(i + 1);
+
+            ChannelInfo gatewayChannel = channel;
+            gatewayChannel.channelId = gatewayId;
+            gatewayChannel.channelName = "Camera " + std::to_string(i + 1);
+
+            auto gatewayDevice = std::make_unique<DeviceManager>();
+            gatewayDevice->SetDeviceInfo(gatewayInfo);
+            gatewayDevice->AddChannel(gatewayChannel);
+            g_sipManager->AddIdentity(gatewayId, gatewayId, password, gatewayDevice.get());
+            g_gatewayDeviceManagers.push_back(std::move(gatewayDevice));
+        }
+        if (!g_sipManager->RegisterAllIdentities(serverIp, serverPort, registerExpires, heartbeatInterval)) {
+            std::cerr << "Failed to schedule gateway registrations!" << std::endl;
+            return -1;
+        }
+    } else {
+        RegisterPolicy policy = g_sipManager->GetRegisterPolicy();
+        policy.expires = registerExpires;
+        g_sipManager->SetRegisterPolicy(policy);
+
+        if (!g_sipManager->RegisterToServer(serverIp, serverPort, username, password)) {
+            std::cerr << "Failed to register to SIP Server!" << std::endl;
+            return -1;
+        }
     }
 
     // 启动工作线程
     std::cout << "\nStarting worker threads..." << std::endl;
-    std::thread heartbeatThread(HeartbeatThread);
     std::thread sipProcessThread(SipProcessThread);
     std::thread rtpProcessThread(RtpProcessThread);
 
@@ -183,19 +369,38 @@ int main(int argc, char* argv[]) {
     // 清理资源
     std::cout << "\nShutting down..." << std::endl;
 
-    g_sipManager->Unregister();
-
     g_running = false;
 
-    if (heartbeatThread.joinable()) heartbeatThread.join();
     if (sipProcessThread.joinable()) sipProcessThread.join();
     if (rtpProcessThread.joinable()) rtpProcessThread.join();
 
+    // SIP状态只在ProcessMessage线程中修改，处理线程退出后再注销
+    g_sipManager->Unregister();
+
+    // 告警上报回调引用SipManager，先取消并等待正在执行的上报结束
+    g_alarmManager.reset();
+
+    // 先停定时器线程和回放调度线程，SipManager析构时不再有回调投递
+    g_timerService->Stop();
+    g_playbackScheduler->Stop();
+
+    // 线程池析构时执行完剩余查询，其结果投递给仍存活的SipManager
+    g_threadPool.reset();
+
     g_psMuxer.reset();
     g_rtpManager.reset();
-    g_deviceManager.reset();
     g_sipManager.reset();
+    g_playbackScheduler.reset();
+    g_playbackManager.reset();
+    g_recordManager.reset();
+    g_deviceManager.reset();
+    g_gatewayDeviceManagers.clear();
+    g_timerService.reset();
+
+    EventLog::Instance().Close();
 
+    // 写出异步日志中剩余的内容，避免与控制台输出交错
+    Logger::Instance().Flush();
     std::cout << "Shutdown complete." << std::endl;
 
     return 0;
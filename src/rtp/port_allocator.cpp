@@ -0,0 +1,213 @@
+#include "rtp/port_allocator.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <intrin.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+namespace gb28181 {
+
+namespace {
+
+int CountTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// 超出有效范围的尾部位置为1，查找时视为已占用
+void FillTail(std::vector<uint64_t>& words, size_t validBits) {
+    if (validBits % 64 != 0) {
+        words.back() |= ~0ULL << (validBits % 64);
+    }
+}
+
+bool CanBindUdp(int port) {
+#ifdef _WIN32
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCKET) {
+        return true;    // 无法校验时按可用处理
+    }
+#else
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return true;
+    }
+#endif
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+
+    bool ok = bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+
+#ifdef _WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+    return ok;
+}
+
+} // namespace
+
+PortAllocator::PortAllocator(int basePort, int portCount, bool validateBind)
+    : basePort_(std::max(1024, basePort + (basePort & 1)))
+    , blockCount_(static_cast<size_t>(std::max(0, std::min(portCount, 65536 - basePort_))) / kPortsPerSession)
+    , validateBind_(validateBind)
+    , freeCount_(blockCount_)
+    , cursor_(0) {
+    size_t wordCount = std::max<size_t>(1, (blockCount_ + 63) / 64);
+    used_.assign(wordCount, 0);
+    unusable_.assign(wordCount, 0);
+    fullWords_.assign((wordCount + 63) / 64, 0);
+
+    FillTail(used_, blockCount_);
+    FillTail(fullWords_, wordCount);
+    for (size_t i = 0; i < wordCount; i++) {
+        if (used_[i] == ~0ULL) {
+            fullWords_[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+
+    LOG_INFO("[PortAllocator] RTP ports " << basePort_ << "-"
+             << (basePort_ + static_cast<int>(blockCount_) * kPortsPerSession - 1)
+             << ", " << blockCount_ << " sessions");
+}
+
+int64_t PortAllocator::FindFree(size_t start) const {
+    size_t wordCount = used_.size();
+    size_t word = start / 64;
+
+    uint64_t freeBits = ~used_[word] & (~0ULL << (start % 64));
+    if (freeBits != 0) {
+        return static_cast<int64_t>(word * 64 + CountTrailingZeros(freeBits));
+    }
+
+    // 在第二级位图中找下一个未满的字，到末尾后回绕，最后一轮覆盖起点所在字的低位部分
+    size_t next = word + 1;
+    for (size_t n = 0; n <= fullWords_.size() + 1; n++) {
+        if (next >= wordCount) {
+            next = 0;
+        }
+
+        size_t summary = next / 64;
+        uint64_t notFull = ~fullWords_[summary] & (~0ULL << (next % 64));
+        if (notFull != 0) {
+            size_t found = summary * 64 + CountTrailingZeros(notFull);
+            return static_cast<int64_t>(found * 64 + CountTrailingZeros(~used_[found]));
+        }
+        next = (summary + 1) * 64;
+    }
+    return -1;
+}
+
+void PortAllocator::Mark(size_t block) {
+    size_t word = block / 64;
+    used_[word] |= 1ULL << (block % 64);
+    if (used_[word] == ~0ULL) {
+        fullWords_[word / 64] |= 1ULL << (word % 64);
+    }
+}
+
+void PortAllocator::Unmark(size_t block) {
+    size_t word = block / 64;
+    used_[word] &= ~(1ULL << (block % 64));
+    fullWords_[word / 64] &= ~(1ULL << (word % 64));
+}
+
+bool PortAllocator::CanBind(size_t block) const {
+    int port = basePort_ + static_cast<int>(block) * kPortsPerSession;
+    for (int i = 0; i < kPortsPerSession; i++) {
+        if (!CanBindUdp(port + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int PortAllocator::Allocate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    while (freeCount_ > 0) {
+        int64_t found = FindFree(cursor_);
+        if (found < 0) {
+            break;
+        }
+
+        size_t block = static_cast<size_t>(found);
+        Mark(block);
+        freeCount_--;
+        cursor_ = (block + 1) % blockCount_;
+
+        int port = basePort_ + static_cast<int>(block) * kPortsPerSession;
+        if (validateBind_ && !CanBind(block)) {
+            // 端口被其他程序占用，保持占用标记且不再分配
+            unusable_[block / 64] |= 1ULL << (block % 64);
+            LOG_WARN("[PortAllocator] Ports " << port << "-" << (port + kPortsPerSession - 1)
+                     << " in use by another process, skipping");
+            continue;
+        }
+        return port;
+    }
+
+    LOG_ERROR("[PortAllocator] No free RTP ports");
+    return -1;
+}
+
+void PortAllocator::Release(int port) {
+    int offset = port - basePort_;
+    if (offset < 0 || offset % kPortsPerSession != 0) {
+        return;
+    }
+
+    size_t block = static_cast<size_t>(offset / kPortsPerSession);
+    if (block >= blockCount_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t bit = 1ULL << (block % 64);
+    if (!(used_[block / 64] & bit) || (unusable_[block / 64] & bit)) {
+        return;
+    }
+
+    Unmark(block);
+    freeCount_++;
+}
+
+bool PortAllocator::IsAllocated(int port) const {
+    int offset = port - basePort_;
+    if (offset < 0) {
+        return false;
+    }
+
+    size_t block = static_cast<size_t>(offset / kPortsPerSession);
+    if (block >= blockCount_) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (used_[block / 64] >> (block % 64)) & 1;
+}
+
+size_t PortAllocator::GetFreeCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return freeCount_;
+}
+
+} // namespace gb28181
@@ -1,5 +1,5 @@
 #include "rtp/rtp_manager.h"
-#include <iostream>
+#include "utils/logger.h"
 
 namespace gb28181 {
 
@@ -22,7 +22,7 @@ public:
         remotePort_ = remotePort;
         payloadType_ = payloadType;
         sessionStarted_ = true;
-        std::cout << "[RTP] Session started to " << remoteIp << ":" << remotePort << std::endl;
+        LOG_INFO("[RTP] Session started to " << remoteIp << ":" << remotePort);
         return true;
     }
 
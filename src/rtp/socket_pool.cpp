@@ -0,0 +1,254 @@
+#include "rtp/socket_pool.h"
+#include "rtp/port_allocator.h"
+#include "utils/logger.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace gb28181 {
+
+namespace {
+
+void CloseSocket(SocketHandle sock) {
+    if (sock == kInvalidSocket) {
+        return;
+    }
+#ifdef _WIN32
+    closesocket(static_cast<SOCKET>(sock));
+#else
+    close(static_cast<int>(sock));
+#endif
+}
+
+bool SetNonBlocking(SocketHandle sock) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(static_cast<SOCKET>(sock), FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(static_cast<int>(sock), F_GETFL, 0);
+    return flags >= 0 && fcntl(static_cast<int>(sock), F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+/**
+ * @brief 创建并绑定套接字，设置缓冲区和非阻塞，失败返回kInvalidSocket
+ */
+SocketHandle OpenBound(int type, int port, const SocketPoolOptions& options) {
+#ifdef _WIN32
+    SOCKET raw = socket(AF_INET, type, 0);
+    if (raw == INVALID_SOCKET) {
+        return kInvalidSocket;
+    }
+    SocketHandle sock = static_cast<SocketHandle>(raw);
+#else
+    int raw = socket(AF_INET, type, 0);
+    if (raw < 0) {
+        return kInvalidSocket;
+    }
+    SocketHandle sock = raw;
+#endif
+
+    if (options.sendBufferBytes > 0) {
+        setsockopt(raw, SOL_SOCKET, SO_SNDBUF,
+                   reinterpret_cast<const char*>(&options.sendBufferBytes), sizeof(options.sendBufferBytes));
+    }
+    if (options.recvBufferBytes > 0) {
+        setsockopt(raw, SOL_SOCKET, SO_RCVBUF,
+                   reinterpret_cast<const char*>(&options.recvBufferBytes), sizeof(options.recvBufferBytes));
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+
+    if (bind(raw, (struct sockaddr*)&addr, sizeof(addr)) != 0 || !SetNonBlocking(sock) ||
+        (type == SOCK_STREAM && listen(raw, 1) != 0)) {
+        CloseSocket(sock);
+        return kInvalidSocket;
+    }
+    return sock;
+}
+
+} // namespace
+
+MediaSockets::~MediaSockets() {
+    Close();
+}
+
+MediaSockets::MediaSockets(MediaSockets&& other) noexcept {
+    *this = std::move(other);
+}
+
+MediaSockets& MediaSockets::operator=(MediaSockets&& other) noexcept {
+    if (this != &other) {
+        Close();
+        basePort = other.basePort;
+        for (int i = 0; i < COUNT; i++) {
+            udp[i] = other.udp[i];
+            other.udp[i] = kInvalidSocket;
+        }
+        tcpListen = other.tcpListen;
+        other.tcpListen = kInvalidSocket;
+        other.basePort = -1;
+    }
+    return *this;
+}
+
+void MediaSockets::Close() {
+    for (SocketHandle& sock : udp) {
+        CloseSocket(sock);
+        sock = kInvalidSocket;
+    }
+    CloseSocket(tcpListen);
+    tcpListen = kInvalidSocket;
+    basePort = -1;
+}
+
+SocketPool::SocketPool(PortAllocator* portAllocator, const SocketPoolOptions& options)
+    : portAllocator_(portAllocator)
+    , options_(options)
+    , running_(false)
+    , misses_(0) {
+    idle_.reserve(options_.highWatermark);
+}
+
+SocketPool::~SocketPool() {
+    Stop();
+}
+
+bool SocketPool::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&SocketPool::RefillLoop, this);
+
+    LOG_INFO("[SocketPool] Started, watermarks " << options_.lowWatermark
+             << "/" << options_.highWatermark);
+    return true;
+}
+
+void SocketPool::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_ && idle_.empty()) {
+            return;
+        }
+        running_ = false;
+    }
+
+    refillCondition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    std::vector<MediaSockets> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle.swap(idle_);
+    }
+    for (MediaSockets& sockets : idle) {
+        Release(std::move(sockets));
+    }
+}
+
+bool SocketPool::Create(MediaSockets& sockets) {
+    int port = portAllocator_->Allocate();
+    if (port < 0) {
+        return false;
+    }
+
+    sockets.basePort = port;
+    for (int i = 0; i < MediaSockets::COUNT; i++) {
+        sockets.udp[i] = OpenBound(SOCK_DGRAM, port + i, options_);
+        if (sockets.udp[i] == kInvalidSocket) {
+            LOG_WARN("[SocketPool] Failed to bind UDP port " << (port + i));
+            Release(std::move(sockets));
+            return false;
+        }
+    }
+
+    if (options_.tcpListen) {
+        sockets.tcpListen = OpenBound(SOCK_STREAM, port, options_);
+        if (sockets.tcpListen == kInvalidSocket) {
+            LOG_WARN("[SocketPool] Failed to listen on TCP port " << port);
+            Release(std::move(sockets));
+            return false;
+        }
+    }
+    return true;
+}
+
+MediaSockets SocketPool::Claim() {
+    MediaSockets sockets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            sockets = std::move(idle_.back());
+            idle_.pop_back();
+        }
+        if (running_ && idle_.size() < options_.lowWatermark) {
+            refillCondition_.notify_one();
+        }
+    }
+
+    if (!sockets.IsValid()) {
+        // 池空兜底：在调用线程中同步创建
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        Create(sockets);
+    }
+    return sockets;
+}
+
+void SocketPool::Release(MediaSockets sockets) {
+    int port = sockets.basePort;
+    if (port < 0) {
+        return;
+    }
+
+    // 先关闭再归还，端口再次分配时可以立即绑定
+    sockets.Close();
+    portAllocator_->Release(port);
+}
+
+size_t SocketPool::GetIdleCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+void SocketPool::RefillLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        refillCondition_.wait(lock, [this] {
+            return !running_ || idle_.size() < options_.lowWatermark;
+        });
+
+        // 补充到高水位；创建失败（端口耗尽）时等下一次Claim再试
+        while (running_ && idle_.size() < options_.highWatermark) {
+            lock.unlock();
+            MediaSockets sockets;
+            bool created = Create(sockets);
+            lock.lock();
+
+            if (!created) {
+                refillCondition_.wait(lock);
+                break;
+            }
+            idle_.push_back(std::move(sockets));
+        }
+    }
+}
+
+} // namespace gb28181
@@ -0,0 +1,60 @@
+#include "sip/identity_table.h"
+#include <algorithm>
+
+namespace gb28181 {
+
+int IdentityTable::Add(const std::string& deviceId,
+                       const std::string& username,
+                       const std::string& password,
+                       DeviceManager *device) {
+    if (byDeviceId_.find(deviceId) != byDeviceId_.end()) {
+        return -1;
+    }
+
+    uint32_t index = static_cast<uint32_t>(deviceIds.size());
+
+    deviceIds.push_back(deviceId);
+    usernames.push_back(username.empty() ? deviceId : username);
+    passwords.push_back(password);
+    devices.push_back(device);
+    states.push_back(IdentityState::UNREGISTERED);
+    registerIds.push_back(-1);
+    sns.push_back(1);
+    nextKeepaliveMs.push_back(0);
+    keepaliveTimers.push_back(0);
+    missedKeepalives.push_back(0);
+
+    byDeviceId_[deviceId] = index;
+    return static_cast<int>(index);
+}
+
+int IdentityTable::Find(const std::string& deviceId) const {
+    auto it = byDeviceId_.find(deviceId);
+    return (it != byDeviceId_.end()) ? static_cast<int>(it->second) : -1;
+}
+
+int IdentityTable::FindByRegisterId(int rid) const {
+    auto it = byRegisterId_.find(rid);
+    return (it != byRegisterId_.end()) ? static_cast<int>(it->second) : -1;
+}
+
+void IdentityTable::SetRegisterId(size_t index, int rid) {
+    if (index >= registerIds.size()) {
+        return;
+    }
+
+    if (registerIds[index] >= 0) {
+        byRegisterId_.erase(registerIds[index]);
+    }
+
+    registerIds[index] = rid;
+    if (rid >= 0) {
+        byRegisterId_[rid] = static_cast<uint32_t>(index);
+    }
+}
+
+size_t IdentityTable::CountInState(IdentityState state) const {
+    return static_cast<size_t>(std::count(states.begin(), states.end(), state));
+}
+
+} // namespace gb28181
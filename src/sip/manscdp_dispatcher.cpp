@@ -0,0 +1,336 @@
+#include "sip/manscdp_dispatcher.h"
+#include "utils/logger.h"
+#include <cstring>
+
+namespace gb28181 {
+
+namespace {
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+std::string_view Trim(std::string_view text) {
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && IsSpace(text[start])) start++;
+    while (end > start && IsSpace(text[end - 1])) end--;
+    return text.substr(start, end - start);
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// 最多尝试的种子数，超过后改用线性探测
+const int kMaxSeedTries = 4096;
+const int kMaxTableBits = 12;
+
+} // namespace
+
+bool ParseManscdpMessage(std::string_view body, ManscdpMessage& message) {
+    message = ManscdpMessage();
+    message.body = body;
+
+    const char *data = body.data();
+    size_t length = body.size();
+    size_t pos = 0;
+    bool haveCmdType = false;
+    bool haveSn = false;
+    bool haveDeviceId = false;
+
+    while (pos < length) {
+        const void *lt = memchr(data + pos, '<', length - pos);
+        if (!lt) {
+            break;
+        }
+        pos = static_cast<const char*>(lt) - data + 1;
+        if (pos >= length) {
+            break;
+        }
+
+        // 跳过XML声明、注释和结束标签
+        char first = data[pos];
+        if (first == '?' || first == '!' || first == '/') {
+            continue;
+        }
+
+        size_t nameStart = pos;
+        while (pos < length && !IsSpace(data[pos]) && data[pos] != '>' && data[pos] != '/') {
+            pos++;
+        }
+        std::string_view name(data + nameStart, pos - nameStart);
+
+        const void *gt = memchr(data + pos, '>', length - pos);
+        if (!gt) {
+            break;
+        }
+        pos = static_cast<const char*>(gt) - data + 1;
+
+        if (message.root.empty()) {
+            message.root = name;
+            continue;
+        }
+
+        // 只关心三个字段，按名称长度区分避免逐个比较
+        std::string_view *target = nullptr;
+        bool *found = nullptr;
+        switch (name.size()) {
+            case 2:
+                if (!haveSn && name == "SN") found = &haveSn;
+                break;
+            case 7:
+                if (!haveCmdType && name == "CmdType") { found = &haveCmdType; target = &message.cmdType; }
+                break;
+            case 8:
+                if (!haveDeviceId && name == "DeviceID") { found = &haveDeviceId; target = &message.deviceId; }
+                break;
+            default:
+                break;
+        }
+        if (!found) {
+            continue;
+        }
+
+        const void *end = memchr(data + pos, '<', length - pos);
+        size_t textEnd = end ? static_cast<const char*>(end) - data : length;
+        std::string_view text = Trim(std::string_view(data + pos, textEnd - pos));
+        pos = textEnd;
+
+        *found = true;
+        if (target) {
+            *target = text;
+        } else {
+            uint32_t sn = 0;
+            for (char c : text) {
+                if (c < '0' || c > '9') break;
+                sn = sn * 10 + static_cast<uint32_t>(c - '0');
+            }
+            message.sn = sn;
+            message.hasSn = true;
+        }
+
+        if (haveCmdType && haveSn && haveDeviceId) {
+            break;
+        }
+    }
+
+    return !message.root.empty() && !message.cmdType.empty();
+}
+
+std::string_view FindManscdpElement(std::string_view body, std::string_view tag) {
+    size_t pos = 0;
+    while ((pos = body.find(tag, pos)) != std::string_view::npos) {
+        size_t after = pos + tag.size();
+        if (pos > 0 && body[pos - 1] == '<' && after < body.size() &&
+            (body[after] == '>' || IsSpace(body[after]))) {
+            size_t gt = body.find('>', after);
+            if (gt == std::string_view::npos) {
+                break;
+            }
+            size_t end = body.find('<', gt + 1);
+            if (end == std::string_view::npos) {
+                end = body.size();
+            }
+            return Trim(body.substr(gt + 1, end - gt - 1));
+        }
+        pos = after;
+    }
+    return std::string_view();
+}
+
+bool ParsePtzCommand(std::string_view hex, PtzCommand& command) {
+    hex = Trim(hex);
+    if (hex.size() != 16) {
+        return false;
+    }
+
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        int high = HexValue(hex[i * 2]);
+        int low = HexValue(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+
+    // 字节1固定A5H；字节2低半字节 = (字节1高半字节 + 字节1低半字节 + 字节2高半字节) % 16
+    if (bytes[0] != 0xA5) {
+        return false;
+    }
+    if ((((bytes[0] >> 4) + (bytes[0] & 0x0F) + (bytes[1] >> 4)) & 0x0F) != (bytes[1] & 0x0F)) {
+        return false;
+    }
+
+    // 字节8 = 前7字节累加和 % 256
+    unsigned sum = 0;
+    for (int i = 0; i < 7; i++) {
+        sum += bytes[i];
+    }
+    if ((sum & 0xFF) != bytes[7]) {
+        return false;
+    }
+
+    command = PtzCommand();
+    command.instruction = bytes[3];
+    command.address = static_cast<uint16_t>(bytes[2] | ((bytes[6] & 0x0F) << 8));
+
+    uint8_t code = bytes[3];
+    if ((code & 0xC0) == 0x00) {
+        // PTZ指令：bit5缩小 bit4放大 bit3上 bit2下 bit1左 bit0右
+        bool up = code & 0x08;
+        bool down = code & 0x04;
+        bool left = code & 0x02;
+        bool right = code & 0x01;
+
+        if (up && left)        command.direction = 5;
+        else if (down && left) command.direction = 6;
+        else if (up && right)  command.direction = 7;
+        else if (down && right) command.direction = 8;
+        else if (up)           command.direction = 1;
+        else if (down)         command.direction = 2;
+        else if (left)         command.direction = 3;
+        else if (right)        command.direction = 4;
+
+        if (code & 0x10)      command.zoom = 1;
+        else if (code & 0x20) command.zoom = 2;
+
+        command.panSpeed = bytes[4];
+        command.tiltSpeed = bytes[5];
+        command.zoomSpeed = bytes[6] >> 4;
+        command.type = (code == 0) ? PtzCommand::Type::STOP : PtzCommand::Type::MOVE;
+        return true;
+    }
+
+    switch (code) {
+        case 0x81: command.type = PtzCommand::Type::PRESET_SET; break;
+        case 0x82: command.type = PtzCommand::Type::PRESET_CALL; break;
+        case 0x83: command.type = PtzCommand::Type::PRESET_DELETE; break;
+        default:   command.type = PtzCommand::Type::OTHER; break;
+    }
+    command.presetId = bytes[5];
+    return true;
+}
+
+ManscdpDispatcher::ManscdpDispatcher() : seed_(1), bits_(0) {
+    slots_.assign(1, -1);
+}
+
+void ManscdpDispatcher::Register(const std::string& cmdType, Handler handler) {
+    for (auto& entry : entries_) {
+        if (entry.cmdType == cmdType) {
+            entry.handler = std::move(handler);
+            return;
+        }
+    }
+
+    entries_.push_back(Entry{cmdType, std::move(handler)});
+    Rebuild();
+}
+
+bool ManscdpDispatcher::Dispatch(const ManscdpMessage& message, int tid, size_t index, bool& handled) const {
+    handled = false;
+    if (entries_.empty() || message.cmdType.empty()) {
+        return false;
+    }
+
+    size_t mask = slots_.size() - 1;
+    for (size_t slot = Slot(Key(message.cmdType)), probes = 0; probes < slots_.size();
+         slot = (slot + 1) & mask, probes++) {
+        int entry = slots_[slot];
+        if (entry < 0) {
+            return false;
+        }
+        if (entries_[entry].cmdType == message.cmdType) {
+            handled = true;
+            return entries_[entry].handler(message, tid, index);
+        }
+        // 完美哈希下槽位唯一，不匹配即未注册
+        if (seed_ != 0) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+uint32_t ManscdpDispatcher::Key(std::string_view name) {
+    if (name.empty()) {
+        return 0;
+    }
+
+    // 长度加首、次、中、尾字符，区分GB28181全部命令名
+    uint32_t key = static_cast<uint32_t>(name.size());
+    key = key * 31 + static_cast<unsigned char>(name[0]);
+    key = key * 31 + static_cast<unsigned char>(name[name.size() > 1 ? 1 : 0]);
+    key = key * 31 + static_cast<unsigned char>(name[name.size() / 2]);
+    key = key * 31 + static_cast<unsigned char>(name[name.size() - 1]);
+    return key ^ (key >> 15);
+}
+
+size_t ManscdpDispatcher::Slot(uint32_t key) const {
+    if (bits_ == 0) {
+        return 0;
+    }
+    uint32_t multiplier = (seed_ != 0) ? seed_ : 0x9E3779B1u;
+    return static_cast<size_t>((key * multiplier) >> (32 - bits_));
+}
+
+void ManscdpDispatcher::Rebuild() {
+    int minBits = 1;
+    while ((1u << minBits) < entries_.size() * 2) {
+        minBits++;
+    }
+
+    std::vector<uint32_t> keys;
+    keys.reserve(entries_.size());
+    for (const auto& entry : entries_) {
+        keys.push_back(Key(entry.cmdType));
+    }
+
+    // 逐步放大表长，在每个表长下搜索使所有命令槽位互不冲突的奇数乘子
+    uint32_t candidate = 0x9E3779B1u;
+    for (bits_ = minBits; bits_ <= kMaxTableBits; bits_++) {
+        std::vector<int> slots(static_cast<size_t>(1) << bits_, -1);
+        for (int attempt = 0; attempt < kMaxSeedTries; attempt++) {
+            candidate = candidate * 1664525u + 1013904223u;
+            seed_ = candidate | 1u;
+
+            std::fill(slots.begin(), slots.end(), -1);
+            bool perfect = true;
+            for (size_t i = 0; i < keys.size(); i++) {
+                size_t slot = Slot(keys[i]);
+                if (slots[slot] >= 0) {
+                    perfect = false;
+                    break;
+                }
+                slots[slot] = static_cast<int>(i);
+            }
+
+            if (perfect) {
+                slots_.swap(slots);
+                return;
+            }
+        }
+    }
+
+    // 命令名的哈希键相同，无法构造完美哈希，退化为线性探测
+    LOG_WARN("[ManscdpDispatcher] No perfect hash for " << entries_.size()
+             << " commands, falling back to linear probing");
+    bits_ = minBits;
+    seed_ = 0;
+    slots_.assign(static_cast<size_t>(1) << bits_, -1);
+    for (size_t i = 0; i < keys.size(); i++) {
+        size_t slot = Slot(keys[i]);
+        while (slots_[slot] >= 0) {
+            slot = (slot + 1) & (slots_.size() - 1);
+        }
+        slots_[slot] = static_cast<int>(i);
+    }
+}
+
+} // namespace gb28181
@@ -0,0 +1,172 @@
+#include "sip/mansrtsp.h"
+#include <cmath>
+#include <cstring>
+
+namespace gb28181 {
+
+namespace {
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+std::string_view Trim(std::string_view text) {
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && IsSpace(text[start])) start++;
+    while (end > start && IsSpace(text[end - 1])) end--;
+    return text.substr(start, end - start);
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i];
+        char y = b[i];
+        if (x >= 'a' && x <= 'z') x = static_cast<char>(x - 'a' + 'A');
+        if (y >= 'a' && y <= 'z') y = static_cast<char>(y - 'a' + 'A');
+        if (x != y) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 解析带可选符号和小数部分的十进制数，如"-2"、"0.5"、"12.345"，遇到其他字符停止
+ * @param consumed 输出已解析的字符数
+ * @return 没有数字时返回false
+ */
+bool ParseDecimal(std::string_view text, double& value, size_t& consumed) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < text.size() && (text[i] == '-' || text[i] == '+')) {
+        negative = (text[i] == '-');
+        i++;
+    }
+
+    double result = 0;
+    size_t digits = 0;
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++) {
+        result = result * 10 + (text[i] - '0');
+    }
+    if (i < text.size() && text[i] == '.') {
+        double scale = 0.1;
+        for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++) {
+            result += (text[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    if (digits == 0) {
+        return false;
+    }
+    value = negative ? -result : result;
+    consumed = i;
+    return true;
+}
+
+/**
+ * @brief 解析Range头，只取npt起点，如"npt=now-"、"npt=12.5-"、"npt=0-30"
+ */
+bool ParseRange(std::string_view value, MansrtspRequest& request) {
+    if (value.size() < 4 || !EqualsIgnoreCase(value.substr(0, 4), "npt=")) {
+        return false;
+    }
+    value.remove_prefix(4);
+
+    if (value.size() >= 3 && EqualsIgnoreCase(value.substr(0, 3), "now")) {
+        request.rangeNow = true;
+        return true;
+    }
+
+    double seconds = 0;
+    size_t consumed = 0;
+    if (!ParseDecimal(value, seconds, consumed) || seconds < 0) {
+        return false;
+    }
+    request.rangeNow = false;
+    request.rangeStartMs = static_cast<uint64_t>(std::llround(seconds * 1000));
+    return true;
+}
+
+} // namespace
+
+bool ParseMansrtsp(std::string_view body, MansrtspRequest& request) {
+    request = MansrtspRequest();
+
+    const char *data = body.data();
+    size_t length = body.size();
+    size_t pos = 0;
+    bool firstLine = true;
+    bool hasCseq = false;
+
+    while (pos < length) {
+        const void *newline = memchr(data + pos, '\n', length - pos);
+        size_t lineEnd = newline ? static_cast<const char*>(newline) - data : length;
+        std::string_view line = Trim(std::string_view(data + pos, lineEnd - pos));
+        pos = lineEnd + 1;
+
+        if (line.empty()) {
+            // 空行之后为消息体，MANSRTSP请求没有消息体
+            if (firstLine) {
+                continue;
+            }
+            break;
+        }
+
+        if (firstLine) {
+            // 请求行：PLAY RTSP/1.0
+            firstLine = false;
+            size_t space = line.find(' ');
+            if (space == std::string_view::npos) {
+                return false;
+            }
+            request.methodName = line.substr(0, space);
+            std::string_view version = Trim(line.substr(space + 1));
+            if (version.size() < 5 || !EqualsIgnoreCase(version.substr(0, 5), "RTSP/")) {
+                return false;
+            }
+
+            if (EqualsIgnoreCase(request.methodName, "PLAY")) {
+                request.method = MansrtspMethod::PLAY;
+            } else if (EqualsIgnoreCase(request.methodName, "PAUSE")) {
+                request.method = MansrtspMethod::PAUSE;
+            } else if (EqualsIgnoreCase(request.methodName, "TEARDOWN")) {
+                request.method = MansrtspMethod::TEARDOWN;
+            }
+            continue;
+        }
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = Trim(line.substr(0, colon));
+        std::string_view value = Trim(line.substr(colon + 1));
+
+        double number = 0;
+        size_t consumed = 0;
+        if (EqualsIgnoreCase(name, "CSeq")) {
+            if (!ParseDecimal(value, number, consumed) || number < 0 || number > UINT32_MAX) {
+                return false;
+            }
+            request.cseq = static_cast<uint32_t>(number);
+            hasCseq = true;
+        } else if (EqualsIgnoreCase(name, "Scale")) {
+            if (!ParseDecimal(value, number, consumed) || number == 0) {
+                return false;
+            }
+            request.scale = number;
+            request.hasScale = true;
+        } else if (EqualsIgnoreCase(name, "Range")) {
+            request.hasRange = ParseRange(value, request);
+        }
+    }
+
+    return !firstLine && hasCseq;
+}
+
+} // namespace gb28181
@@ -1,97 +1,442 @@
 #include "sip/media_session.h"
-#include <iostream>
-#include <random>
+#include "utils/logger.h"
+#include "utils/timer_service.h"
+#include "rtp/port_allocator.h"
+#include "rtp/socket_pool.h"
 #include <algorithm>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace gb28181 {
 
+namespace {
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+/**
+ * @brief 会话槽位
+ * 状态和活动时间为原子量，可无锁读写；其余会话信息由mutex保护。
+ * generation为奇数表示槽位在用，会话终止时加一变为偶数，复用时再加一。
+ */
+struct MediaSessionManager::Slot {
+    std::atomic<uint32_t> generation{0};
+    std::atomic<int> state{static_cast<int>(SessionState::IDLE)};
+    std::atomic<int64_t> lastActivityNs{0};
+    std::atomic<uint64_t> expiryTimer{0};       // TimerService::TimerId
+    std::mutex mutex;
+    MediaSessionInfo info;
+    uint32_t allocatedSsrc = SsrcAllocator::kInvalidSsrc;   // 从分配器取得、终止时需回收的SSRC
+    MediaSockets sockets;
+};
+
+/**
+ * @brief Call-ID索引分片
+ */
+struct alignas(64) MediaSessionManager::Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, SessionHandle> sessions;
+};
+
 MediaSessionManager::MediaSessionManager()
-    : initialized_(false)
-    , ssrcCounter_(0) {
+    : shards_(new Shard[kShardCount])
+    , chunkCount_(0)
+    , sessionCount_(0)
+    , timerService_(nullptr)
+    , armedExpiries_(0)
+    , portAllocator_(nullptr)
+    , timeoutNs_(300LL * 1000000000LL)
+    , initialized_(false) {
+    for (auto& chunk : chunks_) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
 }
 
 MediaSessionManager::~MediaSessionManager() {
+    // 等待超时回调结束，之后不再访问槽位
+    SetTimerService(nullptr, static_cast<int>(timeoutNs_.load() / 1000000000LL));
+
     // 清理所有会话
-    sessions_.clear();
+    for (size_t i = 0; i < chunkCount_; i++) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
 }
 
 bool MediaSessionManager::Initialize() {
-    initialized_ = true;
-    std::cout << "[MediaSessionManager] Initialized" << std::endl;
+    initialized_.store(true);
+    LOG_INFO("[MediaSessionManager] Initialized");
     return true;
 }
 
-MediaSessionInfo* MediaSessionManager::CreateSession(const std::string& sessionId,
-                                                     const std::string& channelId,
-                                                     const std::string& remoteIp,
-                                                     const std::string& videoCodec,
-                                                     const std::string& audioCodec) {
-    if (!initialized_) {
-        std::cerr << "[MediaSessionManager] Not initialized" << std::endl;
+void MediaSessionManager::SetRealm(const std::string& realm) {
+    ssrcAllocator_.SetRealm(realm);
+}
+
+void MediaSessionManager::SetPortAllocator(PortAllocator* portAllocator) {
+    portAllocator_ = portAllocator;
+}
+
+MediaSessionManager::Shard& MediaSessionManager::GetShard(const std::string& sessionId) const {
+    return shards_[std::hash<std::string>()(sessionId) % kShardCount];
+}
+
+MediaSessionManager::Slot *MediaSessionManager::GetSlot(uint32_t index) const {
+    Slot *chunk = chunks_[index / kSlotsPerChunk].load(std::memory_order_acquire);
+    return chunk ? &chunk[index % kSlotsPerChunk] : nullptr;
+}
+
+MediaSessionManager::Slot *MediaSessionManager::ResolveSlot(SessionHandle handle) const {
+    if (!handle.IsValid() || handle.index >= kSlotsPerChunk * kMaxChunks) {
         return nullptr;
     }
 
-    // 检查会话是否已存在
-    if (sessions_.find(sessionId) != sessions_.end()) {
-        std::cerr << "[MediaSessionManager] Session already exists: " << sessionId << std::endl;
+    Slot *slot = GetSlot(handle.index);
+    if (!slot || slot->generation.load(std::memory_order_acquire) != handle.generation) {
         return nullptr;
     }
+    return slot;
+}
+
+SessionHandle MediaSessionManager::AllocateSlot() {
+    std::lock_guard<std::mutex> lock(slotMutex_);
+
+    if (freeSlots_.empty()) {
+        if (chunkCount_ == kMaxChunks) {
+            return SessionHandle();
+        }
+
+        Slot *chunk = new Slot[kSlotsPerChunk];
+        uint32_t base = static_cast<uint32_t>(chunkCount_ * kSlotsPerChunk);
+        chunks_[chunkCount_].store(chunk, std::memory_order_release);
+        chunkCount_++;
+
+        // 倒序压入，先分配低下标
+        for (uint32_t i = kSlotsPerChunk; i > 0; i--) {
+            freeSlots_.push_back(base + i - 1);
+        }
+    }
 
-    // 创建新会话
-    auto session = std::make_unique<MediaSessionInfo>();
-    session->sessionId = sessionId;
-    session->channelId = channelId;
-    session->remoteIp = remoteIp;
-    session->remoteVideoPort = 0;
-    session->remoteAudioPort = 0;
-    session->localIp = "";
-    session->localVideoPort = 0;
-    session->localAudioPort = 0;
-    session->mediaType = MediaType::VIDEO_AUDIO;
-    session->state = SessionState::INVITING;
-    session->videoCodec = videoCodec;
-    session->audioCodec = audioCodec;
-    session->videoSsrc = GenerateSsrc();
-    session->audioSsrc = GenerateSsrc();
-    session->createTime = std::chrono::system_clock::now();
-    session->lastActivity = session->createTime;
+    SessionHandle handle;
+    handle.index = freeSlots_.back();
+    freeSlots_.pop_back();
+    // 空闲槽位的代数为偶数，下一代为奇数且不为0
+    handle.generation = GetSlot(handle.index)->generation.load(std::memory_order_relaxed) + 1;
+    return handle;
+}
 
-    MediaSessionInfo* sessionPtr = session.get();
-    sessions_[sessionId] = std::move(session);
+void MediaSessionManager::ReleaseSlot(uint32_t index) {
+    std::lock_guard<std::mutex> lock(slotMutex_);
+    freeSlots_.push_back(index);
+}
 
-    std::cout << "[MediaSessionManager] Created session: " << sessionId
-              << " channel: " << channelId
-              << " remote: " << remoteIp << std::endl;
+SessionState MediaSessionManager::RetireSlot(Slot *slot, uint64_t& sessionHash,
+                                             MediaSockets& sockets, int& localPort) {
+    {
+        std::lock_guard<std::mutex> slotLock(slot->mutex);
+        sessionHash = slot->info.sessionHash;
+        slot->info.state = SessionState::TERMINATED;
+        ssrcAllocator_.Release(slot->allocatedSsrc);
+        slot->allocatedSsrc = SsrcAllocator::kInvalidSsrc;
+        sockets = std::move(slot->sockets);
+        localPort = sockets.IsValid() ? sockets.basePort : slot->info.localVideoPort;
+    }
+    SessionState oldState = static_cast<SessionState>(
+        slot->state.exchange(static_cast<int>(SessionState::TERMINATED), std::memory_order_acq_rel));
 
-    TriggerEvent(sessionId, SessionState::INVITING, "SESSION_CREATED");
+    // 代数变为偶数，已发出的句柄全部失效
+    slot->generation.fetch_add(1, std::memory_order_release);
 
-    return sessionPtr;
+    // 持有分片写锁，不能等待正在执行的回调（回调会获取分片锁）；取消失败的回调仍会执行并自行计数
+    TimerService *timerService = timerService_.load();
+    if (timerService && timerService->Cancel(slot->expiryTimer.exchange(TimerService::kInvalidTimer))) {
+        FinishExpiry();
+    }
+    return oldState;
 }
 
-MediaSessionInfo* MediaSessionManager::GetSession(const std::string& sessionId) {
-    auto it = sessions_.find(sessionId);
-    if (it != sessions_.end()) {
-        return it->second.get();
+void MediaSessionManager::ReleaseMedia(MediaSockets& sockets, int localPort) {
+    // 先关闭再归还，端口再次分配时可以立即绑定
+    sockets.Close();
+    if (portAllocator_ && localPort > 0) {
+        portAllocator_->Release(localPort);
     }
-    return nullptr;
 }
 
-bool MediaSessionManager::UpdateSessionState(const std::string& sessionId, SessionState state) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[MediaSessionManager] Session not found: " << sessionId << std::endl;
+void MediaSessionManager::ArmExpiry(SessionHandle handle, Slot *slot, int64_t delayNs) {
+    TimerService *timerService = timerService_.load();
+    if (!timerService) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(expiryMutex_);
+        armedExpiries_++;
+    }
+    int64_t delayMs = std::max<int64_t>(1, (delayNs + 999999) / 1000000);
+    TimerService::TimerId timer = timerService->ScheduleOnce(delayMs, [this, handle]() {
+        OnExpiryTimer(handle);
+        FinishExpiry();
+    });
+    slot->expiryTimer.store(timer);
+
+    // 与SetTimerService并发时定时器可能挂在已摘下的旧服务上，与RetireSlot并发时会话可能已终止，
+    // 两者都收集不到这个定时器，这里自行取消；已被对方取走则由对方处理
+    if ((timerService_.load() != timerService || !IsValid(handle)) &&
+        slot->expiryTimer.compare_exchange_strong(timer, TimerService::kInvalidTimer) &&
+        timerService->Cancel(timer)) {
+        FinishExpiry();
+    }
+}
+
+void MediaSessionManager::FinishExpiry() {
+    // 在锁内通知：SetTimerService被唤醒后可能立即销毁管理器
+    std::lock_guard<std::mutex> lock(expiryMutex_);
+    if (--armedExpiries_ == 0) {
+        expiryDone_.notify_all();
+    }
+}
+
+void MediaSessionManager::OnExpiryTimer(SessionHandle handle) {
+    Slot *slot = ResolveSlot(handle);
+    if (!slot) {
+        return;
+    }
+
+    std::string sessionId;
+    {
+        std::lock_guard<std::mutex> slotLock(slot->mutex);
+        sessionId = slot->info.sessionId;
+    }
+
+    int64_t timeoutNs = timeoutNs_.load();
+    if (ExpireIfIdle(sessionId, handle, NowNs() - timeoutNs)) {
+        return;
+    }
+
+    // 期间有活动，按最后活动时间重新定时；会话已终止则不再定时
+    if (IsValid(handle)) {
+        ArmExpiry(handle, slot, slot->lastActivityNs.load(std::memory_order_relaxed) + timeoutNs - NowNs());
+    }
+}
+
+bool MediaSessionManager::ExpireIfIdle(const std::string& sessionId, SessionHandle handle,
+                                       int64_t idleBeforeNs) {
+    uint64_t sessionHash = 0;
+    SessionState oldState = SessionState::IDLE;
+    MediaSockets sockets;
+    int localPort = 0;
+
+    {
+        Shard& shard = GetShard(sessionId);
+        std::unique_lock<std::shared_mutex> shardLock(shard.mutex);
+
+        auto it = shard.sessions.find(sessionId);
+        if (it == shard.sessions.end() || it->second != handle) {
+            return false;
+        }
+
+        Slot *slot = GetSlot(handle.index);
+        if (slot->lastActivityNs.load(std::memory_order_relaxed) >= idleBeforeNs) {
+            return false;
+        }
+
+        oldState = RetireSlot(slot, sessionHash, sockets, localPort);
+        shard.sessions.erase(it);
+    }
+
+    ReleaseMedia(sockets, localPort);
+    ReleaseSlot(handle.index);
+    sessionCount_.fetch_sub(1);
+
+    LOG_INFO("[MediaSessionManager] Session timed out: " << sessionId
+             << " state: " << GetStateName(oldState));
+
+    TriggerEvent(sessionId, sessionHash, SessionState::TERMINATED, EventCode::SESSION_TIMEOUT,
+                 "SESSION_TIMEOUT", static_cast<uint32_t>(oldState));
+    return true;
+}
+
+template <class F>
+bool MediaSessionManager::WithSession(const std::string& sessionId, F&& fn) {
+    Shard& shard = GetShard(sessionId);
+    std::shared_lock<std::shared_mutex> shardLock(shard.mutex);
+
+    auto it = shard.sessions.find(sessionId);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+
+    // 持有分片读锁期间会话不会被终止，槽位不会被复用
+    Slot *slot = GetSlot(it->second.index);
+    std::lock_guard<std::mutex> slotLock(slot->mutex);
+    fn(*slot);
+    return true;
+}
+
+SessionHandle MediaSessionManager::CreateSession(const std::string& sessionId,
+                                                 const std::string& channelId,
+                                                 const std::string& remoteIp,
+                                                 const std::string& videoCodec,
+                                                 const std::string& audioCodec,
+                                                 bool history) {
+    if (!initialized_.load()) {
+        LOG_ERROR("[MediaSessionManager] Not initialized");
+        return SessionHandle();
+    }
+
+    uint64_t sessionHash = EventLog::HashSession(sessionId);
+    uint32_t ssrc = SsrcAllocator::kInvalidSsrc;
+    SessionHandle handle;
+
+    {
+        Shard& shard = GetShard(sessionId);
+        std::unique_lock<std::shared_mutex> shardLock(shard.mutex);
+
+        // 检查会话是否已存在
+        if (shard.sessions.find(sessionId) != shard.sessions.end()) {
+            LOG_ERROR("[MediaSessionManager] Session already exists: " << sessionId);
+            return SessionHandle();
+        }
+
+        ssrc = ssrcAllocator_.Allocate(history);
+        if (ssrc == SsrcAllocator::kInvalidSsrc) {
+            LOG_ERROR("[MediaSessionManager] No SSRC available, rejecting: " << sessionId);
+            return SessionHandle();
+        }
+
+        handle = AllocateSlot();
+        if (!handle.IsValid()) {
+            LOG_ERROR("[MediaSessionManager] Session table full, rejecting: " << sessionId);
+            ssrcAllocator_.Release(ssrc);
+            return SessionHandle();
+        }
+
+        // 创建新会话
+        Slot *slot = GetSlot(handle.index);
+        {
+            std::lock_guard<std::mutex> slotLock(slot->mutex);
+            MediaSessionInfo& session = slot->info;
+            session.sessionId = sessionId;
+            session.sessionHash = sessionHash;
+            session.channelId = channelId;
+            session.remoteIp = remoteIp;
+            session.remoteVideoPort = 0;
+            session.remoteAudioPort = 0;
+            session.localIp = "";
+            session.localVideoPort = 0;
+            session.localAudioPort = 0;
+            session.mediaType = MediaType::VIDEO_AUDIO;
+            session.state = SessionState::INVITING;
+            session.videoCodec = videoCodec;
+            session.audioCodec = audioCodec;
+            session.videoSsrc = ssrc;
+            session.audioSsrc = ssrc;
+            session.videoStream = 0;
+            session.mediaParams.clear();
+            slot->allocatedSsrc = ssrc;
+            session.createTime = std::chrono::system_clock::now();
+            session.lastActivity = session.createTime;
+        }
+
+        slot->state.store(static_cast<int>(SessionState::INVITING), std::memory_order_relaxed);
+        slot->lastActivityNs.store(NowNs(), std::memory_order_relaxed);
+        slot->generation.store(handle.generation, std::memory_order_release);
+
+        shard.sessions.emplace(sessionId, handle);
+        ArmExpiry(handle, slot, timeoutNs_.load());
+    }
+
+    sessionCount_.fetch_add(1);
+
+    LOG_INFO("[MediaSessionManager] Created session: " << sessionId
+             << " channel: " << channelId
+             << " remote: " << remoteIp);
+
+    TriggerEvent(sessionId, sessionHash, SessionState::INVITING, EventCode::SESSION_CREATED,
+                 "SESSION_CREATED", ssrc);
+
+    return handle;
+}
+
+SessionHandle MediaSessionManager::FindSession(const std::string& sessionId) const {
+    Shard& shard = GetShard(sessionId);
+    std::shared_lock<std::shared_mutex> shardLock(shard.mutex);
+
+    auto it = shard.sessions.find(sessionId);
+    if (it != shard.sessions.end()) {
+        return it->second;
+    }
+    return SessionHandle();
+}
+
+bool MediaSessionManager::GetSession(const std::string& sessionId, MediaSessionInfo& info) const {
+    return GetSession(FindSession(sessionId), info);
+}
+
+bool MediaSessionManager::GetSession(SessionHandle handle, MediaSessionInfo& info) const {
+    Slot *slot = ResolveSlot(handle);
+    if (!slot) {
         return false;
     }
 
-    SessionState oldState = it->second->state;
-    it->second->state = state;
-    it->second->lastActivity = std::chrono::system_clock::now();
+    {
+        std::lock_guard<std::mutex> slotLock(slot->mutex);
+        info = slot->info;
+    }
+    info.state = static_cast<SessionState>(slot->state.load(std::memory_order_acquire));
+    info.lastActivity = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(slot->lastActivityNs.load(std::memory_order_relaxed))));
+
+    // 拷贝期间会话可能已终止、槽位被复用，再次校验代数
+    return slot->generation.load(std::memory_order_acquire) == handle.generation;
+}
+
+bool MediaSessionManager::IsValid(SessionHandle handle) const {
+    return ResolveSlot(handle) != nullptr;
+}
+
+SessionState MediaSessionManager::GetState(SessionHandle handle) const {
+    Slot *slot = ResolveSlot(handle);
+    if (!slot) {
+        return SessionState::TERMINATED;
+    }
 
-    std::cout << "[MediaSessionManager] Session " << sessionId
-              << " state: " << GetStateName(oldState)
-              << " -> " << GetStateName(state) << std::endl;
+    SessionState state = static_cast<SessionState>(slot->state.load(std::memory_order_acquire));
+    if (slot->generation.load(std::memory_order_acquire) != handle.generation) {
+        return SessionState::TERMINATED;
+    }
+    return state;
+}
 
-    TriggerEvent(sessionId, state, "STATE_CHANGED");
+bool MediaSessionManager::UpdateSessionState(const std::string& sessionId, SessionState state) {
+    SessionState oldState = SessionState::IDLE;
+    uint64_t sessionHash = 0;
+
+    bool found = WithSession(sessionId, [&](Slot& slot) {
+        oldState = static_cast<SessionState>(
+            slot.state.exchange(static_cast<int>(state), std::memory_order_acq_rel));
+        slot.info.state = state;
+        slot.lastActivityNs.store(NowNs(), std::memory_order_relaxed);
+        sessionHash = slot.info.sessionHash;
+    });
+
+    if (!found) {
+        LOG_ERROR("[MediaSessionManager] Session not found: " << sessionId);
+        return false;
+    }
+
+    LOG_INFO("[MediaSessionManager] Session " << sessionId
+             << " state: " << GetStateName(oldState)
+             << " -> " << GetStateName(state));
+
+    TriggerEvent(sessionId, sessionHash, state, EventCode::SESSION_STATE_CHANGED,
+                 "STATE_CHANGED", static_cast<uint32_t>(oldState));
 
     return true;
 }
@@ -99,19 +444,20 @@ bool MediaSessionManager::UpdateSessionState(const std::string& sessionId, Sessi
 bool MediaSessionManager::SetLocalPorts(const std::string& sessionId,
                                         int localVideoPort,
                                         int localAudioPort) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[MediaSessionManager] Session not found: " << sessionId << std::endl;
+    bool found = WithSession(sessionId, [&](Slot& slot) {
+        slot.info.localVideoPort = localVideoPort;
+        slot.info.localAudioPort = localAudioPort;
+        slot.lastActivityNs.store(NowNs(), std::memory_order_relaxed);
+    });
+
+    if (!found) {
+        LOG_ERROR("[MediaSessionManager] Session not found: " << sessionId);
         return false;
     }
 
-    it->second->localVideoPort = localVideoPort;
-    it->second->localAudioPort = localAudioPort;
-    it->second->lastActivity = std::chrono::system_clock::now();
-
-    std::cout << "[MediaSessionManager] Session " << sessionId
-              << " local ports: video=" << localVideoPort
-              << " audio=" << localAudioPort << std::endl;
+    LOG_INFO("[MediaSessionManager] Session " << sessionId
+             << " local ports: video=" << localVideoPort
+             << " audio=" << localAudioPort);
 
     return true;
 }
@@ -119,52 +465,117 @@ bool MediaSessionManager::SetLocalPorts(const std::string& sessionId,
 bool MediaSessionManager::SetRemotePorts(const std::string& sessionId,
                                          int remoteVideoPort,
                                          int remoteAudioPort) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[MediaSessionManager] Session not found: " << sessionId << std::endl;
+    bool found = WithSession(sessionId, [&](Slot& slot) {
+        slot.info.remoteVideoPort = remoteVideoPort;
+        slot.info.remoteAudioPort = remoteAudioPort;
+        slot.lastActivityNs.store(NowNs(), std::memory_order_relaxed);
+    });
+
+    if (!found) {
+        LOG_ERROR("[MediaSessionManager] Session not found: " << sessionId);
         return false;
     }
 
-    it->second->remoteVideoPort = remoteVideoPort;
-    it->second->remoteAudioPort = remoteAudioPort;
-    it->second->lastActivity = std::chrono::system_clock::now();
-
-    std::cout << "[MediaSessionManager] Session " << sessionId
-              << " remote ports: video=" << remoteVideoPort
-              << " audio=" << remoteAudioPort << std::endl;
+    LOG_INFO("[MediaSessionManager] Session " << sessionId
+             << " remote ports: video=" << remoteVideoPort
+             << " audio=" << remoteAudioPort);
 
     return true;
 }
 
+bool MediaSessionManager::AttachSockets(const std::string& sessionId, MediaSockets sockets) {
+    return WithSession(sessionId, [&](Slot& slot) {
+        slot.sockets = std::move(sockets);
+    });
+}
+
 bool MediaSessionManager::SetSsrc(const std::string& sessionId,
                                   uint32_t videoSsrc,
                                   uint32_t audioSsrc) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[MediaSessionManager] Session not found: " << sessionId << std::endl;
+    bool reserved = true;
+    bool found = WithSession(sessionId, [&](Slot& slot) {
+        // 先占用新值再回收原值：不属于本域或已被其他会话占用时保留原先分配的SSRC，避免两路码流同SSRC
+        if (videoSsrc != slot.allocatedSsrc) {
+            if (!ssrcAllocator_.Reserve(videoSsrc)) {
+                reserved = false;
+                return;
+            }
+            ssrcAllocator_.Release(slot.allocatedSsrc);
+            slot.allocatedSsrc = videoSsrc;
+        }
+        slot.info.videoSsrc = videoSsrc;
+        slot.info.audioSsrc = audioSsrc;
+        slot.lastActivityNs.store(NowNs(), std::memory_order_relaxed);
+    });
+
+    if (!found) {
+        LOG_ERROR("[MediaSessionManager] Session not found: " << sessionId);
         return false;
     }
 
-    it->second->videoSsrc = videoSsrc;
-    it->second->audioSsrc = audioSsrc;
-    it->second->lastActivity = std::chrono::system_clock::now();
+    if (!reserved) {
+        LOG_WARN("[MediaSessionManager] SSRC " << videoSsrc << " unavailable for session "
+                 << sessionId << ", keeping the allocated one");
+        return false;
+    }
 
     return true;
 }
 
-bool MediaSessionManager::TerminateSession(const std::string& sessionId) {
-    auto it = sessions_.find(sessionId);
-    if (it == sessions_.end()) {
-        std::cerr << "[MediaSessionManager] Session not found: " << sessionId << std::endl;
+bool MediaSessionManager::SetVideoStream(const std::string& sessionId,
+                                         int videoStream,
+                                         const std::string& mediaParams) {
+    bool found = WithSession(sessionId, [&](Slot& slot) {
+        slot.info.videoStream = videoStream;
+        slot.info.mediaParams = mediaParams;
+    });
+
+    if (!found) {
+        LOG_ERROR("[MediaSessionManager] Session not found: " << sessionId);
         return false;
     }
 
-    std::cout << "[MediaSessionManager] Terminating session: " << sessionId << std::endl;
+    LOG_INFO("[MediaSessionManager] Session " << sessionId
+             << " uses video stream " << videoStream << " (" << mediaParams << ")");
+
+    return true;
+}
+
+bool MediaSessionManager::TerminateSession(const std::string& sessionId) {
+    SessionState oldState = SessionState::IDLE;
+    uint64_t sessionHash = 0;
+    uint32_t index = 0;
+    MediaSockets sockets;
+    int localPort = 0;
+
+    {
+        Shard& shard = GetShard(sessionId);
+        std::unique_lock<std::shared_mutex> shardLock(shard.mutex);
+
+        auto it = shard.sessions.find(sessionId);
+        if (it == shard.sessions.end()) {
+            LOG_ERROR("[MediaSessionManager] Session not found: " << sessionId);
+            return false;
+        }
 
-    UpdateSessionState(sessionId, SessionState::TERMINATING);
-    TriggerEvent(sessionId, SessionState::TERMINATED, "SESSION_TERMINATED");
+        index = it->second.index;
+        oldState = RetireSlot(GetSlot(index), sessionHash, sockets, localPort);
+        shard.sessions.erase(it);
+    }
 
-    sessions_.erase(it);
+    ReleaseMedia(sockets, localPort);
+    ReleaseSlot(index);
+    sessionCount_.fetch_sub(1);
+
+    LOG_INFO("[MediaSessionManager] Terminating session: " << sessionId);
+    LOG_INFO("[MediaSessionManager] Session " << sessionId
+             << " state: " << GetStateName(oldState)
+             << " -> " << GetStateName(SessionState::TERMINATING));
+
+    TriggerEvent(sessionId, sessionHash, SessionState::TERMINATING, EventCode::SESSION_STATE_CHANGED,
+                 "STATE_CHANGED", static_cast<uint32_t>(oldState));
+    TriggerEvent(sessionId, sessionHash, SessionState::TERMINATED, EventCode::SESSION_TERMINATED,
+                 "SESSION_TERMINATED");
 
     return true;
 }
@@ -172,10 +583,14 @@ bool MediaSessionManager::TerminateSession(const std::string& sessionId) {
 std::vector<std::string> MediaSessionManager::GetActiveSessions() {
     std::vector<std::string> activeSessions;
 
-    for (const auto& pair : sessions_) {
-        if (pair.second->state == SessionState::ESTABLISHED ||
-            pair.second->state == SessionState::INVITING) {
-            activeSessions.push_back(pair.first);
+    for (size_t i = 0; i < kShardCount; i++) {
+        std::shared_lock<std::shared_mutex> shardLock(shards_[i].mutex);
+        for (const auto& pair : shards_[i].sessions) {
+            SessionState state = static_cast<SessionState>(
+                GetSlot(pair.second.index)->state.load(std::memory_order_acquire));
+            if (state == SessionState::ESTABLISHED || state == SessionState::INVITING) {
+                activeSessions.push_back(pair.first);
+            }
         }
     }
 
@@ -183,31 +598,77 @@ std::vector<std::string> MediaSessionManager::GetActiveSessions() {
 }
 
 size_t MediaSessionManager::GetSessionCount() {
-    return sessions_.size();
+    return sessionCount_.load();
 }
 
-size_t MediaSessionManager::CleanupTimeoutSessions(int timeoutSeconds) {
-    auto now = std::chrono::system_clock::now();
-    auto timeoutDuration = std::chrono::seconds(timeoutSeconds);
-    size_t cleanupCount = 0;
+void MediaSessionManager::SetTimerService(TimerService* timerService, int timeoutSeconds) {
+    timeoutNs_.store(static_cast<int64_t>(std::max(1, timeoutSeconds)) * 1000000000LL);
 
-    std::vector<std::string> timeoutSessions;
+    TimerService *previous = timerService_.exchange(timerService);
+    if (previous == timerService) {
+        return;
+    }
 
-    for (const auto& pair : sessions_) {
-        auto elapsed = now - pair.second->lastActivity;
-        if (elapsed > timeoutDuration) {
-            timeoutSessions.push_back(pair.first);
+    // 先在分片锁内摘下旧定时器，出锁后再取消：正在执行的超时回调会获取分片锁，持锁等待会死锁
+    std::vector<std::pair<SessionHandle, TimerService::TimerId>> timers;
+    for (size_t i = 0; i < kShardCount; i++) {
+        std::shared_lock<std::shared_mutex> shardLock(shards_[i].mutex);
+        for (const auto& pair : shards_[i].sessions) {
+            Slot *slot = GetSlot(pair.second.index);
+            timers.emplace_back(pair.second, slot->expiryTimer.exchange(TimerService::kInvalidTimer));
         }
     }
 
-    for (const auto& sessionId : timeoutSessions) {
-        std::cout << "[MediaSessionManager] Cleaning up timeout session: " << sessionId << std::endl;
-        sessions_.erase(sessionId);
-        cleanupCount++;
+    // 等待旧定时器服务上正在执行的回调返回
+    if (previous) {
+        for (const auto& timer : timers) {
+            if (previous->CancelAndWait(timer.second)) {
+                FinishExpiry();
+            }
+        }
+    }
+
+    // 解除时还要等待已从会话表摘下的定时器（回调终止了自己的会话，或会话刚被终止）的回调结束，
+    // 返回后管理器可以安全销毁
+    if (!timerService) {
+        std::unique_lock<std::mutex> lock(expiryMutex_);
+        expiryDone_.wait(lock, [this] { return armedExpiries_ == 0; });
+        return;
+    }
+
+    // 仍然有效的会话按最后活动时间挂到新的定时器服务上
+    int64_t now = NowNs();
+    for (const auto& timer : timers) {
+        Slot *slot = ResolveSlot(timer.first);
+        if (slot) {
+            ArmExpiry(timer.first, slot,
+                      slot->lastActivityNs.load(std::memory_order_relaxed) + timeoutNs_.load() - now);
+        }
+    }
+}
+
+size_t MediaSessionManager::CleanupTimeoutSessions(int timeoutSeconds) {
+    int64_t idleBeforeNs = NowNs() - static_cast<int64_t>(timeoutSeconds) * 1000000000LL;
+    std::vector<std::pair<std::string, SessionHandle>> timeoutSessions;
+
+    for (size_t i = 0; i < kShardCount; i++) {
+        std::shared_lock<std::shared_mutex> shardLock(shards_[i].mutex);
+        for (const auto& pair : shards_[i].sessions) {
+            if (GetSlot(pair.second.index)->lastActivityNs.load(std::memory_order_relaxed) < idleBeforeNs) {
+                timeoutSessions.emplace_back(pair.first, pair.second);
+            }
+        }
+    }
+
+    size_t cleanupCount = 0;
+    for (const auto& pair : timeoutSessions) {
+        if (ExpireIfIdle(pair.first, pair.second, idleBeforeNs)) {
+            cleanupCount++;
+        }
     }
 
     if (cleanupCount > 0) {
-        std::cout << "[MediaSessionManager] Cleaned up " << cleanupCount << " timeout sessions" << std::endl;
+        LOG_INFO("[MediaSessionManager] Cleaned up " << cleanupCount << " timeout sessions");
     }
 
     return cleanupCount;
@@ -218,9 +679,13 @@ void MediaSessionManager::SetEventCallback(SessionEventCallback callback) {
 }
 
 void MediaSessionManager::UpdateActivity(const std::string& sessionId) {
-    auto it = sessions_.find(sessionId);
-    if (it != sessions_.end()) {
-        it->second->lastActivity = std::chrono::system_clock::now();
+    UpdateActivity(FindSession(sessionId));
+}
+
+void MediaSessionManager::UpdateActivity(SessionHandle handle) {
+    Slot *slot = ResolveSlot(handle);
+    if (slot) {
+        slot->lastActivityNs.store(NowNs(), std::memory_order_relaxed);
     }
 }
 
@@ -235,23 +700,14 @@ std::string MediaSessionManager::GetStateName(SessionState state) {
     }
 }
 
-uint32_t MediaSessionManager::GenerateSsrc() {
-    // 生成随机SSRC
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<uint32_t> dis(1, 0xFFFFFFFF);
-
-    uint32_t ssrc;
-    do {
-        ssrc = dis(gen);
-    } while (ssrc == 0); // SSRC不能为0
-
-    return ssrc;
-}
-
 void MediaSessionManager::TriggerEvent(const std::string& sessionId,
+                                       uint64_t sessionHash,
                                        SessionState state,
-                                       const std::string& event) {
+                                       EventCode code,
+                                       const std::string& event,
+                                       uint32_t arg) {
+    EventLog::Instance().Record(code, sessionHash, static_cast<uint16_t>(state), arg);
+
     if (eventCallback_) {
         eventCallback_(sessionId, state, event);
     }
@@ -0,0 +1,227 @@
+#include "sip/register_scheduler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace gb28181 {
+
+RegisterScheduler::RegisterScheduler()
+    : tokens_(0)
+    , lastRefillMs_(-1)
+    , rng_(static_cast<uint32_t>(
+          std::chrono::steady_clock::now().time_since_epoch().count())) {
+    SetPolicy(RegisterPolicy());
+}
+
+RegisterScheduler::~RegisterScheduler() {
+}
+
+void RegisterScheduler::SetPolicy(const RegisterPolicy& policy) {
+    policy_ = policy;
+
+    // 刷新比例过大时来不及在过期前完成重注册，过小则浪费信令
+    policy_.refreshRatio = std::min(0.95, std::max(0.1, policy_.refreshRatio));
+    policy_.retryBaseMs = std::max(100, policy_.retryBaseMs);
+    policy_.retryMaxMs = std::max(policy_.retryBaseMs, policy_.retryMaxMs);
+    policy_.maxRegistersPerSecond = std::max(0.1, policy_.maxRegistersPerSecond);
+    policy_.burst = std::max(1, policy_.burst);
+    policy_.requestTimeoutMs = std::max(1000, policy_.requestTimeoutMs);
+
+    tokens_ = std::min(tokens_, static_cast<double>(policy_.burst));
+    if (lastRefillMs_ < 0) {
+        tokens_ = policy_.burst;
+    }
+}
+
+void RegisterScheduler::Resize(size_t count) {
+    if (count <= states_.size()) {
+        return;
+    }
+
+    states_.resize(count, SlotState::IDLE);
+    dueMs_.resize(count, -1);
+    attempts_.resize(count, 0);
+    challenges_.resize(count, 0);
+}
+
+void RegisterScheduler::Schedule(size_t index, int64_t dueMs) {
+    Resize(index + 1);
+    Push(index, dueMs, SlotState::SCHEDULED);
+}
+
+void RegisterScheduler::Cancel(size_t index) {
+    if (index >= states_.size()) {
+        return;
+    }
+
+    // 堆和就绪队列中的条目通过状态/时间校验惰性丢弃
+    states_[index] = SlotState::IDLE;
+    dueMs_[index] = -1;
+    attempts_[index] = 0;
+    challenges_[index] = 0;
+}
+
+size_t RegisterScheduler::Poll(int64_t nowMs, std::vector<uint32_t>& out, size_t maxCount) {
+    RefillTokens(nowMs);
+
+    // 到期的排期进入就绪队列，到期的发送中条目视为超时
+    while (!heap_.empty() && heap_.top().dueMs <= nowMs) {
+        HeapEntry entry = heap_.top();
+        heap_.pop();
+
+        uint32_t index = entry.index;
+        if (dueMs_[index] != entry.dueMs) {
+            continue;
+        }
+
+        if (states_[index] == SlotState::SCHEDULED) {
+            states_[index] = SlotState::QUEUED;
+            dueMs_[index] = -1;
+            ready_.push_back(index);
+        } else if (states_[index] == SlotState::IN_FLIGHT) {
+            counters_.timedOut++;
+            OnFailure(index, nowMs);
+        }
+    }
+
+    size_t count = 0;
+    while (count < maxCount && !ready_.empty()) {
+        uint32_t index = ready_.front();
+        if (states_[index] != SlotState::QUEUED) {
+            ready_.pop_front();
+            continue;
+        }
+
+        if (tokens_ < 1.0) {
+            counters_.throttled++;
+            break;
+        }
+
+        tokens_ -= 1.0;
+        ready_.pop_front();
+
+        challenges_[index] = 0;
+        Push(index, nowMs + policy_.requestTimeoutMs, SlotState::IN_FLIGHT);
+        counters_.sent++;
+
+        out.push_back(index);
+        count++;
+    }
+
+    return count;
+}
+
+void RegisterScheduler::OnSuccess(size_t index, int64_t nowMs, int grantedExpires) {
+    if (index >= states_.size()) {
+        return;
+    }
+
+    counters_.succeeded++;
+    attempts_[index] = 0;
+    challenges_[index] = 0;
+
+    int expires = (grantedExpires > 0) ? grantedExpires : policy_.expires;
+    int64_t refreshMs = static_cast<int64_t>(expires * 1000.0 * policy_.refreshRatio);
+
+    // 只向前抖动，保证刷新不会晚于设定比例
+    Push(index, nowMs + Jitter(refreshMs * 9 / 10, refreshMs), SlotState::SCHEDULED);
+}
+
+void RegisterScheduler::OnFailure(size_t index, int64_t nowMs) {
+    if (index >= states_.size()) {
+        return;
+    }
+
+    counters_.failed++;
+    challenges_[index] = 0;
+    if (attempts_[index] < 16) {
+        attempts_[index]++;
+    }
+
+    // 指数退避 + 等量抖动：delay/2 ~ delay 之间均匀分布
+    int64_t delay = static_cast<int64_t>(policy_.retryBaseMs) << (attempts_[index] - 1);
+    delay = std::min(delay, static_cast<int64_t>(policy_.retryMaxMs));
+
+    Push(index, nowMs + Jitter(delay / 2, delay), SlotState::SCHEDULED);
+}
+
+bool RegisterScheduler::OnChallenge(size_t index, int64_t nowMs) {
+    if (index >= states_.size()) {
+        return false;
+    }
+
+    if (++challenges_[index] > policy_.maxChallenges) {
+        OnFailure(index, nowMs);
+        return false;
+    }
+
+    // 带认证的重发属于同一次注册，不消耗令牌，只重置超时
+    Push(index, nowMs + policy_.requestTimeoutMs, SlotState::IN_FLIGHT);
+    return true;
+}
+
+bool RegisterScheduler::IsInFlight(size_t index) const {
+    return index < states_.size() && states_[index] == SlotState::IN_FLIGHT;
+}
+
+RegisterMetrics RegisterScheduler::GetMetrics() const {
+    RegisterMetrics metrics = counters_;
+    metrics.scheduled = 0;
+    metrics.queued = 0;
+    metrics.inFlight = 0;
+
+    for (SlotState state : states_) {
+        switch (state) {
+            case SlotState::SCHEDULED: metrics.scheduled++; break;
+            case SlotState::QUEUED:    metrics.queued++; break;
+            case SlotState::IN_FLIGHT: metrics.inFlight++; break;
+            default: break;
+        }
+    }
+
+    return metrics;
+}
+
+int64_t RegisterScheduler::NextDueMs() {
+    // 就绪队列非空时，下一个时间点是令牌补充到1个的时刻
+    for (uint32_t index : ready_) {
+        if (states_[index] == SlotState::QUEUED) {
+            double missing = std::max(0.0, 1.0 - tokens_);
+            return lastRefillMs_ + static_cast<int64_t>(missing * 1000.0 / policy_.maxRegistersPerSecond);
+        }
+    }
+
+    while (!heap_.empty() && dueMs_[heap_.top().index] != heap_.top().dueMs) {
+        heap_.pop();
+    }
+
+    return heap_.empty() ? -1 : heap_.top().dueMs;
+}
+
+void RegisterScheduler::Push(size_t index, int64_t dueMs, SlotState state) {
+    states_[index] = state;
+    dueMs_[index] = dueMs;
+    heap_.push(HeapEntry{dueMs, static_cast<uint32_t>(index)});
+}
+
+void RegisterScheduler::RefillTokens(int64_t nowMs) {
+    if (lastRefillMs_ < 0) {
+        lastRefillMs_ = nowMs;
+        return;
+    }
+
+    if (nowMs > lastRefillMs_) {
+        tokens_ += (nowMs - lastRefillMs_) * policy_.maxRegistersPerSecond / 1000.0;
+        tokens_ = std::min(tokens_, static_cast<double>(policy_.burst));
+        lastRefillMs_ = nowMs;
+    }
+}
+
+int64_t RegisterScheduler::Jitter(int64_t lo, int64_t hi) {
+    if (hi <= lo) {
+        return lo;
+    }
+    std::uniform_int_distribution<int64_t> dist(lo, hi);
+    return dist(rng_);
+}
+
+} // namespace gb28181
@@ -3,9 +3,332 @@
 #include <ctime>
 #include <cstdlib>
 #include <algorithm>
+#include <cstring>
 
 namespace gb28181 {
 
+namespace {
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+std::string_view Trim(std::string_view text) {
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && IsSpace(text[start])) start++;
+    while (end > start && IsSpace(text[end - 1])) end--;
+    return text.substr(start, end - start);
+}
+
+/**
+ * @brief 取下一个以空格分隔的字段，text前移到字段之后
+ */
+std::string_view NextToken(std::string_view& text) {
+    size_t start = 0;
+    while (start < text.size() && IsSpace(text[start])) start++;
+    size_t end = start;
+    while (end < text.size() && !IsSpace(text[end])) end++;
+    std::string_view token = text.substr(start, end - start);
+    text.remove_prefix(end);
+    return token;
+}
+
+/**
+ * @brief 解析十进制无符号数，遇到非数字停止
+ * @return 没有数字或溢出返回false
+ */
+bool ParseUnsigned(std::string_view text, uint64_t& value) {
+    value = 0;
+    size_t i = 0;
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+        uint64_t digit = static_cast<uint64_t>(text[i] - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return i > 0;
+}
+
+int ParseInt(std::string_view text, int fallback) {
+    uint64_t value = 0;
+    if (!ParseUnsigned(text, value) || value > INT32_MAX) {
+        return fallback;
+    }
+    return static_cast<int>(value);
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i];
+        char y = b[i];
+        if (x >= 'a' && x <= 'z') x = static_cast<char>(x - 'a' + 'A');
+        if (y >= 'a' && y <= 'z') y = static_cast<char>(y - 'a' + 'A');
+        if (x != y) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// c=IN IP4 <地址>，取最后一个字段
+std::string_view ParseConnection(std::string_view value) {
+    std::string_view address;
+    for (std::string_view token = NextToken(value); !token.empty(); token = NextToken(value)) {
+        address = token;
+    }
+    return address;
+}
+
+void ParseMediaLine(std::string_view value, SdpMedia& media) {
+    media.type = NextToken(value);
+    // 端口可以带/端口数，只取端口
+    media.port = ParseInt(NextToken(value), 0);
+    media.transport = NextToken(value);
+
+    for (std::string_view token = NextToken(value); !token.empty(); token = NextToken(value)) {
+        int type = ParseInt(token, -1);
+        if (type < 0 || media.payloadCount >= SdpMedia::kMaxPayloads) {
+            continue;
+        }
+        media.payloads[media.payloadCount++].type = type;
+    }
+}
+
+// a=rtpmap:<负载类型> <编码>/<时钟频率>[/<声道数>]
+void ParseRtpmap(std::string_view value, SdpMedia& media) {
+    int type = ParseInt(NextToken(value), -1);
+    SdpPayload *payload = nullptr;
+    for (size_t i = 0; i < media.payloadCount && !payload; i++) {
+        if (media.payloads[i].type == type) {
+            payload = &media.payloads[i];
+        }
+    }
+    if (!payload) {
+        return;
+    }
+
+    std::string_view encoding = NextToken(value);
+    size_t slash = encoding.find('/');
+    if (slash != std::string_view::npos) {
+        payload->clockRate = ParseInt(encoding.substr(slash + 1), 0);
+        encoding = encoding.substr(0, slash);
+    }
+    payload->encoding = encoding;
+}
+
+void ParseAttribute(std::string_view value, SdpMedia *media) {
+    // 会话级属性GB28181不使用
+    if (!media) {
+        return;
+    }
+
+    size_t colon = value.find(':');
+    std::string_view name = value.substr(0, colon);
+    std::string_view arg = (colon == std::string_view::npos) ? std::string_view() : Trim(value.substr(colon + 1));
+
+    if (name == "rtpmap") {
+        ParseRtpmap(arg, *media);
+    } else if (name == "recvonly" || name == "sendonly" || name == "sendrecv" || name == "inactive") {
+        media->direction = name;
+    } else if (name == "setup") {
+        media->setup = arg;
+    } else if (name == "connection") {
+        media->connection = arg;
+    } else if (name == "downloadspeed") {
+        media->downloadSpeed = ParseInt(arg, 0);
+    } else if (name == "streamnumber") {
+        media->streamNumber = ParseInt(arg, -1);
+    } else if (name == "filesize") {
+        uint64_t size = 0;
+        if (ParseUnsigned(arg, size)) {
+            media->fileSize = size;
+        }
+    }
+}
+
+} // namespace
+
+const SdpPayload *SdpMedia::FindPayload(int type) const {
+    for (size_t i = 0; i < payloadCount; i++) {
+        if (payloads[i].type == type) {
+            return &payloads[i];
+        }
+    }
+    return nullptr;
+}
+
+const SdpMedia *SdpDescription::FindMedia(std::string_view type) const {
+    for (size_t i = 0; i < mediaCount; i++) {
+        if (media[i].type == type) {
+            return &media[i];
+        }
+    }
+    return nullptr;
+}
+
+std::string_view SdpDescription::GetAddress(const SdpMedia& media) const {
+    return media.connectionAddress.empty() ? connectionAddress : media.connectionAddress;
+}
+
+bool SdpDescription::GetSsrc(uint32_t& value) const {
+    uint64_t parsed = 0;
+    if (ssrc.size() > 10 || !ParseUnsigned(ssrc, parsed) || parsed > UINT32_MAX) {
+        return false;
+    }
+    for (char c : ssrc) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+    }
+    value = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+bool ParseMediaParams(std::string_view text, SdpMediaParams& params) {
+    params = SdpMediaParams();
+    text = Trim(text);
+    if (text.size() < 2 || text[0] != 'v' || text[1] != '/') {
+        return false;
+    }
+    text.remove_prefix(2);
+
+    // 视频与音频部分以字母a分隔，字段之间以/分隔，空字段表示未指定
+    std::string_view audio;
+    size_t split = text.find('a');
+    if (split != std::string_view::npos) {
+        audio = text.substr(split + 1);
+        text = text.substr(0, split);
+        params.hasAudio = true;
+    }
+
+    auto nextField = [](std::string_view& part) {
+        size_t slash = part.find('/');
+        std::string_view field = part.substr(0, slash);
+        part = (slash == std::string_view::npos) ? std::string_view() : part.substr(slash + 1);
+        return ParseInt(field, 0);
+    };
+
+    params.videoCodec = nextField(text);
+    params.resolution = nextField(text);
+    params.frameRate = nextField(text);
+    params.bitRateType = nextField(text);
+    params.bitRate = nextField(text);
+
+    if (!audio.empty() && audio[0] == '/') {
+        audio.remove_prefix(1);
+    }
+    params.audioCodec = nextField(audio);
+    params.audioBitRate = nextField(audio);
+    params.sampleRate = nextField(audio);
+    params.hasAudio = params.hasAudio &&
+                      (params.audioCodec != 0 || params.audioBitRate != 0 || params.sampleRate != 0);
+    return true;
+}
+
+std::string FormatMediaParams(const SdpMediaParams& params) {
+    std::string text = "v";
+    for (int value : {params.videoCodec, params.resolution, params.frameRate,
+                      params.bitRateType, params.bitRate}) {
+        text += '/';
+        if (value > 0) {
+            text += std::to_string(value);
+        }
+    }
+
+    text += 'a';
+    for (int value : {params.audioCodec, params.audioBitRate, params.sampleRate}) {
+        text += '/';
+        if (params.hasAudio && value > 0) {
+            text += std::to_string(value);
+        }
+    }
+    return text;
+}
+
+bool ParseSdp(std::string_view body, SdpDescription& sdp) {
+    sdp = SdpDescription();
+
+    const char *data = body.data();
+    size_t length = body.size();
+    size_t pos = 0;
+    SdpMedia *media = nullptr;  // 当前媒体段，m=之前为nullptr
+    bool skipMedia = false;     // 超出kMaxMedia的媒体段，其属性行一并忽略
+
+    while (pos < length) {
+        const void *newline = memchr(data + pos, '\n', length - pos);
+        size_t lineEnd = newline ? static_cast<const char*>(newline) - data : length;
+        std::string_view line(data + pos, lineEnd - pos);
+        pos = lineEnd + 1;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.size() < 2 || line[1] != '=') {
+            continue;
+        }
+
+        std::string_view value = line.substr(2);
+        switch (line[0]) {
+            case 'o': {
+                sdp.origin = value;
+                sdp.originAddress = ParseConnection(value);
+                break;
+            }
+            case 's':
+                sdp.sessionName = Trim(value);
+                break;
+            case 'u':
+                sdp.uri = Trim(value);
+                break;
+            case 'c':
+                if (skipMedia) {
+                    break;
+                }
+                if (media) {
+                    media->connectionAddress = ParseConnection(value);
+                } else {
+                    sdp.connectionAddress = ParseConnection(value);
+                }
+                break;
+            case 't': {
+                uint64_t time = 0;
+                if (ParseUnsigned(NextToken(value), time)) sdp.startTime = time;
+                if (ParseUnsigned(NextToken(value), time)) sdp.stopTime = time;
+                break;
+            }
+            case 'm':
+                if (sdp.mediaCount >= SdpDescription::kMaxMedia) {
+                    media = nullptr;
+                    skipMedia = true;
+                    break;
+                }
+                media = &sdp.media[sdp.mediaCount++];
+                ParseMediaLine(value, *media);
+                break;
+            case 'a':
+                if (!skipMedia) {
+                    ParseAttribute(value, media);
+                }
+                break;
+            case 'y':
+                sdp.ssrc = Trim(value);
+                break;
+            case 'f':
+                sdp.format = Trim(value);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return sdp.mediaCount > 0;
+}
+
 SdpNegotiator::SdpNegotiator() : sessionVersion_(0) {
     sessionId_ = GenerateSessionId();
 }
@@ -19,42 +342,63 @@ std::string SdpNegotiator::CreateSdpAnswer(
     SdpMediaFormat videoFormat,
     SdpMediaFormat audioFormat) {
 
+    SdpAnswerOptions options;
+    options.localIp = localIp;
+    options.rtpPort = rtpPort;
+    options.videoFormat = videoFormat;
+    options.audioFormat = audioFormat;
+    return CreateSdpAnswer(options);
+}
+
+std::string SdpNegotiator::CreateSdpAnswer(const SdpAnswerOptions& options) {
     std::stringstream ss;
 
     // v= 协议版本
     ss << "v=0\r\n";
 
     // o= 会话发起者
-    ss << "o=- " << sessionId_ << " " << ++sessionVersion_ << " IN IP4 " << localIp << "\r\n";
+    ss << "o=- " << sessionId_ << " " << ++sessionVersion_ << " IN IP4 " << options.localIp << "\r\n";
 
-    // s= 会话名称
-    ss << "s=Play\r\n";
+    // s= 会话名称，与offer一致
+    ss << "s=" << options.sessionName << "\r\n";
 
     // c= 连接信息
-    ss << "c=IN IP4 " << localIp << "\r\n";
+    ss << "c=IN IP4 " << options.localIp << "\r\n";
 
     // t= 时间信息（0表示无限期）
     ss << "t=0 0\r\n";
 
-    // 视频媒体描述
-    int videoPayload = GetVideoPayloadType(videoFormat);
-    ss << "m=video " << rtpPort << " RTP/AVP " << videoPayload << "\r\n";
-    ss << "a=rtpmap:" << videoPayload << " " << GetFormatName(videoFormat) << "/90000\r\n";
+    // 视频媒体描述，负载类型沿用offer中的编号
+    int videoPayload = (options.videoPayloadType >= 0) ? options.videoPayloadType
+                                                       : GetVideoPayloadType(options.videoFormat);
+    ss << "m=video " << options.rtpPort << " RTP/AVP " << videoPayload << "\r\n";
+    ss << "a=sendonly\r\n";
+    if (options.fileSize > 0) {
+        ss << "a=filesize:" << options.fileSize << "\r\n";
+    }
+    ss << "a=rtpmap:" << videoPayload << " " << GetFormatName(options.videoFormat) << "/90000\r\n";
 
-    // H.264/H.265需要添加fmtp
-    if (videoFormat == SdpMediaFormat::H264) {
+    // H.264/H.265需要添加fmtp，PS流不需要
+    if (options.videoFormat == SdpMediaFormat::H264) {
         ss << "a=fmtp:" << videoPayload << " profile-level-id=42e01f;packetization-mode=1\r\n";
-    } else if (videoFormat == SdpMediaFormat::H265) {
+    } else if (options.videoFormat == SdpMediaFormat::H265) {
         ss << "a=fmtp:" << videoPayload << " profile-id=1\r\n";
-    } else if (videoFormat == SdpMediaFormat::PS) {
-        // PS流不需要fmtp
     }
 
     // 音频媒体描述
-    int audioPayload = GetAudioPayloadType(audioFormat);
-    int audioPort = rtpPort + 2; // 音频端口通常在视频端口+2
+    int audioPayload = (options.audioPayloadType >= 0) ? options.audioPayloadType
+                                                       : GetAudioPayloadType(options.audioFormat);
+    int audioPort = options.rtpPort + 2; // 音频端口通常在视频端口+2
     ss << "m=audio " << audioPort << " RTP/AVP " << audioPayload << "\r\n";
-    ss << "a=rtpmap:" << audioPayload << " " << GetFormatName(audioFormat) << "/8000/1\r\n";
+    ss << "a=rtpmap:" << audioPayload << " " << GetFormatName(options.audioFormat) << "/8000/1\r\n";
+
+    // y= SSRC 和 f= 媒体参数
+    if (!options.ssrc.empty()) {
+        ss << "y=" << options.ssrc << "\r\n";
+    }
+    if (!options.mediaParams.empty()) {
+        ss << "f=" << options.mediaParams << "\r\n";
+    }
 
     return ss.str();
 }
@@ -105,94 +449,6 @@ std::string SdpNegotiator::CreateSdpOffer(
     return ss.str();
 }
 
-SdpSessionInfo SdpNegotiator::ParseSdp(const std::string& sdpStr) {
-    SdpSessionInfo sessionInfo;
-
-    std::istringstream ss(sdpStr);
-    std::string line;
-
-    while (std::getline(ss, line)) {
-        if (line.empty()) continue;
-
-        // 移除行尾的\r
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-
-        if (line.length() < 2) continue;
-
-        char type = line[0];
-        std::string content = line.substr(2);
-
-        switch (type) {
-            case 'v': // 版本
-                sessionInfo.version = content;
-                break;
-
-            case 'o': // 会话发起者
-                sessionInfo.origin = content;
-                break;
-
-            case 's': // 会话名称
-                sessionInfo.sessionName = content;
-                break;
-
-            case 'c': // 连接信息
-                sessionInfo.connectionInfo = content;
-                break;
-
-            case 't': // 时间信息
-                sessionInfo.timing = content;
-                break;
-
-            case 'm': // 媒体描述
-            {
-                SdpMediaInfo mediaInfo;
-                std::istringstream mediaStream(content);
-                std::string token;
-
-                // media类型
-                if (mediaStream >> token) mediaInfo.type = token;
-                // 端口
-                if (mediaStream >> token) mediaInfo.port = std::stoi(token);
-                // 传输协议
-                if (mediaStream >> token) mediaInfo.transport = token;
-                // 负载类型
-                while (mediaStream >> token) {
-                    mediaInfo.payloadTypes.push_back(std::stoi(token));
-                }
-
-                sessionInfo.mediaInfos.push_back(mediaInfo);
-                break;
-            }
-
-            case 'a': // 属性
-            {
-                if (!sessionInfo.mediaInfos.empty()) {
-                    std::string attrName, attrValue;
-                    size_t pos = content.find(':');
-                    if (pos != std::string::npos) {
-                        attrName = content.substr(0, pos);
-                        attrValue = content.substr(pos + 1);
-
-                        if (attrName == "rtpmap") {
-                            sessionInfo.mediaInfos.back().rtpmap = attrValue;
-                        } else if (attrName == "fmtp") {
-                            sessionInfo.mediaInfos.back().fmtp = attrValue;
-                        }
-                    }
-                }
-                break;
-            }
-
-            default:
-                break;
-        }
-    }
-
-    return sessionInfo;
-}
-
 int SdpNegotiator::GetVideoPayloadType(SdpMediaFormat format) {
     switch (format) {
         case SdpMediaFormat::H264:
@@ -200,7 +456,7 @@ int SdpNegotiator::GetVideoPayloadType(SdpMediaFormat format) {
         case SdpMediaFormat::H265:
             return 98;
         case SdpMediaFormat::PS:
-            return 99;
+            return 96;
         default:
             return 96;
     }
@@ -226,7 +482,7 @@ std::string SdpNegotiator::GetFormatName(SdpMediaFormat format) {
         case SdpMediaFormat::H265:
             return "H265";
         case SdpMediaFormat::PS:
-            return "MP2T";
+            return "PS";
         case SdpMediaFormat::PCMU:
             return "PCMU";
         case SdpMediaFormat::PCMA:
@@ -238,6 +494,90 @@ std::string SdpNegotiator::GetFormatName(SdpMediaFormat format) {
     }
 }
 
+bool SdpNegotiator::GetFormatByName(std::string_view name, SdpMediaFormat& format) {
+    static const struct {
+        const char *name;
+        SdpMediaFormat format;
+    } kFormats[] = {
+        {"PS", SdpMediaFormat::PS},
+        {"MP2P", SdpMediaFormat::PS},
+        {"H264", SdpMediaFormat::H264},
+        {"H265", SdpMediaFormat::H265},
+        {"HEVC", SdpMediaFormat::H265},
+        {"PCMA", SdpMediaFormat::PCMA},
+        {"PCMU", SdpMediaFormat::PCMU},
+        {"AAC", SdpMediaFormat::AAC},
+        {"MPEG4-GENERIC", SdpMediaFormat::AAC},
+    };
+
+    for (const auto& entry : kFormats) {
+        if (EqualsIgnoreCase(name, entry.name)) {
+            format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+int SdpNegotiator::ToMediaParamsResolution(int resolution) {
+    static const int kResolutions[] = {
+        SdpMediaParams::kQcif, SdpMediaParams::kCif, SdpMediaParams::kD1,
+        SdpMediaParams::k720P, SdpMediaParams::k1080P
+    };
+    if (resolution < 0) {
+        return kResolutions[0];
+    }
+    return kResolutions[std::min<size_t>(static_cast<size_t>(resolution), 4)];
+}
+
+size_t SdpNegotiator::NegotiateVideo(const SdpMediaParams& requested,
+                                     int streamNumber,
+                                     const std::vector<VideoConfig>& streams,
+                                     SdpMediaParams& answer) {
+    answer = requested;
+    if (streams.empty()) {
+        return 0;
+    }
+
+    size_t selected = 0;
+    if (streamNumber >= 0 && static_cast<size_t>(streamNumber) < streams.size()) {
+        selected = static_cast<size_t>(streamNumber);
+    } else if (requested.resolution > 0) {
+        // 不超过请求分辨率的最大一路；都超过时取最小一路
+        int best = -1;
+        int smallest = -1;
+        for (size_t i = 0; i < streams.size(); i++) {
+            int resolution = ToMediaParamsResolution(streams[i].resolution);
+            if (resolution <= requested.resolution && resolution > best) {
+                best = resolution;
+                selected = i;
+            }
+            if (best < 0 && (smallest < 0 || resolution < smallest)) {
+                smallest = resolution;
+                selected = i;
+            }
+        }
+    }
+
+    const VideoConfig& stream = streams[selected];
+    answer.videoCodec = (stream.codec == "H265" || stream.codec == "HEVC") ? SdpMediaParams::kCodecH265
+                                                                          : SdpMediaParams::kCodecH264;
+    answer.resolution = ToMediaParamsResolution(stream.resolution);
+    answer.frameRate = (requested.frameRate > 0) ? std::min(requested.frameRate, stream.frameRate)
+                                                 : stream.frameRate;
+    answer.bitRateType = stream.vbr ? 2 : 1;
+    answer.bitRate = (requested.bitRate > 0) ? std::min(requested.bitRate, stream.bitRate)
+                                             : stream.bitRate;
+
+    // 音频固定为G.711、64kbps、8kHz
+    if (requested.hasAudio) {
+        answer.audioCodec = 1;
+        answer.audioBitRate = 8;
+        answer.sampleRate = 1;
+    }
+    return selected;
+}
+
 std::string SdpNegotiator::CreateMediaLine(const SdpMediaInfo& media) {
     std::stringstream ss;
     ss << "m=" << media.type << " " << media.port << " " << media.transport;
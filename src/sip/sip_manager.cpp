@@ -1,24 +1,133 @@
 #include "sip/sip_manager.h"
 #include "sip/media_session.h"
 #include "sip/sdp_negotiator.h"
+#include "sip/identity_table.h"
+#include "sip/manscdp_dispatcher.h"
+#include "sip/mansrtsp.h"
+#include "device/device_manager.h"
+#include "device/record_manager.h"
+#include "device/playback_manager.h"
+#include "device/playback_scheduler.h"
+#include "rtp/port_allocator.h"
+#include "rtp/socket_pool.h"
 #include "utils/md5.h"
+#include "utils/timer_service.h"
+#include "utils/xml_template.h"
+#include "utils/thread_pool.h"
+#include "utils/event_log.h"
 #include "eXosip.h"
-#include <iostream>
-#include <sstream>
+#include "utils/logger.h"
+#include <algorithm>
 #include <cstring>
+#include <strings.h>
+#include <cstdio>
 #include <cstdlib>
 #include <random>
 #include <regex>
 #include <iomanip>
 #include <ctime>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
 namespace gb28181 {
 
+namespace {
+
+// MANSCDP消息模板，进程内只编译一次
+const XmlTemplate kKeepaliveTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Notify>\r\n"
+    "<CmdType>Keepalive</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<Status>OK</Status>\r\n"
+    "</Notify>\r\n");
+
+// 没有设备管理器的身份应答空目录
+const XmlTemplate kCatalogTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>Catalog</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<SumNum>0</SumNum>\r\n"
+    "<DeviceList Num=\"0\">\r\n"
+    "</DeviceList>\r\n"
+    "</Response>\r\n");
+
+const XmlTemplate kDeviceInfoTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>DeviceInfo</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<DeviceName>{{DeviceName}}</DeviceName>\r\n"
+    "<Manufacturer>{{Manufacturer}}</Manufacturer>\r\n"
+    "<Model>{{Model}}</Model>\r\n"
+    "<FirmwareVersion>{{FirmwareVersion}}</FirmwareVersion>\r\n"
+    "</Response>\r\n");
+
+const XmlTemplate kDeviceStatusTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>DeviceStatus</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<Result>OK</Result>\r\n"
+    "<Online>{{Online}}</Online>\r\n"
+    "<Status>OK</Status>\r\n"
+    "<Encode>ON</Encode>\r\n"
+    "<Record>OFF</Record>\r\n"
+    "</Response>\r\n");
+
+const XmlTemplate kRecordInfoTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>RecordInfo</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<SumNum>0</SumNum>\r\n"
+    "<RecordList Num=\"0\">\r\n"
+    "</RecordList>\r\n"
+    "</Response>\r\n");
+
+const XmlTemplate kDeviceControlTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Response>\r\n"
+    "<CmdType>DeviceControl</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<Result>{{Result}}</Result>\r\n"
+    "</Response>\r\n");
+
+// 回放或下载的媒体流发送结束（NotifyType 121）
+const XmlTemplate kMediaStatusTemplate(
+    "<?xml version=\"1.0\"?>\r\n"
+    "<Notify>\r\n"
+    "<CmdType>MediaStatus</CmdType>\r\n"
+    "<SN>{{SN}}</SN>\r\n"
+    "<DeviceID>{{DeviceID}}</DeviceID>\r\n"
+    "<NotifyType>121</NotifyType>\r\n"
+    "</Notify>\r\n");
+
+} // namespace
+
 class SipManager::Impl {
 public:
-    Impl() : excontext_(nullptr), registered_(false), cseq_(1), sn_(1), rtpPortBase_(50000) {
+    Impl() : excontext_(nullptr), cseq_(1),
+             gatewayMode_(false), heartbeatIntervalMs_(60000), keepaliveEpochMs_(0),
+             timerService_(nullptr), registerTimer_(TimerService::kInvalidTimer),
+             registerTimerDueMs_(-1),
+             deviceManager_(nullptr), recordManager_(nullptr), playbackManager_(nullptr),
+             playbackScheduler_(nullptr),
+             threadPool_(nullptr),
+             queryRunning_(), queriesInFlight_(0), nextResponseStreamId_(1) {
         excontext_ = eXosip_malloc();
         if (excontext_) {
             eXosip_init(excontext_);
@@ -27,13 +136,38 @@ public:
         // 初始化媒体会话管理器
         mediaSessionManager_ = std::make_unique<MediaSessionManager>();
         mediaSessionManager_->Initialize();
+        SetRtpPortRange(kDefaultRtpPortBase, kDefaultRtpPortCount);
+
+        // BYE、超时或应答失败终止媒体会话时一并停止对应的回放
+        mediaSessionManager_->SetEventCallback(
+            [this](const std::string& sessionId, SessionState state, const std::string& event) {
+                if (state != SessionState::TERMINATED) {
+                    return;
+                }
+                if (playbackManager_ && playbackManager_->HasSession(sessionId)) {
+                    if (playbackScheduler_) {
+                        playbackScheduler_->Remove(sessionId);
+                    }
+                    playbackManager_->StopPlayback(sessionId);
+                }
+
+                // 对话表只在SIP线程访问；空闲超时的已确认对话由本端发BYE结束
+                bool timeout = (event == "SESSION_TIMEOUT");
+                Post([this, sessionId, timeout]() { CloseDialog(sessionId, timeout); });
+            });
+
+        RegisterManscdpHandlers();
     }
 
     ~Impl() {
+        // 工作线程中的查询会回投任务，等其结束后再析构
+        WaitForQueries();
+
         if (excontext_) {
-            if (registered_) {
+            if (identities_.CountInState(IdentityState::REGISTERED) > 0) {
                 Unregister();
             }
+            CancelAllTimers();
             eXosip_quit(excontext_);
             eXosip_free(excontext_);
             excontext_ = nullptr;
@@ -47,18 +181,23 @@ public:
         }
 
         localPort_ = localPort;
-        deviceId_ = deviceId;
         realm_ = realm;
+        mediaSessionManager_->SetRealm(realm);
+
+        // 主身份固定为索引0，单设备模式下只有这一个身份
+        if (identities_.Size() == 0) {
+            identities_.Add(deviceId, deviceId, "");
+        }
 
         // 如果传入的IP是空或"auto"，则自动获取本机IP
         if (localIp.empty() || localIp == "auto") {
             char autoIp[64];
             if (eXosip_guess_localip(excontext_, AF_INET, autoIp, sizeof(autoIp)) == 0) {
                 localIp_ = autoIp;
-                std::cout << "Auto-detected local IP: " << localIp_ << std::endl;
+                LOG_INFO("Auto-detected local IP: " << localIp_);
             } else {
                 localIp_ = "0.0.0.0";
-                std::cout << "Failed to auto-detect IP, using 0.0.0.0" << std::endl;
+                LOG_WARN("Failed to auto-detect IP, using 0.0.0.0");
             }
         } else {
             localIp_ = localIp;
@@ -66,125 +205,235 @@ public:
 
         // 启动监听
         if (eXosip_listen_addr(excontext_, IPPROTO_UDP, localIp_.c_str(), localPort, AF_INET) != 0) {
-            std::cerr << "Failed to listen on " << localIp_ << ":" << localPort << std::endl;
+            LOG_ERROR("Failed to listen on " << localIp_ << ":" << localPort);
             return false;
         }
 
         // 设置User-Agent
         eXosip_set_user_agent(excontext_, "GB28181-Device/1.0");
 
-        std::cout << "SIP initialized on " << localIp_ << ":" << localPort << std::endl;
+        LOG_INFO("SIP initialized on " << localIp_ << ":" << localPort);
         return true;
     }
 
     bool RegisterToServer(const std::string& serverIp, int serverPort,
                          const std::string& username, const std::string& password) {
-        if (!excontext_) {
+        if (!excontext_ || identities_.Size() == 0) {
             return false;
         }
 
         serverIp_ = serverIp;
         serverPort_ = serverPort;
-        username_ = username;
-        password_ = password;
-
-        // 构建from和contact地址
-        std::string from = "sip:" + username_ + "@" + realm_;
-        std::string proxy = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
-        std::string contact = "sip:" + username_ + "@" + localIp_ + ":" + std::to_string(localPort_);
-
-        // 初始化REGISTER
-        int rid = eXosip_register_init(excontext_, from.c_str(), proxy.c_str(), contact.c_str());
-        if (rid < 0) {
-            std::cerr << "Failed to initialize REGISTER" << std::endl;
+        identities_.usernames[0] = username;
+        identities_.passwords[0] = password;
+        EnsureTimerService();
+
+        // 首次注册立即发送，后续刷新与失败重试由注册调度器驱动
+        int64_t now = NowMs();
+        keepaliveEpochMs_ = now;
+        registerScheduler_.Resize(identities_.Size());
+        registerScheduler_.Schedule(0, now);
+        PumpRegisterScheduler(now);
+        ArmRegisterTimer();
+
+        if (!registerScheduler_.IsInFlight(0)) {
             return false;
         }
 
-        // 构建REGISTER消息
-        osip_message_t *reg = nullptr;
-        if (eXosip_register_build_initial_register(excontext_, from.c_str(), proxy.c_str(),
-                                                   contact.c_str(), 3600, &reg) != 0) {
-            std::cerr << "Failed to build REGISTER message" << std::endl;
+        LOG_INFO("REGISTER sent to " << serverIp << ":" << serverPort);
+        return true;
+    }
+
+    bool Unregister() {
+        if (!excontext_) {
             return false;
         }
 
-        // 添加Authorization头（第一次注册时可能为空，等待401响应后重新认证）
-        std::string auth = "Digest username=\"" + username_ + "\",realm=\"" + realm_ +
-                          "\",nonce=\"\",uri=\"sip:" + realm_ + "\",response=\"" +
-                          password_ + "\",algorithm=MD5";
-        osip_message_set_header(reg, "Authorization", auth.c_str());
+        size_t count = 0;
+        for (size_t i = 0; i < identities_.Size(); i++) {
+            if (identities_.states[i] != IdentityState::REGISTERED) {
+                continue;
+            }
 
-        // 发送REGISTER
-        if (eXosip_register_send_register(excontext_, rid, reg) != 0) {
-            std::cerr << "Failed to send REGISTER" << std::endl;
+            std::string from = "sip:" + identities_.usernames[i] + "@" + realm_;
+            std::string proxy = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
+            std::string contact = "sip:" + identities_.usernames[i] + "@" + localIp_ + ":" + std::to_string(localPort_);
+
+            osip_message_t *reg = nullptr;
+            if (eXosip_register_build_initial_register(excontext_, from.c_str(), proxy.c_str(),
+                                                       contact.c_str(), 0, &reg) != 0) {
+                continue;
+            }
+
+            eXosip_register_send_register(excontext_, identities_.registerIds[i], reg);
+
+            identities_.states[i] = IdentityState::UNREGISTERED;
+            CancelKeepalive(i);
+            registerScheduler_.Cancel(i);
+            count++;
+        }
+
+        if (count == 0) {
             return false;
         }
 
-        std::cout << "REGISTER sent to " << serverIp << ":" << serverPort << std::endl;
+        LOG_INFO("UNREGISTER sent for " << count << " identities");
         return true;
     }
 
-    bool Unregister() {
-        if (!excontext_ || !registered_) {
+    bool SendHeartbeat() {
+        if (!excontext_ || identities_.Size() == 0) {
             return false;
         }
 
-        std::string from = "sip:" + username_ + "@" + realm_;
-        std::string proxy = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
-        std::string contact = "sip:" + username_ + "@" + localIp_ + ":" + std::to_string(localPort_);
+        return SendKeepalive(0);
+    }
 
-        osip_message_t *reg = nullptr;
-        if (eXosip_register_build_initial_register(excontext_, from.c_str(), proxy.c_str(),
-                                                   contact.c_str(), 0, &reg) != 0) {
-            return false;
+    void SetDeviceManager(DeviceManager* deviceManager) {
+        deviceManager_ = deviceManager;
+    }
+
+    void SetCatalogOptions(const CatalogOptions& options) {
+        catalogOptions_ = options;
+        catalogOptions_.maxBodyBytes = std::max<size_t>(512, catalogOptions_.maxBodyBytes);
+        catalogOptions_.pacingMs = std::max(0, catalogOptions_.pacingMs);
+    }
+
+    void SetRecordManager(RecordManager* recordManager) {
+        recordManager_ = recordManager;
+    }
+
+    void SetPlaybackManager(PlaybackManager* playbackManager) {
+        playbackManager_ = playbackManager;
+    }
+
+    void SetPlaybackScheduler(PlaybackScheduler* playbackScheduler) {
+        playbackScheduler_ = playbackScheduler;
+        if (playbackScheduler_) {
+            // 正在发送或暂停中的回放会话不按空闲超时拆除
+            playbackScheduler_->SetActivityCallback([this](const std::string& sessionId) {
+                mediaSessionManager_->UpdateActivity(sessionId);
+            });
+            playbackScheduler_->SetFinishedCallback([this](const std::string& sessionId) {
+                Post([this, sessionId]() { HandlePlaybackFinished(sessionId); });
+            });
         }
+    }
 
-        eXosip_register_send_register(excontext_, 0, reg);
+    void SetThreadPool(ThreadPool* threadPool) {
+        threadPool_ = threadPool;
+    }
 
-        registered_ = false;
-        std::cout << "UNREGISTER sent" << std::endl;
-        return true;
+    void SetQueryOptions(const QueryOptions& options) {
+        queryOptions_ = options;
+        queryOptions_.maxCatalogQueries = std::max(1, queryOptions_.maxCatalogQueries);
+        queryOptions_.maxRecordQueries = std::max(1, queryOptions_.maxRecordQueries);
     }
 
-    bool SendHeartbeat() {
-        if (!excontext_ || !registered_) {
-            return false;
+    void SetRtpPortRange(int basePort, int portCount) {
+        if (mediaSessionManager_->GetSessionCount() > 0) {
+            LOG_WARN("[SIP] RTP port range can not change while media sessions are active");
+            return;
         }
+        // 套接字池持有旧分配器的端口，先停掉再替换分配器
+        socketPool_.reset();
+        portAllocator_ = std::make_unique<PortAllocator>(basePort, portCount);
+        mediaSessionManager_->SetPortAllocator(portAllocator_.get());
+        StartSocketPool();
+    }
 
-        // GB28181使用MESSAGE发送心跳
-        std::string to = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
-        std::string from = "sip:" + username_ + "@" + realm_;
+    void SetVideoStreams(const std::vector<VideoConfig>& streams) {
+        videoStreams_ = streams;
+    }
 
-        osip_message_t *msg = nullptr;
-        if (eXosip_message_build_request(excontext_, &msg, "MESSAGE",
-                                         to.c_str(), from.c_str(), nullptr) != 0) {
-            return false;
+    void SetSocketPoolOptions(const SocketPoolOptions& options) {
+        socketPoolOptions_ = options;
+        socketPoolOptions_.lowWatermark = std::min(socketPoolOptions_.lowWatermark,
+                                                   socketPoolOptions_.highWatermark);
+        socketPool_.reset();
+        StartSocketPool();
+    }
+
+    void StartSocketPool() {
+        if (socketPoolOptions_.highWatermark == 0) {
+            return;
+        }
+        socketPool_ = std::make_unique<SocketPool>(portAllocator_.get(), socketPoolOptions_);
+        socketPool_->Start();
+    }
+
+    void SetTimerService(TimerService* timerService) {
+        if (timerService_ == nullptr) {
+            timerService_ = timerService;
         }
+    }
 
-        // 构建心跳消息体（MANSCDP格式）
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Notify>\r\n";
-        ss << "<CmdType>Keepalive</CmdType>\r\n";
-        ss << "<SN>" << sn_++ << "</SN>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<Status>OK</Status>\r\n";
-        ss << "</Notify>\r\n";
+    void SetHeartbeatInterval(int seconds) {
+        heartbeatIntervalMs_ = static_cast<int64_t>(std::max(1, seconds)) * 1000;
+    }
 
-        std::string body = ss.str();
-        osip_message_set_body(msg, body.c_str(), body.length());
-        osip_message_set_content_type(msg, "Application/MANSCDP+xml");
+    int AddIdentity(const std::string& deviceId, const std::string& username,
+                    const std::string& password, DeviceManager* deviceManager) {
+        int index = identities_.Add(deviceId, username, password, deviceManager);
+        if (index < 0) {
+            LOG_ERROR("[SIP] Duplicate gateway identity: " << deviceId);
+        }
+        return index;
+    }
 
-        if (eXosip_message_send_request(excontext_, msg) != 0) {
+    bool RegisterAllIdentities(const std::string& serverIp, int serverPort,
+                               int expires, int heartbeatInterval) {
+        if (!excontext_ || identities_.Size() == 0) {
             return false;
         }
 
-        std::cout << "Keepalive sent" << std::endl;
+        serverIp_ = serverIp;
+        serverPort_ = serverPort;
+        SetHeartbeatInterval(heartbeatInterval);
+        gatewayMode_ = true;
+        keepaliveEpochMs_ = NowMs();
+        EnsureTimerService();
+
+        RegisterPolicy policy = registerScheduler_.GetPolicy();
+        policy.expires = expires;
+        registerScheduler_.SetPolicy(policy);
+
+        // 全部身份同时到期，由调度器的令牌桶按速率上限错开发送
+        registerScheduler_.Resize(identities_.Size());
+        for (size_t i = 0; i < identities_.Size(); i++) {
+            registerScheduler_.Schedule(i, keepaliveEpochMs_);
+        }
+        ArmRegisterTimer();
+
+        LOG_INFO("[SIP] Gateway mode: scheduled REGISTER for " << identities_.Size()
+                 << " identities at " << policy.maxRegistersPerSecond << "/s");
         return true;
     }
 
+    void SetRegisterPolicy(const RegisterPolicy& policy) {
+        registerScheduler_.SetPolicy(policy);
+    }
+
+    RegisterPolicy GetRegisterPolicy() const {
+        return registerScheduler_.GetPolicy();
+    }
+
+    RegisterMetrics GetRegisterMetrics() const {
+        return registerScheduler_.GetMetrics();
+    }
+
+    size_t GetIdentityCount() const {
+        return identities_.Size();
+    }
+
+    size_t GetRegisteredIdentityCount() const {
+        return identities_.CountInState(IdentityState::REGISTERED);
+    }
+
     void ProcessMessage() {
-        if (!excontext_) {
+        RunPostedTasks();
+
+        if (!excontext_ || identities_.Size() == 0) {
             return;
         }
 
@@ -193,44 +442,40 @@ public:
         if (event) {
             switch (event->type) {
                 case EXOSIP_REGISTRATION_SUCCESS:
-                    registered_ = true;
-                    std::cout << "[SIP] Registration successful" << std::endl;
-                    if (eventCallback_) {
-                        eventCallback_("REGISTER_SUCCESS", "Device registered successfully");
-                    }
+                    HandleRegisterSuccess(event);
                     break;
 
                 case EXOSIP_REGISTRATION_FAILURE:
-                    // 检查是否是401未授权响应
-                    if (event->response && event->response->status_code == 401) {
-                        std::cout << "[SIP] Received 401 Unauthorized, performing digest authentication" << std::endl;
-                        Handle401Response(event);
-                    } else {
-                        registered_ = false;
-                        std::cout << "[SIP] Registration failed" << std::endl;
-                        if (eventCallback_) {
-                            eventCallback_("REGISTER_FAILURE", "Registration failed");
-                        }
-                    }
+                    HandleRegisterFailure(event);
                     break;
 
                 case EXOSIP_MESSAGE_NEW:
-                    std::cout << "[SIP] New MESSAGE received" << std::endl;
-                    HandleMessage(event);
+                    LOG_DEBUG("[SIP] New MESSAGE received");
+                    HandleMessage(event, ResolveIdentity(event->request));
+                    break;
+
+                case EXOSIP_MESSAGE_SUCCESS:
+                    // 平台应答了本身份发出的MESSAGE（心跳等），说明链路正常
+                    identities_.missedKeepalives[ResolveIdentity(event->request, "From")] = 0;
                     break;
 
                 case EXOSIP_CALL_INVITE:
-                    std::cout << "[SIP] INVITE received" << std::endl;
-                    HandleInvite(event);
+                    LOG_DEBUG("[SIP] INVITE received");
+                    HandleInvite(event, ResolveIdentity(event->request));
                     break;
 
                 case EXOSIP_CALL_ACK:
-                    std::cout << "[SIP] ACK received" << std::endl;
+                    LOG_DEBUG("[SIP] ACK received");
                     HandleAck(event);
                     break;
 
+                case EXOSIP_CALL_MESSAGE_NEW:
+                    LOG_DEBUG("[SIP] In-dialog request received");
+                    HandleCallMessage(event);
+                    break;
+
                 case EXOSIP_CALL_CLOSED:
-                    std::cout << "[SIP] Call closed" << std::endl;
+                    LOG_DEBUG("[SIP] Call closed");
                     HandleBye(event);
                     break;
 
@@ -240,6 +485,9 @@ public:
 
             eXosip_event_free(event);
         }
+
+        // 事件处理可能改变注册排期，重新对齐注册定时器
+        ArmRegisterTimer();
     }
 
     void SetEventCallback(SipEventCallback callback) {
@@ -252,14 +500,16 @@ public:
 
     std::string GetLocalIp() const { return localIp_; }
     int GetLocalPort() const { return localPort_; }
-    std::string GetDeviceId() const { return deviceId_; }
+    std::string GetDeviceId() const {
+        return identities_.Size() > 0 ? identities_.deviceIds[0] : std::string();
+    }
 
     bool SendMessage(const std::string& to, const std::string& content) {
-        if (!excontext_) {
+        if (!excontext_ || identities_.Size() == 0) {
             return false;
         }
 
-        std::string from = "sip:" + username_ + "@" + realm_;
+        std::string from = "sip:" + identities_.usernames[0] + "@" + realm_;
 
         osip_message_t *msg = nullptr;
         if (eXosip_message_build_request(excontext_, &msg, "MESSAGE",
@@ -277,6 +527,19 @@ public:
         return true;
     }
 
+    void PostNotify(const std::string& content) {
+        Post([this, content]() {
+            if (!excontext_ || identities_.Size() == 0 ||
+                identities_.states[0] != IdentityState::REGISTERED) {
+                LOG_DEBUG("[SipManager] Not registered, notify dropped");
+                return;
+            }
+            if (!SendXmlMessage(0, content)) {
+                LOG_WARN("[SipManager] Failed to send notify");
+            }
+        });
+    }
+
     bool SendResponse(int tid, int statusCode, const std::string& reason) {
         if (!excontext_) {
             return false;
@@ -297,8 +560,8 @@ public:
     }
 
     bool PtzControl(const std::string& channelId, int command, int speed) {
-        std::cout << "[PTZ] Direction control - Channel: " << channelId
-                  << ", Command: " << command << ", Speed: " << speed << std::endl;
+        LOG_INFO("[PTZ] Direction control - Channel: " << channelId
+                 << ", Command: " << command << ", Speed: " << speed);
 
         if (eventCallback_) {
             std::string cmdStr;
@@ -321,8 +584,8 @@ public:
     }
 
     bool PtzZoom(const std::string& channelId, int command, int speed) {
-        std::cout << "[PTZ] Zoom control - Channel: " << channelId
-                  << ", Command: " << command << ", Speed: " << speed << std::endl;
+        LOG_INFO("[PTZ] Zoom control - Channel: " << channelId
+                 << ", Command: " << command << ", Speed: " << speed);
 
         if (eventCallback_) {
             std::string cmdStr;
@@ -339,8 +602,8 @@ public:
     }
 
     bool PtzPreset(const std::string& channelId, int command, int presetId) {
-        std::cout << "[PTZ] Preset control - Channel: " << channelId
-                  << ", Command: " << command << ", PresetID: " << presetId << std::endl;
+        LOG_INFO("[PTZ] Preset control - Channel: " << channelId
+                 << ", Command: " << command << ", PresetID: " << presetId);
 
         if (eventCallback_) {
             std::string cmdStr;
@@ -356,6 +619,7 @@ public:
         return true;
     }
 
+
     MediaSessionManager* GetMediaSessionManager() {
         return mediaSessionManager_.get();
     }
@@ -365,205 +629,697 @@ public:
     }
 
 private:
-    void Handle401Response(eXosip_event_t *event) {
-        if (!event->response) {
-            return;
+    // 在线程池中执行的查询类型
+    enum class QueryKind : uint8_t {
+        CATALOG,
+        RECORD_INFO,
+        COUNT
+    };
+
+    // 待执行的查询，工作线程只访问其中的副本
+    struct QueryJob {
+        QueryKind kind;
+        uint32_t index;             // 身份索引
+        uint32_t sn;                // 查询SN，应答按此关联
+        std::string deviceId;       // 应答中的DeviceID
+        DeviceManager *device;      // 身份自身的设备管理器，为空时应答空目录
+        size_t maxBodyBytes;        // 单条应答消息体上限
+        RecordQueryCondition condition;
+    };
+
+    // 查询完成后待发送的应答消息，按间隔逐条发出
+    struct ResponseStream {
+        QueryKind kind;
+        uint32_t index;
+        uint32_t sn;
+        std::vector<std::string> bodies;
+        size_t next;                // 下一条待发送的消息
+        TimerService::TimerId timer;
+    };
+
+    // 每次最多发送的REGISTER数，避免阻塞事件处理
+    static constexpr size_t kMaxRegistersPerPump = 64;
+    // 连续无应答的心跳数达到该值视为与平台失联（GB28181默认3次）
+    static constexpr uint8_t kMaxMissedKeepalives = 3;
+    // 媒体会话无活动超时时间，活动由ACK、对话内INFO和回放调度刷新
+    static constexpr int kSessionTimeoutSeconds = 300;
+    // 默认RTP端口范围
+    static constexpr int kDefaultRtpPortBase = 50000;
+    static constexpr int kDefaultRtpPortCount = 10000;
+
+    static int64_t NowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool SendRegister(size_t index, int expires) {
+        const std::string& username = identities_.usernames[index];
+
+        // 构建from和contact地址
+        std::string from = "sip:" + username + "@" + realm_;
+        std::string proxy = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
+        std::string contact = "sip:" + username + "@" + localIp_ + ":" + std::to_string(localPort_);
+
+        // 初始化REGISTER
+        int rid = eXosip_register_init(excontext_, from.c_str(), proxy.c_str(), contact.c_str());
+        if (rid < 0) {
+            LOG_ERROR("Failed to initialize REGISTER");
+            return false;
         }
+        identities_.SetRegisterId(index, rid);
 
-        // 解析WWW-Authenticate头
-        const char *authHeader = osip_message_get_header(event->response, "WWW-Authenticate");
+        // 构建REGISTER消息
+        osip_message_t *reg = nullptr;
+        if (eXosip_register_build_initial_register(excontext_, from.c_str(), proxy.c_str(),
+                                                   contact.c_str(), expires, &reg) != 0) {
+            LOG_ERROR("Failed to build REGISTER message");
+            return false;
+        }
 
-        if (!authHeader || strlen(authHeader) == 0) {
-            std::cerr << "[SIP] No WWW-Authenticate header found" << std::endl;
-            return;
+        // 添加Authorization头（第一次注册时可能为空，等待401响应后重新认证）
+        std::string auth = "Digest username=\"" + username + "\",realm=\"" + realm_ +
+                          "\",nonce=\"\",uri=\"sip:" + realm_ + "\",response=\"" +
+                          identities_.passwords[index] + "\",algorithm=MD5";
+        osip_message_set_header(reg, "Authorization", auth.c_str());
+
+        // 发送REGISTER
+        if (eXosip_register_send_register(excontext_, rid, reg) != 0) {
+            LOG_ERROR("Failed to send REGISTER");
+            return false;
         }
 
-        std::cout << "[SIP] WWW-Authenticate: " << authHeader << std::endl;
+        identities_.states[index] = IdentityState::REGISTERING;
+        return true;
+    }
 
-        // 解析认证参数
-        std::string nonce = ParseAuthenticateParam(authHeader, "nonce");
-        std::string realm = ParseAuthenticateParam(authHeader, "realm");
-        std::string algorithm = ParseAuthenticateParam(authHeader, "algorithm");
-        std::string qop = ParseAuthenticateParam(authHeader, "qop");
+    void PumpRegisterScheduler(int64_t now) {
+        registerBatch_.clear();
+        registerScheduler_.Poll(now, registerBatch_, kMaxRegistersPerPump);
 
-        if (nonce.empty()) {
-            std::cerr << "[SIP] No nonce found in WWW-Authenticate" << std::endl;
-            return;
+        for (uint32_t index : registerBatch_) {
+            if (!SendRegister(index, registerScheduler_.GetPolicy().expires)) {
+                registerScheduler_.OnFailure(index, now);
+            }
         }
+    }
 
-        // 使用解析的realm或默认realm
-        if (realm.empty()) {
-            realm = realm_;
+    bool SendKeepalive(size_t index) {
+        if (identities_.states[index] != IdentityState::REGISTERED) {
+            return false;
         }
 
-        // 计算Digest响应
-        std::string uri = "sip:" + realm_;
-        std::string digestResponse = MD5::CalculateDigestResponse(
-            "REGISTER", uri, username_, realm, password_, nonce, qop, "1"
-        );
+        // GB28181使用MESSAGE发送心跳
+        kKeepaliveTemplate.Render(xmlBuffer_, {identities_.sns[index]++, identities_.deviceIds[index]});
+        if (!SendXmlMessage(index, xmlBuffer_)) {
+            return false;
+        }
 
-        // 构建新的REGISTER消息
-        std::string from = "sip:" + username_ + "@" + realm_;
-        std::string proxy = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
-        std::string contact = "sip:" + username_ + "@" + localIp_ + ":" + std::to_string(localPort_);
+        if (!gatewayMode_) {
+            LOG_DEBUG("Keepalive sent");
+        }
+        return true;
+    }
 
-        osip_message_t *reg = nullptr;
-        if (eXosip_register_build_register(excontext_, event->tid, 3600, &reg) != 0) {
-            std::cerr << "[SIP] Failed to build REGISTER for digest auth" << std::endl;
+    void HandleRegisterSuccess(eXosip_event_t *event) {
+        int index = identities_.FindByRegisterId(event->rid);
+        if (index < 0) {
+            LOG_WARN("[SIP] Ignoring registration success for unknown rid " << event->rid);
             return;
         }
 
-        // 构建Authorization头
-        std::stringstream auth;
-        auth << "Digest username=\"" << username_ << "\""
-             << ",realm=\"" << realm << "\""
-             << ",nonce=\"" << nonce << "\""
-             << ",uri=\"" << uri << "\""
-             << ",response=\"" << digestResponse << "\""
-             << ",algorithm=" << algorithm;
+        // 注销（Expires: 0）的200应答，或已注销身份迟到的应答，不能把身份重新置为已注册
+        const char *expires = event->response ? osip_message_get_header(event->response, "Expires") : nullptr;
+        int grantedExpires = expires ? atoi(expires) : 0;
+        if (identities_.states[index] == IdentityState::UNREGISTERED || (expires && grantedExpires <= 0)) {
+            LOG_DEBUG("[SIP] Ignoring registration success for unregistered " << identities_.deviceIds[index]);
+            return;
+        }
 
-        if (!qop.empty()) {
-            auth << ",qop=" << qop
-                 << ",cnonce=\"0a4f113b\""
-                 << ",nc=00000001";
+        identities_.states[index] = IdentityState::REGISTERED;
+
+        // 按平台批准的有效期排期刷新
+        int64_t now = NowMs();
+        registerScheduler_.OnSuccess(index, now, grantedExpires);
+
+        // 心跳对齐到该身份的错峰时隙
+        identities_.missedKeepalives[index] = 0;
+        ScheduleKeepalive(index, NextKeepaliveSlot(index, now));
+
+        if (index == 0) {
+            LOG_INFO("[SIP] Registration successful");
+            if (eventCallback_) {
+                eventCallback_("REGISTER_SUCCESS", "Device registered successfully");
+            }
+        } else if (eventCallback_) {
+            eventCallback_("GATEWAY_REGISTER_SUCCESS", identities_.deviceIds[index]);
         }
+    }
 
-        osip_message_set_header(reg, "Authorization", auth.str().c_str());
+    void HandleRegisterFailure(eXosip_event_t *event) {
+        int index = identities_.FindByRegisterId(event->rid);
+        if (index < 0) {
+            LOG_WARN("[SIP] Ignoring registration failure for unknown rid " << event->rid);
+            return;
+        }
 
-        // 发送REGISTER
-        if (eXosip_register_send_register(excontext_, event->tid, reg) != 0) {
-            std::cerr << "[SIP] Failed to send REGISTER with digest auth" << std::endl;
+        // 已注销的身份不再重试，否则注销请求失败会触发重新注册
+        if (identities_.states[index] == IdentityState::UNREGISTERED) {
             return;
         }
 
-        std::cout << "[SIP] Sent REGISTER with digest authentication" << std::endl;
-    }
+        // 检查是否是401未授权响应
+        int64_t now = NowMs();
+        if (event->response && event->response->status_code == 401 &&
+            registerScheduler_.OnChallenge(index, now)) {
+            LOG_INFO("[SIP] Received 401 Unauthorized, performing digest authentication");
+            Handle401Response(event, index);
+            return;
+        }
 
-    std::string ParseAuthenticateParam(const std::string& authHeader, const std::string& paramName) {
-        std::regex paramRegex(paramName + R"(=([^,\s]+))");
-        std::smatch match;
+        identities_.states[index] = IdentityState::UNREGISTERED;
+        CancelKeepalive(index);
 
-        if (std::regex_search(authHeader, match, paramRegex)) {
-            std::string value = match[1].str();
-            // 移除引号
-            if (value.front() == '"' && value.back() == '"') {
-                value = value.substr(1, value.length() - 2);
-            }
-            return value;
+        // 401超限时OnChallenge已排期重试
+        if (!(event->response && event->response->status_code == 401)) {
+            registerScheduler_.OnFailure(index, now);
         }
 
-        return "";
-    }
-
-    void HandleMessage(eXosip_event_t *event) {
-        if (event->request) {
-            // 解析消息内容
-            const char *body = osip_message_get_body(event->request);
-            if (body) {
-                std::cout << "[SIP] MESSAGE body: " << body << std::endl;
-
-                // 解析MANSCDP命令
-                if (strstr(body, "<CmdType>Catalog</CmdType>")) {
-                    SendCatalogResponse(event->tid);
-                } else if (strstr(body, "<CmdType>DeviceInfo</CmdType>")) {
-                    SendDeviceInfoResponse(event->tid);
-                } else if (strstr(body, "<CmdType>DeviceStatus</CmdType>")) {
-                    SendDeviceStatusResponse(event->tid);
-                } else if (strstr(body, "<CmdType>RecordInfo</CmdType>")) {
-                    std::cout << "[SIP] RecordInfo command received" << std::endl;
-                    SendRecordInfoResponse(event->tid);
-                } else if (strstr(body, "<CmdType>DeviceControl</CmdType>")) {
-                    HandleDeviceControl(event);
-                }
+        if (index == 0) {
+            LOG_WARN("[SIP] Registration failed");
+            if (eventCallback_) {
+                eventCallback_("REGISTER_FAILURE", "Registration failed");
             }
+        } else if (eventCallback_) {
+            eventCallback_("GATEWAY_REGISTER_FAILURE", identities_.deviceIds[index]);
+        }
+    }
 
-            // 发送200 OK响应
-            eXosip_message_build_answer_and_send(excontext_, event->tid, 200);
+    void EnsureTimerService() {
+        if (!timerService_) {
+            ownedTimerService_ = std::make_unique<TimerService>();
+            ownedTimerService_->Start();
+            timerService_ = ownedTimerService_.get();
         }
+
+        // 每个会话在时间轮上各挂一个超时定时器，不再周期性全量扫描
+        mediaSessionManager_->SetTimerService(timerService_, kSessionTimeoutSeconds);
     }
 
-    void HandleInvite(eXosip_event_t *event) {
-        std::cout << "[SIP] Processing INVITE for video streaming" << std::endl;
+    // 定时器线程只投递任务，SIP状态统一在ProcessMessage线程中修改
+    void Post(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(tasksMutex_);
+        tasks_.push_back(std::move(task));
+    }
 
-        // 获取Call-ID
-        std::string callId = "";
-        if (event->request) {
-            const char *callIdStr = osip_message_get_header(event->request, "Call-ID");
-            if (callIdStr) {
-                callId = callIdStr;
+    void RunPostedTasks() {
+        {
+            std::lock_guard<std::mutex> lock(tasksMutex_);
+            if (tasks_.empty()) {
+                return;
             }
+            runningTasks_.swap(tasks_);
         }
 
-        if (callId.empty()) {
-            std::cerr << "[SIP] No Call-ID in INVITE" << std::endl;
-            eXosip_call_send_answer(excontext_, event->tid, 400, nullptr);
-            return;
+        for (auto& task : runningTasks_) {
+            task();
         }
+        runningTasks_.clear();
+    }
 
-        std::cout << "[SIP] Call-ID: " << callId << std::endl;
+    // 注册定时器始终对齐到调度器最近的到期时间
+    void ArmRegisterTimer() {
+        if (!timerService_) {
+            return;
+        }
 
-        // 解析SDP offer
-        const char *sdpBody = osip_message_get_body(event->request);
-        if (!sdpBody) {
-            std::cerr << "[SIP] No SDP body in INVITE" << std::endl;
-            eXosip_call_send_answer(excontext_, event->tid, 400, nullptr);
+        int64_t due = registerScheduler_.NextDueMs();
+        if (due == registerTimerDueMs_) {
             return;
         }
 
-        std::cout << "[SIP] SDP Offer:\n" << sdpBody << std::endl;
+        timerService_->Cancel(registerTimer_);
+        registerTimer_ = TimerService::kInvalidTimer;
+        registerTimerDueMs_ = due;
+        if (due < 0) {
+            return;
+        }
 
-        // 解析SDP获取远程信息
-        std::string remoteIp;
-        int remoteVideoPort = 0;
-        int remoteAudioPort = 0;
-        std::string videoCodec = "H264";
-        std::string audioCodec = "PCMA";
+        registerTimer_ = timerService_->ScheduleOnce(due - NowMs(), [this]() {
+            Post([this]() {
+                registerTimer_ = TimerService::kInvalidTimer;
+                registerTimerDueMs_ = -1;
+                PumpRegisterScheduler(NowMs());
+            });
+        });
+    }
 
-        ParseSdpOffer(sdpBody, remoteIp, remoteVideoPort, remoteAudioPort, videoCodec, audioCodec);
+    void ScheduleKeepalive(size_t index, int64_t dueMs) {
+        CancelKeepalive(index);
 
-        std::cout << "[SIP] Remote - IP: " << remoteIp
-                  << ", VideoPort: " << remoteVideoPort
-                  << ", AudioPort: " << remoteAudioPort
-                  << ", VideoCodec: " << videoCodec
-                  << ", AudioCodec: " << audioCodec << std::endl;
+        identities_.nextKeepaliveMs[index] = dueMs;
+        identities_.keepaliveTimers[index] = timerService_->ScheduleOnce(dueMs - NowMs(), [this, index, dueMs]() {
+            Post([this, index, dueMs]() { OnKeepaliveTimer(index, dueMs); });
+        });
+    }
 
-        // 分配本地RTP端口
-        int localVideoPort = AllocateRtpPort();
-        int localAudioPort = localVideoPort + 2;
+    void CancelKeepalive(size_t index) {
+        if (timerService_) {
+            timerService_->Cancel(identities_.keepaliveTimers[index]);
+        }
+        identities_.keepaliveTimers[index] = TimerService::kInvalidTimer;
+        identities_.nextKeepaliveMs[index] = 0;
+    }
 
-        std::cout << "[SIP] Local - VideoPort: " << localVideoPort
-                  << ", AudioPort: " << localAudioPort << std::endl;
+    void OnKeepaliveTimer(size_t index, int64_t dueMs) {
+        // 定时器触发后、任务执行前可能已被重新排期或取消
+        if (identities_.nextKeepaliveMs[index] != dueMs) {
+            return;
+        }
+        identities_.keepaliveTimers[index] = TimerService::kInvalidTimer;
+        identities_.nextKeepaliveMs[index] = 0;
 
-        // 创建媒体会话
-        MediaSessionInfo *session = mediaSessionManager_->CreateSession(
-            callId, deviceId_, remoteIp, videoCodec, audioCodec
-        );
+        if (identities_.states[index] != IdentityState::REGISTERED) {
+            return;
+        }
 
-        if (!session) {
-            std::cerr << "[SIP] Failed to create media session" << std::endl;
-            eXosip_call_send_answer(excontext_, event->tid, 500, nullptr);
+        if (identities_.missedKeepalives[index] >= kMaxMissedKeepalives) {
+            HandleKeepaliveTimeout(index);
             return;
         }
 
-        // 设置会话端口
-        mediaSessionManager_->SetLocalPorts(callId, localVideoPort, localAudioPort);
-        mediaSessionManager_->SetRemotePorts(callId, remoteVideoPort, remoteAudioPort);
+        if (SendKeepalive(index)) {
+            identities_.missedKeepalives[index]++;
+        }
 
-        // 生成SDP应答
-        SdpNegotiator sdpNegotiator;
-        std::string sdpAnswer = sdpNegotiator.CreateSdpAnswer(
-            localIp_, localVideoPort,
-            (videoCodec == "H264") ? SdpMediaFormat::H264 :
-            (videoCodec == "H265") ? SdpMediaFormat::H265 : SdpMediaFormat::PS,
-            (audioCodec == "PCMA") ? SdpMediaFormat::PCMA : SdpMediaFormat::PCMU
-        );
+        ScheduleKeepalive(index, NextKeepaliveSlot(index, NowMs()));
+    }
 
-        std::cout << "[SIP] SDP Answer:\n" << sdpAnswer << std::endl;
+    void HandleKeepaliveTimeout(size_t index) {
+        LOG_INFO("[SIP] " << static_cast<int>(kMaxMissedKeepalives)
+                 << " keepalives unanswered, re-registering " << identities_.deviceIds[index]);
 
-        // 发送200 OK响应
-        osip_message_t *answer = nullptr;
-        if (eXosip_call_build_answer2(excontext_, event->tid, 200, &answer) != 0) {
-            std::cerr << "[SIP] Failed to build 200 OK answer" << std::endl;
+        identities_.states[index] = IdentityState::UNREGISTERED;
+        identities_.missedKeepalives[index] = 0;
+        registerScheduler_.Schedule(index, NowMs());
+
+        if (index == 0) {
+            if (eventCallback_) {
+                eventCallback_("KEEPALIVE_TIMEOUT", "Server not responding to keepalives");
+            }
+        } else if (eventCallback_) {
+            eventCallback_("GATEWAY_KEEPALIVE_TIMEOUT", identities_.deviceIds[index]);
+        }
+    }
+
+    void CancelAllTimers() {
+        if (!timerService_) {
+            return;
+        }
+
+        for (size_t i = 0; i < identities_.Size(); i++) {
+            CancelKeepalive(i);
+        }
+        for (auto& pair : responseStreams_) {
+            timerService_->Cancel(pair.second.timer);
+        }
+        responseStreams_.clear();
+        timerService_->Cancel(registerTimer_);
+        registerTimer_ = TimerService::kInvalidTimer;
+        mediaSessionManager_->SetTimerService(nullptr);
+
+        if (ownedTimerService_) {
+            ownedTimerService_->Stop();
+        }
+    }
+
+    // 每个身份在心跳周期内占一个固定时隙，N个身份均匀分布在整个周期上
+    int64_t NextKeepaliveSlot(size_t index, int64_t now) const {
+        int64_t period = heartbeatIntervalMs_;
+        int64_t slot = keepaliveEpochMs_ +
+                       static_cast<int64_t>(index) * period / static_cast<int64_t>(identities_.Size());
+        if (now < slot) {
+            return slot;
+        }
+        return slot + ((now - slot) / period + 1) * period;
+    }
+
+    int ResolveIdentity(osip_message_t *request, const char *header = "To") const {
+        // 从To头（收到的请求）或From头（本端发出的请求）的user部分定位设备身份，找不到时归属主身份
+        if (!request || identities_.Size() <= 1) {
+            return 0;
+        }
+
+        const char *value = osip_message_get_header(request, header);
+        if (!value) {
+            return 0;
+        }
+
+        const char *user = strstr(value, "sip:");
+        if (!user) {
+            return 0;
+        }
+        user += 4;
+
+        size_t len = strcspn(user, "@>;:");
+        int index = identities_.Find(std::string(user, len));
+        return (index >= 0) ? index : 0;
+    }
+
+    void Handle401Response(eXosip_event_t *event, size_t index) {
+        if (!event->response) {
+            return;
+        }
+
+        const std::string& username = identities_.usernames[index];
+        int rid = identities_.registerIds[index];
+
+        // 解析WWW-Authenticate头
+        const char *authHeader = osip_message_get_header(event->response, "WWW-Authenticate");
+
+        if (!authHeader || strlen(authHeader) == 0) {
+            LOG_ERROR("[SIP] No WWW-Authenticate header found");
+            return;
+        }
+
+        LOG_DEBUG("[SIP] WWW-Authenticate: " << authHeader);
+
+        // 解析认证参数
+        std::string nonce = ParseAuthenticateParam(authHeader, "nonce");
+        std::string realm = ParseAuthenticateParam(authHeader, "realm");
+        std::string algorithm = ParseAuthenticateParam(authHeader, "algorithm");
+        std::string qop = ParseAuthenticateParam(authHeader, "qop");
+
+        if (nonce.empty()) {
+            LOG_ERROR("[SIP] No nonce found in WWW-Authenticate");
+            return;
+        }
+
+        // 使用解析的realm或默认realm
+        if (realm.empty()) {
+            realm = realm_;
+        }
+
+        // 计算Digest响应
+        std::string uri = "sip:" + realm_;
+        std::string digestResponse = MD5::CalculateDigestResponse(
+            "REGISTER", uri, username, realm, identities_.passwords[index], nonce, qop, "1"
+        );
+
+        osip_message_t *reg = nullptr;
+        if (eXosip_register_build_register(excontext_, rid, registerScheduler_.GetPolicy().expires, &reg) != 0) {
+            LOG_ERROR("[SIP] Failed to build REGISTER for digest auth");
+            return;
+        }
+
+        // 构建Authorization头
+        std::stringstream auth;
+        auth << "Digest username=\"" << username << "\""
+             << ",realm=\"" << realm << "\""
+             << ",nonce=\"" << nonce << "\""
+             << ",uri=\"" << uri << "\""
+             << ",response=\"" << digestResponse << "\""
+             << ",algorithm=" << algorithm;
+
+        if (!qop.empty()) {
+            auth << ",qop=" << qop
+                 << ",cnonce=\"0a4f113b\""
+                 << ",nc=00000001";
+        }
+
+        osip_message_set_header(reg, "Authorization", auth.str().c_str());
+
+        // 发送REGISTER
+        if (eXosip_register_send_register(excontext_, rid, reg) != 0) {
+            LOG_ERROR("[SIP] Failed to send REGISTER with digest auth");
+            return;
+        }
+
+        LOG_INFO("[SIP] Sent REGISTER with digest authentication");
+    }
+
+    std::string ParseAuthenticateParam(const std::string& authHeader, const std::string& paramName) {
+        std::regex paramRegex(paramName + R"(=([^,\s]+))");
+        std::smatch match;
+
+        if (std::regex_search(authHeader, match, paramRegex)) {
+            std::string value = match[1].str();
+            // 移除引号
+            if (value.front() == '"' && value.back() == '"') {
+                value = value.substr(1, value.length() - 2);
+            }
+            return value;
+        }
+
+        return "";
+    }
+
+    void RegisterManscdpHandlers() {
+        manscdpDispatcher_.Register("Catalog", [this](const ManscdpMessage& msg, int tid, size_t index) {
+            return SubmitQuery(MakeQueryJob(QueryKind::CATALOG, msg, index), tid);
+        });
+        manscdpDispatcher_.Register("DeviceInfo", [this](const ManscdpMessage& msg, int tid, size_t index) {
+            return SendDeviceInfoResponse(tid, index, msg.sn);
+        });
+        manscdpDispatcher_.Register("DeviceStatus", [this](const ManscdpMessage& msg, int tid, size_t index) {
+            return SendDeviceStatusResponse(tid, index, msg.sn);
+        });
+        manscdpDispatcher_.Register("RecordInfo", [this](const ManscdpMessage& msg, int tid, size_t index) {
+            return SubmitQuery(MakeQueryJob(QueryKind::RECORD_INFO, msg, index), tid);
+        });
+        manscdpDispatcher_.Register("DeviceControl", [this](const ManscdpMessage& msg, int tid, size_t index) {
+            return HandleDeviceControl(msg, tid, index);
+        });
+    }
+
+    void HandleMessage(eXosip_event_t *event, size_t index) {
+        if (!event->request) {
+            return;
+        }
+
+        // 解析消息内容
+        const char *body = osip_message_get_body(event->request);
+        if (!body) {
+            eXosip_message_build_answer_and_send(excontext_, event->tid, 200);
+            return;
+        }
+
+        LOG_DEBUG("[SIP] MESSAGE body: " << body);
+
+        // 解析MANSCDP命令
+        ManscdpMessage msg;
+        if (!ParseManscdpMessage(body, msg)) {
+            eXosip_message_build_answer_and_send(excontext_, event->tid, 400);
+            return;
+        }
+
+        bool handled = false;
+        bool answered = manscdpDispatcher_.Dispatch(msg, event->tid, index, handled);
+        if (!handled) {
+            LOG_WARN("[SIP] Unsupported MANSCDP command: " << msg.cmdType);
+        }
+
+        // 处理函数未自行应答时发送200 OK响应
+        if (!answered) {
+            eXosip_message_build_answer_and_send(excontext_, event->tid, 200);
+        }
+    }
+
+    void HandleInvite(eXosip_event_t *event, size_t index) {
+        LOG_INFO("[SIP] Processing INVITE for video streaming");
+
+        // 获取Call-ID
+        std::string callId = "";
+        if (event->request) {
+            const char *callIdStr = osip_message_get_header(event->request, "Call-ID");
+            if (callIdStr) {
+                callId = callIdStr;
+            }
+        }
+
+        if (callId.empty()) {
+            LOG_ERROR("[SIP] No Call-ID in INVITE");
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, 0, 400, static_cast<uint32_t>(event->tid));
+            eXosip_call_send_answer(excontext_, event->tid, 400, nullptr);
+            return;
+        }
+
+        uint64_t sessionHash = EventLog::HashSession(callId);
+
+        LOG_DEBUG("[SIP] Call-ID: " << callId);
+
+        // 解析SDP offer
+        const char *sdpBody = osip_message_get_body(event->request);
+        if (!sdpBody) {
+            LOG_ERROR("[SIP] No SDP body in INVITE");
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 400,
+                                        static_cast<uint32_t>(event->tid));
+            eXosip_call_send_answer(excontext_, event->tid, 400, nullptr);
+            return;
+        }
+
+        LOG_DEBUG("[SIP] SDP Offer:\n" << sdpBody);
+
+        // 解析SDP获取远程信息
+        SdpDescription offer;
+        const SdpMedia *videoMedia = nullptr;
+        if (ParseSdp(sdpBody, offer)) {
+            videoMedia = offer.FindMedia("video");
+        }
+        if (!videoMedia) {
+            LOG_ERROR("[SIP] No video media in SDP offer");
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 488,
+                                        static_cast<uint32_t>(event->tid));
+            eXosip_call_send_answer(excontext_, event->tid, 488, nullptr);
+            return;
+        }
+        const SdpMedia *audioMedia = offer.FindMedia("audio");
+
+        // s=Playback/Download为历史媒体，按u=通道和t=时间范围定位录像
+        bool download = (offer.sessionName == "Download");
+        bool history = download || offer.sessionName == "Playback";
+        std::string channelId = identities_.deviceIds[index];
+        if (!offer.uri.empty()) {
+            channelId = std::string(offer.uri.substr(0, offer.uri.find(':')));
+        }
+
+        std::vector<PlaybackSegment> segments;
+        uint64_t fileSize = 0;
+        uint64_t startMs = 0;
+        uint64_t endMs = 0;
+        if (history && !FindPlaybackRecords(offer, channelId, segments, fileSize, startMs, endMs)) {
+            LOG_ERROR("[SIP] No recording for " << offer.sessionName << " of " << channelId);
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 404,
+                                        static_cast<uint32_t>(event->tid));
+            eXosip_call_send_answer(excontext_, event->tid, 404, nullptr);
+            return;
+        }
+
+        std::string remoteIp(offer.GetAddress(*videoMedia));
+        int remoteVideoPort = videoMedia->port;
+        int remoteAudioPort = audioMedia ? audioMedia->port : 0;
+        int videoPayloadType = -1;
+        int audioPayloadType = -1;
+        std::string videoCodec = SelectCodec(videoMedia, true, videoPayloadType);
+        std::string audioCodec = SelectCodec(audioMedia, false, audioPayloadType);
+
+        EventLog::Instance().Record(EventCode::SIP_INVITE_RECEIVED, sessionHash,
+                                    static_cast<uint16_t>(remoteVideoPort), static_cast<uint32_t>(event->tid));
+
+        LOG_DEBUG("[SIP] Remote - IP: " << remoteIp
+                  << ", VideoPort: " << remoteVideoPort
+                  << ", AudioPort: " << remoteAudioPort
+                  << ", VideoCodec: " << videoCodec
+                  << ", AudioCodec: " << audioCodec);
+
+        // 分配本地RTP端口，会话终止时由MediaSessionManager归还
+        // 启用套接字池时直接取一组已绑定的套接字，否则只分配端口
+        MediaSockets sockets;
+        int localVideoPort = -1;
+        if (socketPool_) {
+            sockets = socketPool_->Claim();
+            localVideoPort = sockets.basePort;
+        } else {
+            localVideoPort = portAllocator_->Allocate();
+        }
+        if (localVideoPort < 0) {
+            LOG_ERROR("[SIP] No free RTP port for INVITE");
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 503,
+                                        static_cast<uint32_t>(event->tid));
+            eXosip_call_send_answer(excontext_, event->tid, 503, nullptr);
+            return;
+        }
+        int localAudioPort = localVideoPort + 2;
+
+        LOG_DEBUG("[SIP] Local - VideoPort: " << localVideoPort
+                  << ", AudioPort: " << localAudioPort);
+
+        // 创建媒体会话
+        SessionHandle session = mediaSessionManager_->CreateSession(
+            callId, identities_.deviceIds[index], remoteIp, videoCodec, audioCodec, history
+        );
+
+        if (!session.IsValid()) {
+            LOG_ERROR("[SIP] Failed to create media session");
+            if (socketPool_) {
+                socketPool_->Release(std::move(sockets));
+            } else {
+                portAllocator_->Release(localVideoPort);
+            }
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 500,
+                                        static_cast<uint32_t>(event->tid));
+            eXosip_call_send_answer(excontext_, event->tid, 500, nullptr);
+            return;
+        }
+
+        // 设置会话端口
+        mediaSessionManager_->SetLocalPorts(callId, localVideoPort, localAudioPort);
+        if (sockets.IsValid()) {
+            mediaSessionManager_->AttachSockets(callId, std::move(sockets));
+        }
+        mediaSessionManager_->SetRemotePorts(callId, remoteVideoPort, remoteAudioPort);
+
+        // 沿用平台在y=中指定的SSRC，平台无需重新识别码流；该值不可用时应答回显本机分配的SSRC
+        uint32_t offerSsrc = 0;
+        if (offer.GetSsrc(offerSsrc)) {
+            mediaSessionManager_->SetSsrc(callId, offerSsrc, offerSsrc);
+        }
+
+        // 按f=请求的分辨率、帧率和码率选择主/子码流
+        SdpMediaParams requested;
+        bool hasMediaParams = ParseMediaParams(offer.format, requested);
+        SdpMediaParams negotiated;
+        size_t videoStream = SdpNegotiator::NegotiateVideo(requested, videoMedia->streamNumber,
+                                                           videoStreams_, negotiated);
+        std::string mediaParams;
+        if (hasMediaParams || !videoStreams_.empty()) {
+            mediaParams = FormatMediaParams(negotiated);
+        }
+        mediaSessionManager_->SetVideoStream(callId, static_cast<int>(videoStream), mediaParams);
+
+        if (history && !playbackManager_->StartPlayback(callId, channelId, startMs, endMs, segments,
+                                                        download, videoMedia->downloadSpeed)) {
+            LOG_ERROR("[SIP] Failed to start " << offer.sessionName << " of " << segments.front().filePath);
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 500,
+                                        static_cast<uint32_t>(event->tid));
+            mediaSessionManager_->TerminateSession(callId);
+            eXosip_call_send_answer(excontext_, event->tid, 500, nullptr);
+            return;
+        }
+
+        MediaSessionInfo sessionInfo;
+        mediaSessionManager_->GetSession(session, sessionInfo);
+        char ssrcText[16];
+        snprintf(ssrcText, sizeof(ssrcText), "%010u", sessionInfo.videoSsrc);
+
+        // 生成SDP应答，回显编号、SSRC和协商后的媒体参数
+        SdpAnswerOptions answerOptions;
+        answerOptions.localIp = localIp_;
+        answerOptions.rtpPort = localVideoPort;
+        if (!offer.sessionName.empty()) {
+            answerOptions.sessionName = std::string(offer.sessionName);
+        }
+        answerOptions.videoFormat = (videoCodec == "H264") ? SdpMediaFormat::H264 :
+                                    (videoCodec == "H265") ? SdpMediaFormat::H265 : SdpMediaFormat::PS;
+        answerOptions.videoPayloadType = videoPayloadType;
+        answerOptions.audioFormat = (audioCodec == "PCMA") ? SdpMediaFormat::PCMA : SdpMediaFormat::PCMU;
+        answerOptions.audioPayloadType = audioPayloadType;
+        answerOptions.ssrc = ssrcText;
+        answerOptions.mediaParams = mediaParams;
+        if (download) {
+            answerOptions.fileSize = fileSize;
+        }
+
+        SdpNegotiator sdpNegotiator;
+        std::string sdpAnswer = sdpNegotiator.CreateSdpAnswer(answerOptions);
+
+        LOG_DEBUG("[SIP] SDP Answer:\n" << sdpAnswer);
+
+        // 发送200 OK响应
+        osip_message_t *answer = nullptr;
+        if (eXosip_call_build_answer2(excontext_, event->tid, 200, &answer) != 0) {
+            LOG_ERROR("[SIP] Failed to build 200 OK answer");
+            EventLog::Instance().Record(EventCode::SIP_INVITE_REJECTED, sessionHash, 500,
+                                        static_cast<uint32_t>(event->tid));
             mediaSessionManager_->TerminateSession(callId);
             eXosip_call_send_answer(excontext_, event->tid, 500, nullptr);
             return;
@@ -575,16 +1331,19 @@ private:
 
         // 发送响应
         if (eXosip_call_send_answer(excontext_, event->tid, 200, answer) != 0) {
-            std::cerr << "[SIP] Failed to send 200 OK answer" << std::endl;
+            LOG_ERROR("[SIP] Failed to send 200 OK answer");
             mediaSessionManager_->TerminateSession(callId);
             osip_message_free(answer);
             return;
         }
 
+        EventLog::Instance().Record(EventCode::SIP_INVITE_ANSWERED, sessionHash,
+                                    static_cast<uint16_t>(localVideoPort), static_cast<uint32_t>(event->tid));
+
         // 更新会话状态
         mediaSessionManager_->UpdateSessionState(callId, SessionState::ESTABLISHED);
 
-        std::cout << "[SIP] Sent 200 OK with SDP answer" << std::endl;
+        LOG_INFO("[SIP] Sent 200 OK with SDP answer");
 
         if (eventCallback_) {
             eventCallback_("INVITE_ACCEPTED", "Video streaming session established");
@@ -596,7 +1355,7 @@ private:
     }
 
     void HandleAck(eXosip_event_t *event) {
-        std::cout << "[SIP] ACK received, session confirmed" << std::endl;
+        LOG_INFO("[SIP] ACK received, session confirmed");
 
         // 获取Call-ID
         std::string callId = "";
@@ -608,9 +1367,19 @@ private:
         }
 
         if (!callId.empty()) {
-            std::cout << "[SIP] ACK for Call-ID: " << callId << std::endl;
-            // 更新会话活动时间
+            LOG_DEBUG("[SIP] ACK for Call-ID: " << callId);
+            EventLog::Instance().Record(EventCode::SIP_ACK_RECEIVED, EventLog::HashSession(callId),
+                                        0, static_cast<uint32_t>(event->tid));
+            // 更新会话活动时间，记录已确认的对话供超时时发BYE
             mediaSessionManager_->UpdateActivity(callId);
+            if (event->did > 0) {
+                dialogs_[callId] = event->did;
+            }
+
+            // 回放和下载会话在ACK后开始发送
+            if (playbackScheduler_ && playbackManager_ && playbackManager_->HasSession(callId)) {
+                playbackScheduler_->Add(callId);
+            }
 
             if (eventCallback_) {
                 eventCallback_("ACK_RECEIVED", "Video streaming started");
@@ -623,7 +1392,7 @@ private:
     }
 
     void HandleBye(eXosip_event_t *event) {
-        std::cout << "[SIP] Processing BYE to stop video streaming" << std::endl;
+        LOG_INFO("[SIP] Processing BYE to stop video streaming");
 
         // 获取Call-ID
         std::string callId = "";
@@ -635,9 +1404,12 @@ private:
         }
 
         if (!callId.empty()) {
-            std::cout << "[SIP] BYE for Call-ID: " << callId << std::endl;
+            LOG_DEBUG("[SIP] BYE for Call-ID: " << callId);
+            EventLog::Instance().Record(EventCode::SIP_BYE_RECEIVED, EventLog::HashSession(callId),
+                                        0, static_cast<uint32_t>(event->tid));
 
             // 终止媒体会话
+            dialogs_.erase(callId);
             mediaSessionManager_->TerminateSession(callId);
 
             if (eventCallback_) {
@@ -653,296 +1425,558 @@ private:
         eXosip_call_build_answer_and_send(excontext_, event->tid, 200);
     }
 
-    void HandleDeviceControl(eXosip_event_t *event) {
+    // 对话内请求：回放和下载会话的INFO携带MANSRTSP控制命令
+    void HandleCallMessage(eXosip_event_t *event) {
         if (!event->request) {
             return;
         }
 
-        const char *body = osip_message_get_body(event->request);
-        if (!body) {
-            eXosip_message_build_answer_and_send(excontext_, event->tid, 400);
-            return;
+        std::string callId;
+        const char *callIdStr = osip_message_get_header(event->request, "Call-ID");
+        if (callIdStr) {
+            callId = callIdStr;
         }
 
-        // 解析PTZ命令
-        const char *ptzCmd = strstr(body, "<PTZCmd>");
-        if (ptzCmd) {
-            char cmdStr[256] = {0};
-            const char *start = strstr(ptzCmd, ">");
-            if (start) {
-                start++;
-                const char *end = strstr(start, "<");
-                if (end) {
-                    int len = end - start;
-                    if (len < sizeof(cmdStr)) {
-                        strncpy(cmdStr, start, len);
-                        cmdStr[len] = '\0';
-                        std::cout << "[SIP] PTZ Command: " << cmdStr << std::endl;
-
-                        int command = 0;
-                        int speed = 128;
-                        int presetId = 0;
-
-                        if (strstr(cmdStr, "Command=1")) command = 1;
-                        else if (strstr(cmdStr, "Command=2")) command = 2;
-                        else if (strstr(cmdStr, "Command=3")) command = 3;
-                        else if (strstr(cmdStr, "Command=4")) command = 4;
-                        else if (strstr(cmdStr, "Command=5")) command = 5;
-                        else if (strstr(cmdStr, "Command=6")) command = 6;
-                        else if (strstr(cmdStr, "Command=7")) command = 7;
-                        else if (strstr(cmdStr, "Command=8")) command = 8;
-                        else if (strstr(cmdStr, "Command=11")) command = 11;
-                        else if (strstr(cmdStr, "Command=12")) command = 12;
-                        else if (strstr(cmdStr, "Command=21")) command = 21;
-                        else if (strstr(cmdStr, "Command=22")) command = 22;
-                        else if (strstr(cmdStr, "Command=23")) command = 23;
-
-                        const char *speedStr = strstr(cmdStr, "Speed=");
-                        if (speedStr) {
-                            speed = atoi(speedStr + 6);
-                        }
-
-                        const char *presetStr = strstr(cmdStr, "PresetID=");
-                        if (presetStr) {
-                            presetId = atoi(presetStr + 9);
-                        }
-
-                        bool success = false;
-                        if (command >= 1 && command <= 8) {
-                            success = PtzControl(deviceId_, command, speed);
-                        } else if (command == 11 || command == 12) {
-                            int zoomCmd = (command == 11) ? 1 : 2;
-                            success = PtzZoom(deviceId_, zoomCmd, speed);
-                        } else if (command >= 21 && command <= 23) {
-                            int presetCmd = (command == 21) ? 1 : ((command == 22) ? 2 : 0);
-                            success = PtzPreset(deviceId_, presetCmd, presetId);
-                        }
-
-                        if (success) {
-                            SendDeviceControlResponse(event->tid, "OK");
-                        } else {
-                            SendDeviceControlResponse(event->tid, "ERROR");
-                        }
-                        return;
+        int status = HandleMansrtsp(event->request, callId);
+        EventLog::Instance().Record(EventCode::SIP_INFO_RECEIVED, EventLog::HashSession(callId),
+                                    static_cast<uint32_t>(status), static_cast<uint32_t>(event->tid));
+        eXosip_call_build_answer_and_send(excontext_, event->tid, status);
+    }
+
+    // 执行MANSRTSP命令，返回SIP应答状态码
+    int HandleMansrtsp(osip_message_t *request, const std::string& callId) {
+        const char *method = request->sip_method;
+        if (!method || strcasecmp(method, "INFO") != 0) {
+            LOG_WARN("[SIP] Unsupported in-dialog request: " << (method ? method : ""));
+            return 405;
+        }
+
+        const char *contentType = request->content_type;
+        if (!contentType || strcasecmp(contentType, "Application/MANSRTSP") != 0) {
+            LOG_WARN("[SIP] Unsupported INFO content type: " << (contentType ? contentType : ""));
+            return 415;
+        }
+
+        const char *body = osip_message_get_body(request);
+        MansrtspRequest rtsp;
+        if (!body || !ParseMansrtsp(body, rtsp)) {
+            LOG_WARN("[SIP] Invalid MANSRTSP request for Call-ID: " << callId);
+            return 400;
+        }
+
+        if (!playbackManager_ || !playbackManager_->HasSession(callId)) {
+            LOG_WARN("[SIP] MANSRTSP for unknown playback session: " << callId);
+            return 481;
+        }
+        mediaSessionManager_->UpdateActivity(callId);
+
+        LOG_INFO("[SIP] MANSRTSP " << rtsp.methodName << " CSeq=" << rtsp.cseq
+                 << " for Call-ID: " << callId);
+
+        bool ok = true;
+        switch (rtsp.method) {
+            case MansrtspMethod::PLAY:
+                // 先拖动再设置倍速，两者都在下一帧生效。不带Scale时沿用当前倍速，
+                // 暂停中的会话（包括只带Range拖动的）恢复到暂停前的倍速
+                if (rtsp.hasRange && !rtsp.rangeNow) {
+                    ok = playbackManager_->SeekPlaybackOffset(callId, rtsp.rangeStartMs);
+                }
+                if (ok && rtsp.hasScale) {
+                    PlaybackControl control = {};
+                    control.speed = rtsp.scale;
+                    if (rtsp.scale == 1.0) {
+                        control.mode = PlaybackMode::NORMAL;
+                    } else if (rtsp.scale > 0) {
+                        control.mode = PlaybackMode::FORWARD;
+                    } else {
+                        control.mode = PlaybackMode::BACKWARD;
                     }
+                    ok = playbackManager_->ControlPlayback(callId, control);
+                } else if (ok) {
+                    ok = playbackManager_->ResumePlayback(callId);
+                }
+                break;
+
+            case MansrtspMethod::PAUSE:
+                ok = playbackManager_->PausePlayback(callId);
+                break;
+
+            case MansrtspMethod::TEARDOWN:
+                // 会话终止回调中移出调度并停止回放
+                mediaSessionManager_->TerminateSession(callId);
+                return 200;
+
+            default:
+                LOG_WARN("[SIP] Unsupported MANSRTSP method: " << rtsp.methodName);
+                return 501;
+        }
+
+        if (!ok) {
+            return 400;
+        }
+
+        // 丢弃按旧参数预读的帧，新的控制参数在一个帧间隔内生效
+        if (playbackScheduler_) {
+            playbackScheduler_->Wake(callId);
+        }
+        return 200;
+    }
+
+    bool HandleDeviceControl(const ManscdpMessage& msg, int tid, size_t index) {
+        // 解析PTZ命令
+        std::string_view ptzCmd = FindManscdpElement(msg.body, "PTZCmd");
+        if (ptzCmd.empty()) {
+            // TeleBoot、RecordCmd、GuardCmd、AlarmCmd等没有实现的控制仍以200应答，结果为ERROR
+            LOG_WARN("[SIP] Unsupported DeviceControl without PTZCmd, SN=" << msg.sn);
+            return SendDeviceControlResponse(tid, index, msg.sn, "ERROR");
+        }
+
+        PtzCommand command;
+        if (!ParsePtzCommand(ptzCmd, command)) {
+            LOG_WARN("[SIP] Invalid PTZ command: " << ptzCmd);
+            return SendDeviceControlResponse(tid, index, msg.sn, "ERROR");
+        }
+
+        // 控制目标为消息中的DeviceID（通道），缺省为本设备
+        std::string channelId = msg.deviceId.empty() ? identities_.deviceIds[index] : std::string(msg.deviceId);
+
+        bool success = false;
+        switch (command.type) {
+            case PtzCommand::Type::STOP:
+                success = PtzControl(channelId, 0, 0) && PtzZoom(channelId, 0, 0);
+                break;
+
+            case PtzCommand::Type::MOVE:
+                success = true;
+                if (command.direction != 0) {
+                    int speed = std::max(command.panSpeed, command.tiltSpeed);
+                    success = PtzControl(channelId, command.direction, speed);
                 }
+                if (command.zoom != 0) {
+                    // 变焦速度为4位，扩展到与方向速度相同的0-255范围
+                    success = PtzZoom(channelId, command.zoom, command.zoomSpeed * 17) && success;
+                }
+                break;
+
+            case PtzCommand::Type::PRESET_SET:
+                success = PtzPreset(channelId, 2, command.presetId);
+                break;
+
+            case PtzCommand::Type::PRESET_CALL:
+                success = PtzPreset(channelId, 1, command.presetId);
+                break;
+
+            case PtzCommand::Type::PRESET_DELETE:
+                success = PtzPreset(channelId, 0, command.presetId);
+                break;
+
+            default:
+                LOG_WARN("[SIP] Unsupported PTZ instruction: 0x" << std::hex
+                         << static_cast<int>(command.instruction) << std::dec);
+                break;
+        }
+
+        return SendDeviceControlResponse(tid, index, msg.sn, success ? "OK" : "ERROR");
+    }
+
+    // 按u=通道和t=时间范围查找回放/下载的录像文件，t=为Unix秒，兼容NTP秒
+    // 范围跨多个文件时按时间顺序全部返回，由回放会话依次衔接；fileSize为各文件大小之和
+    bool FindPlaybackRecords(const SdpDescription& offer, const std::string& channelId,
+                             std::vector<PlaybackSegment>& segments, uint64_t& fileSize,
+                             uint64_t& startMs, uint64_t& endMs) {
+        if (!recordManager_ || !playbackManager_) {
+            return false;
+        }
+
+        const uint64_t kNtpEpochOffset = 2208988800ULL;
+        uint64_t start = offer.startTime;
+        uint64_t stop = offer.stopTime;
+        if (start >= kNtpEpochOffset) start -= kNtpEpochOffset;
+        if (stop >= kNtpEpochOffset) stop -= kNtpEpochOffset;
+        if (start == 0 || stop <= start) {
+            return false;
+        }
+
+        // 时间范围只换算一次，录像查询和回放会话共用
+        startMs = start * 1000;
+        endMs = stop * 1000;
+
+        RecordQueryCondition condition;
+        condition.channelId = channelId;
+        condition.startTime = PlaybackManager::FormatMsToTime(startMs);
+        condition.endTime = PlaybackManager::FormatMsToTime(endMs);
+        condition.type = RecordType::ALL;
+        condition.maxResults = 0;
+        condition.order = "asc";
+
+        std::vector<RecordInfo> records = recordManager_->QueryRecords(condition);
+        if (records.empty()) {
+            return false;
+        }
+
+        segments.reserve(records.size());
+        for (const RecordInfo& record : records) {
+            segments.push_back({record.filePath, PlaybackManager::ParseTimeToMs(record.startTime),
+                                PlaybackManager::ParseTimeToMs(record.endTime)});
+            fileSize += record.fileSize;
+        }
+        return true;
+    }
+
+    // 按offer中m=行的顺序选第一个应答能支持的编码，没有可用编码时视频用H264、音频用PCMA
+    static std::string SelectCodec(const SdpMedia *media, bool video, int& payloadType) {
+        payloadType = -1;
+        for (size_t i = 0; media && i < media->payloadCount; i++) {
+            const SdpPayload& payload = media->payloads[i];
+            SdpMediaFormat format;
+            if (payload.encoding.empty()) {
+                // 静态负载类型可以省略rtpmap
+                if (video || (payload.type != 0 && payload.type != 8)) {
+                    continue;
+                }
+                format = (payload.type == 0) ? SdpMediaFormat::PCMU : SdpMediaFormat::PCMA;
+            } else if (!SdpNegotiator::GetFormatByName(payload.encoding, format)) {
+                continue;
+            }
+
+            const char *codec = nullptr;
+            switch (format) {
+                case SdpMediaFormat::H264: codec = video ? "H264" : nullptr; break;
+                case SdpMediaFormat::H265: codec = video ? "H265" : nullptr; break;
+                case SdpMediaFormat::PS:   codec = video ? "PS" : nullptr; break;
+                case SdpMediaFormat::PCMA: codec = video ? nullptr : "PCMA"; break;
+                case SdpMediaFormat::PCMU: codec = video ? nullptr : "PCMU"; break;
+                default: break;
+            }
+            if (codec) {
+                payloadType = payload.type;
+                return codec;
             }
         }
+        return video ? "H264" : "PCMA";
+    }
 
-        eXosip_message_build_answer_and_send(excontext_, event->tid, 400);
+    static uint64_t QueryKey(QueryKind kind, size_t index, uint32_t sn) {
+        return (static_cast<uint64_t>(kind) << 62) | (static_cast<uint64_t>(index) << 32) | sn;
     }
 
-    void ParseSdpOffer(const std::string& sdpStr,
-                      std::string& remoteIp,
-                      int& remoteVideoPort,
-                      int& remoteAudioPort,
-                      std::string& videoCodec,
-                      std::string& audioCodec) {
-        std::istringstream ss(sdpStr);
-        std::string line;
+    static const char *QueryName(QueryKind kind) {
+        return (kind == QueryKind::CATALOG) ? "Catalog" : "RecordInfo";
+    }
 
-        std::string currentMedia;
-        int currentPort = 0;
+    QueryJob MakeQueryJob(QueryKind kind, const ManscdpMessage& msg, size_t index) const {
+        QueryJob job;
+        job.kind = kind;
+        job.index = static_cast<uint32_t>(index);
+        job.sn = msg.sn;
+        job.deviceId = identities_.deviceIds[index];
+        job.device = GetIdentityDevice(index);
+        job.maxBodyBytes = catalogOptions_.maxBodyBytes;
+        job.condition.type = RecordType::ALL;
+        job.condition.maxResults = 0;
+        job.condition.order = "asc";
+
+        if (kind == QueryKind::RECORD_INFO) {
+            // 应答DeviceID与查询目标一致；目标是设备本身时检索全部通道
+            if (!msg.deviceId.empty() && msg.deviceId != job.deviceId) {
+                job.deviceId = std::string(msg.deviceId);
+                job.condition.channelId = job.deviceId;
+            }
+            job.condition.startTime = std::string(FindManscdpElement(msg.body, "StartTime"));
+            job.condition.endTime = std::string(FindManscdpElement(msg.body, "EndTime"));
+
+            std::string_view type = FindManscdpElement(msg.body, "Type");
+            if (type == "time") {
+                job.condition.type = RecordType::TIME;
+            } else if (type == "manual") {
+                job.condition.type = RecordType::MANUAL;
+            } else if (type == "alarm") {
+                job.condition.type = RecordType::ALARM;
+            }
+        }
+        return job;
+    }
 
-        while (std::getline(ss, line)) {
-            if (line.empty()) continue;
-            if (line.back() == '\r') line.pop_back();
+    // 查询先回200 OK，应答以独立MESSAGE发送。同一SN的重复查询合并，
+    // 排队已满时回503并返回true（已自行应答）
+    bool SubmitQuery(QueryJob job, int tid) {
+        uint64_t key = QueryKey(job.kind, job.index, job.sn);
+        if (pendingQueries_.count(key) > 0) {
+            LOG_INFO("[SIP] " << QueryName(job.kind) << " SN=" << job.sn
+                     << " already in progress");
+            return false;
+        }
 
-            if (line.length() < 2) continue;
+        std::deque<QueryJob>& queue = queryQueues_[static_cast<size_t>(job.kind)];
+        if (queue.size() >= queryOptions_.maxQueuedQueries) {
+            LOG_WARN("[SIP] " << QueryName(job.kind) << " queue full, rejecting SN="
+                     << job.sn);
+            eXosip_message_build_answer_and_send(excontext_, tid, 503);
+            return true;
+        }
 
-            char type = line[0];
-            std::string content = line.substr(2);
+        QueryKind kind = job.kind;
+        pendingQueries_.insert(key);
+        queue.push_back(std::move(job));
+        StartQueries(kind);
+        return false;
+    }
 
-            switch (type) {
-                case 'c': // 连接信息
-                    if (content.find("IN IP4") != std::string::npos) {
-                        size_t pos = content.find_last_of(' ');
-                        if (pos != std::string::npos) {
-                            remoteIp = content.substr(pos + 1);
-                        }
-                    }
-                    break;
+    void StartQueries(QueryKind kind) {
+        size_t slot = static_cast<size_t>(kind);
+        int limit = (kind == QueryKind::CATALOG) ? queryOptions_.maxCatalogQueries
+                                                 : queryOptions_.maxRecordQueries;
 
-                case 'm': // 媒体描述
-                    if (content.find("video") == 0) {
-                        currentMedia = "video";
-                        std::istringstream mss(content);
-                        std::string dummy;
-                        mss >> dummy >> currentPort;
-                        remoteVideoPort = currentPort;
-                    } else if (content.find("audio") == 0) {
-                        currentMedia = "audio";
-                        std::istringstream mss(content);
-                        std::string dummy;
-                        mss >> dummy >> currentPort;
-                        remoteAudioPort = currentPort;
-                    }
-                    break;
+        while (queryRunning_[slot] < limit && !queryQueues_[slot].empty()) {
+            auto job = std::make_shared<QueryJob>(std::move(queryQueues_[slot].front()));
+            queryQueues_[slot].pop_front();
+            queryRunning_[slot]++;
+            RunQuery(job);
+        }
+    }
+
+    void RunQuery(std::shared_ptr<QueryJob> job) {
+        if (threadPool_) {
+            {
+                std::lock_guard<std::mutex> lock(queryMutex_);
+                queriesInFlight_++;
+            }
 
-                case 'a': // 属性
-                    if (content.find("rtpmap:") == 0) {
-                        std::string rtpmapContent = content.substr(7);
-                        if (currentMedia == "video") {
-                            if (rtpmapContent.find("H264") != std::string::npos) {
-                                videoCodec = "H264";
-                            } else if (rtpmapContent.find("H265") != std::string::npos) {
-                                videoCodec = "H265";
-                            } else if (rtpmapContent.find("PS") != std::string::npos) {
-                                videoCodec = "PS";
-                            }
-                        } else if (currentMedia == "audio") {
-                            if (rtpmapContent.find("PCMA") != std::string::npos) {
-                                audioCodec = "PCMA";
-                            } else if (rtpmapContent.find("PCMU") != std::string::npos) {
-                                audioCodec = "PCMU";
-                            }
-                        }
+            try {
+                threadPool_->Post([this, job]() {
+                    auto bodies = std::make_shared<std::vector<std::string>>(ExecuteQuery(*job));
+                    Post([this, job, bodies]() { FinishQuery(*job, *bodies); });
+
+                    std::lock_guard<std::mutex> lock(queryMutex_);
+                    if (--queriesInFlight_ == 0) {
+                        queryDone_.notify_all();
                     }
-                    break;
+                });
+                return;
+            } catch (const std::exception& e) {
+                LOG_ERROR("[SIP] Query dispatch failed: " << e.what());
+                std::lock_guard<std::mutex> lock(queryMutex_);
+                queriesInFlight_--;
             }
         }
+
+        // 没有线程池时投递到下一轮处理，保证200 OK先于应答消息发出
+        Post([this, job]() {
+            std::vector<std::string> bodies = ExecuteQuery(*job);
+            FinishQuery(*job, bodies);
+        });
     }
 
-    int AllocateRtpPort() {
-        static int nextPort = rtpPortBase_;
-        int port = nextPort;
-        nextPort += 4; // 每个会话使用4个端口（视频2个，音频2个）
-        return port;
+    // 在工作线程中执行：只访问job副本和自带锁的设备/录像管理器
+    std::vector<std::string> ExecuteQuery(const QueryJob& job) const {
+        std::vector<std::string> bodies;
+        std::string body;
+
+        if (job.kind == QueryKind::CATALOG) {
+            // 每个身份应答自己设备管理器中的通道，网关子身份之间互不相同
+            if (!job.device) {
+                kCatalogTemplate.Render(body, {job.sn, job.deviceId});
+                bodies.push_back(std::move(body));
+                return bodies;
+            }
+
+            size_t offset = 0;
+            do {
+                size_t count = job.device->GenerateCatalogChunk(body, job.sn, job.deviceId,
+                                                                offset, job.maxBodyBytes);
+                if (count == 0 && offset > 0) {
+                    break;
+                }
+                bodies.push_back(body);
+                offset += count;
+            } while (offset < job.device->GetChannelCount());
+            return bodies;
+        }
+
+        if (!recordManager_) {
+            kRecordInfoTemplate.Render(body, {job.sn, job.deviceId});
+            bodies.push_back(std::move(body));
+            return bodies;
+        }
+
+        std::vector<RecordInfo> records = recordManager_->QueryRecords(job.condition);
+        size_t offset = 0;
+        do {
+            size_t count = recordManager_->GenerateRecordInfoChunk(body, job.sn, job.deviceId,
+                                                                   records, offset, job.maxBodyBytes);
+            if (count == 0 && offset > 0) {
+                break;
+            }
+            bodies.push_back(body);
+            offset += count;
+        } while (offset < records.size());
+        return bodies;
     }
 
-    bool SendCatalogResponse(int tid) {
-        osip_message_t *answer = nullptr;
-        if (eXosip_message_build_answer(excontext_, tid, 200, &answer) != 0) {
-            return false;
+    void FinishQuery(const QueryJob& job, std::vector<std::string>& bodies) {
+        queryRunning_[static_cast<size_t>(job.kind)]--;
+        pendingQueries_.erase(QueryKey(job.kind, job.index, job.sn));
+
+        uint64_t id = nextResponseStreamId_++;
+        responseStreams_[id] = ResponseStream{job.kind, job.index, job.sn, std::move(bodies), 0,
+                                              TimerService::kInvalidTimer};
+        SendNextResponse(id);
+
+        StartQueries(job.kind);
+    }
+
+    void WaitForQueries() {
+        std::unique_lock<std::mutex> lock(queryMutex_);
+        queryDone_.wait(lock, [this]() { return queriesInFlight_ == 0; });
+    }
+
+    // 应答消息较多时按间隔逐条发出，避免突发占满平台的UDP接收缓冲
+    void SendNextResponse(uint64_t id) {
+        auto it = responseStreams_.find(id);
+        if (it == responseStreams_.end()) {
+            return;
         }
 
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Response>\r\n";
-        ss << "<CmdType>Catalog</CmdType>\r\n";
-        ss << "<SN>1</SN>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<SumNum>1</SumNum>\r\n";
-        ss << "<DeviceList Num=\"1\">\r\n";
-        ss << "<Item>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<Name>Camera 1</Name>\r\n";
-        ss << "<Manufacturer>GB28181 Inc.</Manufacturer>\r\n";
-        ss << "<Model>IPC-1000</Model>\r\n";
-        ss << "<Status>ON</Status>\r\n";
-        ss << "<IPAddress>" << localIp_ << "</IPAddress>\r\n";
-        ss << "<Port>" << localPort_ << "</Port>\r\n";
-        ss << "</Item>\r\n";
-        ss << "</DeviceList>\r\n";
-        ss << "</Response>\r\n";
-
-        std::string body = ss.str();
-        osip_message_set_body(answer, body.c_str(), body.length());
-        osip_message_set_content_type(answer, "Application/MANSCDP+xml");
+        ResponseStream& stream = it->second;
+        stream.timer = TimerService::kInvalidTimer;
+        if (stream.next < stream.bodies.size()) {
+            SendXmlMessage(stream.index, stream.bodies[stream.next]);
+            stream.next++;
+        }
 
-        eXosip_message_send_answer(excontext_, tid, 200, answer);
-        osip_message_free(answer);
-        return true;
+        if (stream.next >= stream.bodies.size()) {
+            LOG_INFO("[SIP] " << QueryName(stream.kind) << " SN=" << stream.sn
+                     << " sent in " << stream.next << " messages");
+            responseStreams_.erase(it);
+            return;
+        }
+
+        if (!timerService_ || catalogOptions_.pacingMs == 0) {
+            Post([this, id]() { SendNextResponse(id); });
+            return;
+        }
+
+        stream.timer = timerService_->ScheduleOnce(catalogOptions_.pacingMs, [this, id]() {
+            Post([this, id]() { SendNextResponse(id); });
+        });
     }
 
-    bool SendDeviceInfoResponse(int tid) {
-        osip_message_t *answer = nullptr;
-        if (eXosip_message_build_answer(excontext_, tid, 200, &answer) != 0) {
+    // 从指定身份向平台发送MANSCDP消息体
+    bool SendXmlMessage(size_t index, const std::string& body) {
+        std::string to = "sip:" + serverIp_ + ":" + std::to_string(serverPort_);
+        std::string from = "sip:" + identities_.usernames[index] + "@" + realm_;
+
+        osip_message_t *msg = nullptr;
+        if (eXosip_message_build_request(excontext_, &msg, "MESSAGE",
+                                         to.c_str(), from.c_str(), nullptr) != 0) {
             return false;
         }
 
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Response>\r\n";
-        ss << "<CmdType>DeviceInfo</CmdType>\r\n";
-        ss << "<SN>1</SN>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<DeviceName>GB28181 Camera</DeviceName>\r\n";
-        ss << "<Manufacturer>GB28181 Inc.</Manufacturer>\r\n";
-        ss << "<Model>IPC-1000</Model>\r\n";
-        ss << "<FirmwareVersion>1.0.0</FirmwareVersion>\r\n";
-        ss << "</Response>\r\n";
-
-        std::string body = ss.str();
-        osip_message_set_body(answer, body.c_str(), body.length());
-        osip_message_set_content_type(answer, "Application/MANSCDP+xml");
+        osip_message_set_body(msg, body.data(), body.length());
+        osip_message_set_content_type(msg, "Application/MANSCDP+xml");
 
-        eXosip_message_send_answer(excontext_, tid, 200, answer);
-        osip_message_free(answer);
-        return true;
+        return eXosip_message_send_request(excontext_, msg) == 0;
     }
 
-    bool SendDeviceStatusResponse(int tid) {
-        osip_message_t *answer = nullptr;
-        if (eXosip_message_build_answer(excontext_, tid, 200, &answer) != 0) {
-            return false;
+    bool SendDeviceInfoResponse(int tid, size_t index, uint32_t sn) {
+        // 没有设备管理器的身份以设备ID作为名称，其余字段留空
+        DeviceManager *device = GetIdentityDevice(index);
+        DeviceInfo info;
+        if (device) {
+            info = device->GetDeviceInfo();
+        } else {
+            info.deviceName = identities_.deviceIds[index];
         }
 
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Response>\r\n";
-        ss << "<CmdType>DeviceStatus</CmdType>\r\n";
-        ss << "<SN>1</SN>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<Result>OK</Result>\r\n";
-        ss << "<Online>ONLINE</Online>\r\n";
-        ss << "<Status>OK</Status>\r\n";
-        ss << "<Encode>ON</Encode>\r\n";
-        ss << "<Record>OFF</Record>\r\n";
-        ss << "</Response>\r\n";
-
-        std::string body = ss.str();
-        osip_message_set_body(answer, body.c_str(), body.length());
-        osip_message_set_content_type(answer, "Application/MANSCDP+xml");
+        kDeviceInfoTemplate.Render(xmlBuffer_, {sn, identities_.deviceIds[index], info.deviceName,
+                                                info.manufacturer, info.model, info.firmwareVersion});
+        return SendXmlAnswer(tid);
+    }
 
-        eXosip_message_send_answer(excontext_, tid, 200, answer);
-        osip_message_free(answer);
-        return true;
+    // 身份自身的设备管理器，主身份未单独指定时使用SetDeviceManager设置的管理器
+    DeviceManager *GetIdentityDevice(size_t index) const {
+        DeviceManager *device = identities_.devices[index];
+        if (!device && index == 0) {
+            device = deviceManager_;
+        }
+        return device;
     }
 
-    bool SendRecordInfoResponse(int tid) {
-        osip_message_t *answer = nullptr;
-        if (eXosip_message_build_answer(excontext_, tid, 200, &answer) != 0) {
-            return false;
+    bool SendDeviceStatusResponse(int tid, size_t index, uint32_t sn) {
+        const char *online = (identities_.states[index] == IdentityState::REGISTERED) ? "ONLINE" : "OFFLINE";
+        kDeviceStatusTemplate.Render(xmlBuffer_, {sn, identities_.deviceIds[index], online});
+        return SendXmlAnswer(tid);
+    }
+
+    bool SendDeviceControlResponse(int tid, size_t index, uint32_t sn, const std::string& result) {
+        kDeviceControlTemplate.Render(xmlBuffer_, {sn, identities_.deviceIds[index], result});
+        return SendXmlAnswer(tid);
+    }
+
+    // 回放或下载发送完毕：在对话内通知平台MediaStatus，释放回放和媒体会话，对话由平台发BYE结束
+    void HandlePlaybackFinished(const std::string& callId) {
+        MediaSessionInfo info;
+        if (!mediaSessionManager_->GetSession(mediaSessionManager_->FindSession(callId), info)) {
+            return;
         }
 
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Response>\r\n";
-        ss << "<CmdType>RecordInfo</CmdType>\r\n";
-        ss << "<SN>1</SN>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<SumNum>0</SumNum>\r\n";
-        ss << "<RecordList Num=\"0\">\r\n";
-        ss << "</RecordList>\r\n";
-        ss << "</Response>\r\n";
+        int found = identities_.Find(info.channelId);
+        size_t index = (found >= 0) ? static_cast<size_t>(found) : 0;
+        kMediaStatusTemplate.Render(xmlBuffer_, {identities_.sns[index]++, identities_.deviceIds[index]});
+
+        auto it = dialogs_.find(callId);
+        bool sent = false;
+        if (it != dialogs_.end()) {
+            osip_message_t *msg = nullptr;
+            if (eXosip_call_build_request(excontext_, it->second, "MESSAGE", &msg) == 0) {
+                osip_message_set_body(msg, xmlBuffer_.data(), xmlBuffer_.length());
+                osip_message_set_content_type(msg, "Application/MANSCDP+xml");
+                sent = (eXosip_call_send_request(excontext_, it->second, msg) == 0);
+            }
+        } else {
+            sent = SendXmlMessage(index, xmlBuffer_);
+        }
 
-        std::string body = ss.str();
-        osip_message_set_body(answer, body.c_str(), body.length());
-        osip_message_set_content_type(answer, "Application/MANSCDP+xml");
+        if (sent) {
+            LOG_INFO("[SIP] Sent MediaStatus for finished Call-ID: " << callId);
+        } else {
+            LOG_WARN("[SIP] Failed to send MediaStatus for Call-ID: " << callId);
+        }
 
-        eXosip_message_send_answer(excontext_, tid, 200, answer);
-        osip_message_free(answer);
-        return true;
+        // 终止回调中停止回放会话并移除对话记录
+        mediaSessionManager_->TerminateSession(callId);
     }
 
-    bool SendDeviceControlResponse(int tid, const std::string& result) {
+    // 媒体会话终止后移除对话记录，超时终止时向平台发送BYE
+    void CloseDialog(const std::string& callId, bool sendBye) {
+        auto it = dialogs_.find(callId);
+        if (it == dialogs_.end()) {
+            return;
+        }
+        int did = it->second;
+        dialogs_.erase(it);
+
+        if (!sendBye || !excontext_) {
+            return;
+        }
+
+        osip_message_t *bye = nullptr;
+        if (eXosip_call_build_request(excontext_, did, "BYE", &bye) != 0 ||
+            eXosip_call_send_request(excontext_, did, bye) != 0) {
+            LOG_WARN("[SIP] Failed to send BYE for timed out Call-ID: " << callId);
+            return;
+        }
+        LOG_INFO("[SIP] Sent BYE for timed out Call-ID: " << callId);
+    }
+
+    // 以xmlBuffer_中已渲染的MANSCDP消息体发送200 OK
+    bool SendXmlAnswer(int tid) {
         osip_message_t *answer = nullptr;
         if (eXosip_message_build_answer(excontext_, tid, 200, &answer) != 0) {
             return false;
         }
 
-        std::stringstream ss;
-        ss << "<?xml version=\"1.0\"?>\r\n";
-        ss << "<Response>\r\n";
-        ss << "<CmdType>DeviceControl</CmdType>\r\n";
-        ss << "<SN>1</SN>\r\n";
-        ss << "<DeviceID>" << deviceId_ << "</DeviceID>\r\n";
-        ss << "<Result>" << result << "</Result>\r\n";
-        ss << "</Response>\r\n";
-
-        std::string body = ss.str();
-        osip_message_set_body(answer, body.c_str(), body.length());
+        osip_message_set_body(answer, xmlBuffer_.data(), xmlBuffer_.length());
         osip_message_set_content_type(answer, "Application/MANSCDP+xml");
 
         eXosip_message_send_answer(excontext_, tid, 200, answer);
@@ -954,19 +1988,56 @@ private:
     eXosip_t *excontext_;
     std::string localIp_;
     int localPort_;
-    std::string deviceId_;
     std::string realm_;
     std::string serverIp_;
     int serverPort_;
-    std::string username_;
-    std::string password_;
-    bool registered_;
     int cseq_;
-    int sn_;
     SipEventCallback eventCallback_;
     MediaSessionEventCallback mediaSessionEventCallback_;
     std::unique_ptr<MediaSessionManager> mediaSessionManager_;
-    int rtpPortBase_;
+    std::unordered_map<std::string, int> dialogs_;     // Call-ID -> ACK确认的对话did，仅在SIP线程访问
+    std::vector<VideoConfig> videoStreams_;            // 本机视频编码流，下标0为主码流
+    std::unique_ptr<PortAllocator> portAllocator_;     // 每个会话使用4个端口（视频2个，音频2个）
+    std::unique_ptr<SocketPool> socketPool_;           // 未启用时为空，析构时归还端口，须先于portAllocator_析构（声明在其后）
+    SocketPoolOptions socketPoolOptions_;
+
+    // 设备身份（单设备模式只有主身份，网关模式托管多个）
+    IdentityTable identities_;
+    RegisterScheduler registerScheduler_;
+    std::vector<uint32_t> registerBatch_;
+    bool gatewayMode_;
+    int64_t heartbeatIntervalMs_;
+    int64_t keepaliveEpochMs_;
+
+    // 定时器与投递到SIP线程的任务队列
+    TimerService* timerService_;
+    std::unique_ptr<TimerService> ownedTimerService_;
+    TimerService::TimerId registerTimer_;
+    int64_t registerTimerDueMs_;
+    std::mutex tasksMutex_;
+    std::vector<std::function<void()>> tasks_;
+    std::vector<std::function<void()>> runningTasks_;
+
+    // MANSCDP命令分发和消息体渲染缓冲区（跨请求复用）
+    ManscdpDispatcher manscdpDispatcher_;
+    std::string xmlBuffer_;
+
+    // 目录/录像查询：SIP线程排队并限制每类并发，线程池执行，结果投递回SIP线程发送
+    DeviceManager* deviceManager_;
+    RecordManager* recordManager_;
+    PlaybackManager* playbackManager_;
+    PlaybackScheduler* playbackScheduler_;
+    ThreadPool* threadPool_;
+    CatalogOptions catalogOptions_;
+    QueryOptions queryOptions_;
+    std::deque<QueryJob> queryQueues_[static_cast<size_t>(QueryKind::COUNT)];
+    int queryRunning_[static_cast<size_t>(QueryKind::COUNT)];
+    std::unordered_set<uint64_t> pendingQueries_;       // 排队或执行中的查询（类型+身份+SN）
+    std::mutex queryMutex_;
+    std::condition_variable queryDone_;
+    size_t queriesInFlight_;                            // 线程池中尚未结束的查询
+    std::unordered_map<uint64_t, ResponseStream> responseStreams_;
+    uint64_t nextResponseStreamId_;
 };
 
 SipManager::SipManager() : impl_(new Impl()) {}
@@ -991,6 +2062,84 @@ bool SipManager::SendHeartbeat() {
     return impl_->SendHeartbeat();
 }
 
+void SipManager::SetDeviceManager(DeviceManager* deviceManager) {
+    impl_->SetDeviceManager(deviceManager);
+}
+
+void SipManager::SetCatalogOptions(const CatalogOptions& options) {
+    impl_->SetCatalogOptions(options);
+}
+
+void SipManager::SetRecordManager(RecordManager* recordManager) {
+    impl_->SetRecordManager(recordManager);
+}
+
+void SipManager::SetPlaybackManager(PlaybackManager* playbackManager) {
+    impl_->SetPlaybackManager(playbackManager);
+}
+
+void SipManager::SetPlaybackScheduler(PlaybackScheduler* playbackScheduler) {
+    impl_->SetPlaybackScheduler(playbackScheduler);
+}
+
+void SipManager::SetThreadPool(ThreadPool* threadPool) {
+    impl_->SetThreadPool(threadPool);
+}
+
+void SipManager::SetQueryOptions(const QueryOptions& options) {
+    impl_->SetQueryOptions(options);
+}
+
+void SipManager::SetRtpPortRange(int basePort, int portCount) {
+    impl_->SetRtpPortRange(basePort, portCount);
+}
+
+void SipManager::SetVideoStreams(const std::vector<VideoConfig>& streams) {
+    impl_->SetVideoStreams(streams);
+}
+
+void SipManager::SetSocketPoolOptions(const SocketPoolOptions& options) {
+    impl_->SetSocketPoolOptions(options);
+}
+
+void SipManager::SetTimerService(TimerService* timerService) {
+    impl_->SetTimerService(timerService);
+}
+
+void SipManager::SetHeartbeatInterval(int seconds) {
+    impl_->SetHeartbeatInterval(seconds);
+}
+
+int SipManager::AddIdentity(const std::string& deviceId, const std::string& username,
+                            const std::string& password, DeviceManager* deviceManager) {
+    return impl_->AddIdentity(deviceId, username, password, deviceManager);
+}
+
+bool SipManager::RegisterAllIdentities(const std::string& serverIp, int serverPort,
+                                       int expires, int heartbeatInterval) {
+    return impl_->RegisterAllIdentities(serverIp, serverPort, expires, heartbeatInterval);
+}
+
+size_t SipManager::GetIdentityCount() const {
+    return impl_->GetIdentityCount();
+}
+
+size_t SipManager::GetRegisteredIdentityCount() const {
+    return impl_->GetRegisteredIdentityCount();
+}
+
+void SipManager::SetRegisterPolicy(const RegisterPolicy& policy) {
+    impl_->SetRegisterPolicy(policy);
+}
+
+RegisterPolicy SipManager::GetRegisterPolicy() const {
+    return impl_->GetRegisterPolicy();
+}
+
+RegisterMetrics SipManager::GetRegisterMetrics() const {
+    return impl_->GetRegisterMetrics();
+}
+
 void SipManager::ProcessMessage() {
     impl_->ProcessMessage();
 }
@@ -1019,6 +2168,10 @@ bool SipManager::SendMessage(const std::string& to, const std::string& content)
     return impl_->SendMessage(to, content);
 }
 
+void SipManager::PostNotify(const std::string& content) {
+    impl_->PostNotify(content);
+}
+
 bool SipManager::SendResponse(int tid, int statusCode, const std::string& reason) {
     return impl_->SendResponse(tid, statusCode, reason);
 }
@@ -1,5 +1,5 @@
 #include "sip/sip_transport.h"
-#include <iostream>
+#include "utils/logger.h"
 #include <cstring>
 
 #ifdef _WIN32
@@ -35,7 +35,7 @@ public:
     bool Start(const std::string& localIp, int localPort) {
         socket_ = socket(AF_INET, SOCK_DGRAM, 0);
         if (socket_ < 0) {
-            std::cerr << "Failed to create socket" << std::endl;
+            LOG_ERROR("Failed to create socket");
             return false;
         }
 
@@ -46,7 +46,7 @@ public:
         addr.sin_port = htons(localPort);
 
         if (bind(socket_, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-            std::cerr << "Failed to bind socket" << std::endl;
+            LOG_ERROR("Failed to bind socket");
 #ifdef _WIN32
             closesocket(socket_);
 #else
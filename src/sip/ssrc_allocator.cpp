@@ -0,0 +1,143 @@
+#include "sip/ssrc_allocator.h"
+#include "utils/logger.h"
+#include <random>
+#include <chrono>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace gb28181 {
+
+namespace {
+
+int CountTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+} // namespace
+
+SsrcAllocator::SsrcAllocator()
+    : realmDigits_(0)
+    , allocated_(0) {
+    // 只在构造时读一次随机设备作为种子
+    std::random_device rd;
+    uint64_t seed = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+                    static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    randomState_.store(seed);
+
+    for (auto& words : bitmap_) {
+        for (auto& word : words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+        // 最后一个字中超出序号范围的位预先置为占用
+        uint32_t tailBits = kSequenceCount % 64;
+        if (tailBits != 0) {
+            words[kWordsPerType - 1].store(~0ULL << tailBits, std::memory_order_relaxed);
+        }
+    }
+}
+
+void SsrcAllocator::SetRealm(const std::string& realm) {
+    // 域标识取SIP监控域ID的第4-8位
+    uint32_t digits = 0;
+    for (size_t i = 3; i < 8; i++) {
+        digits *= 10;
+        if (i < realm.size() && realm[i] >= '0' && realm[i] <= '9') {
+            digits += static_cast<uint32_t>(realm[i] - '0');
+        }
+    }
+    realmDigits_.store(digits);
+}
+
+uint64_t SsrcAllocator::NextRandom() {
+    // splitmix64，状态推进只需一次原子加
+    uint64_t z = randomState_.fetch_add(0x9E3779B97F4A7C15ULL, std::memory_order_relaxed) +
+                 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+bool SsrcAllocator::TrySet(bool history, uint32_t sequence) {
+    uint64_t bit = 1ULL << (sequence % 64);
+    uint64_t previous = bitmap_[history ? 1 : 0][sequence / 64].fetch_or(bit, std::memory_order_acq_rel);
+    if (previous & bit) {
+        return false;
+    }
+    allocated_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t SsrcAllocator::Allocate(bool history) {
+    std::atomic<uint64_t> *words = bitmap_[history ? 1 : 0];
+    uint32_t start = static_cast<uint32_t>(NextRandom() % kSequenceCount);
+    size_t wordIndex = start / 64;
+    uint64_t startMask = ~0ULL << (start % 64);
+
+    // 从随机起点开始逐字查找空位，最多绕一圈
+    for (size_t n = 0; n <= kWordsPerType; n++) {
+        uint64_t word = words[wordIndex].load(std::memory_order_acquire);
+        uint64_t freeBits = ~word & (n == 0 ? startMask : ~0ULL);
+
+        while (freeBits != 0) {
+            uint32_t sequence = static_cast<uint32_t>(wordIndex * 64 + CountTrailingZeros(freeBits));
+            if (TrySet(history, sequence)) {
+                return (history ? 1000000000U : 0U) + realmDigits_.load() * 10000U + sequence;
+            }
+            // 被其他线程抢先，重新读取该字
+            word = words[wordIndex].load(std::memory_order_acquire);
+            freeBits &= ~word;
+        }
+
+        wordIndex = (wordIndex + 1) % kWordsPerType;
+    }
+
+    LOG_ERROR("[SsrcAllocator] No free " << (history ? "history" : "realtime") << " SSRC");
+    return kInvalidSsrc;
+}
+
+bool SsrcAllocator::Decode(uint32_t ssrc, bool& history, uint32_t& sequence) const {
+    uint32_t type = ssrc / 1000000000U;
+    if (type > 1 || (ssrc / 10000U) % 100000U != realmDigits_.load()) {
+        return false;
+    }
+    history = (type == 1);
+    sequence = ssrc % 10000U;
+    return true;
+}
+
+bool SsrcAllocator::Reserve(uint32_t ssrc) {
+    bool history = false;
+    uint32_t sequence = 0;
+    if (!Decode(ssrc, history, sequence)) {
+        return false;
+    }
+    return TrySet(history, sequence);
+}
+
+void SsrcAllocator::Release(uint32_t ssrc) {
+    bool history = false;
+    uint32_t sequence = 0;
+    if (!Decode(ssrc, history, sequence)) {
+        return;
+    }
+
+    uint64_t bit = 1ULL << (sequence % 64);
+    uint64_t previous = bitmap_[history ? 1 : 0][sequence / 64].fetch_and(~bit, std::memory_order_acq_rel);
+    if (previous & bit) {
+        allocated_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+size_t SsrcAllocator::GetAllocatedCount() const {
+    return allocated_.load(std::memory_order_relaxed);
+}
+
+} // namespace gb28181
@@ -0,0 +1,141 @@
+#include "utils/event_log.h"
+#include "utils/logger.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gb28181 {
+
+const char EventLog::kMagic[8] = {'G', 'B', 'E', 'V', 'L', 'O', 'G', '\0'};
+
+EventLog& EventLog::Instance() {
+    static EventLog instance;
+    return instance;
+}
+
+EventLog::EventLog()
+    : header_(nullptr)
+    , records_(nullptr)
+    , mask_(0)
+    , mapping_(nullptr)
+    , mappingSize_(0) {
+}
+
+EventLog::~EventLog() {
+    Close();
+}
+
+bool EventLog::Open(const std::string& path, size_t capacity) {
+    Close();
+
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    size_t size = sizeof(EventLogHeader) + slots * sizeof(EventRecord);
+
+#ifdef _WIN32
+    // Windows下暂不映射文件，只在内存中保留最近的事件
+    (void)path;
+    void *mapping = ::operator new(size, std::nothrow);
+    if (!mapping) {
+        LOG_ERROR("[EventLog] Failed to allocate " << size << " bytes");
+        return false;
+    }
+    std::memset(mapping, 0, size);
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG_ERROR("[EventLog] Failed to open " << path << ": " << std::strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    bool sizeMatches = (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == size);
+    if (!sizeMatches && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        LOG_ERROR("[EventLog] Failed to resize " << path << ": " << std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("[EventLog] Failed to map " << path << ": " << std::strerror(errno));
+        return false;
+    }
+#endif
+
+    EventLogHeader *header = static_cast<EventLogHeader*>(mapping);
+    bool valid = std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header->version == kVersion &&
+                 header->recordSize == sizeof(EventRecord) &&
+                 header->capacity == slots;
+    if (!valid) {
+        std::memset(mapping, 0, size);
+        std::memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->version = kVersion;
+        header->recordSize = sizeof(EventRecord);
+        header->capacity = slots;
+        header->writeIndex.store(0, std::memory_order_relaxed);
+    }
+
+    header_ = header;
+    records_ = reinterpret_cast<EventRecord*>(static_cast<char*>(mapping) + sizeof(EventLogHeader));
+    mask_ = slots - 1;
+    mapping_ = mapping;
+    mappingSize_ = size;
+
+    if (valid) {
+        LOG_INFO("[EventLog] Opened " << path << ", " << slots << " slots, appending at #"
+                 << header->writeIndex.load(std::memory_order_relaxed));
+    } else {
+        LOG_INFO("[EventLog] Created " << path << ", " << slots << " slots");
+    }
+    return true;
+}
+
+void EventLog::Close() {
+    if (!mapping_) {
+        return;
+    }
+
+    records_ = nullptr;
+    header_ = nullptr;
+
+#ifdef _WIN32
+    ::operator delete(mapping_);
+#else
+    munmap(mapping_, mappingSize_);
+#endif
+
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    mask_ = 0;
+}
+
+const char *EventLog::GetEventName(uint16_t code) {
+    switch (static_cast<EventCode>(code)) {
+        case EventCode::NONE: return "NONE";
+        case EventCode::SESSION_CREATED: return "SESSION_CREATED";
+        case EventCode::SESSION_STATE_CHANGED: return "SESSION_STATE_CHANGED";
+        case EventCode::SESSION_TERMINATED: return "SESSION_TERMINATED";
+        case EventCode::SESSION_TIMEOUT: return "SESSION_TIMEOUT";
+        case EventCode::SIP_INVITE_RECEIVED: return "SIP_INVITE_RECEIVED";
+        case EventCode::SIP_INVITE_ANSWERED: return "SIP_INVITE_ANSWERED";
+        case EventCode::SIP_INVITE_REJECTED: return "SIP_INVITE_REJECTED";
+        case EventCode::SIP_ACK_RECEIVED: return "SIP_ACK_RECEIVED";
+        case EventCode::SIP_BYE_RECEIVED: return "SIP_BYE_RECEIVED";
+        case EventCode::SIP_INFO_RECEIVED: return "SIP_INFO_RECEIVED";
+    }
+    return nullptr;
+}
+
+} // namespace gb28181
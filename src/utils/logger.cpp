@@ -0,0 +1,485 @@
+#include "utils/logger.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gb28181 {
+
+namespace {
+
+// 每个线程的环形缓冲区大小
+const size_t kRingCapacity = 1024 * 1024;
+
+// 单条日志最大长度，超出截断
+const size_t kMaxMessageSize = 16 * 1024;
+
+// 后台线程的批量写出周期
+const int kFlushIntervalMs = 50;
+
+const uint32_t kPaddingRecord = 0xFFFFFFFFu;
+
+struct RecordHeader {
+    int64_t timeUs;         // 系统时间(微秒)
+    uint32_t length;        // 消息长度，kPaddingRecord表示跳到缓冲区开头
+    uint32_t level;
+};
+
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must be 16 bytes");
+
+size_t AlignRecord(size_t size) {
+    return (size + 15) & ~static_cast<size_t>(15);
+}
+
+const char *LevelToString(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG:   return "DEBUG";
+        case LogLevel::INFO:    return "INFO";
+        case LogLevel::WARNING: return "WARN";
+        case LogLevel::ERROR:   return "ERROR";
+        case LogLevel::FATAL:   return "FATAL";
+        default:                return "UNKNOWN";
+    }
+}
+
+/**
+ * @brief 单生产者单消费者字节环
+ * 记录按16字节对齐；末尾空间不足时写一条填充记录后从头开始。
+ * head_/tail_为单调递增的字节位置。
+ */
+class LogRing {
+public:
+    LogRing() : buffer_(new unsigned char[kRingCapacity]), head_(0), tail_(0),
+                dropped_(0), closed_(false) {}
+
+    // 生产者线程调用，返回写入后的占用字节数，缓冲区满返回0
+    size_t Write(LogLevel level, int64_t timeUs, std::string_view message) {
+        if (message.size() > kMaxMessageSize) {
+            message = message.substr(0, kMaxMessageSize);
+        }
+
+        size_t need = AlignRecord(sizeof(RecordHeader) + message.size());
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        size_t offset = static_cast<size_t>(head % kRingCapacity);
+        size_t contiguous = kRingCapacity - offset;
+        size_t total = need + ((contiguous < need) ? contiguous : 0);
+
+        if (head + total - tail > kRingCapacity) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+
+        if (contiguous < need) {
+            RecordHeader padding = {0, kPaddingRecord, 0};
+            memcpy(buffer_.get() + offset, &padding, sizeof(padding));
+            offset = 0;
+        }
+
+        RecordHeader header = {timeUs, static_cast<uint32_t>(message.size()),
+                               static_cast<uint32_t>(level)};
+        memcpy(buffer_.get() + offset, &header, sizeof(header));
+        memcpy(buffer_.get() + offset + sizeof(header), message.data(), message.size());
+        head_.store(head + total, std::memory_order_release);
+        return static_cast<size_t>(head + total - tail);
+    }
+
+    // 后台线程调用：收集当前所有记录（消息为缓冲区内视图），处理完后调用Release
+    template <class Visitor>
+    uint64_t Collect(Visitor&& visit) const {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+
+        while (tail < head) {
+            size_t offset = static_cast<size_t>(tail % kRingCapacity);
+            RecordHeader header;
+            memcpy(&header, buffer_.get() + offset, sizeof(header));
+            if (header.length == kPaddingRecord) {
+                tail += kRingCapacity - offset;
+                continue;
+            }
+
+            const char *text = reinterpret_cast<const char*>(buffer_.get() + offset + sizeof(header));
+            visit(header, std::string_view(text, header.length));
+            tail += AlignRecord(sizeof(header) + header.length);
+        }
+        return tail;
+    }
+
+    void Release(uint64_t tail) {
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    bool Empty() const {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    uint64_t TakeDropped() {
+        return dropped_.exchange(0, std::memory_order_relaxed);
+    }
+
+    void Close() {
+        closed_.store(true, std::memory_order_release);
+    }
+
+    bool IsClosed() const {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::unique_ptr<unsigned char[]> buffer_;
+    alignas(64) std::atomic<uint64_t> head_;
+    alignas(64) std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<bool> closed_;
+};
+
+// 线程退出时标记缓冲区关闭，由后台线程写完剩余日志后回收
+struct RingHolder {
+    std::shared_ptr<LogRing> ring;
+
+    ~RingHolder() {
+        if (ring) {
+            ring->Close();
+        }
+    }
+};
+
+thread_local RingHolder tlsRing;
+thread_local std::string tlsBuffer;
+thread_local bool tlsBufferInUse = false;
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+class Logger::Impl {
+public:
+    Impl() : console_(true), file_(nullptr), cachedSecond_(-1), totalDropped_(0),
+             flushRequested_(0), flushCompleted_(0), wakeup_(false), wakeRequested_(false),
+             stop_(false) {
+        cachedPrefix_[0] = '\0';
+        writer_ = std::thread([this] { WriterLoop(); });
+    }
+
+    ~Impl() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+        if (file_) {
+            fclose(file_);
+        }
+    }
+
+    void SetLogFile(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+        if (!filename.empty()) {
+            file_ = fopen(filename.c_str(), "a");
+        }
+    }
+
+    void SetConsoleOutput(bool enabled) {
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        console_ = enabled;
+    }
+
+    void Write(LogLevel level, std::string_view message) {
+        LogRing *ring = tlsRing.ring.get();
+        if (!ring) {
+            tlsRing.ring = std::make_shared<LogRing>();
+            ring = tlsRing.ring.get();
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            rings_.push_back(tlsRing.ring);
+        }
+
+        // 缓冲区用量超过1/4或写满时提前唤醒后台线程，减少突发日志被丢弃
+        size_t used = ring->Write(level, NowUs(), message);
+        if (level >= LogLevel::ERROR || used == 0 || used > kRingCapacity / 4) {
+            Wake();
+        }
+    }
+
+    void Wake() {
+        if (wakeRequested_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_ = true;
+        }
+        condition_.notify_all();
+    }
+
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t ticket = ++flushRequested_;
+        wakeup_ = true;
+        condition_.notify_all();
+        condition_.wait(lock, [this, ticket] { return flushCompleted_ >= ticket || stop_; });
+    }
+
+    uint64_t GetDroppedCount() const {
+        return totalDropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        int64_t timeUs;
+        LogLevel level;
+        std::string_view text;
+    };
+
+    void WriterLoop() {
+        while (true) {
+            uint64_t flushTicket;
+            bool stopping;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+                                    [this] { return wakeup_ || stop_; });
+                wakeup_ = false;
+                wakeRequested_.store(false, std::memory_order_release);
+                flushTicket = flushRequested_;
+                stopping = stop_;
+            }
+
+            Drain();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                flushCompleted_ = std::max(flushCompleted_, flushTicket);
+            }
+            condition_.notify_all();
+
+            if (stopping) {
+                break;
+            }
+        }
+    }
+
+    // 取出所有线程的日志，按时间排序后一次写出
+    void Drain() {
+        std::vector<std::shared_ptr<LogRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            rings = rings_;
+        }
+
+        entries_.clear();
+        tails_.clear();
+        uint64_t dropped = 0;
+        for (const auto& ring : rings) {
+            dropped += ring->TakeDropped();
+            tails_.push_back(ring->Collect([this](const RecordHeader& header, std::string_view text) {
+                entries_.push_back(Entry{header.timeUs, static_cast<LogLevel>(header.level), text});
+            }));
+        }
+
+        std::stable_sort(entries_.begin(), entries_.end(),
+                         [](const Entry& a, const Entry& b) { return a.timeUs < b.timeUs; });
+
+        batch_.clear();
+        for (const Entry& entry : entries_) {
+            AppendLine(entry.timeUs, entry.level, entry.text);
+        }
+        if (dropped > 0) {
+            totalDropped_.fetch_add(dropped, std::memory_order_relaxed);
+            std::string note = "Dropped " + std::to_string(dropped) + " log messages (buffer full)";
+            AppendLine(NowUs(), LogLevel::WARNING, note);
+        }
+
+        for (size_t i = 0; i < rings.size(); i++) {
+            rings[i]->Release(tails_[i]);
+        }
+
+        if (!batch_.empty()) {
+            std::lock_guard<std::mutex> lock(outputMutex_);
+            if (console_) {
+                fwrite(batch_.data(), 1, batch_.size(), stdout);
+                fflush(stdout);
+            }
+            if (file_) {
+                fwrite(batch_.data(), 1, batch_.size(), file_);
+                fflush(file_);
+            }
+        }
+
+        // 回收已退出线程的缓冲区
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                    [](const std::shared_ptr<LogRing>& ring) {
+                                        return ring->IsClosed() && ring->Empty();
+                                    }),
+                     rings_.end());
+    }
+
+    void AppendLine(int64_t timeUs, LogLevel level, std::string_view text) {
+        int64_t second = timeUs / 1000000;
+        if (second != cachedSecond_) {
+            time_t time = static_cast<time_t>(second);
+            struct tm tm;
+#ifdef _WIN32
+            localtime_s(&tm, &time);
+#else
+            localtime_r(&time, &tm);
+#endif
+            strftime(cachedPrefix_, sizeof(cachedPrefix_), "%Y-%m-%d %H:%M:%S", &tm);
+            cachedSecond_ = second;
+        }
+
+        int millis = static_cast<int>((timeUs / 1000) % 1000);
+        char suffix[8] = {'.', static_cast<char>('0' + millis / 100),
+                          static_cast<char>('0' + (millis / 10) % 10),
+                          static_cast<char>('0' + millis % 10), ' ', '[', '\0', '\0'};
+
+        batch_.append(cachedPrefix_);
+        batch_.append(suffix, 6);
+        batch_.append(LevelToString(level));
+        batch_.append("] ", 2);
+        batch_.append(text.data(), text.size());
+        batch_.push_back('\n');
+    }
+
+private:
+    // 线程缓冲区登记
+    std::mutex ringsMutex_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+
+    // 输出目标
+    std::mutex outputMutex_;
+    bool console_;
+    FILE *file_;
+
+    // 仅后台线程访问
+    std::vector<Entry> entries_;
+    std::vector<uint64_t> tails_;
+    std::string batch_;
+    int64_t cachedSecond_;
+    char cachedPrefix_[32];
+    std::atomic<uint64_t> totalDropped_;
+
+    // 后台线程唤醒与Flush同步
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    uint64_t flushRequested_;
+    uint64_t flushCompleted_;
+    bool wakeup_;
+    std::atomic<bool> wakeRequested_;   // 已请求唤醒、后台线程尚未处理，避免重复加锁
+    bool stop_;
+    std::thread writer_;
+};
+
+Logger& Logger::Instance() {
+    // 不析构：其他静态对象析构时仍可能写日志；进程退出前写出剩余日志
+    static Logger *instance = [] {
+        Logger *logger = new Logger();
+        std::atexit([] { Logger::Instance().Flush(); });
+        return logger;
+    }();
+    return *instance;
+}
+
+Logger::Logger() : impl_(new Impl()), level_(static_cast<int>(LogLevel::INFO)) {}
+
+Logger::~Logger() {}
+
+void Logger::SetLogFile(const std::string& filename) {
+    impl_->SetLogFile(filename);
+}
+
+void Logger::SetConsoleOutput(bool enabled) {
+    impl_->SetConsoleOutput(enabled);
+}
+
+void Logger::Log(LogLevel level, std::string_view message) {
+    if (!IsEnabled(level)) {
+        return;
+    }
+
+    impl_->Write(level, message);
+    if (level == LogLevel::FATAL) {
+        impl_->Flush();
+    }
+}
+
+void Logger::Flush() {
+    impl_->Flush();
+}
+
+uint64_t Logger::GetDroppedCount() const {
+    return impl_->GetDroppedCount();
+}
+
+LogStream::LogStream(LogLevel level) : level_(level), hex_(false), nested_(tlsBufferInUse) {
+    // 格式化参数中的函数调用也可能写日志，嵌套时改用自己的缓冲区
+    if (nested_) {
+        buffer_ = &ownBuffer_;
+    } else {
+        tlsBufferInUse = true;
+        buffer_ = &tlsBuffer;
+        buffer_->clear();
+    }
+}
+
+LogStream::~LogStream() {
+    Logger::Instance().Log(level_, *buffer_);
+    if (!nested_) {
+        tlsBufferInUse = false;
+    }
+}
+
+LogStream& LogStream::operator<<(double value) {
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    buffer_->append(buf, result.ptr - buf);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const void *pointer) {
+    char buf[24] = {'0', 'x'};
+    auto result = std::to_chars(buf + 2, buf + sizeof(buf), reinterpret_cast<uintptr_t>(pointer), 16);
+    buffer_->append(buf, result.ptr - buf);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(std::ios_base& (*manip)(std::ios_base&)) {
+    if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::hex)) {
+        hex_ = true;
+    } else if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::dec)) {
+        hex_ = false;
+    }
+    return *this;
+}
+
+void LogStream::AppendInteger(int64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value, hex_ ? 16 : 10);
+    buffer_->append(buf, result.ptr - buf);
+}
+
+void LogStream::AppendInteger(uint64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value, hex_ ? 16 : 10);
+    buffer_->append(buf, result.ptr - buf);
+}
+
+} // namespace gb28181
@@ -0,0 +1,313 @@
+#include "utils/thread_pool.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace gb28181 {
+
+namespace {
+
+// 当前线程所属的线程池和工作线程下标，非工作线程为nullptr
+thread_local ThreadPool *tlsPool = nullptr;
+thread_local size_t tlsWorkerIndex = 0;
+
+const size_t kInitialDequeCapacity = 256;
+const size_t kInitialInjectCapacity = 64;
+
+// 找不到任务时在休眠前重试的次数
+const int kSpinRounds = 64;
+
+// 每个工作线程缓存的空闲任务节点数上限
+const size_t kMaxFreeNodes = 1024;
+
+/**
+ * @brief Chase-Lev工作窃取双端队列（Lê等人的C11内存模型版本）
+ * 所有者在底部Push/Pop，其他线程在顶部Steal。扩容后旧数组保留到队列析构，
+ * 窃取者可能仍在读取旧数组。
+ */
+class WorkStealingDeque {
+public:
+    WorkStealingDeque() : top_(0), bottom_(0) {
+        arrays_.push_back(std::make_unique<Array>(kInitialDequeCapacity));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    // 仅所有者调用
+    void Push(Task *task) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array *array = array_.load(std::memory_order_relaxed);
+
+        if (b - t > static_cast<int64_t>(array->capacity) - 1) {
+            array = Grow(array, t, b);
+        }
+
+        array->Put(b, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 仅所有者调用
+    Task *Pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *array = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Task *task = array->Get(b);
+        if (t == b) {
+            // 最后一个元素，与窃取者竞争
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // 任意线程调用，竞争失败返回nullptr
+    Task *Steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        Array *array = array_.load(std::memory_order_acquire);
+        Task *task = array->Get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+private:
+    struct Array {
+        explicit Array(size_t size) : capacity(size), mask(size - 1), slots(new std::atomic<Task*>[size]) {}
+
+        Task *Get(int64_t i) const {
+            return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t i, Task *task) {
+            slots[static_cast<size_t>(i) & mask].store(task, std::memory_order_relaxed);
+        }
+
+        size_t capacity;
+        size_t mask;
+        std::unique_ptr<std::atomic<Task*>[]> slots;
+    };
+
+    Array *Grow(Array *array, int64_t top, int64_t bottom) {
+        auto grown = std::make_unique<Array>(array->capacity * 2);
+        for (int64_t i = top; i < bottom; i++) {
+            grown->Put(i, array->Get(i));
+        }
+        arrays_.push_back(std::move(grown));
+        Array *result = arrays_.back().get();
+        array_.store(result, std::memory_order_release);
+        return result;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> arrays_;    // 仅所有者修改
+};
+
+} // namespace
+
+struct ThreadPool::Worker {
+    WorkStealingDeque deque;
+    // 执行完的任务节点留给本线程下次提交复用，仅所有者访问
+    std::vector<std::unique_ptr<Task>> freeNodes;
+};
+
+ThreadPool::ThreadPool(size_t numThreads)
+    : injectQueue_(kInitialInjectCapacity), injectHead_(0), injectCount_(0),
+      pending_(0), sleeping_(0), stop_(false) {
+    numThreads = std::max<size_t>(1, numThreads);
+
+    workers_.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+
+    threads_.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        threads_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_.store(true);
+    }
+
+    wakeCondition_.notify_all();
+
+    for (std::thread& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ThreadPool::Post(Task task) {
+    bool onWorker = (tlsPool == this);
+
+    // 工作线程在停止过程中仍可提交后续任务，析构会等它们执行完
+    if (stop_.load() && !onWorker) {
+        throw std::runtime_error("Post on stopped ThreadPool");
+    }
+
+    // 先计数再发布，取走任务时计数不会短暂下溢
+    if (onWorker) {
+        Task *node = AcquireNode(tlsWorkerIndex, std::move(task));
+        pending_.fetch_add(1);
+        workers_[tlsWorkerIndex]->deque.Push(node);
+    } else {
+        pending_.fetch_add(1);
+        // 注入队列按值存放任务，由取走任务的工作线程放入自己的节点
+        std::lock_guard<std::mutex> lock(injectMutex_);
+        if (injectCount_ == injectQueue_.size()) {
+            GrowInjectQueue();
+        }
+        injectQueue_[(injectHead_ + injectCount_) & (injectQueue_.size() - 1)] = std::move(task);
+        injectCount_++;
+    }
+
+    Wake();
+}
+
+void ThreadPool::GrowInjectQueue() {
+    std::vector<Task> grown(injectQueue_.size() * 2);
+    for (size_t i = 0; i < injectCount_; i++) {
+        grown[i] = std::move(injectQueue_[(injectHead_ + i) & (injectQueue_.size() - 1)]);
+    }
+    injectQueue_.swap(grown);
+    injectHead_ = 0;
+}
+
+Task *ThreadPool::AcquireNode(size_t index, Task&& task) {
+    std::vector<std::unique_ptr<Task>>& freeNodes = workers_[index]->freeNodes;
+    if (freeNodes.empty()) {
+        return new Task(std::move(task));
+    }
+
+    Task *node = freeNodes.back().release();
+    freeNodes.pop_back();
+    *node = std::move(task);
+    return node;
+}
+
+void ThreadPool::ReleaseNode(size_t index, Task *node) {
+    // 先销毁可调用对象，捕获的资源不随空闲节点滞留
+    *node = Task();
+
+    std::vector<std::unique_ptr<Task>>& freeNodes = workers_[index]->freeNodes;
+    if (freeNodes.size() < kMaxFreeNodes) {
+        freeNodes.emplace_back(node);
+    } else {
+        delete node;
+    }
+}
+
+void ThreadPool::Wake() {
+    if (sleeping_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wakeCondition_.notify_one();
+    }
+}
+
+Task *ThreadPool::FindTask(size_t index) {
+    Task *task = workers_[index]->deque.Pop();
+    if (task) {
+        return task;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(injectMutex_);
+        if (injectCount_ > 0) {
+            task = AcquireNode(index, std::move(injectQueue_[injectHead_]));
+            injectHead_ = (injectHead_ + 1) & (injectQueue_.size() - 1);
+            injectCount_--;
+            return task;
+        }
+    }
+
+    // 从下一个线程开始轮流窃取，避免所有空闲线程挤向同一个队列
+    size_t count = workers_.size();
+    for (size_t i = 1; i < count; i++) {
+        task = workers_[(index + i) % count]->deque.Steal();
+        if (task) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::Run(size_t index, Task *task) {
+    try {
+        (*task)();
+    } catch (const std::exception& e) {
+        LOG_ERROR("[ThreadPool] Task threw exception: " << e.what());
+    } catch (...) {
+        LOG_ERROR("[ThreadPool] Task threw unknown exception");
+    }
+    ReleaseNode(index, task);
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    tlsPool = this;
+    tlsWorkerIndex = index;
+
+    int idleRounds = 0;
+    while (true) {
+        Task *task = FindTask(index);
+        if (task) {
+            pending_.fetch_sub(1);
+            // 本线程队列还有积压时唤醒一个空闲线程来窃取
+            if (pending_.load() > 0) {
+                Wake();
+            }
+            Run(index, task);
+            idleRounds = 0;
+            continue;
+        }
+
+        // 计数显示有任务但暂时没取到（窃取竞争失败或所有者正在取），稍后重试
+        if (pending_.load() > 0 && ++idleRounds < kSpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        idleRounds = 0;
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleeping_.fetch_add(1);
+        wakeCondition_.wait(lock, [this] {
+            return stop_.load() || pending_.load() > 0;
+        });
+        sleeping_.fetch_sub(1);
+
+        if (stop_.load() && pending_.load() == 0) {
+            break;
+        }
+    }
+
+    tlsPool = nullptr;
+}
+
+} // namespace gb28181
@@ -0,0 +1,353 @@
+#include "utils/timer_service.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <limits>
+
+namespace gb28181 {
+
+TimerService::TimerService(int tickMs)
+    : tickMs_(std::max(1, tickMs))
+    , origin_(std::chrono::steady_clock::now())
+    , running_(false)
+    , currentTick_(0)
+    , pending_(0)
+    , runningTimer_(kInvalidTimer) {
+    for (int level = 0; level < kLevels; level++) {
+        std::fill(heads_[level], heads_[level] + kSlots, kNil);
+        occupied_[level] = 0;
+    }
+}
+
+TimerService::~TimerService() {
+    Stop();
+}
+
+bool TimerService::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&TimerService::Run, this);
+
+    LOG_INFO("[TimerService] Started, tick=" << tickMs_ << "ms");
+    return true;
+}
+
+void TimerService::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+
+    cond_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    LOG_INFO("[TimerService] Stopped");
+}
+
+TimerService::TimerId TimerService::ScheduleOnce(int64_t delayMs, Callback callback) {
+    return Add(delayMs, 0, std::move(callback));
+}
+
+TimerService::TimerId TimerService::ScheduleRepeating(int64_t intervalMs, Callback callback,
+                                                      int64_t initialDelayMs) {
+    if (intervalMs <= 0) {
+        return kInvalidTimer;
+    }
+    return Add(initialDelayMs < 0 ? intervalMs : initialDelayMs, intervalMs, std::move(callback));
+}
+
+bool TimerService::Cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return CancelLocked(id);
+}
+
+bool TimerService::CancelAndWait(TimerId id) {
+    if (id == kInvalidTimer) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool cancelled = CancelLocked(id);
+
+    // 已到期但尚未执行的回调不再执行
+    for (auto& entry : fired_) {
+        if (entry.id == id && entry.callback) {
+            entry.callback = nullptr;
+            cancelled = true;
+        }
+    }
+
+    if (std::this_thread::get_id() != thread_.get_id()) {
+        callbackDone_.wait(lock, [this, id] { return runningTimer_ != id; });
+    }
+    return cancelled;
+}
+
+bool TimerService::CancelLocked(TimerId id) {
+    if (id == kInvalidTimer) {
+        return false;
+    }
+
+    uint32_t index = static_cast<uint32_t>(id & 0xFFFFFFFF);
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+
+    if (index >= nodes_.size() || nodes_[index].generation != generation ||
+        nodes_[index].level < 0) {
+        return false;
+    }
+
+    Unlink(index);
+    Release(index);
+    return true;
+}
+
+size_t TimerService::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+TimerService::TimerId TimerService::Add(int64_t delayMs, int64_t intervalMs, Callback callback) {
+    if (!callback) {
+        return kInvalidTimer;
+    }
+
+    // 向上取整到tick，至少延后一个tick
+    uint64_t delayTicks = static_cast<uint64_t>((std::max<int64_t>(0, delayMs) + tickMs_ - 1) / tickMs_);
+    uint64_t intervalTicks = static_cast<uint64_t>((intervalMs + tickMs_ - 1) / tickMs_);
+
+    TimerId id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint32_t index;
+        if (!freeList_.empty()) {
+            index = freeList_.back();
+            freeList_.pop_back();
+        } else {
+            index = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+
+        // 定时器线程休眠期间currentTick_可能落后于当前时间，以两者较大者为基准
+        Node& node = nodes_[index];
+        node.expireTick = std::max(currentTick_, CurrentTargetTick()) + std::max<uint64_t>(1, delayTicks);
+        node.intervalTicks = intervalTicks;
+        node.callback = std::move(callback);
+        Link(index);
+        pending_++;
+
+        id = (static_cast<uint64_t>(node.generation) << 32) | index;
+    }
+
+    // 新定时器可能早于线程当前的休眠截止时间
+    cond_.notify_one();
+    return id;
+}
+
+void TimerService::Link(uint32_t index) {
+    Node& node = nodes_[index];
+
+    // 降级时恰好到期的定时器放入当前槽，随后即被处理
+    uint64_t tick = std::max(node.expireTick, currentTick_);
+    uint64_t delta = tick - currentTick_;
+
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) {
+        level++;
+    }
+
+    // 超出时间轮范围的定时器挂在最高层最远的槽，降级时重新计算
+    uint64_t span = 1ULL << (kSlotBits * kLevels);
+    if (delta >= span) {
+        tick = currentTick_ + span - 1;
+    }
+
+    int slot = static_cast<int>((tick >> (kSlotBits * level)) & (kSlots - 1));
+
+    node.level = static_cast<int16_t>(level);
+    node.slot = static_cast<uint8_t>(slot);
+    node.prev = kNil;
+    node.next = heads_[level][slot];
+    if (node.next != kNil) {
+        nodes_[node.next].prev = index;
+    }
+    heads_[level][slot] = index;
+    occupied_[level] |= (1ULL << slot);
+}
+
+void TimerService::Unlink(uint32_t index) {
+    Node& node = nodes_[index];
+    if (node.level < 0) {
+        return;
+    }
+
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[node.level][node.slot] = node.next;
+        if (node.next == kNil) {
+            occupied_[node.level] &= ~(1ULL << node.slot);
+        }
+    }
+    if (node.next != kNil) {
+        nodes_[node.next].prev = node.prev;
+    }
+
+    node.level = -1;
+    node.prev = kNil;
+    node.next = kNil;
+}
+
+void TimerService::Release(uint32_t index) {
+    Node& node = nodes_[index];
+    node.callback = nullptr;
+    node.level = -1;
+
+    // 代数递增使旧ID失效（跳过0，保证ID不等于kInvalidTimer）
+    if (++node.generation == 0) {
+        node.generation = 1;
+    }
+
+    freeList_.push_back(index);
+    pending_--;
+}
+
+void TimerService::Cascade(int level) {
+    int slot = static_cast<int>((currentTick_ >> (kSlotBits * level)) & (kSlots - 1));
+
+    uint32_t index = heads_[level][slot];
+    heads_[level][slot] = kNil;
+    occupied_[level] &= ~(1ULL << slot);
+
+    // 把上层槽中的定时器按剩余时间重新分配到下层
+    while (index != kNil) {
+        uint32_t next = nodes_[index].next;
+        nodes_[index].level = -1;
+        Link(index);
+        index = next;
+    }
+
+    if (slot == 0 && level + 1 < kLevels) {
+        Cascade(level + 1);
+    }
+}
+
+void TimerService::Advance(uint64_t targetTick) {
+    while (currentTick_ < targetTick) {
+        // 第0层为空时直接跳到下一次进位前，避免逐tick空转
+        if (occupied_[0] == 0) {
+            uint64_t beforeWrap = currentTick_ | (kSlots - 1);
+            if (beforeWrap > currentTick_) {
+                currentTick_ = std::min(targetTick, beforeWrap);
+                continue;
+            }
+        }
+
+        currentTick_++;
+        int slot = static_cast<int>(currentTick_ & (kSlots - 1));
+        if (slot == 0) {
+            Cascade(1);
+        }
+
+        uint32_t index = heads_[0][slot];
+        heads_[0][slot] = kNil;
+        occupied_[0] &= ~(1ULL << slot);
+
+        while (index != kNil) {
+            Node& node = nodes_[index];
+            uint32_t next = node.next;
+            TimerId id = (static_cast<uint64_t>(node.generation) << 32) | index;
+            node.level = -1;
+
+            if (node.expireTick > currentTick_) {
+                // 超出时间轮范围的定时器尚未真正到期
+                Link(index);
+            } else if (node.intervalTicks > 0) {
+                fired_.push_back({id, node.callback});
+                node.expireTick = std::max(node.expireTick + node.intervalTicks, currentTick_ + 1);
+                Link(index);
+            } else {
+                fired_.push_back({id, std::move(node.callback)});
+                Release(index);
+            }
+
+            index = next;
+        }
+    }
+}
+
+uint64_t TimerService::TicksUntilNextEvent() const {
+    if (pending_ == 0) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    // 下一次进位时上层定时器可能降到第0层，因此最多休眠到进位点
+    uint64_t untilWrap = kSlots - (currentTick_ & (kSlots - 1));
+
+    uint64_t bits = occupied_[0];
+    if (bits == 0) {
+        return untilWrap;
+    }
+
+    int shift = static_cast<int>((currentTick_ + 1) & (kSlots - 1));
+    uint64_t rotated = (shift == 0) ? bits : ((bits >> shift) | (bits << (kSlots - shift)));
+    uint64_t untilSlot = static_cast<uint64_t>(__builtin_ctzll(rotated)) + 1;
+
+    return std::min(untilSlot, untilWrap);
+}
+
+uint64_t TimerService::CurrentTargetTick() const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - origin_).count();
+    return static_cast<uint64_t>(elapsed / tickMs_);
+}
+
+void TimerService::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (running_) {
+        uint64_t target = CurrentTargetTick();
+        if (target > currentTick_) {
+            Advance(target);
+        }
+
+        if (!fired_.empty()) {
+            // 回调在锁外执行，允许在回调中再添加或取消定时器；
+            // 每个回调执行前在锁内取出，CancelAndWait置空的回调被跳过
+            for (size_t i = 0; i < fired_.size(); i++) {
+                Callback callback = std::move(fired_[i].callback);
+                if (!callback) {
+                    continue;
+                }
+                runningTimer_ = fired_[i].id;
+                lock.unlock();
+                callback();
+                callback = nullptr;
+                lock.lock();
+                runningTimer_ = kInvalidTimer;
+                callbackDone_.notify_all();
+            }
+            fired_.clear();
+            continue;
+        }
+
+        uint64_t wait = TicksUntilNextEvent();
+        if (wait == std::numeric_limits<uint64_t>::max()) {
+            cond_.wait(lock);
+        } else {
+            auto deadline = origin_ + std::chrono::milliseconds(
+                static_cast<int64_t>((currentTick_ + wait) * tickMs_));
+            cond_.wait_until(lock, deadline);
+        }
+    }
+}
+
+} // namespace gb28181
@@ -0,0 +1,123 @@
+#include "utils/xml_template.h"
+#include "utils/logger.h"
+#include <charconv>
+
+namespace gb28181 {
+
+namespace {
+
+// 需要转义的字符表
+struct EscapeTable {
+    bool special[256];
+
+    EscapeTable() : special() {
+        special[static_cast<unsigned char>('<')] = true;
+        special[static_cast<unsigned char>('>')] = true;
+        special[static_cast<unsigned char>('&')] = true;
+        special[static_cast<unsigned char>('"')] = true;
+        special[static_cast<unsigned char>('\'')] = true;
+    }
+};
+
+const EscapeTable kEscapeTable;
+
+} // namespace
+
+void XmlEscapeAppend(std::string& out, std::string_view text) {
+    size_t i = 0;
+    while (i < text.size() && !kEscapeTable.special[static_cast<unsigned char>(text[i])]) {
+        i++;
+    }
+
+    // 快速路径：没有特殊字符
+    if (i == text.size()) {
+        out.append(text.data(), text.size());
+        return;
+    }
+
+    out.append(text.data(), i);
+    for (; i < text.size(); i++) {
+        char c = text[i];
+        switch (c) {
+            case '<':  out.append("&lt;", 4); break;
+            case '>':  out.append("&gt;", 4); break;
+            case '&':  out.append("&amp;", 5); break;
+            case '"':  out.append("&quot;", 6); break;
+            case '\'': out.append("&apos;", 6); break;
+            default:   out.push_back(c); break;
+        }
+    }
+}
+
+void XmlValue::AppendTo(std::string& out) const {
+    if (!isNumber_) {
+        XmlEscapeAppend(out, text_);
+        return;
+    }
+
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), number_);
+    out.append(buf, result.ptr - buf);
+}
+
+XmlTemplate::XmlTemplate(std::string_view text) : staticSize_(0) {
+    size_t pos = 0;
+    std::string pending;
+
+    while (pos < text.size()) {
+        size_t open = text.find("{{", pos);
+        size_t close = (open == std::string_view::npos) ? open : text.find("}}", open + 2);
+        if (close == std::string_view::npos) {
+            pending.append(text.data() + pos, text.size() - pos);
+            break;
+        }
+
+        pending.append(text.data() + pos, open - pos);
+
+        std::string name(text.substr(open + 2, close - open - 2));
+        int field = -1;
+        for (size_t i = 0; i < fieldNames_.size(); i++) {
+            if (fieldNames_[i] == name) {
+                field = static_cast<int>(i);
+                break;
+            }
+        }
+        if (field < 0) {
+            field = static_cast<int>(fieldNames_.size());
+            fieldNames_.push_back(name);
+        }
+
+        staticSize_ += pending.size();
+        segments_.push_back(Segment{std::move(pending), field});
+        pending.clear();
+        pos = close + 2;
+    }
+
+    staticSize_ += pending.size();
+    segments_.push_back(Segment{std::move(pending), -1});
+}
+
+void XmlTemplate::Render(std::string& out, std::initializer_list<XmlValue> values) const {
+    out.clear();
+    RenderAppend(out, values);
+}
+
+void XmlTemplate::RenderAppend(std::string& out, std::initializer_list<XmlValue> values) const {
+    if (values.size() != fieldNames_.size()) {
+        LOG_ERROR("[XmlTemplate] Expected " << fieldNames_.size()
+                  << " fields, got " << values.size());
+        return;
+    }
+
+    const XmlValue *fields = values.begin();
+    out.reserve(out.size() + staticSize_ + fieldNames_.size() * 24);
+
+    for (const Segment& segment : segments_) {
+        out.append(segment.text);
+        if (segment.field >= 0) {
+            fields[segment.field].AppendTo(out);
+        }
+    }
+}
+
+} // namespace gb28181
@@ -0,0 +1,190 @@
+/**
+ * @brief 二进制事件日志解码工具
+ * 用法: gb28181_event_dump [--json] [--session <Call-ID>] <event_file>
+ */
+
+#include "utils/event_log.h"
+#include "sip/media_session.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace gb28181;
+
+namespace {
+
+struct DecodedRecord {
+    uint64_t seq;
+    uint64_t timestampNs;
+    uint64_t sessionHash;
+    uint16_t code;
+    uint16_t arg0;
+    uint32_t arg1;
+};
+
+void PrintUsage(const char *program) {
+    std::fprintf(stderr, "Usage: %s [--json] [--session <Call-ID>] <event_file>\n", program);
+}
+
+std::string FormatTime(uint64_t timestampNs) {
+    time_t seconds = static_cast<time_t>(timestampNs / 1000000000ULL);
+    struct tm tmTime;
+#ifdef _WIN32
+    localtime_s(&tmTime, &seconds);
+#else
+    localtime_r(&seconds, &tmTime);
+#endif
+    char buffer[64];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tmTime);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%09" PRIu64,
+                  static_cast<uint64_t>(timestampNs % 1000000000ULL));
+    return buffer;
+}
+
+std::string EventName(uint16_t code) {
+    const char *name = EventLog::GetEventName(code);
+    return name ? name : "EVENT_" + std::to_string(code);
+}
+
+bool IsSessionEvent(uint16_t code) {
+    return code >= static_cast<uint16_t>(EventCode::SESSION_CREATED) &&
+           code <= static_cast<uint16_t>(EventCode::SESSION_TIMEOUT);
+}
+
+void PrintText(const DecodedRecord& record) {
+    std::printf("%s #%" PRIu64 " session=%016" PRIx64 " %s",
+                FormatTime(record.timestampNs).c_str(), record.seq,
+                record.sessionHash, EventName(record.code).c_str());
+
+    if (IsSessionEvent(record.code)) {
+        std::printf(" state=%s",
+                    MediaSessionManager::GetStateName(static_cast<SessionState>(record.arg0)).c_str());
+        if (record.code == static_cast<uint16_t>(EventCode::SESSION_STATE_CHANGED) ||
+            record.code == static_cast<uint16_t>(EventCode::SESSION_TIMEOUT)) {
+            std::printf(" from=%s",
+                        MediaSessionManager::GetStateName(static_cast<SessionState>(record.arg1)).c_str());
+        } else if (record.arg1 != 0) {
+            std::printf(" ssrc=%" PRIu32, record.arg1);
+        }
+    } else {
+        std::printf(" arg0=%u tid=%" PRIu32, record.arg0, record.arg1);
+    }
+    std::printf("\n");
+}
+
+void PrintJson(const DecodedRecord& record, bool first) {
+    std::printf("%s\n  {\"seq\": %" PRIu64 ", \"time\": \"%s\", \"timestampNs\": %" PRIu64
+                ", \"session\": \"%016" PRIx64 "\", \"event\": \"%s\", \"code\": %u"
+                ", \"arg0\": %u, \"arg1\": %" PRIu32 "}",
+                first ? "" : ",", record.seq, FormatTime(record.timestampNs).c_str(),
+                record.timestampNs, record.sessionHash, EventName(record.code).c_str(),
+                record.code, record.arg0, record.arg1);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    bool json = false;
+    bool filterSession = false;
+    uint64_t sessionHash = 0;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (std::strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+            filterSession = true;
+            sessionHash = EventLog::HashSession(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!path) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+
+    // 文件头和记录中的原子字段按普通整数读取，布局见EventLogHeader/EventRecord
+    unsigned char header[sizeof(EventLogHeader)];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        std::fprintf(stderr, "%s: file too short\n", path);
+        return 1;
+    }
+
+    uint32_t version = 0;
+    uint32_t recordSize = 0;
+    uint64_t capacity = 0;
+    uint64_t writeIndex = 0;
+    std::memcpy(&version, header + offsetof(EventLogHeader, version), sizeof(version));
+    std::memcpy(&recordSize, header + offsetof(EventLogHeader, recordSize), sizeof(recordSize));
+    std::memcpy(&capacity, header + offsetof(EventLogHeader, capacity), sizeof(capacity));
+    std::memcpy(&writeIndex, header + offsetof(EventLogHeader, writeIndex), sizeof(writeIndex));
+
+    if (std::memcmp(header, EventLog::kMagic, sizeof(EventLog::kMagic)) != 0 ||
+        version != EventLog::kVersion || recordSize != sizeof(EventRecord) ||
+        capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        std::fprintf(stderr, "%s: not a GB28181 event log (or unsupported version)\n", path);
+        return 1;
+    }
+
+    std::vector<DecodedRecord> records;
+    unsigned char raw[sizeof(EventRecord)];
+    for (uint64_t slot = 0; slot < capacity && file.read(reinterpret_cast<char*>(raw), sizeof(raw)); slot++) {
+        DecodedRecord record;
+        std::memcpy(&record.seq, raw + offsetof(EventRecord, seq), sizeof(record.seq));
+        std::memcpy(&record.timestampNs, raw + offsetof(EventRecord, timestampNs), sizeof(record.timestampNs));
+        std::memcpy(&record.sessionHash, raw + offsetof(EventRecord, sessionHash), sizeof(record.sessionHash));
+        std::memcpy(&record.code, raw + offsetof(EventRecord, code), sizeof(record.code));
+        std::memcpy(&record.arg0, raw + offsetof(EventRecord, arg0), sizeof(record.arg0));
+        std::memcpy(&record.arg1, raw + offsetof(EventRecord, arg1), sizeof(record.arg1));
+
+        // 空槽、写到一半或序号与槽位不符的记录跳过
+        if (record.seq == 0 || ((record.seq - 1) & (capacity - 1)) != slot) {
+            continue;
+        }
+        record.seq -= 1;
+
+        if (filterSession && record.sessionHash != sessionHash) {
+            continue;
+        }
+        records.push_back(record);
+    }
+
+    std::sort(records.begin(), records.end(), [](const DecodedRecord& a, const DecodedRecord& b) {
+        return a.seq < b.seq;
+    });
+
+    if (json) {
+        std::printf("{\"capacity\": %" PRIu64 ", \"writeIndex\": %" PRIu64 ", \"events\": [",
+                    capacity, writeIndex);
+        for (size_t i = 0; i < records.size(); i++) {
+            PrintJson(records[i], i == 0);
+        }
+        std::printf("%s]}\n", records.empty() ? "" : "\n");
+    } else {
+        for (const DecodedRecord& record : records) {
+            PrintText(record);
+        }
+        uint64_t lost = writeIndex > capacity ? writeIndex - capacity : 0;
+        std::fprintf(stderr, "%zu events decoded, %" PRIu64 " written, %" PRIu64 " overwritten\n",
+                     records.size(), writeIndex, lost);
+    }
+
+    return 0;
+}